@@ -12,8 +12,8 @@ template <typename T>
 std::unique_ptr<T[]> CreateRandomNDArray(const int sidelength, const int ndims);
 
 template <>
-std::unique_ptr<std::int16_t[]> CreateRandomNDArray(const int sidelength,
-                                                    const int ndims)
+inline std::unique_ptr<std::int16_t[]> CreateRandomNDArray(
+    const int sidelength, const int ndims)
 {
   const auto nelems = std::pow(sidelength, ndims);
   auto values = std::make_unique<std::int16_t[]>(nelems);
@@ -30,8 +30,8 @@ std::unique_ptr<std::int16_t[]> CreateRandomNDArray(const int sidelength,
 }
 
 template <>
-std::unique_ptr<float[]> CreateRandomNDArray(const int sidelength,
-                                             const int ndims)
+inline std::unique_ptr<float[]> CreateRandomNDArray(const int sidelength,
+                                                    const int ndims)
 {
   const auto nelems = std::pow(sidelength, ndims);
   auto values = std::make_unique<float[]>(nelems);
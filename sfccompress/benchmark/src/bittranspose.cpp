@@ -67,4 +67,40 @@ BENCHMARK_TEMPLATE(BM_Bittranspose_Reverse, float, std::int32_t)
     ->Ranges({{1 << 4, 1 << 11}, {2, 2}});
 BENCHMARK_TEMPLATE(BM_Bittranspose_Reverse, float, std::int32_t)
     ->RangeMultiplier(2)
-    ->Ranges({{1 << 4, 1 << 9}, {3, 3}});
\ No newline at end of file
+    ->Ranges({{1 << 4, 1 << 9}, {3, 3}});
+// Forward and reverse with each kernel, on the same data
+
+template <typename T, typename U>
+static void BM_Bittranspose_Kernel(benchmark::State& state)
+{
+  static_assert(sizeof(T) == sizeof(U));
+  const auto sidelength = state.range(0);
+  const auto ndims = state.range(1);
+  const auto kernel = sfcc::BitTransposeKernel(state.range(2));
+  if (!sfcc::bitTransposeKernelSupported(kernel)) {
+    state.SkipWithError("Kernel is not supported by this CPU");
+    return;
+  }
+  const auto nelems = std::pow(sidelength, ndims);
+  auto data = CreateRandomNDArray<T>(sidelength, ndims);
+  sfcc::BitTransposer bittranposer(kernel);
+  for (auto _ : state) {
+    bittranposer.transpose_t<U>((U*)data.get(), nelems);
+    bittranposer.reverse_transpose_t<U>((U*)data.get(), nelems);
+  }
+  state.SetBytesProcessed(state.iterations() * 2 * nelems * sizeof(T));
+}
+
+BENCHMARK_TEMPLATE(BM_Bittranspose_Kernel, std::int16_t, std::int16_t)
+    ->ArgNames({"sidelength", "ndims", "kernel"})
+    ->ArgsProduct({{1 << 6, 1 << 8}, {3},
+                   {int(sfcc::BitTransposeKernel::SCALAR),
+                    int(sfcc::BitTransposeKernel::SSE2),
+                    int(sfcc::BitTransposeKernel::AVX2)}});
+
+BENCHMARK_TEMPLATE(BM_Bittranspose_Kernel, float, std::int32_t)
+    ->ArgNames({"sidelength", "ndims", "kernel"})
+    ->ArgsProduct({{1 << 6, 1 << 8}, {3},
+                   {int(sfcc::BitTransposeKernel::SCALAR),
+                    int(sfcc::BitTransposeKernel::SSE2),
+                    int(sfcc::BitTransposeKernel::AVX2)}});
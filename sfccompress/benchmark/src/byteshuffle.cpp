@@ -0,0 +1,41 @@
+#include <benchmark/benchmark.h>
+#include <bittranspose_utils.h>
+#include <byteshuffle.h>
+#include <memory>
+
+// Forward and reverse with each kernel, on the same data
+
+template <typename T>
+static void BM_Byteshuffle_Kernel(benchmark::State& state)
+{
+  const auto sidelength = state.range(0);
+  const auto ndims = state.range(1);
+  const auto kernel = sfcc::ByteShuffleKernel(state.range(2));
+  if (!sfcc::byteShuffleKernelSupported(kernel)) {
+    state.SkipWithError("Kernel is not supported by this CPU");
+    return;
+  }
+  const auto nelems = std::pow(sidelength, ndims);
+  auto data = CreateRandomNDArray<T>(sidelength, ndims);
+  sfcc::ByteShuffler shuffler(kernel);
+  for (auto _ : state) {
+    shuffler.shuffle((std::uint8_t*)data.get(), nelems * sizeof(T), sizeof(T));
+    shuffler.reverse_shuffle((std::uint8_t*)data.get(), nelems * sizeof(T),
+                             sizeof(T));
+  }
+  state.SetBytesProcessed(state.iterations() * 2 * nelems * sizeof(T));
+}
+
+BENCHMARK_TEMPLATE(BM_Byteshuffle_Kernel, std::int16_t)
+    ->ArgNames({"sidelength", "ndims", "kernel"})
+    ->ArgsProduct({{1 << 6, 1 << 8}, {3},
+                   {int(sfcc::ByteShuffleKernel::SCALAR),
+                    int(sfcc::ByteShuffleKernel::SSE2),
+                    int(sfcc::ByteShuffleKernel::AVX2)}});
+
+BENCHMARK_TEMPLATE(BM_Byteshuffle_Kernel, float)
+    ->ArgNames({"sidelength", "ndims", "kernel"})
+    ->ArgsProduct({{1 << 6, 1 << 8}, {3},
+                   {int(sfcc::ByteShuffleKernel::SCALAR),
+                    int(sfcc::ByteShuffleKernel::SSE2),
+                    int(sfcc::ByteShuffleKernel::AVX2)}});
@@ -0,0 +1,74 @@
+#include <benchmark/benchmark.h>
+#include <pipeline.h>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+// Round trips of pipelines on a smooth noisy field, the kind of data the
+// transforms are meant for. New combinations only need a line in Specs.
+
+static const std::vector<std::string> Specs = {
+    "bitshuffle|bwt|mtf|rle|huffman",
+    "bitshuffle|bwt|mtf|rle_varint|huffman16",
+    "bitshuffle|bitplane",
+    "byteshuffle|fse",
+    "byteshuffle|bwt|mtf|fse",
+    "byteshuffle|deflate",
+    "bwt|mtf|rle_varint|huffman16_x4",
+    "delta|byteshuffle|fse",
+    "lorenzo|byteshuffle|fse",
+    "lorenzo|byteshuffle|deflate",
+};
+
+static std::vector<std::uint8_t> CreateSmoothField(const int sidelength)
+{
+  std::vector<std::uint8_t> data(sidelength * sidelength * sidelength *
+                                 sizeof(std::int16_t));
+  auto values = reinterpret_cast<std::int16_t*>(data.data());
+  std::mt19937 rng(7);
+  std::normal_distribution<double> noise(0, 4);
+  for (auto z = 0; z < sidelength; z++)
+    for (auto y = 0; y < sidelength; y++)
+      for (auto x = 0; x < sidelength; x++)
+        *values++ = std::int16_t(
+            1000 * std::sin(x * 0.05) * std::cos(y * 0.07) + 20 * z +
+            noise(rng));
+  return data;
+}
+
+static void BM_Pipeline(benchmark::State& state, const std::string& spec)
+{
+  const auto sidelength = state.range(0);
+  const auto data = CreateSmoothField(sidelength);
+  sfc::sfcc_header header{};
+  header.ndims = 3;
+  header.sidelength_k = std::uint8_t(std::log2(sidelength));
+  header.dtype_nbytes = sizeof(std::int16_t);
+  sfcc::pipeline pipeline(sfcc::parsePipeline(spec).stages);
+  std::vector<std::uint8_t> compressed(
+      pipeline.maxCompressedSize(data.size(), header));
+  std::vector<std::uint8_t> decompressed(data.size());
+  unsigned long long compressed_length = 0;
+  for (auto _ : state) {
+    sfc::sfcc_header compressed_header;
+    std::tie(compressed_length, compressed_header) =
+        pipeline.compressInto(data.data(), data.size(), compressed.data(),
+                              compressed.size(), header);
+    pipeline.decompressInto(compressed.data(), compressed_length,
+                            decompressed.data(), decompressed.size(),
+                            compressed_header);
+  }
+  state.SetBytesProcessed(state.iterations() * 2 * data.size());
+  state.counters["ratio"] = double(data.size()) / compressed_length;
+}
+
+static const int RegisterPipelines = []() {
+  for (const auto& spec : Specs)
+    benchmark::RegisterBenchmark(("BM_Pipeline/" + spec).c_str(), BM_Pipeline,
+                                 spec)
+        ->ArgName("sidelength")
+        ->Arg(1 << 6);
+  return 0;
+}();
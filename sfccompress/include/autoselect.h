@@ -0,0 +1,102 @@
+/**
+ * @file autoselect.h
+ * @author Conrad Haupt (conrad@conradhaupt.co.za)
+ * @brief Choice of curve, transform and codec from samples of the data
+ * @version 1.0
+ * @date 2020-03-26
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#ifndef SFCC_AUTOSELECT_H
+#define SFCC_AUTOSELECT_H
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "sfcc.h"
+
+namespace sfcc {
+
+// What a choice is scored by. MIXED weighs the two with ratio_weight.
+enum class objective_t
+{
+  RATIO,
+  DECODE_SPEED,
+  MIXED
+};
+extern std::unordered_map<std::string, objective_t> objective_string_t;
+
+// Applied after the curve and before the codec
+enum class transform_t
+{
+  NONE,
+  BITTRANSPOSE,
+  BYTESHUFFLE
+};
+std::string tostring(transform_t transform);
+
+struct auto_candidate
+{
+  ::sfc::sfcc::sfc_t curve;
+  transform_t transform;
+  ::sfc::sfcc::compression_t codec;
+  // Order-1 entropy of the bytes of the samples, in bits per byte
+  double entropy;
+  double ratio;
+  // Bytes per second decoded, including the reverse transform and reordering
+  double decode_speed;
+  double score;
+};
+
+struct auto_options
+{
+  objective_t objective = objective_t::RATIO;
+  // Share of a MIXED score given to the ratio, the rest going to decode speed
+  double ratio_weight = 0.5;
+  // Sub-cubes sampled, each of at most sample_bytes
+  int nsamples = 8;
+  unsigned long long sample_bytes = 1ULL << 16;
+  // Number of curve and transform pairs, those with the lowest entropy, whose
+  // samples are trial encoded with every codec
+  int ntrials = 4;
+  // Level of LZ77 and DEFLATE, else the default of each
+  std::optional<int> level;
+  unsigned int seed = 0;
+  // Every codec of the compress command but NONE. The BZIP codecs and BWT
+  // only encode whole blocks of 1 MiB, so they are left out of the default, as
+  // a sample that large costs more than it saves.
+  std::vector<::sfc::sfcc::compression_t> codecs = {
+      ::sfc::sfcc::compression_t::RLE,
+      ::sfc::sfcc::compression_t::HUFFMAN,
+      ::sfc::sfcc::compression_t::HUFFMAN16,
+      ::sfc::sfcc::compression_t::HUFFMAN16_X4,
+      ::sfc::sfcc::compression_t::FSE,
+      ::sfc::sfcc::compression_t::BITPLANE,
+      ::sfc::sfcc::compression_t::RLE_VARINT,
+      ::sfc::sfcc::compression_t::LZ77,
+      ::sfc::sfcc::compression_t::LZ78,
+      ::sfc::sfcc::compression_t::LZW,
+      ::sfc::sfcc::compression_t::DEFLATE};
+};
+
+// Rank the combinations for data, the row-major array described by header,
+// by sampling sub-cubes of it rather than compressing all of it. Every curve
+// and transform pair is applied to the samples and ranked by the entropy of
+// the result, which is cheap to estimate, and the best ntrials pairs are trial
+// encoded with each codec. Returns the trial encodes that decode back to the
+// samples, best first. Curves are only tried for 2D and 3D arrays of 2- or
+// 4-byte values, which is what they reorder, and the transforms for values
+// they change.
+std::vector<auto_candidate> rankCandidates(
+    const std::uint8_t* data, const sfc::sfcc_header& header,
+    const auto_options& options = auto_options());
+// The first of rankCandidates()
+auto_candidate autoSelect(const std::uint8_t* data,
+                          const sfc::sfcc_header& header,
+                          const auto_options& options = auto_options());
+
+}  // namespace sfcc
+
+#endif
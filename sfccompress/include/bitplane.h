@@ -0,0 +1,63 @@
+/**
+ * @file bitplane.h
+ * @author Conrad Haupt (conrad@conradhaupt.co.za)
+ * @brief Context-modelled binary range coding of bit-transposed planes
+ * @version 1.0
+ * @date 2020-03-14
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#ifndef LIBSFCC_BITPLANE_H
+#define LIBSFCC_BITPLANE_H
+
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+// After bit transposition the data is a run of planes, each holding one bit of
+// every value in curve order. Every bit is coded with an adaptive binary range
+// coder. Its probability comes from a model selected by the plane, the
+// preceding bits of the plane and the bits around it in the two more
+// significant planes, which are coded first. Constant planes are not stored at
+// all and planes that do not compress are copied.
+namespace bitplane {
+
+// Probabilities are ProbabilityBits wide and move 1/2^AdaptationShift of the
+// way towards each coded bit
+constexpr int ProbabilityBits = 12;
+constexpr int AdaptationShift = 4;
+// Number of preceding bits of the same plane in the context
+constexpr int HistoryBits = 6;
+constexpr int MaxPlanes = 64;
+
+// Number of bytes in each plane of length bytes of bit-transposed values that
+// are dtypeNBytes wide, matching sfcc::BitTransposer. Bytes past the last plane
+// are stored as they are.
+unsigned long long planeSizeBytes(unsigned long long length, int dtypeNBytes);
+
+// Largest stream easyEncode() can output for length bytes in nplanes planes
+unsigned long long maxCompressedSize(unsigned long long length, int nplanes);
+
+// Encode length bytes made up of nplanes planes of planeBytes bytes each, least
+// significant plane first, followed by any remaining bytes. A single plane
+// covering all of the data codes it as a flat bit stream.
+std::tuple<std::unique_ptr<std::uint8_t[]>, unsigned long long> easyEncode(
+    const std::uint8_t* uncompressed, unsigned long long length, int nplanes,
+    unsigned long long planeBytes);
+
+// Size in bytes of the data held by an encoded stream
+unsigned long long decodedSizeBytes(const std::uint8_t* compressed,
+                                    unsigned long long compressedSizeBytes);
+
+// Decode a stream into uncompressed, which must hold at least
+// decodedSizeBytes() bytes. Returns the number of bytes written.
+unsigned long long easyDecode(const std::uint8_t* compressed,
+                              unsigned long long compressedSizeBytes,
+                              std::uint8_t* uncompressed,
+                              unsigned long long uncompressedSizeBytes);
+
+}  // namespace bitplane
+#endif
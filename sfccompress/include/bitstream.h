@@ -28,6 +28,8 @@
 #include <algorithm>
 #include <cassert>
 #include <cstdint>
+#include <cstring>
+#include <limits>
 #include <stdexcept>
 #include <string>
 #include "utils.h"
@@ -70,17 +72,27 @@ class Code final
 // class BitStreamWriter:
 // ========================================================
 
+// Bits are packed LSB-first into a 64-bit accumulator which is stored to the
+// output as a whole (unaligned, little-endian) word after every append. Only
+// the completed bytes are then retired from the accumulator, so the buffer
+// always holds every bit written so far and no explicit flush is needed. The
+// buffer keeps SlackBytes of room past the last byte for the word stores.
 class BitStreamWriter final
 {
  public:
+  static constexpr int SlackBytes = sizeof(std::uint64_t);
+  // Largest bit count that can be appended with a single word store.
+  static constexpr int MaxBitsPerStore = 56;
+
   // No copy/assignment.
   BitStreamWriter(const BitStreamWriter &) = delete;
   BitStreamWriter &operator=(const BitStreamWriter &) = delete;
 
   BitStreamWriter();
-  explicit BitStreamWriter(int initialSizeInBits, int growthGranularity = 2);
+  explicit BitStreamWriter(std::uint64_t initialSizeInBits,
+                           int growthGranularity = 2);
 
-  void allocate(int bitsWanted);
+  void allocate(std::uint64_t bitsWanted);
   void setGranularity(int growthGranularity);
   std::uint8_t *release();
 
@@ -93,71 +105,182 @@ class BitStreamWriter final
   void appendBitString(const std::string &bitStr);
 #endif  // HUFFMAN_NO_STD_STRING
 
-  int getByteCount() const;
-  int getBitCount() const;
+  std::uint64_t getByteCount() const;
+  std::uint64_t getBitCount() const;
   const std::uint8_t *getBitStream() const;
 
   ~BitStreamWriter();
 
  private:
   void internalInit();
-  static std::uint8_t *allocBytes(int bytesWanted, std::uint8_t *oldPtr,
-                                  int oldSize);
+  void grow();
+  void putBits(std::uint64_t num, int bitCount);
+  static std::uint8_t *allocBytes(std::uint64_t bytesWanted,
+                                  std::uint8_t *oldPtr, std::uint64_t oldSize);
 
   std::uint8_t *stream;  // Growable buffer to store our bits. Heap allocated &
                          // owned by the class instance.
-  int bytesAllocated;    // Current size of heap-allocated stream buffer *in
-                         // bytes*.
+  std::uint64_t bytesAllocated;  // Current size of heap-allocated stream
+                                 // buffer *in bytes*, excluding the
+                                 // SlackBytes.
   int granularity;  // Amount bytesAllocated multiplies by when auto-resizing in
-                    // appendBit().
-  int currBytePos;  // Current byte being written to, from 0 to
-                    // bytesAllocated-1.
-  int nextBitPos;   // Bit position within the current byte to access next. 0
-                    // to 7.
-  int numBitsWritten;  // Number of bits in use from the stream buffer, not
-                       // including byte-rounding padding.
+                    // grow().
+  std::uint64_t currBytePos;  // Byte holding the lowest pending accumulator
+                              // bit.
+  std::uint64_t bitBuffer;  // Pending bits of the current byte, LSB-first.
+  int bitBufferCount;       // Number of pending bits in bitBuffer. 0 to 7.
+  std::uint64_t numBitsWritten;  // Number of bits in use from the stream
+                                 // buffer, not including byte-rounding
+                                 // padding.
 };
 
 // ========================================================
 // class BitStreamReader:
 // ========================================================
 
+// Reads the LSB-first streams produced by BitStreamWriter. Whole words are
+// loaded into a 64-bit accumulator which always holds at least 56 valid bits
+// after a refill, so peekBits()/skipBits() can be used for table-driven
+// decoding without touching the stream for every bit. Reading past the end of
+// the stream yields zero bits.
 class BitStreamReader final
 {
  public:
+  // Largest bit count that can be peeked after a single refill.
+  static constexpr int MaxPeekBits = 56;
+
   // No copy/assignment.
   BitStreamReader(const BitStreamReader &) = delete;
   BitStreamReader &operator=(const BitStreamReader &) = delete;
 
   BitStreamReader(const BitStreamWriter &bitStreamWriter);
-  BitStreamReader(const std::uint8_t *bitStream, int byteCount, int bitCount);
+  BitStreamReader(const std::uint8_t *bitStream, std::uint64_t byteCount,
+                  std::uint64_t bitCount);
 
   void reset();
-  bool readNextBit();
+  bool isEndOfStream() const { return numBitsRead >= sizeInBits; }
+  bool readNextBit(int &bitOut);
   std::uint64_t readBitsU64(int bitCount);
 
+  // Look at the next bitCount (<= MaxPeekBits) bits without consuming them.
+  std::uint64_t peekBits(int bitCount);
+  // Consume bitCount bits, which must have been made available by peekBits().
+  void skipBits(int bitCount);
+
   // Basic stream info:
-  int getByteCount() const;
-  int getBitCount() const;
+  std::uint64_t getByteCount() const;
+  std::uint64_t getBitCount() const;
+  std::uint64_t getBitsRead() const { return numBitsRead; }
   const std::uint8_t *getBitStream() const;
 
-  // Current Huffman code being read from the stream:
-  void clearCode();
-  Code getCode() const;
-  int getCodeLength() const;
-
  private:
+  void refill();
+
   const std::uint8_t
       *stream;  // Pointer to the external bit stream. Not owned by the reader.
-  const int
+  const std::uint64_t
       sizeInBytes;  // Size of the stream *in bytes*. Might include padding.
-  const int sizeInBits;  // Size of the stream *in bits*, padding *not* include.
-  int currBytePos;       // Current byte being read in the stream.
-  int nextBitPos;   // Bit position within the current byte to access next. 0
-                    // to 7.
-  int numBitsRead;  // Total bits read from the stream so far. Never includes
-                    // byte-rounding padding.
-  Code currCode;  // Current Huffman code being built from the input bit stream.
+  const std::uint64_t
+      sizeInBits;  // Size of the stream *in bits*, padding *not* include.
+  std::uint64_t currBytePos;  // Next byte of the stream to load into
+                              // bitBuffer.
+  std::uint64_t bitBuffer;  // Bits loaded but not yet consumed, LSB-first.
+  int bitBufferCount;       // Number of valid bits in bitBuffer.
+  std::uint64_t numBitsRead;  // Total bits read from the stream so far.
+                              // Never includes byte-rounding padding.
 };
+
+// ========================================================
+// Inline hot paths:
+// ========================================================
+
+inline void BitStreamWriter::putBits(const std::uint64_t num,
+                                     const int bitCount)
+{
+  assert(bitCount <= MaxBitsPerStore);
+  const std::uint64_t mask = (std::uint64_t(1) << bitCount) - 1;
+  bitBuffer |= (num & mask) << bitBufferCount;
+  bitBufferCount += bitCount;
+  numBitsWritten += bitCount;
+
+  // The word store may touch the SlackBytes past the end of the buffer
+  if (currBytePos + (bitBufferCount >> 3) >= bytesAllocated) {
+    grow();
+  }
+  std::memcpy(stream + currBytePos, &bitBuffer, sizeof(bitBuffer));
+
+  // Retire the completed bytes
+  currBytePos += bitBufferCount >> 3;
+  bitBuffer >>= (bitBufferCount & ~7);
+  bitBufferCount &= 7;
+}
+
+inline void BitStreamWriter::appendBit(const int bit) { putBits(bit & 1, 1); }
+
+inline void BitStreamWriter::appendBitsU64(const std::uint64_t num,
+                                           const int bitCount)
+{
+  assert(bitCount <= 64);
+  if (bitCount > MaxBitsPerStore) {
+    putBits(num, 32);
+    putBits(num >> 32, bitCount - 32);
+  } else {
+    putBits(num, bitCount);
+  }
+}
+
+inline void BitStreamWriter::appendCode(const Code code)
+{
+  appendBitsU64(code.getAsU64(), code.getLength());
+}
+
+inline void BitStreamReader::refill()
+{
+  if (currBytePos + sizeof(std::uint64_t) <= sizeInBytes) {
+    // Branch-free refill: load a whole word and keep as many bytes as fit
+    std::uint64_t word;
+    std::memcpy(&word, stream + currBytePos, sizeof(word));
+    bitBuffer |= word << bitBufferCount;
+    currBytePos += (63 - bitBufferCount) >> 3;
+    bitBufferCount |= MaxPeekBits;
+  } else {
+    // Tail of the stream, bits past the end read as zero
+    while (bitBufferCount <= MaxPeekBits) {
+      if (currBytePos < sizeInBytes) {
+        bitBuffer |= std::uint64_t(stream[currBytePos]) << bitBufferCount;
+      }
+      ++currBytePos;
+      bitBufferCount += 8;
+    }
+  }
+}
+
+inline std::uint64_t BitStreamReader::peekBits(const int bitCount)
+{
+  assert(bitCount <= MaxPeekBits);
+  if (bitBufferCount < bitCount) {
+    refill();
+  }
+  return bitBuffer & ((std::uint64_t(1) << bitCount) - 1);
+}
+
+inline void BitStreamReader::skipBits(const int bitCount)
+{
+  assert(bitCount <= bitBufferCount);
+  bitBuffer >>= bitCount;
+  bitBufferCount -= bitCount;
+  numBitsRead += bitCount;
+}
+
+inline bool BitStreamReader::readNextBit(int &bitOut)
+{
+  if (numBitsRead >= sizeInBits) {
+    return false;  // We are done.
+  }
+  bitOut = static_cast<int>(peekBits(1));
+  skipBits(1);
+  return true;
+}
+
 };  // namespace sfcc
 #endif
\ No newline at end of file
@@ -14,7 +14,12 @@
 #include <bitset>
 #include <cassert>
 #include <climits>
+#include <cstdint>
 #include <iostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
 namespace sfcc {
 template <typename T>
 void bittranspose(T* input, T** output)
@@ -54,55 +59,149 @@ void reverse_bittranspose(T** input, T* output)
   }
 }
 
+// Implementations of the block transpose, all with the output of
+// bittranspose(). SSE2 and AVX2 are only supported on x86 CPUs with them.
+enum class BitTransposeKernel { SCALAR, SSE2, AVX2 };
+
+bool bitTransposeKernelSupported(BitTransposeKernel kernel);
+// The fastest kernel supported by the CPU
+BitTransposeKernel bestBitTransposeKernel();
+
+// Transpose nblocks consecutive blocks of 16 or 32 values, so that word i of
+// block b, bit i of each of its values, is written to output[i * nblocks + b].
+// The reverse reads that layout back into consecutive blocks. Unsupported
+// kernels throw std::invalid_argument.
+void bittransposeBlocks(const std::uint16_t* input, std::uint16_t* output,
+                        unsigned long long nblocks, BitTransposeKernel kernel);
+void bittransposeBlocks(const std::uint32_t* input, std::uint32_t* output,
+                        unsigned long long nblocks, BitTransposeKernel kernel);
+void reverseBittransposeBlocks(const std::uint16_t* input,
+                               std::uint16_t* output,
+                               unsigned long long nblocks,
+                               BitTransposeKernel kernel);
+void reverseBittransposeBlocks(const std::uint32_t* input,
+                               std::uint32_t* output,
+                               unsigned long long nblocks,
+                               BitTransposeKernel kernel);
+
 class BitTransposer
 {
- public:
-  BitTransposer() {}
+ private:
+  BitTransposeKernel _kernel;
+  unsigned long long _blockBytes;
 
+  // Transpose every whole block of nbits values of input into output, one
+  // plane after the other. output must be zeroed.
   template <typename T>
-  void transpose_t(T* data, unsigned long long length)
+  void transposeInto(T* input, unsigned long long length, T* output) const
   {
-    const auto nbits = sizeof(T) * CHAR_BIT;
+    constexpr auto nbits = sizeof(T) * CHAR_BIT;
     // Number of T in block
-    const auto blocklength = length / (sizeof(T) * CHAR_BIT);
-    T** transpose_output = new T*[nbits];
-    T* output_data = new T[length]();
+    const auto blocklength = length / nbits;
+    if constexpr (sizeof(T) == 2 || sizeof(T) == 4) {
+      using U = std::make_unsigned_t<T>;
+      bittransposeBlocks((const U*)input, (U*)output, blocklength, _kernel);
+      return;
+    }
+    T* transpose_output[nbits];
     for (auto i = 0; i < nbits; i++)
-      transpose_output[i] = output_data + (blocklength * i);
+      transpose_output[i] = output + (blocklength * i);
 
-    auto current_read = data;
-    for (auto i = 0; i < blocklength; i++) {
+    auto current_read = input;
+    for (auto i = 0ULL; i < blocklength; i++) {
       sfcc::bittranspose(current_read, transpose_output);
       current_read += nbits;
       std::for_each(transpose_output, transpose_output + nbits,
                     [](auto& out) { out++; });
     }
-    std::copy(output_data, output_data + length, data);
-    delete[] output_data;
-    delete[] transpose_output;
   }
   template <typename T>
-  void reverse_transpose_t(T* data, unsigned long long length)
+  void reverseTransposeInto(T* input, unsigned long long length,
+                            T* output) const
   {
-    const auto nbits = sizeof(T) * CHAR_BIT;
+    constexpr auto nbits = sizeof(T) * CHAR_BIT;
     // Number of T in block
-    const auto blocklength = length / (sizeof(T) * CHAR_BIT);
-    T** transpose_input = new T*[nbits];
-    T* output_data = new T[length]();
+    const auto blocklength = length / nbits;
+    if constexpr (sizeof(T) == 2 || sizeof(T) == 4) {
+      using U = std::make_unsigned_t<T>;
+      reverseBittransposeBlocks((const U*)input, (U*)output, blocklength,
+                                _kernel);
+      return;
+    }
+    T* transpose_input[nbits];
     for (auto i = 0; i < nbits; i++)
-      transpose_input[i] = data + (blocklength * i);
+      transpose_input[i] = input + (blocklength * i);
 
-    auto current_write = output_data;
-    for (auto i = 0; i < blocklength; i++) {
+    auto current_write = output;
+    for (auto i = 0ULL; i < blocklength; i++) {
       sfcc::reverse_bittranspose(transpose_input, current_write);
       current_write += nbits;
       std::for_each(transpose_input, transpose_input + nbits,
                     [](auto& out) { out++; });
     }
+  }
+
+  // Apply transform to each block of _blockBytes in place, through a scratch
+  // block. Values past the last whole block of nbits values are left as they
+  // are.
+  template <typename T, typename Transform>
+  void transformBlocks(T* data, unsigned long long length,
+                       Transform transform) const
+  {
+    constexpr auto nbits = sizeof(T) * CHAR_BIT;
+    if (_blockBytes % (sizeof(T) * nbits) != 0)
+      throw std::invalid_argument(
+          "Bit-transpose block size must be a multiple of " +
+          std::to_string(sizeof(T) * nbits) + " bytes");
+    const auto blockLength = _blockBytes / sizeof(T);
+    std::vector<T> scratch(std::min(blockLength, length));
+    for (auto start = 0ULL; start < length; start += blockLength) {
+      const auto n = std::min(blockLength, length - start);
+      const auto transposed = n / nbits * nbits;
+      std::fill(scratch.begin(), scratch.end(), T(0));
+      transform(data + start, n, scratch.data());
+      std::copy(scratch.data(), scratch.data() + transposed, data + start);
+    }
+  }
 
+ public:
+  // blockBytes of zero transposes the whole array at once, so that each bit
+  // plane spans all of it. Otherwise each block of blockBytes is transposed on
+  // its own, keeping the planes of a block together and the working set small.
+  BitTransposer(BitTransposeKernel kernel = bestBitTransposeKernel(),
+                unsigned long long blockBytes = 0)
+      : _kernel{kernel}, _blockBytes{blockBytes}
+  {}
+
+  unsigned long long blockBytes() const { return _blockBytes; }
+
+  template <typename T>
+  void transpose_t(T* data, unsigned long long length)
+  {
+    if (_blockBytes) {
+      transformBlocks(data, length, [this](T* in, auto n, T* out) {
+        transposeInto(in, n, out);
+      });
+      return;
+    }
+    T* output_data = new T[length]();
+    transposeInto(data, length, output_data);
+    std::copy(output_data, output_data + length, data);
+    delete[] output_data;
+  }
+  template <typename T>
+  void reverse_transpose_t(T* data, unsigned long long length)
+  {
+    if (_blockBytes) {
+      transformBlocks(data, length, [this](T* in, auto n, T* out) {
+        reverseTransposeInto(in, n, out);
+      });
+      return;
+    }
+    T* output_data = new T[length]();
+    reverseTransposeInto(data, length, output_data);
     std::copy(output_data, output_data + length, data);
     delete[] output_data;
-    delete[] transpose_input;
   }
 
   void transpose(std::uint8_t* data, unsigned long long length,
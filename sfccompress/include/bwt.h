@@ -13,102 +13,180 @@
 
 #include <algorithm>
 #include <cstring>
-#include <exception>
-#include <functional>
 #include <iostream>
+#include <limits>
 #include <memory>
+#include <stdexcept>
 #include <tuple>
+#include <type_traits>
 #include <vector>
 #include "sfcc.h"
 
 namespace sfcc {
 
 namespace bwt {
+
+// Suffix array of text[0, n), whose last symbol must be a unique 0 sentinel and
+// whose symbols are below alphabetSize. Built in O(n) time with SA-IS.
+void suffixArray(const std::uint32_t* text, std::int32_t* sa, std::int32_t n,
+                 std::uint32_t alphabetSize);
+
+// The byte BWT of a block is decoded as BlockStreams interleaved LF-mapping
+// walks, each producing one segment of the block, so that several cache misses
+// are in flight at once. Segment k starts at k * (length / nstreams), and its
+// walk starts from the row of the suffix at the start of segment k + 1.
+constexpr int BlockStreams = 8;
+// Rows are packed with a byte of output in 32 bits
+constexpr std::uint32_t MaxBlockLength = (1U << 24) - 2;
+
+// Number of streams a block of length bytes is decoded with
+inline int blockStreams(const std::uint32_t length)
+{
+  return length < std::uint32_t(BlockStreams) ? 1 : BlockStreams;
+}
+
+// BWT of length bytes into output, the same as divbwt(). The rows of the
+// suffixes starting segments 1 to nstreams - 1 are written to streamRows.
+// suffixes is scratch space for the suffix array. Returns the primary index.
+std::uint32_t byteBWT(const std::uint8_t* data, std::uint32_t length,
+                      std::uint8_t* output, std::uint32_t* streamRows,
+                      int nstreams, std::vector<std::int32_t>& suffixes);
+inline std::uint32_t byteBWT(const std::uint8_t* data,
+                             const std::uint32_t length, std::uint8_t* output,
+                             std::uint32_t* streamRows, const int nstreams)
+{
+  std::vector<std::int32_t> suffixes;
+  return byteBWT(data, length, output, streamRows, nstreams, suffixes);
+}
+
+// Invert byteBWT(), or divbwt() if nstreams is 1. rows is scratch space for
+// the LF mapping. Malformed indices throw std::runtime_error.
+void inverseByteBWT(const std::uint8_t* bwt, std::uint32_t length,
+                    std::uint32_t primaryIndex, const std::uint32_t* streamRows,
+                    int nstreams, std::uint8_t* output,
+                    std::vector<std::uint32_t>& rows);
+inline void inverseByteBWT(const std::uint8_t* bwt, const std::uint32_t length,
+                           const std::uint32_t primaryIndex,
+                           const std::uint32_t* streamRows, const int nstreams,
+                           std::uint8_t* output)
+{
+  std::vector<std::uint32_t> rows;
+  inverseByteBWT(bwt, length, primaryIndex, streamRows, nstreams, output,
+                 rows);
+}
+
+// Replace every value with its rank among the distinct values of data, offset
+// by offset, and return the number of distinct values. Ranks follow numeric
+// order, so the BWT sorts whole samples rather than their bytes.
 template <typename T>
-struct suffix
+std::uint32_t rankSymbols(const T* data, const unsigned long long length,
+                          std::uint32_t* ranks, const std::uint32_t offset)
 {
- private:
-  const T* begin;
-  const T* end;
-
- public:
-  suffix(const T* begin, const T* end) : begin{begin}, end{end} {}
-  bool compare(const T* lhs, const T* rhs)
-  {
-    // if (lhs > end || lhs < begin || rhs > end || rhs < begin)
-    //   throw std::runtime_error("pointers must be between begin and end");
-    auto lhs_length = end - lhs;
-    auto rhs_length = end - rhs;
-    auto result =
-        std::memcmp(lhs, rhs, std::min(lhs_length, rhs_length) * sizeof(T));
-    if (result < 0)
-      return true;
-    else if (result > 0)
-      return false;
-    else
-      return rhs_length > lhs_length;
+  if constexpr (std::is_integral_v<T> && sizeof(T) <= 2) {
+    // Narrow samples are ranked with a table over every possible value
+    constexpr auto lowest = std::int32_t(std::numeric_limits<T>::min());
+    std::vector<std::uint32_t> table(1U << (8 * sizeof(T)));
+    for (auto i = 0ULL; i < length; i++) table[data[i] - lowest] = 1;
+    std::uint32_t distinct = 0;
+    for (auto& rank : table)
+      if (rank) rank = offset + distinct++;
+    for (auto i = 0ULL; i < length; i++) ranks[i] = table[data[i] - lowest];
+    return distinct;
+  } else {
+    std::vector<T> values(data, data + length);
+    std::sort(values.begin(), values.end());
+    values.erase(std::unique(values.begin(), values.end()), values.end());
+    for (auto i = 0ULL; i < length; i++)
+      ranks[i] = offset + std::uint32_t(std::lower_bound(values.begin(),
+                                                         values.end(),
+                                                         data[i]) -
+                                        values.begin());
+    return std::uint32_t(values.size());
   }
-};
+}
 }  // namespace bwt
 
+// BWT of length samples followed by an end-of-line that sorts before every
+// sample. Returns the length + 1 output samples, the row of the rotation
+// starting at data[1] and the row of the end-of-line, whose output sample is a
+// copy of its neighbour.
 template <typename T>
 std::tuple< ::std::unique_ptr<std::uint8_t[]>, std::uint32_t, std::uint32_t>
 easyBWT(T* data, unsigned long long length)
 {
-  // Check if the block is all the same
-  auto [min, max] = std::minmax_element(data, data + length);
-  if (::sfc::DEBUG)
+  if (length >= std::uint64_t(std::numeric_limits<std::int32_t>::max()))
+    throw std::invalid_argument("BWT blocks must be shorter than 2^31 samples");
+  auto output = std::make_unique<std::uint8_t[]>((length + 1) * sizeof(T));
+  auto bwt_output = reinterpret_cast<T*>(output.get());
+  if (length == 0) return {std::move(output), std::uint32_t{}, std::uint32_t{}};
+
+  if (::sfc::DEBUG) {
+    auto [min, max] = std::minmax_element(data, data + length);
     std::cout << "BWT data with min=" << std::int16_t(*min)
               << " and max=" << std::int16_t(*max) << std::endl;
-  if (*min == *max) {
-    // Block is all the same value
-    auto bwt_output =
-        std::make_unique<std::uint8_t[]>((length + 1) * sizeof(T));
-    std::generate((T*)bwt_output.get(), (T*)bwt_output.get() + length + 1,
-                  [&min]() { return *min; });
-
-    return {std::move(bwt_output), std::uint32_t{}, std::uint32_t{}};
   }
 
-  bwt::suffix<T> suff(data, data + length);
-  auto data_set = std::make_unique<T*[]>(length + 1);
-  auto start = data;
-  std::generate(data_set.get(), data_set.get() + length + 1,
-                [&start]() { return start++; });
-  std::sort(data_set.get(), data_set.get() + length + 1,
-            std::bind(&bwt::suffix<T>::compare, suff, std::placeholders::_1,
-                      std::placeholders::_2));
-  auto bwt_output = std::make_unique<T[]>(length + 1);
-  auto index = 0ULL;
-  std::uint32_t first;
-  std::uint32_t last;
-  auto it = data_set.get();
-  for (auto index = 0ULL; index < length + 1; index++, it++) {
+  // Rank 0 is kept for the end-of-line
+  const auto n = std::int32_t(length + 1);
+  std::vector<std::uint32_t> text(n);
+  const auto alphabetSize = bwt::rankSymbols(data, length, text.data(), 1) + 1;
+  text[length] = 0;
+  std::vector<std::int32_t> sa(n);
+  bwt::suffixArray(text.data(), sa.data(), n, alphabetSize);
+  text = std::vector<std::uint32_t>();
+
+  std::uint32_t first = 0;
+  std::uint32_t last = 0;
+  for (auto index = 0; index < n; index++) {
+    const auto pos = sa[index];
     //  If the output is the end-of-line
-    if (*it == data) {
+    if (pos == 0) {
       last = index;
-      if (index == 0ULL)
-        // Make the current output value the next one
-        bwt_output[index] = *(*(it + 1) - 1);
-      else
-        bwt_output[index] = bwt_output[index - 1];
-      continue;
-
+      // The end-of-line suffix sorts first, so there is always a previous row
+      bwt_output[index] = bwt_output[index - 1];
     } else {
-      if (*it == (data + 1)) first = index;
-      // if the value is neither the beginning or the end
-      bwt_output[index] = *(*it - 1);
+      if (pos == 1) first = index;
+      bwt_output[index] = data[pos - 1];
     }
   }
-  auto output = std::make_unique<std::uint8_t[]>((length + 1) * sizeof(T));
-  std::move((std::uint8_t*)bwt_output.get(),
-            ((std::uint8_t*)bwt_output.get()) + ((length + 1) * sizeof(T)),
-            output.get());
   if (::sfc::DEBUG)
     std::cout << "BWT_OUTPUT Size: " << (length + 1) * sizeof(T) << std::endl;
   return {std::move(output), first, last};
 }
 
+// Invert easyBWT() given its length + 1 output samples and the row of the
+// end-of-line, writing the length original samples to data.
+template <typename T>
+void easyInverseBWT(const T* bwt, const unsigned long long length,
+                    const std::uint32_t last, T* data)
+{
+  if (length == 0) return;
+  if (last == 0 || last > length)
+    throw std::runtime_error("BWT end-of-line row is out of range");
+
+  // The LF mapping takes the row of a suffix to the row of the suffix one
+  // sample earlier: the rows of a symbol keep their order between the last
+  // and first columns, and the first column is the end-of-line followed by
+  // every sample in sorted order.
+  const auto n = length + 1;
+  std::vector<std::uint32_t> lf(n);
+  const auto distinct = bwt::rankSymbols(bwt, n, lf.data(), 0);
+  std::vector<std::uint32_t> next(distinct + 1);
+  for (auto i = 0ULL; i < n; i++)
+    if (i != last) next[lf[i] + 1]++;
+  next[0] = 1;
+  for (auto r = 1U; r <= distinct; r++) next[r] += next[r - 1];
+  for (auto i = 0ULL; i < n; i++)
+    if (i != last) lf[i] = next[lf[i]]++;
+
+  // Row 0 is the end-of-line suffix, preceded by the last sample
+  std::uint64_t row = 0;
+  for (auto i = length; i-- > 0;) {
+    data[i] = bwt[row];
+    row = lf[row];
+  }
+}
+
 }  // namespace sfcc
 
 #endif
\ No newline at end of file
@@ -0,0 +1,73 @@
+/**
+ * @file byteshuffle.h
+ * @author Conrad Haupt (conrad@conradhaupt.co.za)
+ * @brief Byte-plane shuffle of fixed-width values
+ * @version 1.0
+ * @date 2020-03-23
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#ifndef SFCC_BYTESHUFFLE_H
+#define SFCC_BYTESHUFFLE_H
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+
+namespace sfcc {
+
+// Implementations of the shuffle, all with the same output. SSE2 and AVX2 are
+// only supported on x86 CPUs with them.
+enum class ByteShuffleKernel { SCALAR, SSE2, AVX2 };
+
+bool byteShuffleKernelSupported(ByteShuffleKernel kernel);
+// The fastest kernel supported by the CPU
+ByteShuffleKernel bestByteShuffleKernel();
+
+// Byte b of every value of nbytes bytes in input is written to plane b of
+// output, so that output[b * nvalues + v] is byte b of value v. Bytes after
+// the last whole value are copied as they are. The reverse gathers the planes
+// back into values. Unsupported kernels throw std::invalid_argument.
+void byteShuffle(const std::uint8_t* input, std::uint8_t* output,
+                 unsigned long long length, int nbytes,
+                 ByteShuffleKernel kernel);
+void reverseByteShuffle(const std::uint8_t* input, std::uint8_t* output,
+                        unsigned long long length, int nbytes,
+                        ByteShuffleKernel kernel);
+
+// Byte shuffling groups bytes of the same significance, much like the bit
+// transpose groups bits, at the cost of a copy
+class ByteShuffler
+{
+ private:
+  ByteShuffleKernel _kernel;
+
+ public:
+  ByteShuffler(ByteShuffleKernel kernel = bestByteShuffleKernel())
+      : _kernel{kernel}
+  {}
+
+  void shuffle(std::uint8_t* data, unsigned long long length,
+               std::uint8_t dtype_nbytes) const
+  {
+    if (dtype_nbytes == 0 || length % dtype_nbytes != 0)
+      throw std::logic_error("Length must be divisible by dtype_nbytes");
+    auto output = std::make_unique<std::uint8_t[]>(length);
+    byteShuffle(data, output.get(), length, dtype_nbytes, _kernel);
+    std::copy(output.get(), output.get() + length, data);
+  }
+
+  void reverse_shuffle(std::uint8_t* data, unsigned long long length,
+                       std::uint8_t dtype_nbytes) const
+  {
+    if (dtype_nbytes == 0 || length % dtype_nbytes != 0)
+      throw std::logic_error("Length must be divisible by dtype_nbytes");
+    auto output = std::make_unique<std::uint8_t[]>(length);
+    reverseByteShuffle(data, output.get(), length, dtype_nbytes, _kernel);
+    std::copy(output.get(), output.get() + length, data);
+  }
+};
+}  // namespace sfcc
+
+#endif
@@ -0,0 +1,132 @@
+/**
+ * @file canonical_huffman.h
+ * @author Conrad Haupt (conrad@conradhaupt.co.za)
+ * @brief Length-limited canonical Huffman coding over 8- or 16-bit symbols
+ * @version 1.0
+ * @date 2020-03-09
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#ifndef LIBSFCC_CANONICAL_HUFFMAN_H
+#define LIBSFCC_CANONICAL_HUFFMAN_H
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+#include "bitstream.h"
+
+namespace sfcc {
+namespace canonical_huffman {
+
+// Codes of up to DecodeTableBits bits are decoded with a single lookup into a
+// table of 2^DecodeTableBits entries (8 KiB), longer codes fall back to a
+// canonical bit-by-bit search.
+constexpr int DecodeTableBits = 11;
+// Maximum code lengths. Byte codes always fit in the decode table, 16-bit
+// codes only have to be long enough to cover the full alphabet.
+constexpr int MaxCodeLength8 = 11;
+constexpr int MaxCodeLength16 = 16;
+// Number of independent bit streams used by the interleaved coder
+constexpr int NumStreams = 4;
+
+// Optimal code lengths, no longer than maxCodeLength, for the given symbol
+// frequencies using the package-merge algorithm. Symbols with a frequency of
+// zero get a length of zero.
+std::vector<std::uint8_t> lengthLimitedCodeLengths(
+    const std::vector<std::uint64_t>& frequencies, int maxCodeLength);
+
+// Canonical code for an alphabet, built from its code lengths. Codes are stored
+// bit-reversed so that they can be written to and read from the LSB-first bit
+// streams directly.
+class CodeTable
+{
+ public:
+  CodeTable() = default;
+  explicit CodeTable(std::vector<std::uint8_t> codeLengths);
+
+  static CodeTable fromFrequencies(
+      const std::vector<std::uint64_t>& frequencies, int maxCodeLength);
+
+  // Serialise the code lengths. The symbols are symbolBits bits wide.
+  void write(BitStreamWriter& writer, int symbolBits) const;
+  static CodeTable read(BitStreamReader& reader, int symbolBits);
+  // Upper bound on the number of bits written by write()
+  std::uint64_t tableSizeBits(int symbolBits) const;
+
+  void encode(BitStreamWriter& writer, unsigned symbol) const
+  {
+    writer.appendBitsU64(codes[symbol], lengths[symbol]);
+  }
+  unsigned decode(BitStreamReader& reader) const;
+
+  int getCodeLength(unsigned symbol) const { return lengths[symbol]; }
+  int getMaxCodeLength() const { return maxCodeLength; }
+  std::size_t alphabetSize() const { return lengths.size(); }
+
+ private:
+  unsigned decodeSlow(BitStreamReader& reader) const;
+
+  std::vector<std::uint8_t> lengths;
+  std::vector<std::uint32_t> codes;  // Bit-reversed canonical codes
+  // Number of codes of each length and the symbols ordered by (length, symbol)
+  std::array<std::uint32_t, MaxCodeLength16 + 1> lengthCounts{};
+  std::vector<std::uint16_t> sortedSymbols;
+  // Entries are (length << 16) | symbol, a length of zero marks a code longer
+  // than DecodeTableBits.
+  std::vector<std::uint32_t> decodeTable;
+  int maxCodeLength = 0;
+};
+
+inline unsigned CodeTable::decode(BitStreamReader& reader) const
+{
+  const auto entry = decodeTable[reader.peekBits(DecodeTableBits)];
+  const int length = entry >> 16;
+  if (length != 0) {
+    reader.skipBits(length);
+    return entry & 0xFFFF;
+  }
+  return decodeSlow(reader);
+}
+
+// Largest stream easyEncode() (or easyEncodeInterleaved()) can output for
+// nsymbols symbols of symbolBits bits
+unsigned long long maxCompressedSize(unsigned long long nsymbols,
+                                     int symbolBits, bool interleaved);
+
+// Encode nsymbols symbols of type TSymbol (std::uint8_t or std::uint16_t). The
+// symbol width and count are stored in the stream.
+template <typename TSymbol>
+std::tuple<std::unique_ptr<std::uint8_t[]>, unsigned long long> easyEncode(
+    const TSymbol* uncompressed, unsigned long long nsymbols);
+
+// Size in bytes of the data held by an encoded stream
+unsigned long long decodedSizeBytes(const std::uint8_t* compressed,
+                                    unsigned long long compressedSizeBytes);
+
+// Decode a stream into uncompressed, which must hold at least
+// decodedSizeBytes() bytes. Returns the number of bytes written.
+unsigned long long easyDecode(const std::uint8_t* compressed,
+                              unsigned long long compressedSizeBytes,
+                              std::uint8_t* uncompressed,
+                              unsigned long long uncompressedSizeBytes);
+
+// As easyEncode(), but the symbols are split into NumStreams contiguous parts
+// that are coded into separate bit streams with a jump table in the header, so
+// that the decoder can advance NumStreams independent bit positions at once.
+template <typename TSymbol>
+std::tuple<std::unique_ptr<std::uint8_t[]>, unsigned long long>
+easyEncodeInterleaved(const TSymbol* uncompressed, unsigned long long nsymbols);
+
+// Decode the output of easyEncodeInterleaved(). decodedSizeBytes() applies to
+// both stream formats.
+unsigned long long easyDecodeInterleaved(
+    const std::uint8_t* compressed, unsigned long long compressedSizeBytes,
+    std::uint8_t* uncompressed, unsigned long long uncompressedSizeBytes);
+
+}  // namespace canonical_huffman
+}  // namespace sfcc
+#endif
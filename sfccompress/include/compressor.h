@@ -13,18 +13,33 @@
 #define SFCC_COMPRESSOR_H
 #include <divsufsort.h>
 #include <algorithm>
+#include <cstring>
 #include <exception>
 #include <memory>
+#include <optional>
 #include <tuple>
+#include <vector>
+#include "bitplane.h"
 #include "bwt.h"
+#include "canonical_huffman.h"
+#include "deflate.h"
+#include "fse.h"
 #include "huffman.h"
 #include "lz77.h"
+#include "lz77_decoder.h"
+#include "lz77_encoder.h"
+#include "lz78.h"
 #include "lzw.h"
 #include "mtf.h"
 #include "rle.h"
+#include "rle_varint.h"
 #include "sfcc.h"
 namespace sfcc {
 
+// Throws std::length_error if an output of capacity bytes cannot hold the
+// required number
+void requireCapacity(unsigned long long capacity, unsigned long long required);
+
 class compressor
 {
  public:
@@ -33,36 +48,60 @@ class compressor
   compressor(const compressor& comp) = delete;
   virtual ~compressor() {}
 
+  // Compress length bytes of data into output, which may be preallocated or
+  // mapped memory. output must hold at least maxCompressedSize() bytes, an
+  // upper bound for any data of that length, or std::length_error is thrown.
+  // Returns the number of bytes written and the header of the output.
+  virtual unsigned long long maxCompressedSize(
+      unsigned long long length, const sfc::sfcc_header& header) const = 0;
+  virtual std::tuple<unsigned long long, sfc::sfcc_header> compressInto(
+      const std::uint8_t* data, unsigned long long length,
+      std::uint8_t* output, unsigned long long capacity,
+      const sfc::sfcc_header& header) = 0;
+  // As compressInto(), output holding at least maxDecompressedSize() bytes,
+  // which is exact where the stream records its size
+  virtual unsigned long long maxDecompressedSize(
+      const std::uint8_t* data, unsigned long long length,
+      const sfc::sfcc_header& header) const = 0;
+  virtual std::tuple<unsigned long long, sfc::sfcc_header> decompressInto(
+      const std::uint8_t* data, unsigned long long length,
+      std::uint8_t* output, unsigned long long capacity,
+      const sfc::sfcc_header& header) = 0;
+
+  // As compressInto() and decompressInto(), allocating the output. Only the
+  // returned number of bytes of it are valid.
   virtual std::tuple<std::unique_ptr<std::uint8_t[]>, unsigned long long,
                      sfc::sfcc_header>
   compress(const std::unique_ptr<std::uint8_t[]>& data,
-           const unsigned long long& length,
-           const sfc::sfcc_header& header) = 0;
+           const unsigned long long& length, const sfc::sfcc_header& header);
   virtual std::tuple<std::unique_ptr<std::uint8_t[]>, unsigned long long,
                      sfc::sfcc_header>
   decompress(const std::unique_ptr<std::uint8_t[]>& data,
-             const unsigned long long& length,
-             const sfc::sfcc_header& header) = 0;
+             const unsigned long long& length, const sfc::sfcc_header& header);
   virtual std::string getFileExtension() const = 0;
   virtual sfc::sfcc::compression_t getCompressionType() const = 0;
 };
 
-class no_compressor
+// Copies data as it is, the postcompressor of bzip<> for a plain BWT
+class no_compressor : public compressor
 {
  public:
   no_compressor();
-  // We don't want to copy as std::unique_ptr isn't copyable
-  no_compressor(const compressor& comp) = delete;
   virtual ~no_compressor();
 
-  virtual std::tuple<std::unique_ptr<std::uint8_t[]>, unsigned long long,
-                     sfc::sfcc_header>
-  compress(const std::unique_ptr<std::uint8_t[]>& data,
-           const unsigned long long& length, const sfc::sfcc_header& header);
-  virtual std::tuple<std::unique_ptr<std::uint8_t[]>, unsigned long long,
-                     sfc::sfcc_header>
-  decompress(const std::unique_ptr<std::uint8_t[]>& data,
-             const unsigned long long& length, const sfc::sfcc_header& header);
+  virtual unsigned long long maxCompressedSize(
+      unsigned long long length, const sfc::sfcc_header& header) const;
+  virtual std::tuple<unsigned long long, sfc::sfcc_header> compressInto(
+      const std::uint8_t* data, unsigned long long length,
+      std::uint8_t* output, unsigned long long capacity,
+      const sfc::sfcc_header& header);
+  virtual unsigned long long maxDecompressedSize(
+      const std::uint8_t* data, unsigned long long length,
+      const sfc::sfcc_header& header) const;
+  virtual std::tuple<unsigned long long, sfc::sfcc_header> decompressInto(
+      const std::uint8_t* data, unsigned long long length,
+      std::uint8_t* output, unsigned long long capacity,
+      const sfc::sfcc_header& header);
   virtual std::string getFileExtension() const;
   virtual sfc::sfcc::compression_t getCompressionType() const;
 };
@@ -73,14 +112,96 @@ class huffman : public compressor
   huffman();
   virtual ~huffman();
 
-  virtual std::tuple<std::unique_ptr<std::uint8_t[]>, unsigned long long,
-                     sfc::sfcc_header>
-  compress(const std::unique_ptr<std::uint8_t[]>& data,
-           const unsigned long long& length, const sfc::sfcc_header& header);
-  virtual std::tuple<std::unique_ptr<std::uint8_t[]>, unsigned long long,
-                     sfc::sfcc_header>
-  decompress(const std::unique_ptr<std::uint8_t[]>& data,
-             const unsigned long long& length, const sfc::sfcc_header& header);
+  virtual unsigned long long maxCompressedSize(
+      unsigned long long length, const sfc::sfcc_header& header) const;
+  virtual std::tuple<unsigned long long, sfc::sfcc_header> compressInto(
+      const std::uint8_t* data, unsigned long long length,
+      std::uint8_t* output, unsigned long long capacity,
+      const sfc::sfcc_header& header);
+  virtual unsigned long long maxDecompressedSize(
+      const std::uint8_t* data, unsigned long long length,
+      const sfc::sfcc_header& header) const;
+  virtual std::tuple<unsigned long long, sfc::sfcc_header> decompressInto(
+      const std::uint8_t* data, unsigned long long length,
+      std::uint8_t* output, unsigned long long capacity,
+      const sfc::sfcc_header& header);
+  virtual std::string getFileExtension() const;
+  virtual sfc::sfcc::compression_t getCompressionType() const;
+};
+
+// Length-limited canonical Huffman over 16-bit symbols for 2- and 4-byte data,
+// and over bytes otherwise.
+class huffman16 : public compressor
+{
+ public:
+  // interleaved selects the four-stream format (HUFFMAN16_X4)
+  huffman16(bool interleaved = false);
+  virtual ~huffman16();
+
+  virtual unsigned long long maxCompressedSize(
+      unsigned long long length, const sfc::sfcc_header& header) const;
+  virtual std::tuple<unsigned long long, sfc::sfcc_header> compressInto(
+      const std::uint8_t* data, unsigned long long length,
+      std::uint8_t* output, unsigned long long capacity,
+      const sfc::sfcc_header& header);
+  virtual unsigned long long maxDecompressedSize(
+      const std::uint8_t* data, unsigned long long length,
+      const sfc::sfcc_header& header) const;
+  virtual std::tuple<unsigned long long, sfc::sfcc_header> decompressInto(
+      const std::uint8_t* data, unsigned long long length,
+      std::uint8_t* output, unsigned long long capacity,
+      const sfc::sfcc_header& header);
+  virtual std::string getFileExtension() const;
+  virtual sfc::sfcc::compression_t getCompressionType() const;
+
+ private:
+  const bool _interleaved;
+};
+
+class fse : public compressor
+{
+ public:
+  fse();
+  virtual ~fse();
+
+  virtual unsigned long long maxCompressedSize(
+      unsigned long long length, const sfc::sfcc_header& header) const;
+  virtual std::tuple<unsigned long long, sfc::sfcc_header> compressInto(
+      const std::uint8_t* data, unsigned long long length,
+      std::uint8_t* output, unsigned long long capacity,
+      const sfc::sfcc_header& header);
+  virtual unsigned long long maxDecompressedSize(
+      const std::uint8_t* data, unsigned long long length,
+      const sfc::sfcc_header& header) const;
+  virtual std::tuple<unsigned long long, sfc::sfcc_header> decompressInto(
+      const std::uint8_t* data, unsigned long long length,
+      std::uint8_t* output, unsigned long long capacity,
+      const sfc::sfcc_header& header);
+  virtual std::string getFileExtension() const;
+  virtual sfc::sfcc::compression_t getCompressionType() const;
+};
+
+// Context-modelled range coding of the planes of bit-transposed data. Data
+// that is not bit-transposed is coded as a single plane.
+class bitplane : public compressor
+{
+ public:
+  bitplane();
+  virtual ~bitplane();
+
+  virtual unsigned long long maxCompressedSize(
+      unsigned long long length, const sfc::sfcc_header& header) const;
+  virtual std::tuple<unsigned long long, sfc::sfcc_header> compressInto(
+      const std::uint8_t* data, unsigned long long length,
+      std::uint8_t* output, unsigned long long capacity,
+      const sfc::sfcc_header& header);
+  virtual unsigned long long maxDecompressedSize(
+      const std::uint8_t* data, unsigned long long length,
+      const sfc::sfcc_header& header) const;
+  virtual std::tuple<unsigned long long, sfc::sfcc_header> decompressInto(
+      const std::uint8_t* data, unsigned long long length,
+      std::uint8_t* output, unsigned long long capacity,
+      const sfc::sfcc_header& header);
   virtual std::string getFileExtension() const;
   virtual sfc::sfcc::compression_t getCompressionType() const;
 };
@@ -88,16 +209,48 @@ class huffman : public compressor
 class lz77 : public compressor
 {
  public:
-  lz77();
+  // Higher levels search harder for matches, see lz77_encoder.h. Streams of
+  // every level are decoded the same way.
+  lz77(int level = ::lz77::DefaultLevel);
   virtual ~lz77();
-  virtual std::tuple<std::unique_ptr<std::uint8_t[]>, unsigned long long,
-                     sfc::sfcc_header>
-  compress(const std::unique_ptr<std::uint8_t[]>& data,
-           const unsigned long long& length, const sfc::sfcc_header& header);
-  virtual std::tuple<std::unique_ptr<std::uint8_t[]>, unsigned long long,
-                     sfc::sfcc_header>
-  decompress(const std::unique_ptr<std::uint8_t[]>& data,
-             const unsigned long long& length, const sfc::sfcc_header& header);
+  virtual unsigned long long maxCompressedSize(
+      unsigned long long length, const sfc::sfcc_header& header) const;
+  virtual std::tuple<unsigned long long, sfc::sfcc_header> compressInto(
+      const std::uint8_t* data, unsigned long long length,
+      std::uint8_t* output, unsigned long long capacity,
+      const sfc::sfcc_header& header);
+  virtual unsigned long long maxDecompressedSize(
+      const std::uint8_t* data, unsigned long long length,
+      const sfc::sfcc_header& header) const;
+  virtual std::tuple<unsigned long long, sfc::sfcc_header> decompressInto(
+      const std::uint8_t* data, unsigned long long length,
+      std::uint8_t* output, unsigned long long capacity,
+      const sfc::sfcc_header& header);
+  virtual std::string getFileExtension() const;
+  virtual sfc::sfcc::compression_t getCompressionType() const;
+
+ private:
+  const int _level;
+};
+
+class lz78 : public compressor
+{
+ public:
+  lz78();
+  virtual ~lz78();
+  virtual unsigned long long maxCompressedSize(
+      unsigned long long length, const sfc::sfcc_header& header) const;
+  virtual std::tuple<unsigned long long, sfc::sfcc_header> compressInto(
+      const std::uint8_t* data, unsigned long long length,
+      std::uint8_t* output, unsigned long long capacity,
+      const sfc::sfcc_header& header);
+  virtual unsigned long long maxDecompressedSize(
+      const std::uint8_t* data, unsigned long long length,
+      const sfc::sfcc_header& header) const;
+  virtual std::tuple<unsigned long long, sfc::sfcc_header> decompressInto(
+      const std::uint8_t* data, unsigned long long length,
+      std::uint8_t* output, unsigned long long capacity,
+      const sfc::sfcc_header& header);
   virtual std::string getFileExtension() const;
   virtual sfc::sfcc::compression_t getCompressionType() const;
 };
@@ -105,18 +258,28 @@ class lz77 : public compressor
 class lzw : public compressor
 {
  public:
-  lzw();
+  // Codes grow up to dictBits bits, recorded in the header. Decompression
+  // always uses the width from the header.
+  lzw(int dictBits = ::lzw::WideDictBits);
   virtual ~lzw();
-  virtual std::tuple<std::unique_ptr<std::uint8_t[]>, unsigned long long,
-                     sfc::sfcc_header>
-  compress(const std::unique_ptr<std::uint8_t[]>& data,
-           const unsigned long long& length, const sfc::sfcc_header& header);
-  virtual std::tuple<std::unique_ptr<std::uint8_t[]>, unsigned long long,
-                     sfc::sfcc_header>
-  decompress(const std::unique_ptr<std::uint8_t[]>& data,
-             const unsigned long long& length, const sfc::sfcc_header& header);
+  virtual unsigned long long maxCompressedSize(
+      unsigned long long length, const sfc::sfcc_header& header) const;
+  virtual std::tuple<unsigned long long, sfc::sfcc_header> compressInto(
+      const std::uint8_t* data, unsigned long long length,
+      std::uint8_t* output, unsigned long long capacity,
+      const sfc::sfcc_header& header);
+  virtual unsigned long long maxDecompressedSize(
+      const std::uint8_t* data, unsigned long long length,
+      const sfc::sfcc_header& header) const;
+  virtual std::tuple<unsigned long long, sfc::sfcc_header> decompressInto(
+      const std::uint8_t* data, unsigned long long length,
+      std::uint8_t* output, unsigned long long capacity,
+      const sfc::sfcc_header& header);
   virtual std::string getFileExtension() const;
   virtual sfc::sfcc::compression_t getCompressionType() const;
+
+ private:
+  const int _dictBits;
 };
 
 class rle : public compressor
@@ -124,124 +287,207 @@ class rle : public compressor
  public:
   rle();
   virtual ~rle();
-  virtual std::tuple<std::unique_ptr<std::uint8_t[]>, unsigned long long,
-                     sfc::sfcc_header>
-  compress(const std::unique_ptr<std::uint8_t[]>& data,
-           const unsigned long long& length, const sfc::sfcc_header& header);
-  virtual std::tuple<std::unique_ptr<std::uint8_t[]>, unsigned long long,
-                     sfc::sfcc_header>
-  decompress(const std::unique_ptr<std::uint8_t[]>& data,
-             const unsigned long long& length, const sfc::sfcc_header& header);
+  virtual unsigned long long maxCompressedSize(
+      unsigned long long length, const sfc::sfcc_header& header) const;
+  virtual std::tuple<unsigned long long, sfc::sfcc_header> compressInto(
+      const std::uint8_t* data, unsigned long long length,
+      std::uint8_t* output, unsigned long long capacity,
+      const sfc::sfcc_header& header);
+  virtual unsigned long long maxDecompressedSize(
+      const std::uint8_t* data, unsigned long long length,
+      const sfc::sfcc_header& header) const;
+  virtual std::tuple<unsigned long long, sfc::sfcc_header> decompressInto(
+      const std::uint8_t* data, unsigned long long length,
+      std::uint8_t* output, unsigned long long capacity,
+      const sfc::sfcc_header& header);
   virtual std::string getFileExtension() const;
   virtual sfc::sfcc::compression_t getCompressionType() const;
 };
 
-// class deflate : public compressor
-// {
-//  public:
-//   deflate();
-//   virtual ~deflate();
-//   virtual std::tuple<std::unique_ptr<std::uint8_t[]>, unsigned long long,
-//                      sfc::sfcc_header>
-//   compress(const std::unique_ptr<std::uint8_t[]>& data,
-//            const unsigned long long& length, const sfc::sfcc_header& header);
-//   virtual std::tuple<std::unique_ptr<std::uint8_t[]>, unsigned long long,
-//                      sfc::sfcc_header>
-//   decompress(const std::unique_ptr<std::uint8_t[]>& data,
-//              const unsigned long long& length, const sfc::sfcc_header&
-//              header);
-//   virtual std::string getFileExtension() const;
-//   virtual sfc::sfcc::compression_t getCompressionType() const;
-// };
+class rle_varint : public compressor
+{
+ public:
+  rle_varint();
+  virtual ~rle_varint();
+  virtual unsigned long long maxCompressedSize(
+      unsigned long long length, const sfc::sfcc_header& header) const;
+  virtual std::tuple<unsigned long long, sfc::sfcc_header> compressInto(
+      const std::uint8_t* data, unsigned long long length,
+      std::uint8_t* output, unsigned long long capacity,
+      const sfc::sfcc_header& header);
+  virtual unsigned long long maxDecompressedSize(
+      const std::uint8_t* data, unsigned long long length,
+      const sfc::sfcc_header& header) const;
+  virtual std::tuple<unsigned long long, sfc::sfcc_header> decompressInto(
+      const std::uint8_t* data, unsigned long long length,
+      std::uint8_t* output, unsigned long long capacity,
+      const sfc::sfcc_header& header);
+  virtual std::string getFileExtension() const;
+  virtual sfc::sfcc::compression_t getCompressionType() const;
+};
+
+class deflate : public compressor
+{
+ public:
+  // Streams are raw DEFLATE, readable by zlib, see deflate.h
+  deflate(int level = ::deflate::DefaultLevel);
+  virtual ~deflate();
+  virtual unsigned long long maxCompressedSize(
+      unsigned long long length, const sfc::sfcc_header& header) const;
+  virtual std::tuple<unsigned long long, sfc::sfcc_header> compressInto(
+      const std::uint8_t* data, unsigned long long length,
+      std::uint8_t* output, unsigned long long capacity,
+      const sfc::sfcc_header& header);
+  virtual unsigned long long maxDecompressedSize(
+      const std::uint8_t* data, unsigned long long length,
+      const sfc::sfcc_header& header) const;
+  virtual std::tuple<unsigned long long, sfc::sfcc_header> decompressInto(
+      const std::uint8_t* data, unsigned long long length,
+      std::uint8_t* output, unsigned long long capacity,
+      const sfc::sfcc_header& header);
+  virtual std::string getFileExtension() const;
+  virtual sfc::sfcc::compression_t getCompressionType() const;
+
+ private:
+  const int _level;
+};
 
 template <class postcompressor>
 class bzip : public compressor
 {
  public:
-  bzip(bool forceByteCompression = false);
+  // postcomp defaults to a default-constructed postcompressor
+  bzip(bool forceByteCompression = false,
+       std::unique_ptr<postcompressor> postcomp = nullptr);
   virtual ~bzip();
 
-  virtual std::tuple<std::unique_ptr<std::uint8_t[]>, unsigned long long,
-                     sfc::sfcc_header>
-  compress(const std::unique_ptr<std::uint8_t[]>& data,
-           const unsigned long long& length, const sfc::sfcc_header& header);
-  virtual std::tuple<std::unique_ptr<std::uint8_t[]>, unsigned long long,
-                     sfc::sfcc_header>
-  decompress(const std::unique_ptr<std::uint8_t[]>& data,
-             const unsigned long long& length, const sfc::sfcc_header& header);
+  virtual unsigned long long maxCompressedSize(
+      unsigned long long length, const sfc::sfcc_header& header) const;
+  virtual std::tuple<unsigned long long, sfc::sfcc_header> compressInto(
+      const std::uint8_t* data, unsigned long long length,
+      std::uint8_t* output, unsigned long long capacity,
+      const sfc::sfcc_header& header);
+  virtual unsigned long long maxDecompressedSize(
+      const std::uint8_t* data, unsigned long long length,
+      const sfc::sfcc_header& header) const;
+  virtual std::tuple<unsigned long long, sfc::sfcc_header> decompressInto(
+      const std::uint8_t* data, unsigned long long length,
+      std::uint8_t* output, unsigned long long capacity,
+      const sfc::sfcc_header& header);
   virtual std::string getFileExtension() const;
   virtual sfc::sfcc::compression_t getCompressionType() const;
 
  protected:
   const bool _forceByteCompression;
+  std::unique_ptr<postcompressor> _postcompressor;
   constexpr static std::uint16_t MAX_BLOCK_SIZE_BYTES_EXP =
       20;  // 2^ceillog2(900k)), close to the maximum block size of BZIP2
   constexpr static std::uint32_t MAX_BLOCK_SIZE_BYTES =
       1U << MAX_BLOCK_SIZE_BYTES_EXP;  // 2^ceil(log2(900k)), close to the
   // maximum block size of BZIP2
+  // The high byte of the primary index word counts the BWT stream rows that
+  // follow it, which is zero in older files
+  constexpr static int BWT_NSTREAMS_SHIFT = 24;
+  constexpr static std::uint32_t BWT_PRIMARY_INDEX_MASK =
+      (1U << BWT_NSTREAMS_SHIFT) - 1;
+  // Largest block structure before the data: block size, padding bits, min
+  // and max values, primary index and BWT stream rows
+  constexpr static std::uint32_t MAX_BLOCK_HEADER_BYTES =
+      sizeof(std::uint32_t) + 3 * sizeof(std::uint8_t) +
+      ::sfcc::bwt::BlockStreams * sizeof(std::uint32_t);
+  // Buffers reused from block to block, and from call to call, so that once
+  // they have grown to the block size no block allocates its own
+  struct Scratch
+  {
+    std::unique_ptr<std::uint8_t[]> bwt;
+    std::unique_ptr<std::uint8_t[]> mtf;
+    std::vector<std::int32_t> suffixes;
+    std::vector<std::uint32_t> lf_rows;
+    std::vector<std::uint8_t> alphabet;
+  };
+  Scratch _scratch;
   struct Block
   {
     std::uint32_t length;  // Length in bytes
-    std::uint8_t* data;
+    const std::uint8_t* data;
     std::optional<std::int8_t> min_value;
     std::optional<std::int8_t> max_value;
     std::optional<std::uint32_t> bwt_primary_index;
-    std::optional<std::uint8_t> npaddingbits;
+    // See sfcc::bwt::byteBWT()
+    std::uint32_t bwt_stream_rows[::sfcc::bwt::BlockStreams - 1];
+    std::uint8_t bwt_nstream_rows = 0;
+    std::optional<std::uint8_t> npaddingbits;  // See getPaddingBitsByte()
     bool encoded = false;
-    std::uint8_t* dataptr() { return data; }
+    const std::uint8_t* dataptr() { return data; }
     // Number of bytes in un/compressed data
     std::uint32_t data_length() { return length; }
-    std::uint32_t size()
+    // Number of bytes in the block structure before the data
+    std::uint32_t header_size()
     {
       std::uint32_t _size{};
-      // Block structure
       if (encoded) {
         _size += sizeof(std::uint32_t);  // Block size (excluding metadata)
         if (npaddingbits) _size += sizeof(npaddingbits.value());
         if (min_value) _size += sizeof(min_value.value());
         if (max_value) _size += sizeof(max_value.value());
         if (bwt_primary_index) _size += sizeof(bwt_primary_index.value());
+        _size += bwt_nstream_rows * sizeof(std::uint32_t);
       }
-      _size += length;
       return _size;
     }
+    std::uint32_t size() { return header_size() + length; }
 
-    std::unique_ptr<std::uint8_t[]> toArray()
+    // Write the block header, if encoded, to output, returning the end of what
+    // was written. The data follows it. The words follow single bytes, so they
+    // are copied rather than stored through std::uint32_t pointers.
+    std::uint8_t* writeHeaderTo(std::uint8_t* output)
     {
-      auto array = std::make_unique<std::uint8_t[]>(size());
-      auto array_ptr = array.get();
       if (encoded) {
-        *((std::uint32_t*)array_ptr) = data_length();
-        array_ptr += sizeof(data_length());
+        const std::uint32_t blocksize = data_length();
+        std::memcpy(output, &blocksize, sizeof(blocksize));
+        output += sizeof(blocksize);
 
         if (npaddingbits) {
-          *((std::uint8_t*)array_ptr) = npaddingbits.value();
-          array_ptr += sizeof(npaddingbits.value());
+          *((std::uint8_t*)output) = npaddingbits.value();
+          output += sizeof(npaddingbits.value());
         }
 
         if (min_value) {
-          *((std::uint8_t*)array_ptr) = min_value.value();
-          array_ptr += sizeof(min_value.value());
+          *((std::uint8_t*)output) = min_value.value();
+          output += sizeof(min_value.value());
         }
 
         if (max_value) {
-          *((std::uint8_t*)array_ptr) = max_value.value();
-          array_ptr += sizeof(max_value.value());
+          *((std::uint8_t*)output) = max_value.value();
+          output += sizeof(max_value.value());
         }
         if (bwt_primary_index) {
-          *((std::uint32_t*)array_ptr) = bwt_primary_index.value();
-          array_ptr += sizeof(bwt_primary_index.value());
+          const std::uint32_t primary_index =
+              bwt_primary_index.value() |
+              (std::uint32_t(bwt_nstream_rows) << BWT_NSTREAMS_SHIFT);
+          std::memcpy(output, &primary_index, sizeof(primary_index));
+          output += sizeof(primary_index);
         }
+        std::memcpy(output, bwt_stream_rows,
+                    bwt_nstream_rows * sizeof(bwt_stream_rows[0]));
+        output += bwt_nstream_rows * sizeof(bwt_stream_rows[0]);
       }
-
-      std::copy(data, data + data_length(), array_ptr);
-
-      return std::move(array);
+      return output;
     }
   };
+  // Number of blocks in a compressed stream, checking that they fit in it
+  std::uint32_t countBlocks(const std::uint8_t* data, unsigned long long length,
+                            const sfc::sfcc_header& header) const;
 };  // namespace sfcc
 
+// level only applies to LZ77, BZIP_LZ77 and DEFLATE, each of which takes its
+// own default level without it. PIPELINE needs its stages and throws
+// std::invalid_argument, see make_compressor(header) and pipeline.
 std::unique_ptr<compressor> make_compressor(
-    const ::sfc::sfcc::compression_t& comp, const bool& bitTransposed = false);
+    const ::sfc::sfcc::compression_t& comp, const bool& bitTransposed = false,
+    const std::optional<int>& level = std::nullopt);
+// The compressor that decodes a file with header, building a pipeline from its
+// stages if it has them
+std::unique_ptr<compressor> make_compressor(const sfc::sfcc_header& header);
 }  // namespace sfcc
 #endif
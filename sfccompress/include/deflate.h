@@ -0,0 +1,50 @@
+/**
+ * @file deflate.h
+ * @author Conrad Haupt (conrad@conradhaupt.co.za)
+ * @brief Raw DEFLATE (RFC 1951) coding
+ * @version 1.0
+ * @date 2020-03-19
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#ifndef LIBSFCC_DEFLATE_H
+#define LIBSFCC_DEFLATE_H
+
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <tuple>
+
+// Streams are raw DEFLATE without a zlib or gzip wrapper, so they can be read
+// by zlib's inflate with negative window bits. Each block is written stored,
+// with the fixed codes or with dynamic codes, whichever is smallest. Levels
+// follow zlib's:
+//   1-3   greedy parsing, with increasingly deep hash chains,
+//   4-9   lazy parsing, which defers a match if the next position has a longer
+//         one, with increasingly deep hash chains.
+namespace deflate {
+
+constexpr int MinLevel = 1;
+constexpr int DefaultLevel = 6;
+constexpr int MaxLevel = 9;
+
+// Largest stream easyEncode() can output for nbytes bytes, with room for
+// every block to be stored
+unsigned long long maxCompressedSize(unsigned long long nbytes);
+
+// Encode nbytes bytes as a single DEFLATE stream
+std::tuple<std::unique_ptr<std::uint8_t[]>, unsigned long long> easyEncode(
+    const std::uint8_t* uncompressed, unsigned long long nbytes,
+    int level = DefaultLevel);
+
+// Decode a stream into uncompressed, which must be large enough for all of its
+// data as the stream does not record its size. Returns the number of bytes
+// written. Malformed streams throw std::runtime_error.
+unsigned long long easyDecode(const std::uint8_t* compressed,
+                              unsigned long long compressedSizeBytes,
+                              std::uint8_t* uncompressed,
+                              unsigned long long uncompressedSizeBytes);
+
+}  // namespace deflate
+#endif
@@ -0,0 +1,115 @@
+/**
+ * @file fse.h
+ * @author Conrad Haupt (conrad@conradhaupt.co.za)
+ * @brief Table-based asymmetric numeral system (FSE) coding over bytes
+ * @version 1.0
+ * @date 2020-03-12
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#ifndef LIBSFCC_FSE_H
+#define LIBSFCC_FSE_H
+
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+#include "bitstream.h"
+
+namespace fse {
+
+using BitStreamWriter = ::sfcc::BitStreamWriter;
+using BitStreamReader = ::sfcc::BitStreamReader;
+
+// The coder state takes 2^tableLog values. Larger tables approximate the symbol
+// probabilities more closely at the cost of a larger header and decode table.
+constexpr int MinTableLog = 5;
+constexpr int DefaultTableLog = 11;
+constexpr int MaxTableLog = 12;
+constexpr int AlphabetSize = 256;
+
+// Scale the symbol frequencies to normalised counts summing to 2^tableLog.
+// Symbols that occur get a count of at least one.
+std::vector<std::uint16_t> normaliseCounts(
+    const std::vector<std::uint64_t>& frequencies, int tableLog);
+
+// Encoding and decoding tables built from a set of normalised counts
+class CodeTable
+{
+ public:
+  CodeTable() = default;
+  CodeTable(std::vector<std::uint16_t> normalisedCounts, int tableLog);
+
+  // Serialise the normalised counts and the table log
+  void write(BitStreamWriter& writer) const;
+  static CodeTable read(BitStreamReader& reader);
+  // Upper bound on the number of bits written by write()
+  std::uint64_t tableSizeBits() const;
+
+  int getTableLog() const { return tableLog; }
+  std::uint32_t getNormalisedCount(unsigned symbol) const
+  {
+    return normalisedCounts[symbol];
+  }
+
+  // Encoder: states are in [2^tableLog, 2^(tableLog+1)). encode() returns the
+  // number of low bits of state that must be output before the transition.
+  struct SymbolTransform
+  {
+    std::int32_t deltaFindState;
+    std::uint32_t deltaNbBits;
+  };
+  int encodeBitCount(std::uint32_t state, unsigned symbol) const
+  {
+    return (state + symbolTransforms[symbol].deltaNbBits) >> 16;
+  }
+  std::uint32_t encodeNextState(std::uint32_t state, unsigned symbol,
+                                int nbBits) const
+  {
+    return stateTable[(state >> nbBits) +
+                      symbolTransforms[symbol].deltaFindState];
+  }
+
+  // Decoder: states are in [0, 2^tableLog). The next state is newState plus
+  // nbBits bits read from the stream.
+  struct DecodeEntry
+  {
+    std::uint16_t newState;
+    std::uint8_t symbol;
+    std::uint8_t nbBits;
+  };
+  const DecodeEntry& decodeEntry(std::uint32_t state) const
+  {
+    return decodeTable[state];
+  }
+
+ private:
+  std::vector<std::uint16_t> normalisedCounts;
+  std::vector<std::uint16_t> stateTable;
+  std::vector<SymbolTransform> symbolTransforms;
+  std::vector<DecodeEntry> decodeTable;
+  int tableLog = 0;
+};
+
+// Largest stream easyEncode() can output for nbytes bytes
+unsigned long long maxCompressedSize(unsigned long long nbytes);
+
+// Encode nbytes bytes. The byte count and code table are stored in the stream.
+std::tuple<std::unique_ptr<std::uint8_t[]>, unsigned long long> easyEncode(
+    const std::uint8_t* uncompressed, unsigned long long nbytes);
+
+// Size in bytes of the data held by an encoded stream
+unsigned long long decodedSizeBytes(const std::uint8_t* compressed,
+                                    unsigned long long compressedSizeBytes);
+
+// Decode a stream into uncompressed, which must hold at least
+// decodedSizeBytes() bytes. Returns the number of bytes written.
+unsigned long long easyDecode(const std::uint8_t* compressed,
+                              unsigned long long compressedSizeBytes,
+                              std::uint8_t* uncompressed,
+                              unsigned long long uncompressedSizeBytes);
+
+}  // namespace fse
+#endif
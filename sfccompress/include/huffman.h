@@ -68,12 +68,11 @@
 // own error handling strategy. The default simply writes to
 // stderr and calls std::abort().
 //
-// Memory allocated explicitly by the bit streams will be sourced
-// from HUFFMAN_MALLOC/HUFFMAN_MFREE, so you can override the macros
-// to add custom memory management. Current that's all the memory
-// we allocate directly, but we also use std::priority_queue<> to
-// build the Huffman tree and the queue will allocate memory from
-// the global heap, so you won't be able to catch that, unfortunately.
+// Bits are written and read through the shared word-buffered
+// sfcc::BitStreamWriter/BitStreamReader (see bitstream.h), whose
+// buffers are allocated with new[] and must be freed with delete[].
+// We also use std::priority_queue<> to build the Huffman tree and the
+// queue will allocate memory from the global heap.
 //
 // The huffman::Node struct is not very optimized for size.
 // We use full signed integers for the value and child indexes,
@@ -107,21 +106,13 @@
 #include <map>
 #include <queue>
 #include <vector>
+#include "bitstream.h"
 
 // Disable the bit stream => std::string dumping methods.
 // #ifndef HUFFMAN_NO_STD_STRING
 #include <string>
 // #endif // HUFFMAN_NO_STD_STRING
 
-// If you provide a custom malloc(), you must also provide a custom free().
-// Note: We never check HUFFMAN_MALLOC's return for null. A custom
-// implementation should just abort with a fatal error if the program runs out
-// of memory.
-#ifndef HUFFMAN_MALLOC
-#define HUFFMAN_MALLOC std::malloc
-#define HUFFMAN_MFREE std::free
-#endif  // HUFFMAN_MALLOC
-
 namespace huffman {
 
 // ========================================================
@@ -172,98 +163,12 @@ class Code final
 };
 
 // ========================================================
-// class BitStreamWriter:
+// Bit streams:
 // ========================================================
 
-class BitStreamWriter final
-{
- public:
-  // No copy/assignment.
-  BitStreamWriter(const BitStreamWriter &) = delete;
-  BitStreamWriter &operator=(const BitStreamWriter &) = delete;
-
-  BitStreamWriter();
-  explicit BitStreamWriter(int initialSizeInBits, int growthGranularity = 2);
-
-  void allocate(int bitsWanted);
-  void setGranularity(int growthGranularity);
-  std::uint8_t *release();
-
-  void appendBit(int bit);
-  void appendBitsU64(std::uint64_t num, int bitCount);
-  void appendCode(Code code);
-
-#ifndef HUFFMAN_NO_STD_STRING
-  std::string toBitString() const;  // Useful for debugging.
-  void appendBitString(const std::string &bitStr);
-#endif  // HUFFMAN_NO_STD_STRING
-
-  int getByteCount() const;
-  int getBitCount() const;
-  const std::uint8_t *getBitStream() const;
-
-  ~BitStreamWriter();
-
- private:
-  void internalInit();
-  static std::uint8_t *allocBytes(int bytesWanted, std::uint8_t *oldPtr,
-                                  int oldSize);
-
-  std::uint8_t *stream;  // Growable buffer to store our bits. Heap allocated &
-                         // owned by the class instance.
-  int bytesAllocated;    // Current size of heap-allocated stream buffer *in
-                         // bytes*.
-  int granularity;  // Amount bytesAllocated multiplies by when auto-resizing in
-                    // appendBit().
-  int currBytePos;  // Current byte being written to, from 0 to
-                    // bytesAllocated-1.
-  int nextBitPos;   // Bit position within the current byte to access next. 0
-                    // to 7.
-  int numBitsWritten;  // Number of bits in use from the stream buffer, not
-                       // including byte-rounding padding.
-};
-
-// ========================================================
-// class BitStreamReader:
-// ========================================================
-
-class BitStreamReader final
-{
- public:
-  // No copy/assignment.
-  BitStreamReader(const BitStreamReader &) = delete;
-  BitStreamReader &operator=(const BitStreamReader &) = delete;
-
-  BitStreamReader(const BitStreamWriter &bitStreamWriter);
-  BitStreamReader(const std::uint8_t *bitStream, int byteCount, int bitCount);
-
-  void reset();
-  bool readNextBit();
-  std::uint64_t readBitsU64(int bitCount);
-
-  // Basic stream info:
-  int getByteCount() const;
-  int getBitCount() const;
-  const std::uint8_t *getBitStream() const;
-
-  // Current Huffman code being read from the stream:
-  void clearCode();
-  Code getCode() const;
-  int getCodeLength() const;
-
- private:
-  const std::uint8_t
-      *stream;  // Pointer to the external bit stream. Not owned by the reader.
-  const int
-      sizeInBytes;  // Size of the stream *in bytes*. Might include padding.
-  const int sizeInBits;  // Size of the stream *in bits*, padding *not* include.
-  int currBytePos;       // Current byte being read in the stream.
-  int nextBitPos;   // Bit position within the current byte to access next. 0
-                    // to 7.
-  int numBitsRead;  // Total bits read from the stream so far. Never includes
-                    // byte-rounding padding.
-  Code currCode;  // Current Huffman code being built from the input bit stream.
-};
+// The word-buffered bit streams are shared with the other codecs.
+using BitStreamWriter = ::sfcc::BitStreamWriter;
+using BitStreamReader = ::sfcc::BitStreamReader;
 
 // ========================================================
 // Huffman Tree Node:
@@ -275,7 +180,7 @@ constexpr int MaxNodes = MaxSymbols + 512;
 
 struct Node final
 {
-  int frequency = Nil;   // Occurrence count; Nil if not in use.
+  std::int64_t frequency = Nil;  // Occurrence count; Nil if not in use.
   int leftChild = Nil;   // Left  gets code 0 assigned to it; Nil initially
   int rightChild = Nil;  // Right gets code 1 assigned to it; Nil initially.
   int value = Nil;       // Symbol value of this node. Interpreted as a byte.
@@ -299,7 +204,7 @@ class Encoder final
   // Constructor will start the encoding process,
   // building the Huffman tree and creating the output stream.
   // Call getBitStreamWriter() to fetch the results.
-  Encoder(const std::uint8_t *data, int dataSizeBytes,
+  Encoder(const std::uint8_t *data, std::uint64_t dataSizeBytes,
           bool prependTreeToBitStream);
 
   // Find node can be used by a decoder to reconstruct
@@ -334,11 +239,13 @@ class Encoder final
   // Internal helpers:
   void buildHuffmanTree();
   void writeTreeBitStream();
-  void writeDataBitStream(const std::uint8_t *data, int dataSizeBytes);
-  void countFrequencies(const std::uint8_t *data, int dataSizeBytes);
+  void writeDataBitStream(const std::uint8_t *data,
+                          std::uint64_t dataSizeBytes);
+  void countFrequencies(const std::uint8_t *data, std::uint64_t dataSizeBytes);
+  std::uint64_t worstCaseBitCount(bool prependTreeToBitStream) const;
   void recursiveAssignCodes(Node *node, const Node *parent, int bit);
   const Node *recursiveFindLeaf(const Node *node, Code code) const;
-  Node *addInnerNode(int frequency, int child0, int child1);
+  Node *addInnerNode(std::int64_t frequency, int child0, int child1);
 
  private:
   // Output bit stream (will allocate some heap memory).
@@ -365,49 +272,69 @@ class Decoder final
 
   // Start the decoder from a bit stream:
   explicit Decoder(const BitStreamWriter &encodedBitStream);
-  Decoder(const std::uint8_t *encodedData, int encodedSizeBytes,
-          int encodedSizeBits);
+  Decoder(const std::uint8_t *encodedData, std::uint64_t encodedSizeBytes,
+          std::uint64_t encodedSizeBits);
 
   // Runs the decoding loop, writing to the user buffer.
   // Returns the number of *bytes* decoded, which might differ
   // from dataSizeBytes if there is an error or size mismatch.
-  int decode(std::uint8_t *data, int dataSizeBytes);
+  std::uint64_t decode(std::uint8_t *data, std::uint64_t dataSizeBytes);
 
  private:
+  // Codes up to this many bits are decoded with a single table lookup.
+  static constexpr int DecodeTableBits = 11;
+
   // Internal helpers:
   void readPrefixData();
+  void buildDecodeTable();
   int findMatchingCode(const Code code) const;
+  int decodeSlow();
 
   // Helps us manipulate the external raw buffer.
   BitStreamReader bitStream;
 
+  // Current Huffman code being built from the input bit stream.
+  Code currCode;
+
   // Assume the output is only storing the leaf nodes.
   // We also don't need to store a full Node here, just
   // its code, since the value/symbol is implicit by the
   // position within the array.
   std::array<Code, MaxSymbols> codes;
   std::map<Code, int> codes_maps;
+
+  // Indexed by the next DecodeTableBits bits of the stream, entries are
+  // (length << 16) | symbol, a length of zero marks a longer code.
+  std::vector<std::uint32_t> decodeTable;
 };
 
 // ========================================================
 // easyEncode() / easyDecode():
 // ========================================================
 
+// Largest stream easyEncode() can output for uncompressedSizeBytes bytes. A
+// Huffman code averages less than one bit more than the entropy of the data,
+// which is at most eight bits per byte.
+std::uint64_t maxCompressedSize(std::uint64_t uncompressedSizeBytes);
+
 // Quick Huffman data compression.
-// Output compressed data is heap allocated with HUFFMAN_MALLOC()
-// and should be later freed with HUFFMAN_MFREE().
-void easyEncode(const std::uint8_t *uncompressed, int uncompressedSizeBytes,
-                std::uint8_t **compressed, int *compressedSizeBytes,
-                int *compressedSizeBits);
+// Output compressed data is heap allocated with new[]
+// and should be later freed with delete[].
+void easyEncode(const std::uint8_t *uncompressed,
+                std::uint64_t uncompressedSizeBytes, std::uint8_t **compressed,
+                std::uint64_t *compressedSizeBytes,
+                std::uint64_t *compressedSizeBits);
 
 // Decompress back the output of easyEncode().
 // The uncompressed output buffer is assumed to be big enough to hold the
 // uncompressed data, if it happens to be smaller, the decoder will return a
 // partial output and the return value of this function will be less than
 // uncompressedSizeBytes.
-int easyDecode(const std::uint8_t *compressed, int compressedSizeBytes,
-               int compressedSizeBits, std::uint8_t *uncompressed,
-               int uncompressedSizeBytes);
+std::uint64_t easyDecode(const std::uint8_t *compressed,
+                         std::uint64_t compressedSizeBytes,
+                         std::uint64_t compressedSizeBits,
+                         std::uint8_t *uncompressed,
+                         std::uint64_t uncompressedSizeBytes);
 
 }  // namespace huffman
 
@@ -425,5 +352,7 @@ int easyDecode(const std::uint8_t *compressed, int compressedSizeBytes,
 #include <cstdio>  // For the default error handler
 #endif             // HUFFMAN_USING_DEFAULT_ERROR_HANDLER
 
+#include <algorithm>
 #include <cassert>
 #include <cstring>
+#include <limits>
@@ -0,0 +1,37 @@
+/**
+ * @file lz77_decoder.h
+ * @author Conrad Haupt (conrad@conradhaupt.co.za)
+ * @brief Single-pass decoding of yalz77 streams into a caller buffer
+ * @version 1.0
+ * @date 2020-03-17
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#ifndef LIBSFCC_LZ77_DECODER_H
+#define LIBSFCC_LZ77_DECODER_H
+
+#include <cstdint>
+#include <stdexcept>
+#include "lz77.h"
+
+// Decodes a complete stream as written by lz77::compress_t or lz77::encode().
+// Unlike lz77::decompress_t the input cannot be fed in pieces, but the output
+// is written straight into its final buffer.
+namespace lz77 {
+
+// Size in bytes of the data held by an encoded stream
+unsigned long long decodedSizeBytes(const std::uint8_t* compressed,
+                                    unsigned long long compressedSizeBytes);
+
+// Decode a stream into uncompressed, which must hold at least
+// decodedSizeBytes() bytes. Returns the number of bytes written. Matches are
+// copied in wide moves, so bytes of a larger buffer past that count may be
+// overwritten. Malformed streams throw std::runtime_error.
+unsigned long long decode(const std::uint8_t* compressed,
+                          unsigned long long compressedSizeBytes,
+                          std::uint8_t* uncompressed,
+                          unsigned long long uncompressedSizeBytes);
+
+}  // namespace lz77
+#endif
@@ -0,0 +1,40 @@
+/**
+ * @file lz77_encoder.h
+ * @author Conrad Haupt (conrad@conradhaupt.co.za)
+ * @brief Levelled LZ77 match finder writing the yalz77 stream format
+ * @version 1.0
+ * @date 2020-03-16
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#ifndef LIBSFCC_LZ77_ENCODER_H
+#define LIBSFCC_LZ77_ENCODER_H
+
+#include <cstdint>
+#include "lz77.h"
+
+// The streams are read by lz77::decompress_t. Levels trade speed for ratio:
+//   1     a single probe of a hash table of recent positions,
+//   2-4   greedy parsing over hash chains of increasing depth,
+//   5     lazy parsing, which defers a match if the next position has a better
+//         one,
+//   6-9   a forward search for the cheapest encoding over every match length,
+//         with increasingly deep chains.
+namespace lz77 {
+
+constexpr int MinLevel = 1;
+constexpr int DefaultLevel = 5;
+constexpr int MaxLevel = 9;
+
+// Upper bound on the size of the stream written by encode() for length bytes
+unsigned long long maxCompressedSize(unsigned long long length);
+
+// Encode length bytes into compressed, which must hold maxCompressedSize()
+// bytes. Returns the number of bytes written.
+unsigned long long encode(const std::uint8_t* uncompressed,
+                          unsigned long long length, std::uint8_t* compressed,
+                          int level = DefaultLevel);
+
+}  // namespace lz77
+#endif
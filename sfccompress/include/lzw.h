@@ -35,7 +35,8 @@
 // This is the compression scheme used by the GIF image format and the Unix
 // 'compress' tool. Main differences from this implementation is that End Of
 // Input (EOI) and Clear Codes (CC) are not stored in the output and the max
-// code length in bits is 12, vs 16 in compress.
+// code length in bits defaults to 12, vs 16 in compress. It can be raised to
+// MaxDictBits, the encoder and decoder must agree on it.
 //
 // EOI is simply detected by the end of the data stream, while CC happens if the
 // dictionary gets filled. Data is written/read from bit streams, which handle
@@ -69,22 +70,14 @@
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
-#include <map>
-#include <tuple>
+#include <vector>
+#include "bitstream.h"
 
 // Disable the bit stream => std::string dumping methods.
 #ifndef LZW_NO_STD_STRING
 #include <string>
 #endif  // LZW_NO_STD_STRING
 
-// If you provide a custom malloc(), you must also provide a custom free().
-// Note: We never check LZW_MALLOC's return for null. A custom implementation
-// should just abort with a fatal error if the program runs out of memory.
-#ifndef LZW_MALLOC
-#define LZW_MALLOC std::malloc
-#define LZW_MFREE std::free
-#endif  // LZW_MALLOC
-
 namespace lzw {
 
 // ========================================================
@@ -97,99 +90,23 @@ void fatalError(const char *message);
 #endif  // LZW_ERROR
 
 // ========================================================
-// class BitStreamWriter:
-// ========================================================
-
-class BitStreamWriter final
-{
- public:
-  // No copy/assignment.
-  BitStreamWriter(const BitStreamWriter &) = delete;
-  BitStreamWriter &operator=(const BitStreamWriter &) = delete;
-
-  BitStreamWriter();
-  explicit BitStreamWriter(int initialSizeInBits, int growthGranularity = 2);
-
-  void allocate(int bitsWanted);
-  void setGranularity(int growthGranularity);
-  std::uint8_t *release();
-
-  void appendBit(int bit);
-  void appendBitsU64(std::uint64_t num, int bitCount);
-
-#ifndef LZW_NO_STD_STRING
-  std::string toBitString() const;  // Useful for debugging.
-  void appendBitString(const std::string &bitStr);
-#endif  // LZW_NO_STD_STRING
-
-  int getByteCount() const;
-  int getBitCount() const;
-  const std::uint8_t *getBitStream() const;
-
-  ~BitStreamWriter();
-
- private:
-  void internalInit();
-  static std::uint8_t *allocBytes(int bytesWanted, std::uint8_t *oldPtr,
-                                  int oldSize);
-
-  std::uint8_t *stream;  // Growable buffer to store our bits. Heap allocated &
-                         // owned by the class instance.
-  int bytesAllocated;    // Current size of heap-allocated stream buffer *in
-                         // bytes*.
-  int granularity;  // Amount bytesAllocated multiplies by when auto-resizing in
-                    // appendBit().
-  int currBytePos;  // Current byte being written to, from 0 to
-                    // bytesAllocated-1.
-  int nextBitPos;   // Bit position within the current byte to access next. 0
-                    // to 7.
-  int numBitsWritten;  // Number of bits in use from the stream buffer, not
-                       // including byte-rounding padding.
-};
-
-// ========================================================
-// class BitStreamReader:
+// Bit streams:
 // ========================================================
 
-class BitStreamReader final
-{
- public:
-  // No copy/assignment.
-  BitStreamReader(const BitStreamReader &) = delete;
-  BitStreamReader &operator=(const BitStreamReader &) = delete;
-
-  BitStreamReader(const BitStreamWriter &bitStreamWriter);
-  BitStreamReader(const std::uint8_t *bitStream, int byteCount, int bitCount);
-
-  bool isEndOfStream() const;
-  bool readNextBit(int &bitOut);
-  std::uint64_t readBitsU64(int bitCount);
-  void reset();
-
- private:
-  const std::uint8_t
-      *stream;  // Pointer to the external bit stream. Not owned by the reader.
-  const int
-      sizeInBytes;  // Size of the stream *in bytes*. Might include padding.
-  const int sizeInBits;  // Size of the stream *in bits*, padding *not* include.
-  int currBytePos;       // Current byte being read in the stream.
-  int nextBitPos;   // Bit position within the current byte to access next. 0
-                    // to 7.
-  int numBitsRead;  // Total bits read from the stream so far. Never includes
-                    // byte-rounding padding.
-};
+// The word-buffered bit streams are shared with the other codecs.
+using BitStreamWriter = ::sfcc::BitStreamWriter;
+using BitStreamReader = ::sfcc::BitStreamReader;
 
 // ========================================================
 // LZW Dictionary helper:
 // ========================================================
 constexpr int Nil = -1;
-constexpr int MaxDictBits = 12;
+constexpr int DefaultDictBits = 12;
+// Width used for new .sfcc files, which ratio better on large blocks
+constexpr int WideDictBits = 16;
+constexpr int MaxDictBits = 20;
 constexpr int StartBits = 9;
-constexpr int FirstCode = (1 << (StartBits - 1));   // 256
-constexpr int MaxDictEntries = (1 << MaxDictBits);  // 4096
-
-bool entries_compare(const std::tuple<int, int> &lhs,
-                     const std::tuple<int, int> &rhs);
+constexpr int FirstCode = (1 << (StartBits - 1));  // 256
 
 class Dictionary final
 {
@@ -202,33 +119,54 @@ class Dictionary final
 
   // Dictionary entries 0-255 are always reserved to the byte/ASCII range.
   int size;
-  Entry entries[MaxDictEntries];
-  std::map<std::tuple<int, int>, int> entries_map;
+  std::vector<Entry> entries;
 
-  Dictionary();
+  explicit Dictionary(int maxDictBits = DefaultDictBits);
   int findIndex(int code, int value) const;
   bool add(int code, int value);
   bool flush(int &codeBitsWidth);
+  int getMaxDictBits() const { return maxDictBits; }
+
+ private:
+  std::uint32_t slotOf(int code, int value) const;
+
+  int maxDictBits;
+  // Open-addressed hash table from (code, value) to the entry index, with
+  // twice as many slots as entries. Free slots hold Nil.
+  std::vector<int> slots;
+  std::uint32_t slotMask;
 };
 
 // ========================================================
 // easyEncode() / easyDecode():
 // ========================================================
 
+// Largest stream easyEncode() can output for uncompressedSizeBytes bytes,
+// every byte emitting at most one code
+std::uint64_t maxCompressedSize(std::uint64_t uncompressedSizeBytes,
+                                int maxDictBits = DefaultDictBits);
+
 // Quick LZW data compression. Output compressed data is heap allocated
-// with LZW_MALLOC() and should be later freed with LZW_MFREE().
-void easyEncode(const std::uint8_t *uncompressed, int uncompressedSizeBytes,
-                std::uint8_t **compressed, int *compressedSizeBytes,
-                int *compressedSizeBits);
+// with new[] and should be later freed with delete[]. Codes grow up to
+// maxDictBits (StartBits to MaxDictBits) bits.
+void easyEncode(const std::uint8_t *uncompressed,
+                std::uint64_t uncompressedSizeBytes, std::uint8_t **compressed,
+                std::uint64_t *compressedSizeBytes,
+                std::uint64_t *compressedSizeBits,
+                int maxDictBits = DefaultDictBits);
 
 // Decompress back the output of easyEncode().
 // The uncompressed output buffer is assumed to be big enough to hold the
 // uncompressed data, if it happens to be smaller, the decoder will return a
 // partial output and the return value of this function will be less than
-// uncompressedSizeBytes.
-int easyDecode(const std::uint8_t *compressed, int compressedSizeBytes,
-               int compressedSizeBits, std::uint8_t *uncompressed,
-               int uncompressedSizeBytes);
+// uncompressedSizeBytes. Phrases are copied within the buffer in wide moves,
+// so bytes past the returned count may be overwritten.
+std::uint64_t easyDecode(const std::uint8_t *compressed,
+                         std::uint64_t compressedSizeBytes,
+                         std::uint64_t compressedSizeBits,
+                         std::uint8_t *uncompressed,
+                         std::uint64_t uncompressedSizeBytes,
+                         int maxDictBits = DefaultDictBits);
 
 }  // namespace lzw
 
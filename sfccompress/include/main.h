@@ -12,6 +12,7 @@
 #define SFCCOMPARE_MAIN_H
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include "libsfc/gray.h"
 #include "libsfc/hilbert.h"
 #include "libsfc/morton.h"
@@ -40,6 +41,35 @@ const std::string bittranspose =
     "Reorder bits of the data so that they are grouped by significance";
 const std::string nobittranspose =
     "Do not reorder bits of the data by significance";
+const std::string byteshuffle =
+    "Group the bytes of the data by significance, a cheaper alternative to "
+    "reordering bits";
+const std::string bittranspose_block =
+    "Reorder bits within blocks of N bytes, a power of two from 512 to 8 MiB, "
+    "instead of across the whole array";
+const std::string level =
+    "Compression level of LZ77, BZIP_LZ77 and DEFLATE, from 1 (fastest) to 9 "
+    "(smallest), by default 5 for LZ77 and 6 for DEFLATE";
+const std::string pipeline =
+    "Compress with a chain of stages separated by '|', optionally led by the "
+    "curve, e.g. hilbert|bitshuffle|bwt|mtf|rle|huffman. Stages are "
+    "bitshuffle, byteshuffle, bwt, sbwt (the BWT of whole samples), mtf, the "
+    "delta and lorenzo predictors and the codecs in lower case";
+const std::string autoselect =
+    "Choose the curve, transform and codec by trial compressions of samples "
+    "of the data, for the best RATIO, decode SPEED or a MIXED score";
+const std::string auto_weight =
+    "Weight of the ratio in a MIXED --auto score, from 0 to 1, the rest "
+    "going to decode speed";
+const std::string stats =
+    "Print the entropy and value statistics of files, whole and per block, in "
+    "each curve";
+const std::string stats_files = "The files to describe";
+const std::string stats_curve =
+    "Only give the statistics in this curve rather than in each";
+const std::string stats_block_size =
+    "Bytes per block, a multiple of the value size, or 0 for no blocks";
+const std::string stats_format = "Output as CSV, separated by ';', or JSON";
 
 }  // namespace desc
 namespace sfcs {
@@ -48,8 +78,17 @@ using types = ::sfc::sfcc::sfc_t;
 namespace compression {
 using types = ::sfc::sfcc::compression_t;
 }
+namespace stats {
+enum class format_t
+{
+  CSV,
+  JSON
+};
+const std::unordered_map<std::string, format_t> format_string_t = {
+    {"CSV", format_t::CSV}, {"JSON", format_t::JSON}};
+}  // namespace stats
 
-std::string SFCToExt(const sfc::main::sfcs::types& _sfc)
+inline std::string SFCToExt(const sfc::main::sfcs::types& _sfc)
 {
   switch (_sfc) {
     case sfc::main::sfcs::types::ROW_MAJOR:
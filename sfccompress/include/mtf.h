@@ -14,58 +14,154 @@
 #include <cassert>
 #include <cmath>
 #include <cstdint>
+#include <cstring>
 #include <iostream>
 #include <limits>
-#include <list>
 #include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
 #include "sfcc.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 namespace sfcc {
+namespace mtf {
 
-// Returns the MTF encoded sequence and the min and max elements
+// The alphabet is kept in a contiguous array, front first, so that a symbol is
+// found with vector compares and moved to the front with a single memmove. The
+// array is padded to whole vectors so that the search never needs a bounds
+// check.
+constexpr std::size_t VectorBytes = 16;
+
+// Every symbol from min to max, in order. alphabet is reused, so it only
+// allocates when it grows.
 template <typename T, typename TIndex>
-std::tuple<::std::unique_ptr<TIndex[]>, T, T> easyMTFAnyuType(
-    const T* data, unsigned long long length)
+void makeAlphabet(const T min, const T max, std::vector<T>& alphabet)
+{
+  const auto alphabet_size = std::uint64_t(max - min) + 1;
+  if (sizeof(TIndex) < sizeof(std::uint64_t) &&
+      alphabet_size > (1ULL << (sizeof(TIndex) * 8)))
+    throw std::runtime_error(
+        "TIndex is not large enough to hold all indices for the given "
+        "alphabet");
+  constexpr auto lanes = std::max<std::size_t>(1, VectorBytes / sizeof(T));
+  alphabet.assign((alphabet_size + lanes - 1) / lanes * lanes, min);
+  for (std::uint64_t i = 0; i < alphabet_size; i++) alphabet[i] = T(min + i);
+}
+
+// Position of value, which must be in the alphabet
+template <typename T>
+inline std::size_t find(const T* alphabet, const T value)
+{
+#ifdef __SSE2__
+  if constexpr (std::is_integral_v<T> &&
+                (sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4)) {
+    __m128i needle;
+    if constexpr (sizeof(T) == 1)
+      needle = _mm_set1_epi8(char(value));
+    else if constexpr (sizeof(T) == 2)
+      needle = _mm_set1_epi16(short(value));
+    else
+      needle = _mm_set1_epi32(int(value));
+    for (std::size_t i = 0;; i += VectorBytes / sizeof(T)) {
+      const auto symbols =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(alphabet + i));
+      __m128i equal;
+      if constexpr (sizeof(T) == 1)
+        equal = _mm_cmpeq_epi8(symbols, needle);
+      else if constexpr (sizeof(T) == 2)
+        equal = _mm_cmpeq_epi16(symbols, needle);
+      else
+        equal = _mm_cmpeq_epi32(symbols, needle);
+      const unsigned mask = _mm_movemask_epi8(equal);
+      if (mask != 0) return i + __builtin_ctz(mask) / sizeof(T);
+    }
+  }
+#endif
+  std::size_t i = 0;
+  while (!(alphabet[i] == value)) i++;
+  return i;
+}
+
+template <typename T>
+inline void moveToFront(T* alphabet, const std::size_t index)
+{
+  const auto value = alphabet[index];
+  std::memmove(alphabet + 1, alphabet, index * sizeof(T));
+  alphabet[0] = value;
+}
+
+// MTF encode length elements into output, using alphabet as scratch space.
+// Returns the min and max elements.
+template <typename T, typename TIndex>
+std::pair<T, T> encode(const T* data, const unsigned long long length,
+                       TIndex* output, std::vector<T>& alphabet)
 {
   auto [min, max] = ::std::minmax_element(data, data + length);
-  const auto min_elem = *min;
-  const auto max_elem = *max;
+  const auto min_elem = length == 0 ? T() : *min;
+  const auto max_elem = length == 0 ? T() : *max;
   if (::sfc::DEBUG)
     std::cout << "MTF: " << std::int64_t(min_elem) << " to "
               << std::int64_t(max_elem) << std::endl;
-  auto alphabet_size = 0ULL;
-  std::list<T> alphabet;
-  auto prev = min_elem;
-  for (auto minimum = *min; minimum <= *max; minimum++) {
-    alphabet.push_back(minimum);
-    alphabet_size++;
-    if (minimum == *max) break;
+  makeAlphabet<T, TIndex>(min_elem, max_elem, alphabet);
+  // Populate output array given input data
+  for (auto i = 0ULL; i < length;) {
+    // Repeats of the front symbol, the common case after a BWT
+    const auto front = alphabet[0];
+    for (; i < length && data[i] == front; i++) output[i] = 0;
+    if (i == length) break;
+    const auto index = find(alphabet.data(), data[i]);
+    assert(index < alphabet.size());
+    moveToFront(alphabet.data(), index);
+    output[i++] = TIndex(index);
   }
-  if (1ULL << (sizeof(TIndex) * 8) < alphabet_size)
-    throw std::runtime_error(
-        "TIndex is not large enough to hold all indices for the given "
-        "alphabet");
+  return {min_elem, max_elem};
+}
+
+// MTF decode length indices into output, using alphabet as scratch space
+template <typename T, typename TIndex>
+void decode(const TIndex* data, const unsigned long long length, const T min,
+            const T max, T* output, std::vector<T>& alphabet)
+{
+  if (::sfc::DEBUG)
+    std::cout << "MTF: " << std::int64_t(min) << " to " << std::int64_t(max)
+              << std::endl;
+  makeAlphabet<T, TIndex>(min, max, alphabet);
+  const auto alphabet_size = std::uint64_t(max - min) + 1;
+  // Populate output array given input data
+  for (auto i = 0ULL; i < length;) {
+    const auto front = alphabet[0];
+    for (; i < length && data[i] == 0; i++) output[i] = front;
+    if (i == length) break;
+    const auto index = data[i];
+    if (std::uint64_t(index) >= alphabet_size) {
+      throw std::runtime_error("MTF index is out-of-bounds of alphabet: " +
+                               std::to_string(index) +
+                               ", minmax=" + std::to_string(min) + ", " +
+                               std::to_string(max));
+    }
+    moveToFront(alphabet.data(), index);
+    output[i++] = alphabet[0];
+  }
+}
+
+}  // namespace mtf
+
+// Returns the MTF encoded sequence and the min and max elements
+template <typename T, typename TIndex>
+std::tuple<::std::unique_ptr<TIndex[]>, T, T> easyMTFAnyuType(
+    const T* data, unsigned long long length)
+{
   if (::sfc::DEBUG) std::cout << "Allocating MTF output memory" << std::endl;
   std::unique_ptr<TIndex[]> output = std::make_unique<TIndex[]>(length);
   if (::sfc::DEBUG)
     std::cout << "Finished allocating MTF output memory" << std::endl;
-  // Populate output array given input data
-  std::transform(data, data + length, output.get(), [&alphabet](T value) {
-    TIndex index(-1);
-    auto rem = std::find_if(std::begin(alphabet), std::end(alphabet),
-                            [&index, &value](auto& a) {
-                              index++;
-                              return a == value;
-                            });
-    //  Assert that the the current character is in the alphabet
-    assert(rem != std::end(alphabet));
-    //  Move the value in the alphabet to the beginning of the
-    //  list
-    alphabet.erase(rem);
-    alphabet.push_front(value);
-    return index;
-  });
-  return {std::move(output), min_elem, max_elem};
+  std::vector<T> alphabet;
+  const auto [min, max] =
+      mtf::encode<T, TIndex>(data, length, output.get(), alphabet);
+  return {std::move(output), min, max};
 }
 
 template <typename T, typename TIndex>
@@ -73,45 +169,14 @@ template <typename T, typename TIndex>
                                              unsigned long long length,
                                              const T& min, const T& max)
 {
-  const auto min_elem = min;
-  const auto max_elem = max;
-  if (::sfc::DEBUG)
-    std::cout << "MTF: " << std::int64_t(min_elem) << " to "
-              << std::int64_t(max_elem) << std::endl;
-  auto alphabet_size = 0ULL;
-  std::list<T> alphabet;
-  auto prev = min_elem;
-  for (auto minimum = min_elem; minimum <= max_elem; minimum++) {
-    alphabet.push_back(minimum);
-    alphabet_size++;
-    if (minimum == max) break;
-  }
-  if (1ULL << (sizeof(TIndex) * 8) < alphabet_size)
-    throw std::runtime_error(
-        "TIndex is not large enough to hold all indices for the given "
-        "alphabet");
   if (::sfc::DEBUG) std::cout << "Allocating MTF output memory" << std::endl;
   auto output = std::make_unique<T[]>(length);
   if (::sfc::DEBUG)
     std::cout << "Finished allocating MTF output memory" << std::endl;
-  // Populate output array given input data
-  std::transform(
-      data, data + length, output.get(),
-      [&alphabet, &min_elem, &max_elem, &alphabet_size](TIndex index) {
-        if (index >= alphabet_size) {
-          throw std::runtime_error("MTF index is out-of-bounds of alphabet: " +
-                                   std::to_string(index) +
-                                   ", minmax=" + std::to_string(min_elem) +
-                                   ", " + std::to_string(max_elem));
-        }
-        auto value_it = std::next(std::begin(alphabet), index);
-        auto value = *value_it;
-        alphabet.erase(value_it);
-        alphabet.push_front(value);
-        return value;
-      });
-  return std::move(output);
+  std::vector<T> alphabet;
+  mtf::decode<T, TIndex>(data, length, min, max, output.get(), alphabet);
+  return output;
 }
 
 }  // namespace sfcc
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,119 @@
+/**
+ * @file pipeline.h
+ * @author Conrad Haupt (conrad@conradhaupt.co.za)
+ * @brief A chain of transforms and codecs described by a stage list
+ * @version 1.0
+ * @date 2020-03-25
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#ifndef SFCC_PIPELINE_H
+#define SFCC_PIPELINE_H
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+#include "compressor.h"
+#include "sfcc.h"
+
+namespace sfcc {
+
+// A stage is stored in the header as one byte. Transforms take the values
+// below codec_stage, and a codec is codec_stage | compression_t.
+enum class stage_t : std::uint8_t
+{
+  BITSHUFFLE = 1,
+  BYTESHUFFLE = 2,
+  BWT = 3,
+  MTF = 4,
+  // Residuals of the values, see predict.h
+  DELTA = 5,
+  LORENZO = 6,
+  // The BWT of 2- and 4-byte values as whole samples rather than bytes
+  SAMPLE_BWT = 7
+};
+constexpr std::uint8_t codec_stage = 0x80;
+constexpr int MaxPipelineStages = 16;
+
+// Whether byte is a transform or a codec that can be a pipeline stage. The
+// block-sorting codecs are pipelines of their own and are left out.
+bool validStage(std::uint8_t stage);
+// Names are bitshuffle, byteshuffle, bwt, sbwt, mtf, delta, lorenzo and the
+// codec names in lower case, read case-insensitively. Unknown names throw
+// std::invalid_argument.
+std::uint8_t parseStage(const std::string& name);
+std::string stageName(std::uint8_t stage);
+
+struct pipeline_spec
+{
+  // The curve named before the stages, if any
+  std::optional<::sfc::sfcc::sfc_t> curve;
+  std::vector<std::uint8_t> stages;
+};
+
+// Read a spec of stage names separated by '|', such as
+// "hilbert|bitshuffle|bwt|mtf|rle|huffman", of which the curve is optional.
+// Malformed specs throw std::invalid_argument.
+pipeline_spec parsePipeline(const std::string& spec);
+// Inverse of parsePipeline() for the stages alone
+std::string pipelineToString(const std::vector<std::uint8_t>& stages);
+
+// Runs the stages one after the other, each reading the output of the last.
+// The first stage reads the caller's data and the last writes into the
+// caller's output, the stages between them passing two scratch buffers back
+// and forth that are kept from call to call.
+//
+// The output is a table holding the input length and padding byte of every
+// stage, so that each can be decoded in reverse, followed by the output of the
+// last stage. Values keep the width of the file across the shuffles and
+// predictors and are bytes after any other stage. Bit-transposed data is only
+// marked as such for the stage right after the transpose.
+class pipeline : public compressor
+{
+ public:
+  // level applies to the LZ77 and DEFLATE stages, else each takes its own
+  // default
+  pipeline(const std::vector<std::uint8_t>& stages,
+           std::optional<int> level = std::nullopt);
+  virtual ~pipeline();
+
+  virtual unsigned long long maxCompressedSize(
+      unsigned long long length, const sfc::sfcc_header& header) const;
+  virtual std::tuple<unsigned long long, sfc::sfcc_header> compressInto(
+      const std::uint8_t* data, unsigned long long length,
+      std::uint8_t* output, unsigned long long capacity,
+      const sfc::sfcc_header& header);
+  virtual unsigned long long maxDecompressedSize(
+      const std::uint8_t* data, unsigned long long length,
+      const sfc::sfcc_header& header) const;
+  virtual std::tuple<unsigned long long, sfc::sfcc_header> decompressInto(
+      const std::uint8_t* data, unsigned long long length,
+      std::uint8_t* output, unsigned long long capacity,
+      const sfc::sfcc_header& header);
+  virtual std::string getFileExtension() const;
+  virtual sfc::sfcc::compression_t getCompressionType() const;
+
+  const std::vector<std::uint8_t>& stages() const { return _stages; }
+
+ private:
+  // Input length and padding byte of every stage
+  constexpr static unsigned long long STAGE_ENTRY_BYTES =
+      sizeof(std::uint64_t) + sizeof(std::uint8_t);
+  const std::vector<std::uint8_t> _stages;
+  std::vector<std::unique_ptr<compressor>> _compressors;
+  std::vector<std::uint8_t> _buffers[2];
+
+  unsigned long long tableSize() const
+  {
+    return _stages.size() * STAGE_ENTRY_BYTES;
+  }
+  // The header stage i is run with, on input of length bytes
+  sfc::sfcc_header stageHeader(const sfc::sfcc_header& header, std::size_t i,
+                               unsigned long long length) const;
+};
+
+}  // namespace sfcc
+
+#endif
@@ -0,0 +1,68 @@
+/**
+ * @file predict.h
+ * @author Conrad Haupt (conrad@conradhaupt.co.za)
+ * @brief Predictive coding of values as residuals of their neighbours
+ * @version 1.0
+ * @date 2020-03-28
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#ifndef SFCC_PREDICT_H
+#define SFCC_PREDICT_H
+#include <cstdint>
+#include <vector>
+#include "sfcc.h"
+
+namespace sfcc {
+
+enum class predictor_t
+{
+  // The value before along the order the data is stored in, the curve
+  DELTA,
+  // The N-D Lorenzo predictor from the neighbours before on every axis of the
+  // array, e.g. left + up - up-left in 2D
+  LORENZO
+};
+
+// Residuals of the values of shape, a row-major array with the length of its
+// fastest axis first, from the Lorenzo predictor, zig-zag mapped so that small
+// residuals of either sign are small. The Lorenzo residual is the first
+// difference along every axis in turn, which vectorises across the rows of the
+// slower axes, and reading past the start of an axis reads zero. Arithmetic
+// wraps, so any values are exact. 2-byte values are read as integers and
+// 4-byte values as floats, whose bits are mapped to integers in the order of
+// the floats. Other sizes throw std::invalid_argument.
+void predictValues(const std::uint8_t* input, std::uint8_t* output,
+                   const std::vector<unsigned long long>& shape, int nbytes);
+void reversePredictValues(const std::uint8_t* input, std::uint8_t* output,
+                          const std::vector<unsigned long long>& shape,
+                          int nbytes);
+
+// Prediction of the values of sfcc data, which is in the order of the curve
+// of its header. The Lorenzo predictor needs the neighbours of a value on the
+// grid, which the curve scatters, so the data is reordered to row-major, its
+// residuals found there and reordered back to the curve, where the codec after
+// it sees them. Lorenzo prediction needs the whole array, and for curves
+// other than row-major a 2D or 3D one, else std::invalid_argument is thrown.
+class Predictor
+{
+ private:
+  predictor_t _predictor;
+  std::vector<std::uint8_t> _scratch;
+
+  std::vector<unsigned long long> shape(unsigned long long length,
+                                        const sfc::sfcc_header& header) const;
+
+ public:
+  Predictor(predictor_t predictor) : _predictor{predictor} {}
+
+  void predict(const std::uint8_t* input, std::uint8_t* output,
+               unsigned long long length, const sfc::sfcc_header& header);
+  void reverse(const std::uint8_t* input, std::uint8_t* output,
+               unsigned long long length, const sfc::sfcc_header& header);
+};
+
+}  // namespace sfcc
+
+#endif
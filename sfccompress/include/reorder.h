@@ -162,7 +162,7 @@ class reorderer
   }
 };
 
-std::unique_ptr<reorderer> make_reorderer(
+inline std::unique_ptr<reorderer> make_reorderer(
     const sfc::size_t NDims, const sfc::size_t& dimlength,
     const sfc::main::sfcs::types& from_type,
     const sfc::main::sfcs::types& to_type)
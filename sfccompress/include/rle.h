@@ -37,11 +37,11 @@
 
 // RLE encode/decode raw bytes:
 // template <typename T>
-// int easyEncode(const T* input, int inSizeBytes, std::uint8_t* output,
-//                int outSizeBytes);
+// std::uint64_t easyEncode(const T* input, std::uint64_t inSizeBytes,
+//                          std::uint8_t* output, std::uint64_t outSizeBytes);
 // template <typename T>
-// int easyDecode(const std::uint8_t* input, int inSizeBytes, T* output,
-//                int outSizeBytes);
+// std::uint64_t easyDecode(const std::uint8_t* input, std::uint64_t inSizeBytes,
+//                          T* output, std::uint64_t outSizeBytes);
 
 // }  // namespace rle
 
@@ -82,28 +82,27 @@ static void readData(const std::uint8_t *&input, T &val)
 // ========================================================
 
 template <typename T>
-int easyEncode(T *input, const int inSizeBytes, std::uint8_t *output,
-               const int outSizeBytes)
+std::uint64_t easyEncode(const T *input, const std::uint64_t inSizeBytes,
+                         std::uint8_t *output, const std::uint64_t outSizeBytes)
 {
   if (input == nullptr || output == nullptr) {
     throw std::logic_error("Input pointers are NULL");
   }
-  if (inSizeBytes <= 0 || outSizeBytes <= 0) {
+  if (inSizeBytes == 0 || outSizeBytes == 0) {
     throw std::logic_error("Input and Output sizes are invalid");
   }
 
-  int bytesWritten = 0;
+  std::uint64_t bytesWritten = 0;
   RleWord rleCount = 0;
   T rleByte = *input;
 
-  for (int i = 0; i < inSizeBytes; ++i, ++rleCount) {
+  for (std::uint64_t i = 0; i < inSizeBytes; ++i, ++rleCount) {
     T b = *input;
     input++;
 
     // Output when we hit the end of a sequence or the max size of a RLE word:
     if (b != rleByte || rleCount == MaxRunLength) {
-      if ((bytesWritten + sizeof(RleWord) + sizeof(T)) >
-          static_cast<unsigned>(outSizeBytes)) {
+      if ((bytesWritten + sizeof(RleWord) + sizeof(T)) > outSizeBytes) {
         // Can't fit anymore data! Stop with an error.
         throw std::logic_error("RLE ran out of storage space");
       }
@@ -116,8 +115,7 @@ int easyEncode(T *input, const int inSizeBytes, std::uint8_t *output,
 
   // Residual count at the end:
   if (rleCount != 0) {
-    if ((bytesWritten + sizeof(RleWord) + sizeof(T)) >
-        static_cast<unsigned>(outSizeBytes)) {
+    if ((bytesWritten + sizeof(RleWord) + sizeof(T)) > outSizeBytes) {
       throw std::logic_error("RLE ran out of storage space for residual");
     }
     bytesWritten += writeData<std::uint8_t>(output, rleCount);
@@ -129,21 +127,22 @@ int easyEncode(T *input, const int inSizeBytes, std::uint8_t *output,
 
 // ========================================================
 template <typename T>
-int easyDecode(const std::uint8_t *input, const int inSizeBytes, T *output,
-               const int outSizeBytes)
+std::uint64_t easyDecode(const std::uint8_t *input,
+                         const std::uint64_t inSizeBytes, T *output,
+                         const std::uint64_t outSizeBytes)
 {
   if (input == nullptr || output == nullptr) {
     throw std::logic_error("Input pointers are NULL");
   }
-  if (inSizeBytes <= 0 || outSizeBytes <= 0) {
+  if (inSizeBytes == 0 || outSizeBytes == 0) {
     throw std::logic_error("Input and Output sizes are invalid");
   }
 
-  int bytesWritten = 0;
+  std::uint64_t bytesWritten = 0;
   RleWord rleCount = 0;
   T rleByte = 0;
 
-  for (int i = 0; i < inSizeBytes; i += sizeof(rleCount) + sizeof(rleByte)) {
+  for (std::uint64_t i = 0; i < inSizeBytes; i += sizeof(rleCount) + sizeof(rleByte)) {
     readData<RleWord>(input, rleCount);
     readData<T>(input, rleByte);
 
@@ -0,0 +1,49 @@
+/**
+ * @file rle_varint.h
+ * @author Conrad Haupt (conrad@conradhaupt.co.za)
+ * @brief Run-length coding with variable-length counts
+ * @version 1.0
+ * @date 2020-03-20
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#ifndef LIBSFCC_RLE_VARINT_H
+#define LIBSFCC_RLE_VARINT_H
+
+#include <cstdint>
+#include <stdexcept>
+
+// Unlike easyEncode() in rle.h, runs are not limited to 255 elements and
+// elements that do not repeat are not given a count each. The stream is a
+// sequence of tokens, each a little-endian base-128 varint of
+// (count << 1) | isRun followed by a single element for a run of count equal
+// elements, or by count elements stored as they are. Runs are only coded from
+// MinRun elements, so the stream is never much larger than the input.
+namespace rle {
+
+constexpr unsigned long long MinRun = 4;
+// Longest literal token, so that its varint fits in two bytes
+constexpr unsigned long long MaxLiteralRun = (1ULL << 13) - 1;
+
+// Upper bound on the bytes written by varintEncode() for nelements elements of
+// elementBytes bytes each
+unsigned long long varintMaxEncodedSize(unsigned long long nelements,
+                                        int elementBytes);
+
+// Encode nelements elements of type T (std::uint8_t, std::uint16_t,
+// std::uint32_t or std::uint64_t) into output, which must hold
+// varintMaxEncodedSize() bytes. Returns the number of bytes written.
+template <typename T>
+unsigned long long varintEncode(const T* input, unsigned long long nelements,
+                                std::uint8_t* output);
+
+// Decode a stream into output, which holds nelements elements. Returns the
+// number of elements written. Malformed streams throw std::runtime_error.
+template <typename T>
+unsigned long long varintDecode(const std::uint8_t* input,
+                                unsigned long long inSizeBytes, T* output,
+                                unsigned long long nelements);
+
+}  // namespace rle
+#endif
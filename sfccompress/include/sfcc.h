@@ -22,6 +22,7 @@
 #include <stdexcept>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 namespace sfc {
 
@@ -51,13 +52,33 @@ enum class compression_t : std::uint8_t
   DEFLATE = 6,
   BZIP_LZ77 = 7,
   BZIP_LZW = 8,
-  BWT = 9
+  BWT = 9,
+  HUFFMAN16 = 10,
+  HUFFMAN16_X4 = 11,
+  FSE = 12,
+  BZIP_FSE = 13,
+  BITPLANE = 14,
+  RLE_VARINT = 15,
+  // A chain of transforms and codecs listed in the header, see pipeline.h
+  PIPELINE = 16
 };
 
 extern std::unordered_map<std::string, compression_t> compression_string_t;
 
 extern const std::string magicword;
 extern const std::uint8_t magicword_uint8_t[];
+constexpr std::uint8_t npaddingbits_mask = 0b00000111;
+constexpr int lzw_dict_nbits_shift = 3;
+// The SFC type needs three bits of its byte and the top bit marks
+// bit-transposed data. The bits between hold the bit-transpose block size,
+// which is zero in older files that transpose the whole array at once. Data
+// that is not bit-transposed uses the lowest of them to mark byte shuffling.
+constexpr std::uint8_t sfctype_mask = 0b00000111;
+constexpr std::uint8_t bittranspose_mask = 0b10000000;
+constexpr std::uint8_t byteshuffle_mask = 0b00001000;
+constexpr int bittranspose_block_shift = 3;
+constexpr int bittranspose_block_min_nbits = 9;
+constexpr int bittranspose_block_max_nbits = 23;
 
 static std::string tostring(const sfc_t& sfctype)
 {
@@ -82,8 +103,18 @@ struct sfcc_header
   sfcc::compression_t compressiontype;
   std::uint8_t dtype_nbytes;
   std::optional<std::uint8_t> npaddingbits;
+  // LZW dictionary width in bits, unset for the original 12-bit dictionary
+  std::optional<std::uint8_t> lzw_dict_nbits;
   bool bittransposed;
-  std::optional<std::uint32_t> output_block_length;
+  // log2 of the bytes per bit-transposed block, unset if the whole array is
+  // transposed at once
+  std::optional<std::uint8_t> bittranspose_block_nbits;
+  // Byte b of every value is grouped with byte b of the others
+  bool byteshuffled = false;
+  // Stages of a PIPELINE file in the order they are applied, see pipeline.h.
+  // They are stored after the compression type, preceded by their count.
+  std::vector<std::uint8_t> pipeline_stages;
+  std::optional<unsigned long long> output_block_length;
 
   static bool CompressionRequiresPaddingBits(
       const sfcc::compression_t& compressionType)
@@ -99,11 +130,65 @@ struct sfcc_header
     }
   }
 
+  // The padding bit count needs three bits of its byte. The LZW dictionary
+  // width is kept in the remaining bits, which are zero in older files.
+  std::uint8_t getPaddingBitsByte() const
+  {
+    return npaddingbits.value_or(0) |
+           (lzw_dict_nbits.value_or(0) << sfcc::lzw_dict_nbits_shift);
+  }
+  void setPaddingBitsByte(const std::uint8_t byte)
+  {
+    npaddingbits = byte & sfcc::npaddingbits_mask;
+    lzw_dict_nbits.reset();
+    if (byte >> sfcc::lzw_dict_nbits_shift)
+      lzw_dict_nbits = byte >> sfcc::lzw_dict_nbits_shift;
+  }
+
+  std::uint8_t getSfcTypeByte() const
+  {
+    auto byte = std::uint8_t(sfctype);
+    if (bittransposed) {
+      byte |= sfcc::bittranspose_mask;
+      if (bittranspose_block_nbits)
+        byte |= (bittranspose_block_nbits.value() -
+                 (sfcc::bittranspose_block_min_nbits - 1))
+                << sfcc::bittranspose_block_shift;
+    } else if (byteshuffled)
+      byte |= sfcc::byteshuffle_mask;
+    return byte;
+  }
+  void setSfcTypeByte(const std::uint8_t byte)
+  {
+    sfctype = sfcc::sfc_t(byte & sfcc::sfctype_mask);
+    bittransposed = (byte & sfcc::bittranspose_mask) != 0;
+    bittranspose_block_nbits.reset();
+    byteshuffled = false;
+    if (!bittransposed) {
+      byteshuffled = (byte & sfcc::byteshuffle_mask) != 0;
+      return;
+    }
+    const auto block = (byte & ~sfcc::bittranspose_mask) >>
+                       sfcc::bittranspose_block_shift;
+    if (block)
+      bittranspose_block_nbits =
+          block + (sfcc::bittranspose_block_min_nbits - 1);
+  }
+
+  // Bytes per bit-transposed block, zero if the whole array is transposed
+  unsigned long long bittransposeBlockBytes() const
+  {
+    return bittranspose_block_nbits ? 1ULL << bittranspose_block_nbits.value()
+                                    : 0;
+  }
+
   int size() const
   {
     auto _size = 9;
     if (npaddingbits && CompressionRequiresPaddingBits(compressiontype))
       _size++;
+    if (compressiontype == sfcc::compression_t::PIPELINE)
+      _size += 1 + pipeline_stages.size();
     return _size;
   }
 };
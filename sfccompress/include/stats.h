@@ -0,0 +1,108 @@
+/**
+ * @file stats.h
+ * @author Conrad Haupt (conrad@conradhaupt.co.za)
+ * @brief Block entropy and value statistics of sfcc files
+ * @version 1.0
+ * @date 2020-03-27
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#ifndef SFCC_STATS_H
+#define SFCC_STATS_H
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "sfcc.h"
+
+namespace sfcc {
+
+// How the bytes of a file are read as values, as sfcc_stats.py does: 2-byte
+// values of uncompressed files as int16 and everything else as bytes
+enum class value_t
+{
+  UINT8,
+  INT16
+};
+value_t valueType(const sfc::sfcc_header& header);
+int valueBytes(value_t type);
+
+// pandas describe() of a sequence: the standard deviation is that of a
+// sample and the quartiles are interpolated linearly. Empty sequences have a
+// count of 0 and NaN for the rest.
+struct describe_stats
+{
+  unsigned long long count;
+  double mean;
+  double std;
+  double min;
+  double q25;
+  double q50;
+  double q75;
+  double max;
+};
+
+struct block_stats
+{
+  unsigned long long offset;  // In bytes
+  unsigned long long length;  // In bytes
+  // Shannon entropy of the values in base 2^(8 * value bytes), the "Total
+  // Entropy" of sfcc_stats.py
+  double value_entropy;
+  // Order-0 and order-1 Shannon entropy of the bytes, as a fraction of eight
+  // bits per byte like the block entropy of binwalk
+  double entropy;
+  double entropy1;
+  describe_stats values;
+  // Of the differences between consecutive values of the block, or of the
+  // whole for the total
+  describe_stats diffs;
+  // Runs of equal consecutive values
+  unsigned long long nruns;
+  unsigned long long max_run;
+};
+
+// Statistics of length bytes of data, of the whole and of every block of
+// block_bytes, the last of which may be shorter. block_bytes of zero gives
+// no blocks. Byte histograms use four interleaved count tables so that
+// repeated bytes do not stall on the same counter, and the order-1 counts of
+// each block are cleared by walking the block again rather than the table.
+// The quartiles of the whole come from histograms of the values and their
+// differences, and those of blocks from sorting them.
+struct data_stats
+{
+  block_stats total;
+  std::vector<block_stats> blocks;
+};
+data_stats dataStats(const std::uint8_t* data, unsigned long long length,
+                     value_t type, unsigned long long block_bytes);
+
+struct file_stats
+{
+  std::string filename;
+  ::sfc::sfcc::sfc_t curve;
+  bool bittransposed;
+  bool byteshuffled;
+  ::sfc::sfcc::compression_t compression;
+  value_t type;
+  data_stats stats;
+};
+
+// Statistics of an sfcc file in each of curves. Only files that hold plain
+// 2D or 3D arrays of 2- or 4-byte values can be reordered, so others only
+// give the order they are stored in.
+std::vector<file_stats> fileStats(const std::string& filename,
+                                  const std::vector<::sfc::sfcc::sfc_t>& curves,
+                                  unsigned long long block_bytes);
+
+// Semicolon-separated rows, one for the whole of each file and one per block.
+// The columns of sfcc_stats.py come first, with the same names and values,
+// followed by byte-shuffled, block, offset, length, byte entropy, order-1
+// entropy, runs and max run.
+void writeStatsCSV(std::ostream& out, const std::vector<file_stats>& files);
+void writeStatsJSON(std::ostream& out, const std::vector<file_stats>& files);
+
+}  // namespace sfcc
+
+#endif
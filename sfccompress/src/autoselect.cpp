@@ -0,0 +1,303 @@
+/**
+ * @file autoselect.cpp
+ * @author Conrad Haupt (conrad@conradhaupt.co.za)
+ * @brief Choice of curve, transform and codec from samples of the data
+ * @version 1.0
+ * @date 2020-03-26
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#include "autoselect.h"
+#include <chrono>
+#include <cmath>
+#include <random>
+#include "bittranspose.h"
+#include "byteshuffle.h"
+#include "compressor.h"
+#include "reorder.h"
+
+namespace sfcc {
+std::unordered_map<std::string, objective_t> objective_string_t = {
+    {"RATIO", objective_t::RATIO},
+    {"SPEED", objective_t::DECODE_SPEED},
+    {"MIXED", objective_t::MIXED}};
+
+std::string tostring(const transform_t transform)
+{
+  switch (transform) {
+    case transform_t::BITTRANSPOSE:
+      return "BITTRANSPOSE";
+    case transform_t::BYTESHUFFLE:
+      return "BYTESHUFFLE";
+    default:
+      return "NONE";
+  }
+}
+
+namespace {
+using ::sfc::sfcc::compression_t;
+using ::sfc::sfcc::sfc_t;
+using Clock = std::chrono::steady_clock;
+
+// The samples of the data after a curve and transform
+struct Prepared
+{
+  sfc_t curve;
+  transform_t transform;
+  sfc::sfcc_header header;
+  std::vector<std::vector<std::uint8_t>> samples;
+  double entropy;
+  // Time taken to undo the transform and curve on every sample
+  double inverse_seconds;
+};
+
+// Copy the sub-cube of side 2^k at origin out of the row-major array of
+// header, rows of the first axis at a time
+void copySubCube(const std::uint8_t* data, const sfc::sfcc_header& header,
+                 const std::vector<unsigned long long>& origin, const int k,
+                 std::uint8_t* output)
+{
+  const auto n = 1ULL << header.sidelength_k;
+  const auto side = 1ULL << k;
+  const auto rowBytes = side * header.dtype_nbytes;
+  const auto nrows = 1ULL << (k * (header.ndims - 1));
+  for (auto r = 0ULL; r < nrows; r++) {
+    auto offset = origin[0];
+    auto rest = r;
+    auto stride = n;
+    for (auto d = 1; d < header.ndims; d++, rest /= side, stride *= n)
+      offset += (origin[d] + rest % side) * stride;
+    const auto row = data + offset * header.dtype_nbytes;
+    std::copy(row, row + rowBytes, output + r * rowBytes);
+  }
+}
+
+std::vector<std::vector<std::uint8_t>> drawSamples(
+    const std::uint8_t* data, const sfc::sfcc_header& header, const int k,
+    const auto_options& options)
+{
+  const auto sampleBytes =
+      (1ULL << (k * header.ndims)) * header.dtype_nbytes;
+  // The array is its own sample if it is small enough
+  const auto nsamples = k == header.sidelength_k ? 1 : options.nsamples;
+  std::mt19937 rng(options.seed);
+  std::uniform_int_distribution<unsigned long long> position(
+      0, (1ULL << (header.sidelength_k - k)) - 1);
+  std::vector<std::vector<std::uint8_t>> samples;
+  std::vector<unsigned long long> origin(header.ndims);
+  for (auto i = 0; i < nsamples; i++) {
+    for (auto& coord : origin) coord = position(rng) << k;
+    samples.emplace_back(sampleBytes);
+    copySubCube(data, header, origin, k, samples.back().data());
+  }
+  return samples;
+}
+
+// Order-1 entropy of the bytes of the samples, which unlike order-0 sees the
+// locality a curve adds
+double orderOneEntropy(const std::vector<std::vector<std::uint8_t>>& samples)
+{
+  std::vector<std::uint32_t> counts(256 * 256);
+  auto total = 0ULL;
+  for (const auto& sample : samples) {
+    for (auto i = 1ULL; i < sample.size(); i++)
+      counts[sample[i - 1] * 256 + sample[i]]++;
+    total += sample.empty() ? 0 : sample.size() - 1;
+  }
+  if (total == 0) return 0;
+  auto bits = 0.0;
+  for (auto context = 0; context < 256; context++) {
+    const auto row = counts.data() + context * 256;
+    auto ncontext = 0ULL;
+    for (auto s = 0; s < 256; s++) ncontext += row[s];
+    for (auto s = 0; s < 256; s++)
+      if (row[s]) bits -= row[s] * std::log2(double(row[s]) / ncontext);
+  }
+  return bits / total;
+}
+
+Prepared prepare(const std::vector<std::vector<std::uint8_t>>& samples,
+                 const sfc::sfcc_header& sampleHeader, const sfc_t curve,
+                 const transform_t transform)
+{
+  Prepared prepared{curve, transform, sampleHeader, samples, 0, 0};
+  auto& header = prepared.header;
+  header.sfctype = curve;
+  header.bittransposed = transform == transform_t::BITTRANSPOSE;
+  header.byteshuffled = transform == transform_t::BYTESHUFFLE;
+  const auto side = 1ULL << header.sidelength_k;
+  const auto forward =
+      make_reorderer(header.ndims, side, sfc_t::ROW_MAJOR, curve);
+  const auto inverse =
+      make_reorderer(header.ndims, side, curve, sfc_t::ROW_MAJOR);
+  BitTransposer transposer;
+  const ByteShuffler shuffler;
+  for (auto& sample : prepared.samples) {
+    const auto data = sample.data();
+    const auto length = sample.size();
+    if (forward)
+      forward->reorder_withtemporary_vardtype(data, length,
+                                              header.dtype_nbytes);
+    if (transform == transform_t::BITTRANSPOSE)
+      transposer.transpose(data, length, header.dtype_nbytes);
+    else if (transform == transform_t::BYTESHUFFLE)
+      shuffler.shuffle(data, length, header.dtype_nbytes);
+
+    // Timed on a copy, as decompression would undo them
+    auto copy = sample;
+    const auto start = Clock::now();
+    if (transform == transform_t::BITTRANSPOSE)
+      transposer.reverse_transpose(copy.data(), length, header.dtype_nbytes);
+    else if (transform == transform_t::BYTESHUFFLE)
+      shuffler.reverse_shuffle(copy.data(), length, header.dtype_nbytes);
+    if (inverse)
+      inverse->reorder_withtemporary_vardtype(copy.data(), length,
+                                              header.dtype_nbytes);
+    prepared.inverse_seconds +=
+        std::chrono::duration<double>(Clock::now() - start).count();
+  }
+  prepared.entropy = orderOneEntropy(prepared.samples);
+  return prepared;
+}
+
+double score(const auto_candidate& candidate, const auto_options& options)
+{
+  switch (options.objective) {
+    case objective_t::RATIO:
+      return candidate.ratio;
+    case objective_t::DECODE_SPEED:
+      return candidate.decode_speed;
+    default:
+      // Geometric, so that the units of speed do not change the ranking
+      return std::pow(candidate.ratio, options.ratio_weight) *
+             std::pow(candidate.decode_speed, 1 - options.ratio_weight);
+  }
+}
+
+// Trial encode the samples of prepared with codec, returning false if the
+// codec cannot reproduce them
+bool trial(const Prepared& prepared, const compression_t codec,
+           const auto_options& options, auto_candidate& candidate)
+{
+  const auto& header = prepared.header;
+  auto compressor = make_compressor(
+      codec, prepared.transform != transform_t::NONE, options.level);
+  if (!compressor) return false;
+  std::vector<std::uint8_t> compressed;
+  std::vector<std::uint8_t> decompressed;
+  auto input_bytes = 0ULL;
+  auto output_bytes = 0ULL;
+  auto seconds = prepared.inverse_seconds;
+  try {
+    for (const auto& sample : prepared.samples) {
+      compressed.resize(compressor->maxCompressedSize(sample.size(), header));
+      const auto [length, compressed_header] =
+          compressor->compressInto(sample.data(), sample.size(),
+                                   compressed.data(), compressed.size(),
+                                   header);
+      decompressed.resize(sample.size());
+      const auto start = Clock::now();
+      const auto [decoded, decoded_header] = compressor->decompressInto(
+          compressed.data(), length, decompressed.data(), decompressed.size(),
+          compressed_header);
+      seconds += std::chrono::duration<double>(Clock::now() - start).count();
+      // The block-sorting codecs only encode whole blocks, which may be
+      // larger than the sample
+      if (decoded != sample.size() || decompressed != sample) return false;
+      input_bytes += sample.size();
+      output_bytes += length;
+    }
+  } catch (const std::exception& e) {
+    if (::sfc::DEBUG)
+      std::cout << "AUTO: " << ::sfc::sfcc::tostring(codec)
+                << " failed: " << e.what() << std::endl;
+    return false;
+  }
+  candidate = {prepared.curve,
+               prepared.transform,
+               codec,
+               prepared.entropy,
+               double(input_bytes) / std::max(output_bytes, 1ULL),
+               input_bytes / std::max(seconds, 1e-9),
+               0};
+  candidate.score = score(candidate, options);
+  return true;
+}
+}  // namespace
+
+std::vector<auto_candidate> rankCandidates(const std::uint8_t* data,
+                                           const sfc::sfcc_header& header,
+                                           const auto_options& options)
+{
+  if (options.nsamples < 1 || options.ntrials < 1)
+    throw std::invalid_argument("At least one sample and trial are needed");
+  if (options.ratio_weight < 0 || options.ratio_weight > 1)
+    throw std::invalid_argument("The ratio weight must be from 0 to 1");
+
+  // The largest sub-cube within the sample size, at least one value per side
+  auto k = header.sidelength_k;
+  while (k > 0 && (1ULL << (k * header.ndims)) * header.dtype_nbytes >
+                      options.sample_bytes)
+    k--;
+  const auto samples = drawSamples(data, header, k, options);
+  auto sampleHeader = header;
+  sampleHeader.sidelength_k = k;
+  sampleHeader.compressiontype = compression_t::NONE;
+  sampleHeader.npaddingbits.reset();
+  sampleHeader.bittranspose_block_nbits.reset();
+  sampleHeader.output_block_length.reset();
+
+  const auto wideValues =
+      header.dtype_nbytes == 2 || header.dtype_nbytes == 4;
+  std::vector<sfc_t> curves = {sfc_t::ROW_MAJOR};
+  if (wideValues && (header.ndims == 2 || header.ndims == 3))
+    curves.insert(curves.end(),
+                  {sfc_t::MORTON, sfc_t::GRAY_CODE, sfc_t::HILBERT});
+  std::vector<transform_t> transforms = {transform_t::NONE};
+  if (wideValues)
+    transforms.insert(transforms.end(), {transform_t::BITTRANSPOSE,
+                                         transform_t::BYTESHUFFLE});
+
+  std::vector<Prepared> pairs;
+  for (const auto curve : curves)
+    for (const auto transform : transforms)
+      pairs.push_back(prepare(samples, sampleHeader, curve, transform));
+  std::stable_sort(pairs.begin(), pairs.end(), [](auto& a, auto& b) {
+    return a.entropy < b.entropy;
+  });
+  if (pairs.size() > std::size_t(options.ntrials))
+    pairs.erase(pairs.begin() + options.ntrials, pairs.end());
+
+  std::vector<auto_candidate> candidates;
+  for (const auto& pair : pairs) {
+    for (const auto codec : options.codecs) {
+      auto_candidate candidate;
+      if (trial(pair, codec, options, candidate))
+        candidates.push_back(candidate);
+    }
+  }
+  std::stable_sort(candidates.begin(), candidates.end(),
+                   [](auto& a, auto& b) { return a.score > b.score; });
+  if (::sfc::DEBUG)
+    for (const auto& candidate : candidates)
+      std::cout << "AUTO: " << ::sfc::sfcc::tostring(candidate.curve) << " "
+                << tostring(candidate.transform) << " "
+                << ::sfc::sfcc::tostring(candidate.codec)
+                << " entropy=" << candidate.entropy
+                << " ratio=" << candidate.ratio
+                << " decode_speed=" << candidate.decode_speed << std::endl;
+  return candidates;
+}
+
+auto_candidate autoSelect(const std::uint8_t* data,
+                          const sfc::sfcc_header& header,
+                          const auto_options& options)
+{
+  const auto candidates = rankCandidates(data, header, options);
+  if (candidates.empty())
+    throw std::runtime_error("No codec could encode the samples");
+  return candidates.front();
+}
+
+}  // namespace sfcc
@@ -0,0 +1,360 @@
+/**
+ * @file bitplane.cpp
+ * @author Conrad Haupt (conrad@conradhaupt.co.za)
+ * @brief Context-modelled binary range coding of bit-transposed planes
+ * @version 1.0
+ * @date 2020-03-14
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#include "bitplane.h"
+#include <algorithm>
+#include <string>
+#include "bitstream.h"
+
+namespace bitplane {
+
+namespace {
+// Stream layout: data length, number of planes, plane size, then for each plane
+// from the most significant down its mode and, if it is coded, its coded size.
+// The plane payloads follow byte-aligned in the same order, then the bytes
+// after the last plane.
+constexpr int LengthBits = 64;
+constexpr int PlaneCountBits = 7;
+constexpr int ModeBits = 2;
+constexpr int CodedSizeBits = 64;
+
+enum class PlaneMode : std::uint8_t
+{
+  ZEROS = 0,
+  ONES = 1,
+  STORED = 2,
+  CODED = 3
+};
+
+// The context holds the plane history and four bits of the planes above
+constexpr int ContextBits = HistoryBits + 4;
+constexpr std::uint32_t HistoryMask = (1U << HistoryBits) - 1;
+constexpr std::uint16_t InitialProbability = 1U << (ProbabilityBits - 1);
+
+// Range coder as used by LZMA, carries propagate through the pending bytes.
+// Probabilities are those of a zero bit.
+constexpr std::uint32_t TopValue = 1U << 24;
+constexpr int FlushBytes = 5;
+
+class RangeEncoder
+{
+ public:
+  static constexpr bool Encoding = true;
+
+  int codeBit(std::uint16_t& probability, const int bit)
+  {
+    const std::uint32_t bound = (range >> ProbabilityBits) * probability;
+    if (bit == 0) {
+      range = bound;
+      probability += ((1U << ProbabilityBits) - probability) >> AdaptationShift;
+    } else {
+      low += bound;
+      range -= bound;
+      probability -= probability >> AdaptationShift;
+    }
+    while (range < TopValue) {
+      range <<= 8;
+      shiftLow();
+    }
+    return bit;
+  }
+
+  std::vector<std::uint8_t> finish()
+  {
+    for (auto i = 0; i < FlushBytes; i++) shiftLow();
+    return std::move(output);
+  }
+
+ private:
+  void shiftLow()
+  {
+    if (std::uint32_t(low) < 0xFF000000U || (low >> 32) != 0) {
+      const std::uint8_t carry = low >> 32;
+      auto pending = cache;
+      do {
+        output.push_back(std::uint8_t(pending + carry));
+        pending = 0xFF;
+      } while (--cacheSize != 0);
+      cache = std::uint8_t(low >> 24);
+    }
+    cacheSize++;
+    low = (low & 0x00FFFFFFU) << 8;
+  }
+
+  std::uint64_t low = 0;
+  std::uint32_t range = 0xFFFFFFFFU;
+  std::uint8_t cache = 0;
+  std::uint64_t cacheSize = 1;
+  std::vector<std::uint8_t> output;
+};
+
+class RangeDecoder
+{
+ public:
+  static constexpr bool Encoding = false;
+
+  RangeDecoder(const std::uint8_t* stream, const std::uint64_t sizeBytes)
+      : stream(stream), sizeBytes(sizeBytes)
+  {
+    for (auto i = 0; i < FlushBytes; i++) code = (code << 8) | nextByte();
+  }
+
+  int codeBit(std::uint16_t& probability, int)
+  {
+    const std::uint32_t bound = (range >> ProbabilityBits) * probability;
+    int bit;
+    if (code < bound) {
+      range = bound;
+      probability += ((1U << ProbabilityBits) - probability) >> AdaptationShift;
+      bit = 0;
+    } else {
+      code -= bound;
+      range -= bound;
+      probability -= probability >> AdaptationShift;
+      bit = 1;
+    }
+    while (range < TopValue) {
+      range <<= 8;
+      code = (code << 8) | nextByte();
+    }
+    return bit;
+  }
+
+  // True if the decoder needed more bytes than the stream holds
+  bool overrun() const { return position > sizeBytes; }
+
+ private:
+  std::uint8_t nextByte()
+  {
+    // Bytes past the end read as zero, overrun() reports them
+    return position < sizeBytes ? stream[position++] : (position++, 0);
+  }
+
+  const std::uint8_t* stream;
+  const std::uint64_t sizeBytes;
+  std::uint64_t position = 0;
+  std::uint32_t code = 0;
+  std::uint32_t range = 0xFFFFFFFFU;
+};
+
+// Bit i of a plane of nbits bits, zero outside of it or for a missing plane
+inline std::uint32_t bitAt(const std::uint8_t* plane, const std::uint64_t nbits,
+                           const std::uint64_t i)
+{
+  if (plane == nullptr || i >= nbits) return 0;
+  return (plane[i >> 3] >> (i & 7)) & 1;
+}
+
+// Run a plane through the coder. The encoder reads the bits from plane, the
+// decoder writes them to it. upper and upper2 are the next two more
+// significant planes, or nullptr.
+template <class Coder, typename TByte>
+void codePlane(Coder& coder, TByte* plane, const std::uint8_t* upper,
+               const std::uint8_t* upper2, const std::uint64_t planeBytes)
+{
+  std::vector<std::uint16_t> probabilities(1U << ContextBits,
+                                           InitialProbability);
+  const auto nbits = planeBytes * 8;
+  std::uint32_t history = 0;
+  for (std::uint64_t iByte = 0; iByte < planeBytes; iByte++) {
+    std::uint8_t byte = 0;
+    if constexpr (Coder::Encoding) byte = plane[iByte];
+    for (auto j = 0; j < 8; j++) {
+      const auto i = iByte * 8 + j;
+      // i - 1 wraps around to a value past the end for the first bit
+      const auto context = ((history & HistoryMask) << 4) |
+                           (bitAt(upper, nbits, i - 1) << 3) |
+                           (bitAt(upper, nbits, i) << 2) |
+                           (bitAt(upper, nbits, i + 1) << 1) |
+                           bitAt(upper2, nbits, i);
+      const auto bit = coder.codeBit(probabilities[context], (byte >> j) & 1);
+      if constexpr (!Coder::Encoding) byte |= bit << j;
+      history = (history << 1) | bit;
+    }
+    if constexpr (!Coder::Encoding) plane[iByte] = byte;
+  }
+}
+
+const std::uint8_t* planeAt(const std::uint8_t* data, const int plane,
+                            const int nplanes,
+                            const unsigned long long planeBytes)
+{
+  return plane < nplanes ? data + plane * planeBytes : nullptr;
+}
+}  // namespace
+
+unsigned long long planeSizeBytes(const unsigned long long length,
+                                  const int dtypeNBytes)
+{
+  const auto nplanes = dtypeNBytes * 8ULL;
+  return length / dtypeNBytes / nplanes * dtypeNBytes;
+}
+
+unsigned long long maxCompressedSize(const unsigned long long length,
+                                     const int nplanes)
+{
+  // Planes that do not code smaller than they are are stored
+  const auto headerBits = LengthBits + PlaneCountBits + LengthBits +
+                          nplanes * (ModeBits + CodedSizeBits);
+  return (headerBits + 7) / 8 + length;
+}
+
+std::tuple<std::unique_ptr<std::uint8_t[]>, unsigned long long> easyEncode(
+    const std::uint8_t* uncompressed, const unsigned long long length,
+    const int nplanes, const unsigned long long planeBytes)
+{
+  if (nplanes < 1 || nplanes > MaxPlanes || planeBytes > length / nplanes)
+    throw std::logic_error("Cannot split " + std::to_string(length) +
+                           " bytes into " + std::to_string(nplanes) +
+                           " planes of " + std::to_string(planeBytes) +
+                           " bytes");
+
+  // Code from the most significant plane down so that the decoder has the
+  // planes above available as context
+  std::vector<PlaneMode> modes(nplanes);
+  std::vector<std::vector<std::uint8_t>> coded(nplanes);
+  for (auto p = nplanes - 1; p >= 0; p--) {
+    const auto plane = uncompressed + p * planeBytes;
+    const auto planeEnd = plane + planeBytes;
+    if (std::all_of(plane, planeEnd, [](auto byte) { return byte == 0; })) {
+      modes[p] = PlaneMode::ZEROS;
+      continue;
+    }
+    if (std::all_of(plane, planeEnd, [](auto byte) { return byte == 0xFF; })) {
+      modes[p] = PlaneMode::ONES;
+      continue;
+    }
+    RangeEncoder encoder;
+    codePlane(encoder, plane, planeAt(uncompressed, p + 1, nplanes, planeBytes),
+              planeAt(uncompressed, p + 2, nplanes, planeBytes), planeBytes);
+    coded[p] = encoder.finish();
+    if (coded[p].size() < planeBytes) {
+      modes[p] = PlaneMode::CODED;
+    } else {
+      modes[p] = PlaneMode::STORED;
+      coded[p].clear();
+    }
+  }
+
+  sfcc::BitStreamWriter header(LengthBits + PlaneCountBits + LengthBits +
+                               nplanes * (ModeBits + CodedSizeBits));
+  header.appendBitsU64(length, LengthBits);
+  header.appendBitsU64(nplanes, PlaneCountBits);
+  header.appendBitsU64(planeBytes, LengthBits);
+  for (auto p = nplanes - 1; p >= 0; p--) {
+    header.appendBitsU64(static_cast<std::uint8_t>(modes[p]), ModeBits);
+    if (modes[p] == PlaneMode::CODED)
+      header.appendBitsU64(coded[p].size(), CodedSizeBits);
+  }
+
+  const auto tailBytes = length - nplanes * planeBytes;
+  unsigned long long compressedSizeBytes = header.getByteCount() + tailBytes;
+  for (auto p = 0; p < nplanes; p++) {
+    if (modes[p] == PlaneMode::CODED) compressedSizeBytes += coded[p].size();
+    if (modes[p] == PlaneMode::STORED) compressedSizeBytes += planeBytes;
+  }
+
+  auto compressed = std::make_unique<std::uint8_t[]>(compressedSizeBytes);
+  auto compressed_ptr = std::copy(
+      header.getBitStream(), header.getBitStream() + header.getByteCount(),
+      compressed.get());
+  for (auto p = nplanes - 1; p >= 0; p--) {
+    const auto plane = uncompressed + p * planeBytes;
+    if (modes[p] == PlaneMode::CODED)
+      compressed_ptr =
+          std::copy(coded[p].begin(), coded[p].end(), compressed_ptr);
+    else if (modes[p] == PlaneMode::STORED)
+      compressed_ptr = std::copy(plane, plane + planeBytes, compressed_ptr);
+  }
+  std::copy(uncompressed + nplanes * planeBytes, uncompressed + length,
+            compressed_ptr);
+  return {std::move(compressed), compressedSizeBytes};
+}
+
+unsigned long long decodedSizeBytes(
+    const std::uint8_t* compressed,
+    const unsigned long long compressedSizeBytes)
+{
+  sfcc::BitStreamReader reader(compressed, compressedSizeBytes,
+                               compressedSizeBytes * 8);
+  return reader.readBitsU64(LengthBits);
+}
+
+unsigned long long easyDecode(const std::uint8_t* compressed,
+                              const unsigned long long compressedSizeBytes,
+                              std::uint8_t* uncompressed,
+                              const unsigned long long uncompressedSizeBytes)
+{
+  sfcc::BitStreamReader header(compressed, compressedSizeBytes,
+                               compressedSizeBytes * 8);
+  const auto length = header.readBitsU64(LengthBits);
+  if (length > uncompressedSizeBytes)
+    throw std::runtime_error("Bit plane output buffer is too small: " +
+                             std::to_string(uncompressedSizeBytes) + " < " +
+                             std::to_string(length));
+  const int nplanes = header.readBitsU64(PlaneCountBits);
+  const auto planeBytes = header.readBitsU64(LengthBits);
+  if (nplanes < 1 || nplanes > MaxPlanes || planeBytes > length / nplanes)
+    throw std::runtime_error("Invalid bit plane layout of " +
+                             std::to_string(nplanes) + " planes of " +
+                             std::to_string(planeBytes) + " bytes");
+
+  std::vector<PlaneMode> modes(nplanes);
+  std::vector<std::uint64_t> codedSizes(nplanes, 0);
+  for (auto p = nplanes - 1; p >= 0; p--) {
+    modes[p] = static_cast<PlaneMode>(header.readBitsU64(ModeBits));
+    if (modes[p] == PlaneMode::CODED)
+      codedSizes[p] = header.readBitsU64(CodedSizeBits);
+  }
+
+  auto offset = (header.getBitsRead() + 7) / 8;
+  const auto take = [&](const std::uint64_t nbytes) {
+    if (nbytes > compressedSizeBytes - offset)
+      throw std::runtime_error("Bit plane stream ended unexpectedly");
+    const auto payload = compressed + offset;
+    offset += nbytes;
+    return payload;
+  };
+
+  for (auto p = nplanes - 1; p >= 0; p--) {
+    const auto plane = uncompressed + p * planeBytes;
+    switch (modes[p]) {
+      case PlaneMode::ZEROS:
+        std::fill(plane, plane + planeBytes, 0);
+        break;
+      case PlaneMode::ONES:
+        std::fill(plane, plane + planeBytes, 0xFF);
+        break;
+      case PlaneMode::STORED: {
+        const auto payload = take(planeBytes);
+        std::copy(payload, payload + planeBytes, plane);
+        break;
+      }
+      case PlaneMode::CODED: {
+        RangeDecoder decoder(take(codedSizes[p]), codedSizes[p]);
+        codePlane(decoder, plane,
+                  planeAt(uncompressed, p + 1, nplanes, planeBytes),
+                  planeAt(uncompressed, p + 2, nplanes, planeBytes),
+                  planeBytes);
+        if (decoder.overrun())
+          throw std::runtime_error("Bit plane " + std::to_string(p) +
+                                   " ended unexpectedly");
+        break;
+      }
+    }
+  }
+
+  const auto tailBytes = length - nplanes * planeBytes;
+  const auto tail = take(tailBytes);
+  std::copy(tail, tail + tailBytes, uncompressed + nplanes * planeBytes);
+  return length;
+}
+
+}  // namespace bitplane
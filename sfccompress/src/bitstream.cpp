@@ -74,15 +74,10 @@ bool Code::operator!=(const Code other) const { return !(*this == other); }
 // class BitStreamReader:
 // ========================================================
 
-int BitStreamReader::getByteCount() const { return sizeInBytes; }
-int BitStreamReader::getBitCount() const { return sizeInBits; }
+std::uint64_t BitStreamReader::getByteCount() const { return sizeInBytes; }
+std::uint64_t BitStreamReader::getBitCount() const { return sizeInBits; }
 const std::uint8_t *BitStreamReader::getBitStream() const { return stream; }
 
-// Current Huffman code being read from the stream:
-void BitStreamReader::clearCode() { currCode.clear(); }
-Code BitStreamReader::getCode() const { return currCode; }
-int BitStreamReader::getCodeLength() const { return currCode.getLength(); }
-
 // ========================================================
 // class BitStreamWriter:
 // ========================================================
@@ -95,7 +90,7 @@ BitStreamWriter::BitStreamWriter()
   allocate(8192);
 }
 
-BitStreamWriter::BitStreamWriter(const int initialSizeInBits,
+BitStreamWriter::BitStreamWriter(const std::uint64_t initialSizeInBits,
                                  const int growthGranularity)
 {
   internalInit();
@@ -116,24 +111,21 @@ void BitStreamWriter::internalInit()
   bytesAllocated = 0;
   granularity = 2;
   currBytePos = 0;
-  nextBitPos = 0;
+  bitBuffer = 0;
+  bitBufferCount = 0;
   numBitsWritten = 0;
 }
 
-void BitStreamWriter::allocate(int bitsWanted)
+void BitStreamWriter::allocate(std::uint64_t bitsWanted)
 {
   // Require at least a byte.
-  if (bitsWanted <= 0) {
+  if (bitsWanted == 0) {
     bitsWanted = 8;
   }
 
-  // Round upwards if needed:
-  if ((bitsWanted % 8) != 0) {
-    bitsWanted = ::sfcc::utils::nextPowerOfTwo(bitsWanted);
-  }
-
-  // We might already have the required count.
-  const int sizeInBytes = bitsWanted / 8;
+  // Callers that know the worst-case output size get a buffer of exactly
+  // that size, so no regrowth happens while appending.
+  const std::uint64_t sizeInBytes = (bitsWanted + 7) / 8;
   if (sizeInBytes <= bytesAllocated) {
     return;
   }
@@ -142,35 +134,15 @@ void BitStreamWriter::allocate(int bitsWanted)
   bytesAllocated = sizeInBytes;
 }
 
-void BitStreamWriter::appendBit(const int bit)
-{
-  const std::uint32_t mask = std::uint32_t(1) << nextBitPos;
-  stream[currBytePos] = (stream[currBytePos] & ~mask) | (-bit & mask);
-  ++numBitsWritten;
-
-  if (++nextBitPos == 8) {
-    nextBitPos = 0;
-    if (++currBytePos == bytesAllocated) {
-      allocate(bytesAllocated * granularity * 8);
-    }
-  }
-}
-
-void BitStreamWriter::appendBitsU64(const std::uint64_t num, const int bitCount)
+void BitStreamWriter::grow()
 {
-  assert(bitCount <= 64);
-  for (int b = 0; b < bitCount; ++b) {
-    const std::uint64_t mask = std::uint64_t(1) << b;
-    const int bit = !!(num & mask);
-    appendBit(bit);
-  }
-}
-
-void BitStreamWriter::appendCode(const Code code)
-{
-  for (int b = 0; b < code.getLength(); ++b) {
-    appendBit(code.getBit(b));
+  const auto bytesWanted =
+      std::max<std::uint64_t>(bytesAllocated * granularity,
+                              bytesAllocated + SlackBytes);
+  if (bytesWanted > std::numeric_limits<std::uint64_t>::max() / 8) {
+    throw std::length_error("BitStreamWriter exceeded the maximum stream size");
   }
+  allocate(bytesWanted * 8);
 }
 
 #ifndef HUFFMAN_NO_STD_STRING
@@ -186,14 +158,14 @@ std::string BitStreamWriter::toBitString() const
 {
   std::string bitString;
 
-  int usedBytes = numBitsWritten / 8;
-  int leftovers = numBitsWritten % 8;
+  std::uint64_t usedBytes = numBitsWritten / 8;
+  const int leftovers = numBitsWritten % 8;
   if (leftovers != 0) {
     ++usedBytes;
   }
   assert(usedBytes <= bytesAllocated);
 
-  for (int i = 0; i < usedBytes; ++i) {
+  for (std::uint64_t i = 0; i < usedBytes; ++i) {
     const int nBits =
         (leftovers == 0) ? 8 : (i == usedBytes - 1) ? leftovers : 8;
     for (int j = 0; j < nBits; ++j) {
@@ -218,10 +190,10 @@ void BitStreamWriter::setGranularity(const int growthGranularity)
   granularity = (growthGranularity >= 2) ? growthGranularity : 2;
 }
 
-int BitStreamWriter::getByteCount() const
+std::uint64_t BitStreamWriter::getByteCount() const
 {
-  int usedBytes = numBitsWritten / 8;
-  int leftovers = numBitsWritten % 8;
+  std::uint64_t usedBytes = numBitsWritten / 8;
+  const int leftovers = numBitsWritten % 8;
   if (leftovers != 0) {
     ++usedBytes;
   }
@@ -229,15 +201,18 @@ int BitStreamWriter::getByteCount() const
   return usedBytes;
 }
 
-int BitStreamWriter::getBitCount() const { return numBitsWritten; }
+std::uint64_t BitStreamWriter::getBitCount() const { return numBitsWritten; }
 
 const std::uint8_t *BitStreamWriter::getBitStream() const { return stream; }
 
-std::uint8_t *BitStreamWriter::allocBytes(const int bytesWanted,
+std::uint8_t *BitStreamWriter::allocBytes(const std::uint64_t bytesWanted,
                                           std::uint8_t *oldPtr,
-                                          const int oldSize)
+                                          const std::uint64_t oldSize)
 {
-  std::uint8_t *newMemory = new std::uint8_t[bytesWanted];
+  // Every allocation carries SlackBytes for the word-sized stores. The memory
+  // is left uninitialised: each store also writes the zero bits above the
+  // accumulator, and worst-case sized buffers only commit the pages in use.
+  std::uint8_t *newMemory = new std::uint8_t[bytesWanted + SlackBytes];
 
   if (oldPtr != nullptr) {
     std::copy(oldPtr, oldPtr + oldSize, newMemory);
@@ -260,56 +235,39 @@ BitStreamReader::BitStreamReader(const BitStreamWriter &bitStreamWriter)
 }
 
 BitStreamReader::BitStreamReader(const std::uint8_t *bitStream,
-                                 const int byteCount, const int bitCount)
+                                 const std::uint64_t byteCount,
+                                 const std::uint64_t bitCount)
     : stream(bitStream), sizeInBytes(byteCount), sizeInBits(bitCount)
 {
   reset();
 }
 
-bool BitStreamReader::readNextBit()
-{
-  if (numBitsRead > 45000000)
-    // std::cout << numBitsRead << "\t" << sizeInBits << std::endl;
-    if (numBitsRead >= sizeInBits) {
-      return false;  // We are done.
-    }
-
-  const std::uint32_t mask = std::uint32_t(1) << nextBitPos;
-  const int bit = !!(stream[currBytePos] & mask);
-  auto prevNumBitsRead = numBitsRead;
-  ++numBitsRead;
-
-  if (++nextBitPos == 8) {
-    nextBitPos = 0;
-    ++currBytePos;
-  }
-
-  currCode.appendBit(bit);
-  return true;
-}
-
 std::uint64_t BitStreamReader::readBitsU64(const int bitCount)
 {
   assert(bitCount <= 64);
+  if (numBitsRead + bitCount > sizeInBits) {
+    throw std::runtime_error(
+        "Failed to read bits from stream! Unexpected end.");
+  }
 
-  // We can reuse the Code reading infrastructure for this.
-  // This is arguably a little hackish, but gets the job done...
-  currCode.clear();
-  for (int b = 0; b < bitCount; ++b) {
-    if (!readNextBit()) {
-      throw std::runtime_error(
-          "Failed to read bits from stream! Unexpected end.");
-    }
+  if (bitCount > MaxPeekBits) {
+    const std::uint64_t low = peekBits(32);
+    skipBits(32);
+    const std::uint64_t high = peekBits(bitCount - 32);
+    skipBits(bitCount - 32);
+    return low | (high << 32);
   }
-  return currCode.getAsU64();
+  const std::uint64_t num = peekBits(bitCount);
+  skipBits(bitCount);
+  return num;
 }
 
 void BitStreamReader::reset()
 {
   currBytePos = 0;
-  nextBitPos = 0;
+  bitBuffer = 0;
+  bitBufferCount = 0;
   numBitsRead = 0;
-  currCode.clear();
 }
 
 }  // namespace sfcc
@@ -0,0 +1,312 @@
+/**
+ * @file bittranspose.cpp
+ * @author Conrad Haupt (conrad@conradhaupt.co.za)
+ * @brief Bit-matrix transpose kernels
+ * @version 1.0
+ * @date 2020-03-22
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#include "bittranspose.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SFCC_BITTRANSPOSE_X86
+#endif
+
+namespace sfcc {
+namespace {
+
+// Every kernel transposes one block of sizeof(T) * CHAR_BIT values held
+// contiguously in input: bit v of output[i * stride] is bit i of input[v].
+template <typename T>
+void scalarBlock(const T* input, T* output, const std::size_t stride)
+{
+  constexpr auto nbits = sizeof(T) * CHAR_BIT;
+  for (std::size_t i = 0; i < nbits; i++) {
+    T word = 0;
+    for (std::size_t v = 0; v < nbits; v++)
+      word |= T((input[v] >> i) & 1) << v;
+    output[i * stride] = word;
+  }
+}
+
+#ifdef SFCC_BITTRANSPOSE_X86
+// The SIMD kernels gather the same byte of every value into a vector, one
+// value per lane, and read its bits from the top down with movemask, doubling
+// the lanes between reads to bring the next bit to the top.
+
+__attribute__((target("sse2"))) inline void sse2Block(
+    const std::uint16_t* input, std::uint16_t* output, const std::size_t stride)
+{
+  const auto a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input));
+  const auto b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + 8));
+  const auto low = _mm_set1_epi16(0x00FF);
+  auto lo = _mm_packus_epi16(_mm_and_si128(a, low), _mm_and_si128(b, low));
+  auto hi = _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+  for (auto bit = 7; bit >= 0; bit--) {
+    output[bit * stride] = std::uint16_t(_mm_movemask_epi8(lo));
+    output[(8 + bit) * stride] = std::uint16_t(_mm_movemask_epi8(hi));
+    lo = _mm_add_epi8(lo, lo);
+    hi = _mm_add_epi8(hi, hi);
+  }
+}
+
+__attribute__((target("sse2"))) inline void sse2Block(
+    const std::uint32_t* input, std::uint32_t* output, const std::size_t stride)
+{
+  const auto low = _mm_set1_epi32(0xFF);
+  // Byte b of values 0 to 15 and of values 16 to 31
+  __m128i bytes[4][2];
+  for (auto half = 0; half < 2; half++) {
+    __m128i x[4];
+    for (auto q = 0; q < 4; q++)
+      x[q] = _mm_loadu_si128(
+          reinterpret_cast<const __m128i*>(input + 16 * half + 4 * q));
+    for (auto b = 0; b < 4; b++) {
+      const auto shift = _mm_cvtsi32_si128(8 * b);
+      const auto p0 =
+          _mm_packs_epi32(_mm_and_si128(_mm_srl_epi32(x[0], shift), low),
+                          _mm_and_si128(_mm_srl_epi32(x[1], shift), low));
+      const auto p1 =
+          _mm_packs_epi32(_mm_and_si128(_mm_srl_epi32(x[2], shift), low),
+                          _mm_and_si128(_mm_srl_epi32(x[3], shift), low));
+      bytes[b][half] = _mm_packus_epi16(p0, p1);
+    }
+  }
+  for (auto b = 0; b < 4; b++) {
+    auto first = bytes[b][0];
+    auto second = bytes[b][1];
+    for (auto bit = 7; bit >= 0; bit--) {
+      output[(8 * b + bit) * stride] =
+          std::uint32_t(_mm_movemask_epi8(first)) |
+          (std::uint32_t(_mm_movemask_epi8(second)) << 16);
+      first = _mm_add_epi8(first, first);
+      second = _mm_add_epi8(second, second);
+    }
+  }
+}
+
+__attribute__((target("avx2"))) inline void avx2Block(
+    const std::uint16_t* input, std::uint16_t* output, const std::size_t stride)
+{
+  // Low bytes then high bytes of each half, then the halves interleaved so
+  // that the low bytes of all 16 values fill the lower 128 bits
+  const auto shuffle =
+      _mm256_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15, 0,
+                       2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15);
+  auto bytes = _mm256_shuffle_epi8(
+      _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input)), shuffle);
+  bytes = _mm256_permute4x64_epi64(bytes, _MM_SHUFFLE(3, 1, 2, 0));
+  for (auto bit = 7; bit >= 0; bit--) {
+    const auto mask = std::uint32_t(_mm256_movemask_epi8(bytes));
+    output[bit * stride] = std::uint16_t(mask);
+    output[(8 + bit) * stride] = std::uint16_t(mask >> 16);
+    bytes = _mm256_add_epi8(bytes, bytes);
+  }
+}
+
+__attribute__((target("avx2"))) inline void avx2Block(
+    const std::uint32_t* input, std::uint32_t* output, const std::size_t stride)
+{
+  // Each vector of 8 values becomes byte 0 of every value, then bytes 1, 2
+  // and 3, 64 bits each
+  const auto shuffle =
+      _mm256_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15, 0,
+                       4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+  const auto order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+  __m256i r[4];
+  for (auto q = 0; q < 4; q++) {
+    const auto values =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input + 8 * q));
+    r[q] = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(values, shuffle),
+                                       order);
+  }
+  // Bytes 0 and 2 of values 0 to 15 and 16 to 31, then bytes 1 and 3
+  const auto t0 = _mm256_unpacklo_epi64(r[0], r[1]);
+  const auto t1 = _mm256_unpackhi_epi64(r[0], r[1]);
+  const auto t2 = _mm256_unpacklo_epi64(r[2], r[3]);
+  const auto t3 = _mm256_unpackhi_epi64(r[2], r[3]);
+  __m256i bytes[4] = {_mm256_permute2x128_si256(t0, t2, 0x20),
+                      _mm256_permute2x128_si256(t1, t3, 0x20),
+                      _mm256_permute2x128_si256(t0, t2, 0x31),
+                      _mm256_permute2x128_si256(t1, t3, 0x31)};
+  for (auto b = 0; b < 4; b++)
+    for (auto bit = 7; bit >= 0; bit--) {
+      output[(8 * b + bit) * stride] =
+          std::uint32_t(_mm256_movemask_epi8(bytes[b]));
+      bytes[b] = _mm256_add_epi8(bytes[b], bytes[b]);
+    }
+}
+#endif
+
+// Forward transposes scatter the words of each block to their bit planes,
+// reverse transposes gather them. Planes are usually a power of two apart and
+// would compete for the same cache sets one word at a time, so a cache line of
+// blocks is transposed together and each plane is written a line at a time.
+constexpr std::size_t CacheLineBytes = 64;
+
+template <typename T, typename Kernel>
+inline void forwardBlocks(const T* input, T* output,
+                          const unsigned long long nblocks, Kernel kernel)
+{
+  constexpr auto nbits = sizeof(T) * CHAR_BIT;
+  constexpr auto group = CacheLineBytes / sizeof(T);
+  T lines[nbits][group];
+  for (auto first = 0ULL; first < nblocks; first += group) {
+    const auto count = std::min<unsigned long long>(group, nblocks - first);
+    for (std::size_t b = 0; b < count; b++)
+      kernel(input + (first + b) * nbits, &lines[0][b], group);
+    for (std::size_t i = 0; i < nbits; i++)
+      std::copy(lines[i], lines[i] + count, output + i * nblocks + first);
+  }
+}
+
+template <typename T, typename Kernel>
+inline void reverseBlocks(const T* input, T* output,
+                          const unsigned long long nblocks, Kernel kernel)
+{
+  constexpr auto nbits = sizeof(T) * CHAR_BIT;
+  constexpr auto group = CacheLineBytes / sizeof(T);
+  T words[nbits];
+  T lines[nbits][group];
+  for (auto first = 0ULL; first < nblocks; first += group) {
+    const auto count = std::min<unsigned long long>(group, nblocks - first);
+    for (std::size_t i = 0; i < nbits; i++)
+      std::copy(input + i * nblocks + first,
+                input + i * nblocks + first + count, lines[i]);
+    for (std::size_t b = 0; b < count; b++) {
+      for (std::size_t i = 0; i < nbits; i++) words[i] = lines[i][b];
+      kernel(words, output + (first + b) * nbits, 1);
+    }
+  }
+}
+
+#ifdef SFCC_BITTRANSPOSE_X86
+struct SSE2Kernel
+{
+  template <typename T>
+  __attribute__((target("sse2"))) void operator()(
+      const T* input, T* output, const std::size_t stride) const
+  {
+    sse2Block(input, output, stride);
+  }
+};
+
+struct AVX2Kernel
+{
+  template <typename T>
+  __attribute__((target("avx2"))) void operator()(
+      const T* input, T* output, const std::size_t stride) const
+  {
+    avx2Block(input, output, stride);
+  }
+};
+
+template <typename T>
+__attribute__((target("sse2"))) void sse2Blocks(
+    const T* input, T* output, const unsigned long long nblocks,
+    const bool reverse)
+{
+  if (reverse)
+    reverseBlocks(input, output, nblocks, SSE2Kernel());
+  else
+    forwardBlocks(input, output, nblocks, SSE2Kernel());
+}
+
+template <typename T>
+__attribute__((target("avx2"))) void avx2Blocks(
+    const T* input, T* output, const unsigned long long nblocks,
+    const bool reverse)
+{
+  if (reverse)
+    reverseBlocks(input, output, nblocks, AVX2Kernel());
+  else
+    forwardBlocks(input, output, nblocks, AVX2Kernel());
+}
+#endif
+
+template <typename T>
+void transposeBlocks(const T* input, T* output,
+                     const unsigned long long nblocks,
+                     const BitTransposeKernel kernel, const bool reverse)
+{
+  if (!bitTransposeKernelSupported(kernel))
+    throw std::invalid_argument("Bit transpose kernel is not supported");
+  switch (kernel) {
+#ifdef SFCC_BITTRANSPOSE_X86
+    case BitTransposeKernel::SSE2:
+      sse2Blocks(input, output, nblocks, reverse);
+      return;
+    case BitTransposeKernel::AVX2:
+      avx2Blocks(input, output, nblocks, reverse);
+      return;
+#endif
+    default:
+      if (reverse)
+        reverseBlocks(input, output, nblocks, scalarBlock<T>);
+      else
+        forwardBlocks(input, output, nblocks, scalarBlock<T>);
+      return;
+  }
+}
+
+}  // namespace
+
+bool bitTransposeKernelSupported(const BitTransposeKernel kernel)
+{
+  switch (kernel) {
+    case BitTransposeKernel::SCALAR:
+      return true;
+#ifdef SFCC_BITTRANSPOSE_X86
+    case BitTransposeKernel::SSE2:
+      return __builtin_cpu_supports("sse2");
+    case BitTransposeKernel::AVX2:
+      return __builtin_cpu_supports("avx2");
+#endif
+    default:
+      return false;
+  }
+}
+
+BitTransposeKernel bestBitTransposeKernel()
+{
+  static const auto best = []() {
+    for (auto kernel : {BitTransposeKernel::AVX2, BitTransposeKernel::SSE2})
+      if (bitTransposeKernelSupported(kernel)) return kernel;
+    return BitTransposeKernel::SCALAR;
+  }();
+  return best;
+}
+
+void bittransposeBlocks(const std::uint16_t* input, std::uint16_t* output,
+                        const unsigned long long nblocks,
+                        const BitTransposeKernel kernel)
+{
+  transposeBlocks(input, output, nblocks, kernel, false);
+}
+
+void bittransposeBlocks(const std::uint32_t* input, std::uint32_t* output,
+                        const unsigned long long nblocks,
+                        const BitTransposeKernel kernel)
+{
+  transposeBlocks(input, output, nblocks, kernel, false);
+}
+
+void reverseBittransposeBlocks(const std::uint16_t* input,
+                               std::uint16_t* output,
+                               const unsigned long long nblocks,
+                               const BitTransposeKernel kernel)
+{
+  transposeBlocks(input, output, nblocks, kernel, true);
+}
+
+void reverseBittransposeBlocks(const std::uint32_t* input,
+                               std::uint32_t* output,
+                               const unsigned long long nblocks,
+                               const BitTransposeKernel kernel)
+{
+  transposeBlocks(input, output, nblocks, kernel, true);
+}
+
+}  // namespace sfcc
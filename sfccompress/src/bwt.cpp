@@ -0,0 +1,253 @@
+/**
+ * @file bwt.cpp
+ * @author Conrad Haupt (conrad@conradhaupt.co.za)
+ * @brief Suffix sorting and the Burrows-Wheeler transform
+ * @version 1.0
+ * @date 2020-03-21
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#include "bwt.h"
+#include <divsufsort.h>
+#include <string>
+
+namespace sfcc {
+namespace bwt {
+namespace {
+
+// SA-IS (Nong, Zhang and Chan, 2009). Suffixes are classed as S-type if they
+// are smaller than the suffix that follows them and L-type otherwise. Sorting
+// the leftmost S-type (LMS) suffixes is enough to induce the order of every
+// other suffix, and the LMS substrings are at most half of the text, so they
+// are named and sorted by recursing on the reduced text. The reduced text and
+// its suffix array share the space of the output suffix array, so beyond the
+// output only a type bit per symbol and a bucket per alphabet symbol are
+// allocated.
+
+constexpr std::int32_t Empty = -1;
+
+class Types
+{
+ private:
+  std::vector<bool> sType;
+
+ public:
+  template <typename S>
+  Types(const S* text, const std::int32_t n) : sType(n)
+  {
+    // The sentinel is S-type and the symbol before it L-type
+    sType[n - 1] = true;
+    for (auto i = n - 2; i >= 0; i--)
+      sType[i] = text[i] < text[i + 1] ||
+                 (text[i] == text[i + 1] && sType[i + 1]);
+  }
+  bool isS(const std::int32_t i) const { return sType[i]; }
+  bool isLMS(const std::int32_t i) const
+  {
+    return i > 0 && sType[i] && !sType[i - 1];
+  }
+};
+
+// Start (or one past the end) of every symbol's bucket in the suffix array
+template <typename S>
+void findBuckets(const S* text, const std::int32_t n,
+                 std::vector<std::int32_t>& buckets, const bool ends)
+{
+  std::fill(buckets.begin(), buckets.end(), 0);
+  for (auto i = 0; i < n; i++) buckets[text[i]]++;
+  std::int32_t sum = 0;
+  for (auto& bucket : buckets) {
+    sum += bucket;
+    bucket = ends ? sum : sum - bucket;
+  }
+}
+
+template <typename S>
+void induce(const S* text, std::int32_t* sa, const std::int32_t n,
+            const Types& types, std::vector<std::int32_t>& buckets)
+{
+  // L-type suffixes from the front of their buckets, left to right
+  findBuckets(text, n, buckets, false);
+  for (auto i = 0; i < n; i++) {
+    const auto j = sa[i] - 1;
+    if (j >= 0 && !types.isS(j)) sa[buckets[text[j]]++] = j;
+  }
+  // S-type suffixes from the back of their buckets, right to left
+  findBuckets(text, n, buckets, true);
+  for (auto i = n - 1; i >= 0; i--) {
+    const auto j = sa[i] - 1;
+    if (j >= 0 && types.isS(j)) sa[--buckets[text[j]]] = j;
+  }
+}
+
+template <typename S>
+void sais(const S* text, std::int32_t* sa, const std::int32_t n,
+          const std::uint32_t alphabetSize)
+{
+  const Types types(text, n);
+  std::vector<std::int32_t> buckets(alphabetSize);
+
+  // Sort the LMS substrings by placing the LMS suffixes at the ends of their
+  // buckets and inducing the rest
+  findBuckets(text, n, buckets, true);
+  std::fill(sa, sa + n, Empty);
+  for (auto i = 1; i < n; i++)
+    if (types.isLMS(i)) sa[--buckets[text[i]]] = i;
+  induce(text, sa, n, types, buckets);
+
+  // Move the sorted LMS substrings to the front, at most n / 2 of them
+  std::int32_t n1 = 0;
+  for (auto i = 0; i < n; i++)
+    if (types.isLMS(sa[i])) sa[n1++] = sa[i];
+
+  // Name the LMS substrings in order, equal substrings getting the same name.
+  // No two LMS positions are adjacent, so i / 2 places them without collision.
+  std::fill(sa + n1, sa + n, Empty);
+  std::int32_t names = 0;
+  std::int32_t previous = Empty;
+  for (auto i = 0; i < n1; i++) {
+    const auto pos = sa[i];
+    auto differs = previous == Empty;
+    for (auto d = 0; !differs; d++) {
+      if (text[pos + d] != text[previous + d] ||
+          types.isS(pos + d) != types.isS(previous + d))
+        differs = true;
+      else if (d > 0 && (types.isLMS(pos + d) || types.isLMS(previous + d)))
+        break;
+    }
+    if (differs) {
+      names++;
+      previous = pos;
+    }
+    sa[n1 + pos / 2] = names - 1;
+  }
+  for (auto i = n - 1, j = n - 1; i >= n1; i--)
+    if (sa[i] >= 0) sa[j--] = sa[i];
+
+  // Sort the reduced text, recursing while names are not unique
+  auto reduced = sa + n - n1;
+  if (names < n1)
+    sais(reduced, sa, n1, names);
+  else
+    for (auto i = 0; i < n1; i++) sa[reduced[i]] = i;
+
+  // Map the sorted reduced suffixes back to LMS positions and induce the
+  // complete order from them
+  for (auto i = 1, j = 0; i < n; i++)
+    if (types.isLMS(i)) reduced[j++] = i;
+  for (auto i = 0; i < n1; i++) sa[i] = reduced[sa[i]];
+  std::fill(sa + n1, sa + n, Empty);
+  findBuckets(text, n, buckets, true);
+  for (auto i = n1 - 1; i >= 0; i--) {
+    const auto j = sa[i];
+    sa[i] = Empty;
+    sa[--buckets[text[j]]] = j;
+  }
+  induce(text, sa, n, types, buckets);
+}
+
+}  // namespace
+
+void suffixArray(const std::uint32_t* text, std::int32_t* sa,
+                 const std::int32_t n, const std::uint32_t alphabetSize)
+{
+  if (n == 1)
+    sa[0] = 0;
+  else
+    sais(text, sa, n, alphabetSize);
+}
+
+std::uint32_t byteBWT(const std::uint8_t* data, const std::uint32_t length,
+                      std::uint8_t* output, std::uint32_t* streamRows,
+                      const int nstreams, std::vector<std::int32_t>& suffixes)
+{
+  static_assert(std::is_same_v<saidx_t, std::int32_t>,
+                "libdivsufsort must be built with 32-bit indices");
+  if (length == 0) return 0;
+  if (length > MaxBlockLength)
+    throw std::invalid_argument("BWT block of " + std::to_string(length) +
+                                " bytes is too long");
+  suffixes.resize(length);
+  const auto sa = suffixes.data();
+  if (divsufsort(data, sa, saidx_t(length)) != 0)
+    throw std::runtime_error("Suffix sorting failed");
+
+  // Row 0 is the suffix holding only the end-of-line, which the output omits
+  const auto segment = length / nstreams;
+  std::uint32_t primaryIndex = 0;
+  auto out = output;
+  *out++ = data[length - 1];
+  for (std::uint32_t i = 0; i < length; i++) {
+    const auto pos = std::uint32_t(sa[i]);
+    if (pos == 0) {
+      primaryIndex = i + 1;
+      continue;
+    }
+    *out++ = data[pos - 1];
+    if (pos % segment == 0 && pos / segment < std::uint32_t(nstreams))
+      streamRows[pos / segment - 1] = i + 1;
+  }
+  return primaryIndex;
+}
+
+void inverseByteBWT(const std::uint8_t* bwt, const std::uint32_t length,
+                    const std::uint32_t primaryIndex,
+                    const std::uint32_t* streamRows, const int nstreams,
+                    std::uint8_t* output, std::vector<std::uint32_t>& rows)
+{
+  if (length == 0) return;
+  if (length > MaxBlockLength || nstreams < 1 || nstreams > BlockStreams ||
+      std::uint32_t(nstreams) > length)
+    throw std::runtime_error("BWT block has an invalid length");
+  if (primaryIndex == 0 || primaryIndex > length)
+    throw std::runtime_error("BWT primary index is out of range");
+  for (auto k = 0; k < nstreams - 1; k++)
+    if (streamRows[k] > length || streamRows[k] == primaryIndex)
+      throw std::runtime_error("BWT stream index is out of range");
+
+  // Rows 0 to length, the primary index being the end-of-line. Each entry
+  // holds the LF mapping of its row above the byte in its last column.
+  std::uint32_t next[256]{};
+  for (std::uint32_t i = 0; i < length; i++) next[bwt[i]]++;
+  std::uint32_t sum = 1;
+  for (auto& count : next) {
+    const auto c = count;
+    count = sum;
+    sum += c;
+  }
+  rows.resize(length + 1);
+  // Never reached by a valid walk, but kept in range for malformed ones
+  rows[primaryIndex] = 0;
+  for (std::uint32_t row = 0, i = 0; row <= length; row++) {
+    if (row == primaryIndex) continue;
+    const auto c = bwt[i++];
+    rows[row] = (next[c]++ << 8) | c;
+  }
+
+  // Walk every segment backwards from its end, all at once
+  std::uint32_t row[BlockStreams];
+  std::uint8_t* end[BlockStreams];
+  const auto segment = length / nstreams;
+  for (auto k = 0; k < nstreams; k++) {
+    row[k] = k == nstreams - 1 ? 0 : streamRows[k];
+    end[k] = output + (k == nstreams - 1 ? length : (k + 1) * segment);
+  }
+  for (std::uint32_t i = 1; i <= segment; i++)
+    for (auto k = 0; k < nstreams; k++) {
+      const auto entry = rows[row[k]];
+      end[k][-std::ptrdiff_t(i)] = std::uint8_t(entry);
+      row[k] = entry >> 8;
+    }
+  // The last segment also holds the remainder of the block
+  auto& last = row[nstreams - 1];
+  const auto start = output + (nstreams - 1) * segment;
+  for (auto out = end[nstreams - 1] - segment; out != start;) {
+    const auto entry = rows[last];
+    *--out = std::uint8_t(entry);
+    last = entry >> 8;
+  }
+}
+
+}  // namespace bwt
+}  // namespace sfcc
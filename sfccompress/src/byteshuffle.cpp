@@ -0,0 +1,286 @@
+/**
+ * @file byteshuffle.cpp
+ * @author Conrad Haupt (conrad@conradhaupt.co.za)
+ * @brief Byte-plane shuffle kernels
+ * @version 1.0
+ * @date 2020-03-23
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#include "byteshuffle.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SFCC_BYTESHUFFLE_X86
+#endif
+
+namespace sfcc {
+namespace {
+
+// Values from first to nvalues, one plane at a time
+void scalarShuffle(const std::uint8_t* input, std::uint8_t* output,
+                   const unsigned long long first,
+                   const unsigned long long nvalues, const int nbytes)
+{
+  for (auto b = 0; b < nbytes; b++) {
+    const auto plane = output + b * nvalues;
+    for (auto v = first; v < nvalues; v++) plane[v] = input[v * nbytes + b];
+  }
+}
+
+void scalarUnshuffle(const std::uint8_t* input, std::uint8_t* output,
+                     const unsigned long long first,
+                     const unsigned long long nvalues, const int nbytes)
+{
+  for (auto v = first; v < nvalues; v++)
+    for (auto b = 0; b < nbytes; b++)
+      output[v * nbytes + b] = input[b * nvalues + v];
+}
+
+#ifdef SFCC_BYTESHUFFLE_X86
+// The SIMD kernels load one vector of values per byte of a value and split
+// them into a stream of their even bytes and one of their odd bytes with a
+// saturating pack, halving the stride of each stream, until every stream is a
+// single plane. Stream k then holds the byte whose index is k bit-reversed.
+// The reverse interleaves the streams back together with unpacks.
+constexpr int planeOf(int stream, const int nbytes)
+{
+  auto plane = 0;
+  for (auto n = nbytes; n > 1; n /= 2, stream /= 2)
+    plane = (plane << 1) | (stream & 1);
+  return plane;
+}
+
+template <int N>
+__attribute__((target("sse2"))) unsigned long long sse2Shuffle(
+    const std::uint8_t* input, std::uint8_t* output,
+    const unsigned long long nvalues)
+{
+  constexpr auto Lanes = 16ULL;
+  const auto low = _mm_set1_epi16(0x00FF);
+  const auto ngroups = nvalues / Lanes;
+  for (auto g = 0ULL; g < ngroups; g++) {
+    __m128i v[N], t[N];
+    for (auto i = 0; i < N; i++)
+      v[i] = _mm_loadu_si128(
+          reinterpret_cast<const __m128i*>(input + (g * N + i) * Lanes));
+    // Each stream of len vectors becomes two of len / 2
+    for (auto len = N; len > 1; len /= 2) {
+      for (auto i = 0; i < N / 2; i++) {
+        const auto first = 2 * i / len * len;
+        const auto j = i - first / 2;
+        const auto a = v[2 * i];
+        const auto b = v[2 * i + 1];
+        t[first + j] =
+            _mm_packus_epi16(_mm_and_si128(a, low), _mm_and_si128(b, low));
+        t[first + len / 2 + j] =
+            _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+      }
+      std::copy(t, t + N, v);
+    }
+    for (auto k = 0; k < N; k++)
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(
+                           output + planeOf(k, N) * nvalues + g * Lanes),
+                       v[k]);
+  }
+  return ngroups * Lanes;
+}
+
+template <int N>
+__attribute__((target("sse2"))) unsigned long long sse2Unshuffle(
+    const std::uint8_t* input, std::uint8_t* output,
+    const unsigned long long nvalues)
+{
+  constexpr auto Lanes = 16ULL;
+  const auto ngroups = nvalues / Lanes;
+  for (auto g = 0ULL; g < ngroups; g++) {
+    __m128i v[N], t[N];
+    for (auto k = 0; k < N; k++)
+      v[k] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(
+          input + planeOf(k, N) * nvalues + g * Lanes));
+    // Each pair of streams of len / 2 vectors becomes one of len
+    for (auto len = 2; len <= N; len *= 2) {
+      for (auto i = 0; i < N / 2; i++) {
+        const auto first = 2 * i / len * len;
+        const auto j = i - first / 2;
+        const auto even = v[first + j];
+        const auto odd = v[first + len / 2 + j];
+        t[2 * i] = _mm_unpacklo_epi8(even, odd);
+        t[2 * i + 1] = _mm_unpackhi_epi8(even, odd);
+      }
+      std::copy(t, t + N, v);
+    }
+    for (auto i = 0; i < N; i++)
+      _mm_storeu_si128(
+          reinterpret_cast<__m128i*>(output + (g * N + i) * Lanes), v[i]);
+  }
+  return ngroups * Lanes;
+}
+
+// AVX2 packs and unpacks each 128-bit lane on its own, so the lanes are put
+// back in order after each
+template <int N>
+__attribute__((target("avx2"))) unsigned long long avx2Shuffle(
+    const std::uint8_t* input, std::uint8_t* output,
+    const unsigned long long nvalues)
+{
+  constexpr auto Lanes = 32ULL;
+  const auto low = _mm256_set1_epi16(0x00FF);
+  const auto ngroups = nvalues / Lanes;
+  for (auto g = 0ULL; g < ngroups; g++) {
+    __m256i v[N], t[N];
+    for (auto i = 0; i < N; i++)
+      v[i] = _mm256_loadu_si256(
+          reinterpret_cast<const __m256i*>(input + (g * N + i) * Lanes));
+    for (auto len = N; len > 1; len /= 2) {
+      for (auto i = 0; i < N / 2; i++) {
+        const auto first = 2 * i / len * len;
+        const auto j = i - first / 2;
+        const auto a = v[2 * i];
+        const auto b = v[2 * i + 1];
+        t[first + j] = _mm256_permute4x64_epi64(
+            _mm256_packus_epi16(_mm256_and_si256(a, low),
+                                _mm256_and_si256(b, low)),
+            _MM_SHUFFLE(3, 1, 2, 0));
+        t[first + len / 2 + j] = _mm256_permute4x64_epi64(
+            _mm256_packus_epi16(_mm256_srli_epi16(a, 8),
+                                _mm256_srli_epi16(b, 8)),
+            _MM_SHUFFLE(3, 1, 2, 0));
+      }
+      std::copy(t, t + N, v);
+    }
+    for (auto k = 0; k < N; k++)
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(
+                              output + planeOf(k, N) * nvalues + g * Lanes),
+                          v[k]);
+  }
+  return ngroups * Lanes;
+}
+
+template <int N>
+__attribute__((target("avx2"))) unsigned long long avx2Unshuffle(
+    const std::uint8_t* input, std::uint8_t* output,
+    const unsigned long long nvalues)
+{
+  constexpr auto Lanes = 32ULL;
+  const auto ngroups = nvalues / Lanes;
+  for (auto g = 0ULL; g < ngroups; g++) {
+    __m256i v[N], t[N];
+    for (auto k = 0; k < N; k++)
+      v[k] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(
+          input + planeOf(k, N) * nvalues + g * Lanes));
+    for (auto len = 2; len <= N; len *= 2) {
+      for (auto i = 0; i < N / 2; i++) {
+        const auto first = 2 * i / len * len;
+        const auto j = i - first / 2;
+        const auto even = v[first + j];
+        const auto odd = v[first + len / 2 + j];
+        const auto lo = _mm256_unpacklo_epi8(even, odd);
+        const auto hi = _mm256_unpackhi_epi8(even, odd);
+        t[2 * i] = _mm256_permute2x128_si256(lo, hi, 0x20);
+        t[2 * i + 1] = _mm256_permute2x128_si256(lo, hi, 0x31);
+      }
+      std::copy(t, t + N, v);
+    }
+    for (auto i = 0; i < N; i++)
+      _mm256_storeu_si256(
+          reinterpret_cast<__m256i*>(output + (g * N + i) * Lanes), v[i]);
+  }
+  return ngroups * Lanes;
+}
+#endif
+
+// Number of values shuffled by the SIMD kernel, the rest being left to the
+// scalar one
+template <int N>
+unsigned long long simdValues(const std::uint8_t* input, std::uint8_t* output,
+                              const unsigned long long nvalues,
+                              const ByteShuffleKernel kernel,
+                              const bool reverse)
+{
+  switch (kernel) {
+#ifdef SFCC_BYTESHUFFLE_X86
+    case ByteShuffleKernel::SSE2:
+      return reverse ? sse2Unshuffle<N>(input, output, nvalues)
+                     : sse2Shuffle<N>(input, output, nvalues);
+    case ByteShuffleKernel::AVX2:
+      return reverse ? avx2Unshuffle<N>(input, output, nvalues)
+                     : avx2Shuffle<N>(input, output, nvalues);
+#endif
+    default:
+      return 0;
+  }
+}
+
+void shuffleBytes(const std::uint8_t* input, std::uint8_t* output,
+                  const unsigned long long length, const int nbytes,
+                  const ByteShuffleKernel kernel, const bool reverse)
+{
+  if (!byteShuffleKernelSupported(kernel))
+    throw std::invalid_argument("Byte shuffle kernel is not supported");
+  if (nbytes < 1)
+    throw std::invalid_argument("Values must be at least one byte long");
+  const auto nvalues = length / nbytes;
+  auto done = 0ULL;
+  switch (nbytes) {
+    case 2:
+      done = simdValues<2>(input, output, nvalues, kernel, reverse);
+      break;
+    case 4:
+      done = simdValues<4>(input, output, nvalues, kernel, reverse);
+      break;
+    case 8:
+      done = simdValues<8>(input, output, nvalues, kernel, reverse);
+      break;
+  }
+  if (reverse)
+    scalarUnshuffle(input, output, done, nvalues, nbytes);
+  else
+    scalarShuffle(input, output, done, nvalues, nbytes);
+  const auto whole = nvalues * nbytes;
+  std::copy(input + whole, input + length, output + whole);
+}
+
+}  // namespace
+
+bool byteShuffleKernelSupported(const ByteShuffleKernel kernel)
+{
+  switch (kernel) {
+    case ByteShuffleKernel::SCALAR:
+      return true;
+#ifdef SFCC_BYTESHUFFLE_X86
+    case ByteShuffleKernel::SSE2:
+      return __builtin_cpu_supports("sse2");
+    case ByteShuffleKernel::AVX2:
+      return __builtin_cpu_supports("avx2");
+#endif
+    default:
+      return false;
+  }
+}
+
+ByteShuffleKernel bestByteShuffleKernel()
+{
+  static const auto best = []() {
+    for (auto kernel : {ByteShuffleKernel::AVX2, ByteShuffleKernel::SSE2})
+      if (byteShuffleKernelSupported(kernel)) return kernel;
+    return ByteShuffleKernel::SCALAR;
+  }();
+  return best;
+}
+
+void byteShuffle(const std::uint8_t* input, std::uint8_t* output,
+                 const unsigned long long length, const int nbytes,
+                 const ByteShuffleKernel kernel)
+{
+  shuffleBytes(input, output, length, nbytes, kernel, false);
+}
+
+void reverseByteShuffle(const std::uint8_t* input, std::uint8_t* output,
+                        const unsigned long long length, const int nbytes,
+                        const ByteShuffleKernel kernel)
+{
+  shuffleBytes(input, output, length, nbytes, kernel, true);
+}
+
+}  // namespace sfcc
@@ -0,0 +1,519 @@
+/**
+ * @file canonical_huffman.cpp
+ * @author Conrad Haupt (conrad@conradhaupt.co.za)
+ * @brief Length-limited canonical Huffman coding over 8- or 16-bit symbols
+ * @version 1.0
+ * @date 2020-03-09
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#include "canonical_huffman.h"
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <string>
+
+namespace sfcc {
+namespace canonical_huffman {
+
+namespace {
+// Stream layout: symbol width, symbol count, code table, codes
+constexpr int SymbolWidthBits = 8;
+constexpr int SymbolCountBits = 64;
+// Code table: bounds of the coded symbols followed by a length for each symbol
+// in between. A zero length is followed by the number of further zero lengths.
+constexpr int LengthBits = 5;
+constexpr int ZeroRunBits = 8;
+constexpr unsigned MaxZeroRun = (1U << ZeroRunBits) - 1;
+// Interleaved streams: byte size of every stream but the last
+constexpr int JumpTableEntryBits = 64;
+
+std::uint32_t reverseBits(std::uint32_t code, int length)
+{
+  std::uint32_t reversed = 0;
+  for (auto i = 0; i < length; i++) {
+    reversed = (reversed << 1) | (code & 1);
+    code >>= 1;
+  }
+  return reversed;
+}
+
+int maxCodeLengthFor(int symbolBits)
+{
+  return symbolBits == 8 ? MaxCodeLength8 : MaxCodeLength16;
+}
+}  // namespace
+
+std::vector<std::uint8_t> lengthLimitedCodeLengths(
+    const std::vector<std::uint64_t>& frequencies, const int maxCodeLength)
+{
+  std::vector<std::uint8_t> lengths(frequencies.size(), 0);
+
+  // Leaves ordered by increasing frequency
+  std::vector<std::uint32_t> leaves;
+  for (std::uint32_t symbol = 0; symbol < frequencies.size(); symbol++)
+    if (frequencies[symbol] != 0) leaves.push_back(symbol);
+  std::stable_sort(std::begin(leaves), std::end(leaves),
+                   [&frequencies](auto a, auto b) {
+                     return frequencies[a] < frequencies[b];
+                   });
+
+  const auto nleaves = leaves.size();
+  if (nleaves == 0) return lengths;
+  if (nleaves == 1) {
+    // A lone symbol still needs a one bit code
+    lengths[leaves[0]] = 1;
+    return lengths;
+  }
+  if (maxCodeLength < 1 || maxCodeLength > MaxCodeLength16 ||
+      (nleaves - 1) >> maxCodeLength != 0)
+    throw std::logic_error("Cannot code " + std::to_string(nleaves) +
+                           " symbols with at most " +
+                           std::to_string(maxCodeLength) + " bits");
+
+  // Package-merge. Each level is the merge of the leaves with the pairwise
+  // packages of the level below, and only the 2n-2 lightest items of a level
+  // can ever be selected. Items selected from a level are always a prefix of
+  // it, so for each level we only need to remember which items are leaves.
+  const auto maxItems = 2 * nleaves - 2;
+  std::vector<std::vector<bool>> isLeaf(maxCodeLength);
+  std::vector<std::uint64_t> level;
+  std::vector<std::uint64_t> packages;
+  for (auto iLevel = 0; iLevel < maxCodeLength; iLevel++) {
+    packages.clear();
+    for (std::size_t i = 0; i + 1 < level.size(); i += 2)
+      packages.push_back(level[i] + level[i + 1]);
+
+    level.clear();
+    auto& leafFlags = isLeaf[iLevel];
+    std::size_t iLeaf = 0;
+    std::size_t iPackage = 0;
+    while (level.size() < maxItems &&
+           (iLeaf < nleaves || iPackage < packages.size())) {
+      if (iPackage == packages.size() ||
+          (iLeaf < nleaves &&
+           frequencies[leaves[iLeaf]] <= packages[iPackage])) {
+        level.push_back(frequencies[leaves[iLeaf++]]);
+        leafFlags.push_back(true);
+      } else {
+        level.push_back(packages[iPackage++]);
+        leafFlags.push_back(false);
+      }
+    }
+  }
+
+  // Walk back down from the top level. Every level a leaf is selected in adds
+  // one bit to its code.
+  auto nselected = maxItems;
+  for (auto iLevel = maxCodeLength - 1; iLevel >= 0; iLevel--) {
+    const auto& leafFlags = isLeaf[iLevel];
+    std::size_t nselectedLeaves = 0;
+    for (std::size_t i = 0; i < nselected; i++)
+      if (leafFlags[i]) lengths[leaves[nselectedLeaves++]]++;
+    nselected = 2 * (nselected - nselectedLeaves);
+  }
+  return lengths;
+}
+
+CodeTable::CodeTable(std::vector<std::uint8_t> codeLengths)
+    : lengths(std::move(codeLengths)),
+      codes(lengths.size(), 0),
+      decodeTable(1U << DecodeTableBits, 0)
+{
+  if (lengths.size() > (1U << 16))
+    throw std::logic_error("Huffman alphabet is larger than 16 bits");
+
+  for (auto length : lengths) {
+    if (length > MaxCodeLength16)
+      throw std::runtime_error("Huffman code length of " +
+                               std::to_string(length) + " is too long");
+    lengthCounts[length]++;
+    maxCodeLength = std::max<int>(maxCodeLength, length);
+  }
+  lengthCounts[0] = 0;
+
+  // Reject over-subscribed codes, they would not be prefix-free
+  std::uint64_t kraft = 0;
+  for (auto length = 1; length <= MaxCodeLength16; length++)
+    kraft += std::uint64_t(lengthCounts[length]) << (MaxCodeLength16 - length);
+  if (kraft > (1ULL << MaxCodeLength16))
+    throw std::runtime_error("Huffman code lengths are over-subscribed");
+
+  // First canonical code and first sorted index of each length
+  std::array<std::uint32_t, MaxCodeLength16 + 1> nextCode{};
+  std::array<std::uint32_t, MaxCodeLength16 + 1> nextIndex{};
+  for (auto length = 1; length <= MaxCodeLength16; length++) {
+    nextCode[length] = (nextCode[length - 1] + lengthCounts[length - 1]) << 1;
+    nextIndex[length] = nextIndex[length - 1] + lengthCounts[length - 1];
+  }
+
+  sortedSymbols.resize(nextIndex[MaxCodeLength16] +
+                       lengthCounts[MaxCodeLength16]);
+  for (std::uint32_t symbol = 0; symbol < lengths.size(); symbol++) {
+    const int length = lengths[symbol];
+    if (length == 0) continue;
+    codes[symbol] = reverseBits(nextCode[length]++, length);
+    sortedSymbols[nextIndex[length]++] = symbol;
+
+    // Replicate short codes over every table index they prefix
+    if (length <= DecodeTableBits) {
+      const std::uint32_t entry = (std::uint32_t(length) << 16) | symbol;
+      for (auto i = codes[symbol]; i < decodeTable.size(); i += 1U << length)
+        decodeTable[i] = entry;
+    }
+  }
+}
+
+CodeTable CodeTable::fromFrequencies(
+    const std::vector<std::uint64_t>& frequencies, const int maxCodeLength)
+{
+  return CodeTable(lengthLimitedCodeLengths(frequencies, maxCodeLength));
+}
+
+unsigned CodeTable::decodeSlow(BitStreamReader& reader) const
+{
+  // Canonical decoding, one code length at a time. The first bit in the stream
+  // is the most significant bit of the code.
+  const auto bits = reader.peekBits(maxCodeLength);
+  std::uint32_t code = 0;
+  std::uint32_t first = 0;
+  std::uint32_t index = 0;
+  for (auto length = 1; length <= maxCodeLength; length++) {
+    code |= (bits >> (length - 1)) & 1;
+    const auto count = lengthCounts[length];
+    if (code - first < count) {
+      reader.skipBits(length);
+      return sortedSymbols[index + code - first];
+    }
+    index += count;
+    first = (first + count) << 1;
+    code <<= 1;
+  }
+  throw std::runtime_error("Invalid Huffman code in stream");
+}
+
+void CodeTable::write(BitStreamWriter& writer, const int symbolBits) const
+{
+  std::uint32_t firstSymbol = 0;
+  std::uint32_t lastSymbol = 0;
+  const auto used = std::find_if(std::begin(lengths), std::end(lengths),
+                                 [](auto length) { return length != 0; });
+  if (used != std::end(lengths)) {
+    firstSymbol = std::distance(std::begin(lengths), used);
+    lastSymbol = lengths.size() - 1;
+    while (lengths[lastSymbol] == 0) lastSymbol--;
+  }
+  writer.appendBitsU64(firstSymbol, symbolBits);
+  writer.appendBitsU64(lastSymbol, symbolBits);
+
+  for (auto symbol = firstSymbol; symbol <= lastSymbol; symbol++) {
+    writer.appendBitsU64(lengths[symbol], LengthBits);
+    if (lengths[symbol] != 0) continue;
+    unsigned run = 0;
+    while (run < MaxZeroRun && symbol + 1 <= lastSymbol &&
+           lengths[symbol + 1] == 0) {
+      run++;
+      symbol++;
+    }
+    writer.appendBitsU64(run, ZeroRunBits);
+  }
+}
+
+CodeTable CodeTable::read(BitStreamReader& reader, const int symbolBits)
+{
+  const auto firstSymbol = reader.readBitsU64(symbolBits);
+  const auto lastSymbol = reader.readBitsU64(symbolBits);
+  if (firstSymbol > lastSymbol)
+    throw std::runtime_error("Invalid Huffman code table bounds");
+
+  std::vector<std::uint8_t> lengths(1ULL << symbolBits, 0);
+  for (auto symbol = firstSymbol; symbol <= lastSymbol; symbol++) {
+    lengths[symbol] = reader.readBitsU64(LengthBits);
+    if (lengths[symbol] == 0) symbol += reader.readBitsU64(ZeroRunBits);
+  }
+  return CodeTable(std::move(lengths));
+}
+
+std::uint64_t CodeTable::tableSizeBits(const int symbolBits) const
+{
+  // Worst case is a zero run after every length
+  return 2ULL * symbolBits + lengths.size() * (LengthBits + ZeroRunBits);
+}
+
+namespace {
+template <typename TSymbol>
+CodeTable buildCodeTable(const TSymbol* uncompressed,
+                         const unsigned long long nsymbols)
+{
+  constexpr int symbolBits = sizeof(TSymbol) * 8;
+  std::vector<std::uint64_t> frequencies(1ULL << symbolBits, 0);
+  std::for_each(uncompressed, uncompressed + nsymbols,
+                [&frequencies](TSymbol symbol) { frequencies[symbol]++; });
+  return CodeTable::fromFrequencies(frequencies, maxCodeLengthFor(symbolBits));
+}
+
+template <typename TSymbol>
+std::uint64_t encodedSizeBits(const CodeTable& table,
+                              const TSymbol* uncompressed,
+                              const unsigned long long nsymbols)
+{
+  std::uint64_t bits = 0;
+  for (unsigned long long i = 0; i < nsymbols; i++)
+    bits += table.getCodeLength(uncompressed[i]);
+  return bits;
+}
+
+// Read and validate the symbol width and count that start every stream
+std::tuple<int, unsigned long long> readStreamHeader(
+    BitStreamReader& reader, const unsigned long long uncompressedSizeBytes)
+{
+  const int symbolBits = reader.readBitsU64(SymbolWidthBits);
+  if (symbolBits != 8 && symbolBits != 16)
+    throw std::runtime_error("Unsupported Huffman symbol width of " +
+                             std::to_string(symbolBits) + " bits");
+  const auto nsymbols = reader.readBitsU64(SymbolCountBits);
+  const auto outputSizeBytes = nsymbols * (symbolBits / 8);
+  if (outputSizeBytes > uncompressedSizeBytes)
+    throw std::runtime_error("Huffman output buffer is too small: " +
+                             std::to_string(uncompressedSizeBytes) + " < " +
+                             std::to_string(outputSizeBytes));
+  return {symbolBits, nsymbols};
+}
+
+// The output buffer may start at any byte, so 16-bit symbols are copied
+// rather than stored through a std::uint16_t pointer
+template <typename TSymbol>
+void storeSymbol(std::uint8_t* output, const unsigned long long i,
+                 const unsigned symbol)
+{
+  const TSymbol value = symbol;
+  std::memcpy(output + i * sizeof(TSymbol), &value, sizeof(TSymbol));
+}
+
+template <typename TSymbol>
+void decodeSymbols(BitStreamReader& reader, const CodeTable& table,
+                   std::uint8_t* uncompressed,
+                   const unsigned long long nsymbols)
+{
+  for (unsigned long long i = 0; i < nsymbols; i++)
+    storeSymbol<TSymbol>(uncompressed, i, table.decode(reader));
+  if (reader.getBitsRead() > reader.getBitCount())
+    throw std::runtime_error("Huffman stream ended unexpectedly");
+}
+
+// Symbols per interleaved stream. The last stream may be shorter.
+unsigned long long streamLength(const unsigned long long nsymbols, int stream)
+{
+  const auto segment = (nsymbols + NumStreams - 1) / NumStreams;
+  const auto begin = std::min(nsymbols, segment * stream);
+  return std::min(nsymbols, begin + segment) - begin;
+}
+
+template <typename TSymbol>
+void decodeInterleavedSymbols(BitStreamReader (&readers)[NumStreams],
+                              const CodeTable& table,
+                              std::uint8_t* uncompressed,
+                              const unsigned long long nsymbols)
+{
+  const auto segment = (nsymbols + NumStreams - 1) / NumStreams;
+  std::uint8_t* outputs[NumStreams];
+  for (auto i = 0; i < NumStreams; i++)
+    outputs[i] =
+        uncompressed + std::min(nsymbols, segment * i) * sizeof(TSymbol);
+
+  // The four bit positions are independent, so the decodes of one iteration
+  // can overlap in the pipeline
+  const auto common = streamLength(nsymbols, NumStreams - 1);
+  for (unsigned long long j = 0; j < common; j++) {
+    storeSymbol<TSymbol>(outputs[0], j, table.decode(readers[0]));
+    storeSymbol<TSymbol>(outputs[1], j, table.decode(readers[1]));
+    storeSymbol<TSymbol>(outputs[2], j, table.decode(readers[2]));
+    storeSymbol<TSymbol>(outputs[3], j, table.decode(readers[3]));
+  }
+  // Tails of the longer streams
+  for (auto i = 0; i < NumStreams; i++) {
+    const auto length = streamLength(nsymbols, i);
+    for (auto j = common; j < length; j++)
+      storeSymbol<TSymbol>(outputs[i], j, table.decode(readers[i]));
+    if (readers[i].getBitsRead() > readers[i].getBitCount())
+      throw std::runtime_error("Huffman stream " + std::to_string(i) +
+                               " ended unexpectedly");
+  }
+}
+}  // namespace
+
+unsigned long long maxCompressedSize(const unsigned long long nsymbols,
+                                     const int symbolBits,
+                                     const bool interleaved)
+{
+  // A table with a zero run after every length and every symbol coded with
+  // the longest code allowed
+  auto headerBits = SymbolWidthBits + SymbolCountBits + 2ULL * symbolBits +
+                    (1ULL << symbolBits) * (LengthBits + ZeroRunBits);
+  const auto dataBits = nsymbols * maxCodeLengthFor(symbolBits);
+  if (!interleaved) return (headerBits + dataBits + 7) / 8;
+  // Each stream is byte-aligned
+  headerBits += (NumStreams - 1) * JumpTableEntryBits;
+  return (headerBits + 7) / 8 + (dataBits + 7) / 8 + NumStreams;
+}
+
+template <typename TSymbol>
+std::tuple<std::unique_ptr<std::uint8_t[]>, unsigned long long> easyEncode(
+    const TSymbol* uncompressed, const unsigned long long nsymbols)
+{
+  constexpr int symbolBits = sizeof(TSymbol) * 8;
+  const auto table = buildCodeTable(uncompressed, nsymbols);
+
+  // Size the stream up front so that it never has to grow while encoding
+  BitStreamWriter writer(SymbolWidthBits + SymbolCountBits +
+                         table.tableSizeBits(symbolBits) +
+                         encodedSizeBits(table, uncompressed, nsymbols));
+  writer.appendBitsU64(symbolBits, SymbolWidthBits);
+  writer.appendBitsU64(nsymbols, SymbolCountBits);
+  table.write(writer, symbolBits);
+  for (unsigned long long i = 0; i < nsymbols; i++)
+    table.encode(writer, uncompressed[i]);
+
+  const unsigned long long compressedSizeBytes = writer.getByteCount();
+  return {std::unique_ptr<std::uint8_t[]>(writer.release()),
+          compressedSizeBytes};
+}
+
+template std::tuple<std::unique_ptr<std::uint8_t[]>, unsigned long long>
+easyEncode<std::uint8_t>(const std::uint8_t*, unsigned long long);
+template std::tuple<std::unique_ptr<std::uint8_t[]>, unsigned long long>
+easyEncode<std::uint16_t>(const std::uint16_t*, unsigned long long);
+
+template <typename TSymbol>
+std::tuple<std::unique_ptr<std::uint8_t[]>, unsigned long long>
+easyEncodeInterleaved(const TSymbol* uncompressed,
+                      const unsigned long long nsymbols)
+{
+  constexpr int symbolBits = sizeof(TSymbol) * 8;
+  const auto table = buildCodeTable(uncompressed, nsymbols);
+
+  // Each stream codes one contiguous quarter of the symbols
+  const auto segment = (nsymbols + NumStreams - 1) / NumStreams;
+  const TSymbol* inputs[NumStreams];
+  std::unique_ptr<BitStreamWriter> writers[NumStreams];
+  for (auto i = 0; i < NumStreams; i++) {
+    inputs[i] = uncompressed + std::min(nsymbols, segment * i);
+    writers[i] = std::make_unique<BitStreamWriter>(
+        encodedSizeBits(table, inputs[i], streamLength(nsymbols, i)));
+  }
+  const auto common = streamLength(nsymbols, NumStreams - 1);
+  for (unsigned long long j = 0; j < common; j++) {
+    table.encode(*writers[0], inputs[0][j]);
+    table.encode(*writers[1], inputs[1][j]);
+    table.encode(*writers[2], inputs[2][j]);
+    table.encode(*writers[3], inputs[3][j]);
+  }
+  for (auto i = 0; i < NumStreams; i++) {
+    const auto length = streamLength(nsymbols, i);
+    for (auto j = common; j < length; j++)
+      table.encode(*writers[i], inputs[i][j]);
+  }
+
+  // Header: symbol width and count, code table and the jump table holding the
+  // byte sizes of the first three streams. The streams follow byte-aligned.
+  BitStreamWriter header(SymbolWidthBits + SymbolCountBits +
+                         table.tableSizeBits(symbolBits) +
+                         (NumStreams - 1) * JumpTableEntryBits);
+  header.appendBitsU64(symbolBits, SymbolWidthBits);
+  header.appendBitsU64(nsymbols, SymbolCountBits);
+  table.write(header, symbolBits);
+  for (auto i = 0; i < NumStreams - 1; i++)
+    header.appendBitsU64(writers[i]->getByteCount(), JumpTableEntryBits);
+
+  unsigned long long compressedSizeBytes = header.getByteCount();
+  for (auto i = 0; i < NumStreams; i++)
+    compressedSizeBytes += writers[i]->getByteCount();
+  auto compressed = std::make_unique<std::uint8_t[]>(compressedSizeBytes);
+  auto compressed_ptr = std::copy(header.getBitStream(),
+                                  header.getBitStream() + header.getByteCount(),
+                                  compressed.get());
+  for (auto i = 0; i < NumStreams; i++)
+    compressed_ptr = std::copy(
+        writers[i]->getBitStream(),
+        writers[i]->getBitStream() + writers[i]->getByteCount(), compressed_ptr);
+  return {std::move(compressed), compressedSizeBytes};
+}
+
+template std::tuple<std::unique_ptr<std::uint8_t[]>, unsigned long long>
+easyEncodeInterleaved<std::uint8_t>(const std::uint8_t*, unsigned long long);
+template std::tuple<std::unique_ptr<std::uint8_t[]>, unsigned long long>
+easyEncodeInterleaved<std::uint16_t>(const std::uint16_t*, unsigned long long);
+
+unsigned long long decodedSizeBytes(const std::uint8_t* compressed,
+                                    const unsigned long long compressedSizeBytes)
+{
+  BitStreamReader reader(compressed, compressedSizeBytes,
+                         compressedSizeBytes * 8);
+  const auto symbolBits = reader.readBitsU64(SymbolWidthBits);
+  const auto nsymbols = reader.readBitsU64(SymbolCountBits);
+  return nsymbols * (symbolBits / 8);
+}
+
+unsigned long long easyDecode(const std::uint8_t* compressed,
+                              const unsigned long long compressedSizeBytes,
+                              std::uint8_t* uncompressed,
+                              const unsigned long long uncompressedSizeBytes)
+{
+  BitStreamReader reader(compressed, compressedSizeBytes,
+                         compressedSizeBytes * 8);
+  const auto [symbolBits, nsymbols] =
+      readStreamHeader(reader, uncompressedSizeBytes);
+  if (nsymbols == 0) return 0;
+
+  const auto table = CodeTable::read(reader, symbolBits);
+  if (symbolBits == 8)
+    decodeSymbols<std::uint8_t>(reader, table, uncompressed, nsymbols);
+  else
+    decodeSymbols<std::uint16_t>(reader, table, uncompressed, nsymbols);
+  return nsymbols * (symbolBits / 8);
+}
+
+unsigned long long easyDecodeInterleaved(
+    const std::uint8_t* compressed,
+    const unsigned long long compressedSizeBytes, std::uint8_t* uncompressed,
+    const unsigned long long uncompressedSizeBytes)
+{
+  BitStreamReader header(compressed, compressedSizeBytes,
+                         compressedSizeBytes * 8);
+  const auto [symbolBits, nsymbols] =
+      readStreamHeader(header, uncompressedSizeBytes);
+  if (nsymbols == 0) return 0;
+
+  const auto table = CodeTable::read(header, symbolBits);
+  // Locate the streams from the jump table, the last one takes the remainder
+  unsigned long long streamSizes[NumStreams];
+  for (auto i = 0; i < NumStreams - 1; i++)
+    streamSizes[i] = header.readBitsU64(JumpTableEntryBits);
+  unsigned long long offset = (header.getBitsRead() + 7) / 8;
+  const std::uint8_t* streams[NumStreams];
+  for (auto i = 0; i < NumStreams - 1; i++) {
+    streams[i] = compressed + offset;
+    offset += streamSizes[i];
+    if (offset > compressedSizeBytes)
+      throw std::runtime_error("Huffman jump table exceeds the data size");
+  }
+  streams[NumStreams - 1] = compressed + offset;
+  streamSizes[NumStreams - 1] = compressedSizeBytes - offset;
+
+  BitStreamReader readers[NumStreams] = {
+      {streams[0], streamSizes[0], streamSizes[0] * 8},
+      {streams[1], streamSizes[1], streamSizes[1] * 8},
+      {streams[2], streamSizes[2], streamSizes[2] * 8},
+      {streams[3], streamSizes[3], streamSizes[3] * 8}};
+  if (symbolBits == 8)
+    decodeInterleavedSymbols<std::uint8_t>(readers, table, uncompressed,
+                                           nsymbols);
+  else
+    decodeInterleavedSymbols<std::uint16_t>(readers, table, uncompressed,
+                                            nsymbols);
+  return nsymbols * (symbolBits / 8);
+}
+
+}  // namespace canonical_huffman
+}  // namespace sfcc
@@ -10,79 +10,128 @@
  */
 
 #include "compressor.h"
+#include "pipeline.h"
 
 namespace sfcc {
-// HUFFMAN
-huffman::huffman() {}
-huffman::~huffman() {}
+namespace {
+// Number of bytes of data described by a header, or of the bzip<> block being
+// decoded
+unsigned long long headerDataLength(const sfc::sfcc_header& header)
+{
+  if (header.output_block_length) return header.output_block_length.value();
+  return (1ULL << (header.sidelength_k * header.ndims)) * header.dtype_nbytes;
+}
+
+// Copy a stream allocated by an encoder into the caller's output
+unsigned long long copyStream(const std::uint8_t* stream,
+                              const unsigned long long length,
+                              std::uint8_t* output,
+                              const unsigned long long capacity)
+{
+  requireCapacity(capacity, length);
+  std::copy(stream, stream + length, output);
+  return length;
+}
+
+// Use the plane layout written by BitTransposer where there is one. Blocked
+// layouts interleave the planes of every block, so they are coded as one.
+int bitplaneCount(const sfc::sfcc_header& header)
+{
+  if (header.bittransposed && !header.bittranspose_block_nbits &&
+      (header.dtype_nbytes == 2 || header.dtype_nbytes == 4))
+    return header.dtype_nbytes * 8;
+  return 1;
+}
+}  // namespace
+
+void requireCapacity(const unsigned long long capacity,
+                     const unsigned long long required)
+{
+  if (capacity < required)
+    throw std::length_error("Output of " + std::to_string(capacity) +
+                            " bytes is smaller than the " +
+                            std::to_string(required) + " bytes required");
+}
+
+// COMPRESSOR
 std::tuple<std::unique_ptr<std::uint8_t[]>, unsigned long long,
            sfc::sfcc_header>
-huffman::compress(const std::unique_ptr<std::uint8_t[]>& data,
-                  const unsigned long long& length,
-                  const sfc::sfcc_header& header)
+compressor::compress(const std::unique_ptr<std::uint8_t[]>& data,
+                     const unsigned long long& length,
+                     const sfc::sfcc_header& header)
 {
-  // Construct temporary data
-  std::uint8_t* tmp_data;
-  int output_length;
-  int output_length_bits;
+  const auto capacity = maxCompressedSize(length, header);
+  auto output_data = std::make_unique<std::uint8_t[]>(capacity);
+  auto [output_length, head] =
+      compressInto(data.get(), length, output_data.get(), capacity, header);
+  return {std::move(output_data), output_length, head};
+}
 
-  // Compress using Huffman encoding
-  // void easyEncode(const std::uint8_t *uncompressed,
-  // const int uncompressedSizeBytes, std::uint8_t **compressed,
-  // int *compressedSizeBytes, int *compressedSizeBits)
+std::tuple<std::unique_ptr<std::uint8_t[]>, unsigned long long,
+           sfc::sfcc_header>
+compressor::decompress(const std::unique_ptr<std::uint8_t[]>& data,
+                       const unsigned long long& length,
+                       const sfc::sfcc_header& header)
+{
+  const auto capacity = maxDecompressedSize(data.get(), length, header);
+  auto output_data = std::make_unique<std::uint8_t[]>(capacity);
+  auto [output_length, head] =
+      decompressInto(data.get(), length, output_data.get(), capacity, header);
+  return {std::move(output_data), output_length, head};
+}
 
-  ::huffman::easyEncode(data.get(), length, &tmp_data, &output_length,
-                        &output_length_bits);
+// HUFFMAN
+huffman::huffman() {}
+huffman::~huffman() {}
+unsigned long long huffman::maxCompressedSize(
+    const unsigned long long length, const sfc::sfcc_header& header) const
+{
+  return ::huffman::maxCompressedSize(length);
+}
 
-  // Create appropriately sized unique_ptr
-  auto output_data = std::make_unique<std::uint8_t[]>(output_length);
+std::tuple<unsigned long long, sfc::sfcc_header> huffman::compressInto(
+    const std::uint8_t* data, const unsigned long long length,
+    std::uint8_t* output, const unsigned long long capacity,
+    const sfc::sfcc_header& header)
+{
+  requireCapacity(capacity, maxCompressedSize(length, header));
+  std::uint8_t* tmp_data;
+  std::uint64_t output_length;
+  std::uint64_t output_length_bits;
+  ::huffman::easyEncode(data, length, &tmp_data, &output_length,
+                        &output_length_bits);
+  // The encoder owns its stream, so it is copied into the output once
+  std::unique_ptr<std::uint8_t[]> stream(tmp_data);
+  copyStream(stream.get(), output_length, output, capacity);
 
-  // Move tmp data to unique_ptr
-  std::move(tmp_data, tmp_data + output_length, output_data.get());
-  delete[] tmp_data;
   auto head = header;
   head.compressiontype = ::sfc::sfcc::compression_t::HUFFMAN;
   head.npaddingbits = output_length_bits % 8;
-  // Move-return unique_ptr
-  return {std::move(output_data), output_length, head};
+  return {output_length, head};
 }
 
-std::tuple<std::unique_ptr<std::uint8_t[]>, unsigned long long,
-           sfc::sfcc_header>
-huffman::decompress(const std::unique_ptr<std::uint8_t[]>& data,
-                    const unsigned long long& length,
-                    const sfc::sfcc_header& header)
-{
-  // Construct temporary data
-  auto compressed_size_bits =
-      header.npaddingbits.value() == 0
-          ? length * 8
-          : (length - 1) * 8 + header.npaddingbits.value();
-  auto uncompressed_size_bytes =
-      (1ULL << (header.sidelength_k * header.ndims)) * header.dtype_nbytes;
-  // std::uint8_t* tmp_data = new std::uint8_t[uncompressed_size_bytes];
-  auto tmp_data = std::make_unique<std::uint8_t[]>(uncompressed_size_bytes);
-
-  // Compress using Huffman encoding
-  // void easyEncode(const std::uint8_t *uncompressed,
-  // const int uncompressedSizeBytes, std::uint8_t **compressed,
-  // int *compressedSizeBytes, int *compressedSizeBits)
-
-  ::huffman::easyDecode(data.get(), length,
-                        // ((length - 1) * 8) + header.npaddingbits.value() + 1,
-                        length * 8, tmp_data.get(), uncompressed_size_bytes);
-
-  // Create appropriately sized unique_ptr
-  auto output_data = std::make_unique<std::uint8_t[]>(uncompressed_size_bytes);
-  std::move(tmp_data.get(), tmp_data.get() + uncompressed_size_bytes,
-            output_data.get());
-  // delete[] tmp_data;
-  tmp_data.reset();
+unsigned long long huffman::maxDecompressedSize(
+    const std::uint8_t* data, const unsigned long long length,
+    const sfc::sfcc_header& header) const
+{
+  return headerDataLength(header);
+}
+
+std::tuple<unsigned long long, sfc::sfcc_header> huffman::decompressInto(
+    const std::uint8_t* data, const unsigned long long length,
+    std::uint8_t* output, const unsigned long long capacity,
+    const sfc::sfcc_header& header)
+{
+  const auto uncompressed_size_bytes =
+      maxDecompressedSize(data, length, header);
+  requireCapacity(capacity, uncompressed_size_bytes);
+  ::huffman::easyDecode(data, length, length * 8, output,
+                        uncompressed_size_bytes);
+
   auto head = header;
   head.compressiontype = ::sfc::sfcc::compression_t::NONE;
   head.sfctype = ::sfc::sfcc::sfc_t::ROW_MAJOR;
-  // Move-return unique_ptr
-  return {std::move(output_data), uncompressed_size_bytes, head};
+  return {uncompressed_size_bytes, head};
 }
 
 std::string huffman::getFileExtension() const { return "hff"; }
@@ -91,61 +140,254 @@ sfc::sfcc::compression_t huffman::getCompressionType() const
   return sfc::sfcc::compression_t::HUFFMAN;
 }
 
+// HUFFMAN16
+huffman16::huffman16(bool interleaved) : _interleaved{interleaved} {}
+huffman16::~huffman16() {}
+unsigned long long huffman16::maxCompressedSize(
+    const unsigned long long length, const sfc::sfcc_header& header) const
+{
+  if (header.dtype_nbytes % 2 == 0 && length % 2 == 0)
+    return canonical_huffman::maxCompressedSize(length / 2, 16, _interleaved);
+  return canonical_huffman::maxCompressedSize(length, 8, _interleaved);
+}
+
+std::tuple<unsigned long long, sfc::sfcc_header> huffman16::compressInto(
+    const std::uint8_t* data, const unsigned long long length,
+    std::uint8_t* output, const unsigned long long capacity,
+    const sfc::sfcc_header& header)
+{
+  requireCapacity(capacity, maxCompressedSize(length, header));
+  // Code whole 16-bit samples where the data allows it so that the high and
+  // low bytes are not modelled as one distribution
+  std::unique_ptr<std::uint8_t[]> stream;
+  unsigned long long output_length;
+  if (header.dtype_nbytes % 2 == 0 && length % 2 == 0) {
+    // The input may start at any byte, so it is read as samples from a copy
+    // unless it is aligned
+    auto samples = reinterpret_cast<const std::uint16_t*>(data);
+    std::vector<std::uint16_t> aligned;
+    if (reinterpret_cast<std::uintptr_t>(data) % alignof(std::uint16_t)) {
+      aligned.resize(length / 2);
+      std::memcpy(aligned.data(), data, length);
+      samples = aligned.data();
+    }
+    std::tie(stream, output_length) =
+        _interleaved
+            ? canonical_huffman::easyEncodeInterleaved(samples, length / 2)
+            : canonical_huffman::easyEncode(samples, length / 2);
+  } else {
+    std::tie(stream, output_length) =
+        _interleaved ? canonical_huffman::easyEncodeInterleaved(data, length)
+                     : canonical_huffman::easyEncode(data, length);
+  }
+  copyStream(stream.get(), output_length, output, capacity);
+
+  auto head = header;
+  head.compressiontype = getCompressionType();
+  if (::sfc::DEBUG)
+    std::cout << "HUFFMAN16: output_length=" << output_length
+              << " interleaved=" << _interleaved << std::endl;
+  return {output_length, head};
+}
+
+unsigned long long huffman16::maxDecompressedSize(
+    const std::uint8_t* data, const unsigned long long length,
+    const sfc::sfcc_header& header) const
+{
+  // The stream records its own symbol width and count
+  return canonical_huffman::decodedSizeBytes(data, length);
+}
+
+std::tuple<unsigned long long, sfc::sfcc_header> huffman16::decompressInto(
+    const std::uint8_t* data, const unsigned long long length,
+    std::uint8_t* output, const unsigned long long capacity,
+    const sfc::sfcc_header& header)
+{
+  const auto output_length = maxDecompressedSize(data, length, header);
+  requireCapacity(capacity, output_length);
+  if (_interleaved)
+    canonical_huffman::easyDecodeInterleaved(data, length, output,
+                                             output_length);
+  else
+    canonical_huffman::easyDecode(data, length, output, output_length);
+
+  auto head = header;
+  head.compressiontype = ::sfc::sfcc::compression_t::NONE;
+  return {output_length, head};
+}
+
+std::string huffman16::getFileExtension() const
+{
+  return _interleaved ? "hff16x4" : "hff16";
+}
+sfc::sfcc::compression_t huffman16::getCompressionType() const
+{
+  return _interleaved ? sfc::sfcc::compression_t::HUFFMAN16_X4
+                      : sfc::sfcc::compression_t::HUFFMAN16;
+}
+
+// FSE
+fse::fse() {}
+fse::~fse() {}
+unsigned long long fse::maxCompressedSize(const unsigned long long length,
+                                          const sfc::sfcc_header& header) const
+{
+  return ::fse::maxCompressedSize(length);
+}
+
+std::tuple<unsigned long long, sfc::sfcc_header> fse::compressInto(
+    const std::uint8_t* data, const unsigned long long length,
+    std::uint8_t* output, const unsigned long long capacity,
+    const sfc::sfcc_header& header)
+{
+  requireCapacity(capacity, maxCompressedSize(length, header));
+  const auto [stream, output_length] = ::fse::easyEncode(data, length);
+  copyStream(stream.get(), output_length, output, capacity);
+
+  auto head = header;
+  head.compressiontype = ::sfc::sfcc::compression_t::FSE;
+  if (::sfc::DEBUG)
+    std::cout << "FSE: output_length=" << output_length << std::endl;
+  return {output_length, head};
+}
+
+unsigned long long fse::maxDecompressedSize(
+    const std::uint8_t* data, const unsigned long long length,
+    const sfc::sfcc_header& header) const
+{
+  // The stream records its own length
+  return ::fse::decodedSizeBytes(data, length);
+}
+
+std::tuple<unsigned long long, sfc::sfcc_header> fse::decompressInto(
+    const std::uint8_t* data, const unsigned long long length,
+    std::uint8_t* output, const unsigned long long capacity,
+    const sfc::sfcc_header& header)
+{
+  const auto output_length = maxDecompressedSize(data, length, header);
+  requireCapacity(capacity, output_length);
+  ::fse::easyDecode(data, length, output, output_length);
+
+  auto head = header;
+  head.compressiontype = ::sfc::sfcc::compression_t::NONE;
+  return {output_length, head};
+}
+
+std::string fse::getFileExtension() const { return "fse"; }
+sfc::sfcc::compression_t fse::getCompressionType() const
+{
+  return sfc::sfcc::compression_t::FSE;
+}
+
+// BITPLANE
+bitplane::bitplane() {}
+bitplane::~bitplane() {}
+unsigned long long bitplane::maxCompressedSize(
+    const unsigned long long length, const sfc::sfcc_header& header) const
+{
+  return ::bitplane::maxCompressedSize(length, bitplaneCount(header));
+}
+
+std::tuple<unsigned long long, sfc::sfcc_header> bitplane::compressInto(
+    const std::uint8_t* data, const unsigned long long length,
+    std::uint8_t* output, const unsigned long long capacity,
+    const sfc::sfcc_header& header)
+{
+  requireCapacity(capacity, maxCompressedSize(length, header));
+  const auto nplanes = bitplaneCount(header);
+  const auto planeBytes =
+      nplanes == 1 ? length
+                   : ::bitplane::planeSizeBytes(length, header.dtype_nbytes);
+  const auto [stream, output_length] =
+      ::bitplane::easyEncode(data, length, nplanes, planeBytes);
+  copyStream(stream.get(), output_length, output, capacity);
+
+  auto head = header;
+  head.compressiontype = ::sfc::sfcc::compression_t::BITPLANE;
+  if (::sfc::DEBUG)
+    std::cout << "BITPLANE: planes=" << nplanes
+              << " output_length=" << output_length << std::endl;
+  return {output_length, head};
+}
+
+unsigned long long bitplane::maxDecompressedSize(
+    const std::uint8_t* data, const unsigned long long length,
+    const sfc::sfcc_header& header) const
+{
+  // The stream records its own length and plane layout
+  return ::bitplane::decodedSizeBytes(data, length);
+}
+
+std::tuple<unsigned long long, sfc::sfcc_header> bitplane::decompressInto(
+    const std::uint8_t* data, const unsigned long long length,
+    std::uint8_t* output, const unsigned long long capacity,
+    const sfc::sfcc_header& header)
+{
+  const auto output_length = maxDecompressedSize(data, length, header);
+  requireCapacity(capacity, output_length);
+  ::bitplane::easyDecode(data, length, output, output_length);
+
+  auto head = header;
+  head.compressiontype = ::sfc::sfcc::compression_t::NONE;
+  return {output_length, head};
+}
+
+std::string bitplane::getFileExtension() const { return "bpc"; }
+sfc::sfcc::compression_t bitplane::getCompressionType() const
+{
+  return sfc::sfcc::compression_t::BITPLANE;
+}
+
 // LZ77
-lz77::lz77() {}
+lz77::lz77(int level) : _level{level}
+{
+  if (level < ::lz77::MinLevel || level > ::lz77::MaxLevel)
+    throw std::invalid_argument("LZ77 level must be between " +
+                                std::to_string(::lz77::MinLevel) + " and " +
+                                std::to_string(::lz77::MaxLevel));
+}
 lz77::~lz77() {}
-std::tuple<std::unique_ptr<std::uint8_t[]>, unsigned long long,
-           sfc::sfcc_header>
-lz77::compress(const std::unique_ptr<std::uint8_t[]>& data,
-               const unsigned long long& length, const sfc::sfcc_header& header)
+unsigned long long lz77::maxCompressedSize(
+    const unsigned long long length, const sfc::sfcc_header& header) const
+{
+  return ::lz77::maxCompressedSize(length);
+}
+
+std::tuple<unsigned long long, sfc::sfcc_header> lz77::compressInto(
+    const std::uint8_t* data, const unsigned long long length,
+    std::uint8_t* output, const unsigned long long capacity,
+    const sfc::sfcc_header& header)
 {
-  ::lz77::compress_t lz77comp;
-  auto compressed_data = lz77comp.feed(data.get(), data.get() + length);
-  int output_length = compressed_data.size();
-  // Move tmp data to unique_ptr
+  // The encoder writes straight into the output, which holds the worst case
+  requireCapacity(capacity, maxCompressedSize(length, header));
+  const unsigned long long output_length =
+      ::lz77::encode(data, length, output, _level);
   auto head = header;
   head.compressiontype = ::sfc::sfcc::compression_t::LZ77;
-  // Create appropriately sized unique_ptr
-  auto output_data = std::make_unique<std::uint8_t[]>(output_length);
+  return {output_length, head};
+}
 
-  // Copy the compressed data into an array to be returned using move semantics
-  std::copy(std::begin(compressed_data), std::end(compressed_data),
-            output_data.get());
-  // Move-return unique_ptr
-  return {std::move(output_data), output_length, head};
+unsigned long long lz77::maxDecompressedSize(
+    const std::uint8_t* data, const unsigned long long length,
+    const sfc::sfcc_header& header) const
+{
+  // The stream starts with its decoded size, which is exact for both whole
+  // files and bzip<> blocks
+  return ::lz77::decodedSizeBytes(data, length);
 }
 
-std::tuple<std::unique_ptr<std::uint8_t[]>, unsigned long long,
-           sfc::sfcc_header>
-lz77::decompress(const std::unique_ptr<std::uint8_t[]>& data,
-                 const unsigned long long& length,
-                 const sfc::sfcc_header& header)
-{
-  ::lz77::decompress_t lz77decomp;
-  std::string remaining;
-
-  lz77decomp.feed(data.get(), data.get() + length, remaining);
-  auto decompressed_data = lz77decomp.result();
-  int output_length = decompressed_data.size();
-  // auto expected_output_length =
-  //     (1ULL << (header.sidelength_k * header.ndims)) * header.dtype_nbytes;
-
-  // NOT COMPATIBLE WITH BZIP<> COMPRESSOR
-  // if (output_length != expected_output_length)
-  //   throw std::logic_error("Decompressed size was not as expected" +
-  //                          std::to_string(output_length) + " instead of " +
-  //                          std::to_string(expected_output_length));
-  // Move tmp data to unique_ptr
+std::tuple<unsigned long long, sfc::sfcc_header> lz77::decompressInto(
+    const std::uint8_t* data, const unsigned long long length,
+    std::uint8_t* output, const unsigned long long capacity,
+    const sfc::sfcc_header& header)
+{
+  const auto output_length = maxDecompressedSize(data, length, header);
+  requireCapacity(capacity, output_length);
+  ::lz77::decode(data, length, output, output_length);
+
   auto head = header;
   head.compressiontype = ::sfc::sfcc::compression_t::NONE;
-  // Create appropriately sized unique_ptr
-  auto output_data = std::make_unique<std::uint8_t[]>(output_length);
-
-  // Copy the compressed data into an array to be returned using move semantics
-  std::copy(std::begin(decompressed_data), std::end(decompressed_data),
-            output_data.get());
-  // Move-return unique_ptr
-  return {std::move(output_data), output_length, head};
+  return {output_length, head};
 }
 
 std::string lz77::getFileExtension() const { return "lz77"; }
@@ -154,78 +396,127 @@ sfc::sfcc::compression_t lz77::getCompressionType() const
   return sfc::sfcc::compression_t::LZ77;
 }
 
+// LZ78
+lz78::lz78() {}
+lz78::~lz78() {}
+unsigned long long lz78::maxCompressedSize(
+    const unsigned long long length, const sfc::sfcc_header& header) const
+{
+  return ::lz78::maxCompressedSize(length);
+}
+
+std::tuple<unsigned long long, sfc::sfcc_header> lz78::compressInto(
+    const std::uint8_t* data, const unsigned long long length,
+    std::uint8_t* output, const unsigned long long capacity,
+    const sfc::sfcc_header& header)
+{
+  requireCapacity(capacity, maxCompressedSize(length, header));
+  const auto [stream, output_length] = ::lz78::easyEncode(data, length);
+  copyStream(stream.get(), output_length, output, capacity);
+
+  auto head = header;
+  head.compressiontype = ::sfc::sfcc::compression_t::LZ78;
+  return {output_length, head};
+}
+
+unsigned long long lz78::maxDecompressedSize(
+    const std::uint8_t* data, const unsigned long long length,
+    const sfc::sfcc_header& header) const
+{
+  // The stream records its own length and dictionary width
+  return ::lz78::decodedSizeBytes(data, length);
+}
+
+std::tuple<unsigned long long, sfc::sfcc_header> lz78::decompressInto(
+    const std::uint8_t* data, const unsigned long long length,
+    std::uint8_t* output, const unsigned long long capacity,
+    const sfc::sfcc_header& header)
+{
+  const auto output_length = maxDecompressedSize(data, length, header);
+  requireCapacity(capacity, output_length);
+  ::lz78::easyDecode(data, length, output, output_length);
+
+  auto head = header;
+  head.compressiontype = ::sfc::sfcc::compression_t::NONE;
+  return {output_length, head};
+}
+
+std::string lz78::getFileExtension() const { return "lz78"; }
+sfc::sfcc::compression_t lz78::getCompressionType() const
+{
+  return sfc::sfcc::compression_t::LZ78;
+}
+
 // LZW
-lzw::lzw() {}
+lzw::lzw(int dictBits) : _dictBits{dictBits}
+{
+  if (dictBits < ::lzw::StartBits || dictBits > ::lzw::MaxDictBits)
+    throw std::invalid_argument("LZW dictionary width must be between " +
+                                std::to_string(::lzw::StartBits) + " and " +
+                                std::to_string(::lzw::MaxDictBits) + " bits");
+}
 lzw::~lzw() {}
-std::tuple<std::unique_ptr<std::uint8_t[]>, unsigned long long,
-           sfc::sfcc_header>
-lzw::compress(const std::unique_ptr<std::uint8_t[]>& data,
-              const unsigned long long& length, const sfc::sfcc_header& header)
+unsigned long long lzw::maxCompressedSize(const unsigned long long length,
+                                          const sfc::sfcc_header& header) const
 {
-  // Construct temporary data
+  return ::lzw::maxCompressedSize(length, _dictBits);
+}
+
+std::tuple<unsigned long long, sfc::sfcc_header> lzw::compressInto(
+    const std::uint8_t* data, const unsigned long long length,
+    std::uint8_t* output, const unsigned long long capacity,
+    const sfc::sfcc_header& header)
+{
+  requireCapacity(capacity, maxCompressedSize(length, header));
   std::uint8_t* tmp_data;
-  int output_length;
-  int output_length_bits;
-
-  // Compress using Huffman encoding
-  // void easyEncode(const std::uint8_t *uncompressed,
-  // const int uncompressedSizeBytes, std::uint8_t **compressed,
-  // int *compressedSizeBytes, int *compressedSizeBits)
-
-  ::lzw::easyEncode(data.get(), length, &tmp_data, &output_length,
-                    &output_length_bits);
-  // std::cout << "LZQ: output length=" << output_length
-  //           << ", output_length_bits=" << output_length_bits << std::endl;
-
-  // Create appropriately sized unique_ptr
-  auto output_data = std::make_unique<std::uint8_t[]>(output_length);
-  // std::cout << int(tmp_data[0]) << ", " << int(tmp_data[1]) << ", "
-  //           << int(tmp_data[2]) << ", " << int(tmp_data[3]) << ", "
-  //           << int(tmp_data[4]) << ", " << int(tmp_data[5]) << ", "
-  //           << std::endl;
-  // Move tmp data to unique_ptr
-  std::move(tmp_data, tmp_data + output_length, output_data.get());
-  delete[] tmp_data;
+  std::uint64_t output_length;
+  std::uint64_t output_length_bits;
+  ::lzw::easyEncode(data, length, &tmp_data, &output_length,
+                    &output_length_bits, _dictBits);
+  // The encoder owns its stream, so it is copied into the output once
+  std::unique_ptr<std::uint8_t[]> stream(tmp_data);
+  copyStream(stream.get(), output_length, output, capacity);
+
   auto head = header;
   head.compressiontype = ::sfc::sfcc::compression_t::LZW;
   head.npaddingbits = output_length_bits % 8;
-  return {std::move(output_data), output_length, head};
+  // Files with the original dictionary width stay readable by older builds
+  head.lzw_dict_nbits.reset();
+  if (_dictBits != ::lzw::DefaultDictBits) head.lzw_dict_nbits = _dictBits;
+  return {output_length, head};
 }
-std::tuple<std::unique_ptr<std::uint8_t[]>, unsigned long long,
-           sfc::sfcc_header>
-lzw::decompress(const std::unique_ptr<std::uint8_t[]>& data,
-                const unsigned long long& length,
-                const sfc::sfcc_header& header)
+
+unsigned long long lzw::maxDecompressedSize(
+    const std::uint8_t* data, const unsigned long long length,
+    const sfc::sfcc_header& header) const
 {
-  // Construct temporary data
-  unsigned long long output_length;
-  if (header.output_block_length) {
-    output_length = header.output_block_length.value();
-  } else {
-    output_length =
-        (1ULL << (header.sidelength_k * header.ndims)) * header.dtype_nbytes;
-  }
-  // std::uint8_t* tmp_data = new std::uint8_t[output_length];
-  auto tmp_data = std::make_unique<std::uint8_t[]>(output_length);
+  return headerDataLength(header);
+}
+
+std::tuple<unsigned long long, sfc::sfcc_header> lzw::decompressInto(
+    const std::uint8_t* data, const unsigned long long length,
+    std::uint8_t* output, const unsigned long long capacity,
+    const sfc::sfcc_header& header)
+{
+  // The decoder writes straight into the output
+  const auto output_length = maxDecompressedSize(data, length, header);
+  requireCapacity(capacity, output_length);
 
   auto length_bits = header.npaddingbits.value() == 0
                          ? length * 8
                          : ((length - 1) * 8) + header.npaddingbits.value();
 
-  ::lzw::easyDecode(data.get(), length, length_bits, tmp_data.get(),
-                    output_length);
+  const int dictBits =
+      header.lzw_dict_nbits.value_or(::lzw::DefaultDictBits);
+  if (dictBits < ::lzw::StartBits || dictBits > ::lzw::MaxDictBits)
+    throw std::runtime_error("Unsupported LZW dictionary width of " +
+                             std::to_string(dictBits) + " bits");
+  ::lzw::easyDecode(data, length, length_bits, output, output_length,
+                    dictBits);
 
-  // Create appropriately sized unique_ptr
-  auto output_data = std::make_unique<std::uint8_t[]>(output_length);
-
-  // Move tmp data to unique_ptr
-  std::move(tmp_data.get(), tmp_data.get() + output_length, output_data.get());
-  // delete[] tmp_data;
-  tmp_data.reset();
   auto head = header;
   head.compressiontype = ::sfc::sfcc::compression_t::NONE;
-  // Move-return unique_ptr
-  return {std::move(output_data), output_length, head};
+  return {output_length, head};
 }
 
 std::string lzw::getFileExtension() const { return "lzw"; }
@@ -237,100 +528,90 @@ sfc::sfcc::compression_t lzw::getCompressionType() const
 // RLE
 rle::rle() {}
 rle::~rle() {}
-std::tuple<std::unique_ptr<std::uint8_t[]>, unsigned long long,
-           sfc::sfcc_header>
-rle::compress(const std::unique_ptr<std::uint8_t[]>& data,
-              const unsigned long long& length, const sfc::sfcc_header& header)
-{
-  // Construct temporary data
-  const auto MaxOutputSize = (length << 2);
-  // std::uint8_t* tmp_data = new std::uint8_t[MaxOutputSize];
-  auto tmp_data = std::make_unique<std::uint8_t[]>(MaxOutputSize);
-
-  // Compress using Huffman encoding
-  // void easyEncode(const std::uint8_t *uncompressed,
-  // const int uncompressedSizeBytes, std::uint8_t **compressed,
-  // int *compressedSizeBytes, int *compressedSizeBits)
-
-  int output_length = -1;
-  if (header.dtype_nbytes == 2) {
-    auto ptr = reinterpret_cast<std::uint16_t*>(data.get());
+unsigned long long rle::maxCompressedSize(const unsigned long long length,
+                                          const sfc::sfcc_header& header) const
+{
+  // Every element may take a count byte of its own
+  return length + length / std::max<int>(header.dtype_nbytes, 1);
+}
+
+std::tuple<unsigned long long, sfc::sfcc_header> rle::compressInto(
+    const std::uint8_t* data, const unsigned long long length,
+    std::uint8_t* output, const unsigned long long capacity,
+    const sfc::sfcc_header& header)
+{
+  const auto MaxOutputSize = maxCompressedSize(length, header);
+  requireCapacity(capacity, MaxOutputSize);
+
+  unsigned long long output_length = 0;
+  if (header.dtype_nbytes == 1) {
+    output_length =
+        ::rle::easyEncode<std::uint8_t>(data, length, output, MaxOutputSize);
+  } else if (header.dtype_nbytes == 2) {
+    auto ptr = reinterpret_cast<const std::uint16_t*>(data);
     output_length = ::rle::easyEncode<std::uint16_t>(
-        ptr, length / sizeof(std::uint16_t), tmp_data.get(), MaxOutputSize);
+        ptr, length / sizeof(std::uint16_t), output, MaxOutputSize);
   } else if (header.dtype_nbytes == 4) {
-    auto ptr = reinterpret_cast<std::uint32_t*>(data.get());
+    auto ptr = reinterpret_cast<const std::uint32_t*>(data);
     output_length = ::rle::easyEncode<std::uint32_t>(
-        ptr, length / sizeof(std::uint32_t), tmp_data.get(), MaxOutputSize);
+        ptr, length / sizeof(std::uint32_t), output, MaxOutputSize);
   } else {
     throw std::logic_error("Unexpected data-type size of " +
                            std::to_string(header.dtype_nbytes) + " bytes");
   }
-  if (output_length == -1)
+  if (output_length == 0)
     throw std::runtime_error("Could not complete RLE process");
 
-  // Create appropriately sized unique_ptr
-  auto output_data = std::make_unique<std::uint8_t[]>(output_length);
-
-  std::move(tmp_data.get(), tmp_data.get() + output_length, output_data.get());
-  // delete[] tmp_data;
-  tmp_data.reset();
   auto head = header;
   head.compressiontype = ::sfc::sfcc::compression_t::RLE;
 
   if (::sfc::DEBUG)
     std::cout << "RLE: output_length=" << output_length << std::endl;
-  // Move-return unique_ptr
-  return {std::move(output_data), output_length, head};
+  return {output_length, head};
 }
 
-std::tuple<std::unique_ptr<std::uint8_t[]>, unsigned long long,
-           sfc::sfcc_header>
-rle::decompress(const std::unique_ptr<std::uint8_t[]>& data,
-                const unsigned long long& length,
-                const sfc::sfcc_header& header)
+unsigned long long rle::maxDecompressedSize(
+    const std::uint8_t* data, const unsigned long long length,
+    const sfc::sfcc_header& header) const
+{
+  return headerDataLength(header);
+}
+
+std::tuple<unsigned long long, sfc::sfcc_header> rle::decompressInto(
+    const std::uint8_t* data, const unsigned long long length,
+    std::uint8_t* output, const unsigned long long capacity,
+    const sfc::sfcc_header& header)
 {
-  // Construct temporary data
-  const auto OutputSize =
-      (1ULL << (header.sidelength_k * header.ndims)) * header.dtype_nbytes;
+  const auto OutputSize = maxDecompressedSize(data, length, header);
+  requireCapacity(capacity, OutputSize);
   if (::sfc::DEBUG) std::cout << "RLE: Received size=" << length << std::endl;
-  // std::uint8_t* tmp_data = new std::uint8_t[OutputSize];
-  auto tmp_data = std::make_unique<std::uint8_t[]>(OutputSize);
-
-  // Compress using Huffman encoding
-  // void easyEncode(const std::uint8_t *uncompressed,
-  // const int uncompressedSizeBytes, std::uint8_t **compressed,
-  // int *compressedSizeBytes, int *compressedSizeBits)
-  int output_length = -1;
+
+  unsigned long long output_length = 0;
   if (::sfc::DEBUG)
     std::cout << "RLE: expected OutputSize=" << OutputSize << std::endl;
-  if (header.dtype_nbytes == 2) {
+  if (header.dtype_nbytes == 1) {
+    output_length =
+        ::rle::easyDecode<std::uint8_t>(data, length, output, OutputSize);
+  } else if (header.dtype_nbytes == 2) {
     output_length = ::rle::easyDecode<std::uint16_t>(
-        data.get(), length, (std::uint16_t*)tmp_data.get(), OutputSize);
+        data, length, (std::uint16_t*)output, OutputSize);
   } else if (header.dtype_nbytes == 4) {
     output_length = ::rle::easyDecode<std::uint32_t>(
-        data.get(), length, (std::uint32_t*)tmp_data.get(), OutputSize);
+        data, length, (std::uint32_t*)output, OutputSize);
   } else {
     throw std::logic_error("Unexpected data-type size of " +
                            std::to_string(header.dtype_nbytes) + " bytes");
   }
 
-  if (output_length == -1)
+  if (output_length == 0)
     throw std::runtime_error("Could not complete RLE process");
 
   if (::sfc::DEBUG)
     std::cout << "RLE: Actual output size=" << output_length << std::endl;
 
-  // Create appropriately sized unique_ptr
-  auto output_data = std::make_unique<std::uint8_t[]>(output_length);
-
-  std::move((std::uint8_t*)tmp_data.get(),
-            (std::uint8_t*)tmp_data.get() + (output_length), output_data.get());
-  // delete[] tmp_data;
-  tmp_data.reset();
   auto head = header;
   head.compressiontype = ::sfc::sfcc::compression_t::NONE;
-  // Move-return unique_ptr
-  return {std::move(output_data), output_length, head};
+  return {output_length, head};
 }
 std::string rle::getFileExtension() const { return "rle"; }
 sfc::sfcc::compression_t rle::getCompressionType() const
@@ -338,127 +619,253 @@ sfc::sfcc::compression_t rle::getCompressionType() const
   return sfc::sfcc::compression_t::RLE;
 }
 
-// // DEFLATE
-// deflate::deflate() {}
-// deflate::~deflate() {}
-// std::tuple<std::unique_ptr<std::uint8_t[]>, unsigned long long,
-//            sfc::sfcc_header>
-// deflate::compress(const std::unique_ptr<std::uint8_t[]>& data,
-//                   const unsigned long long& length,
-//                   const sfc::sfcc_header& header)
-// {
-//   auto lz77comp = std::make_unique<lz77>();
-//   auto huffcomp = std::make_unique<huffman>();
-//   auto [temp_data, temp_length, temp_head] =
-//       lz77comp->compress(data, length, header);
-//   // std::cout << "LZ77 length=" << temp_length << std::endl;
-//   auto [output_data, output_length, head] =
-//       huffcomp->compress(temp_data, temp_length, temp_head);
-//   // std::cout << "Huffman length=" << output_length << std::endl;
-//   // std::cout << "\tnpaddingbits=" << int(head.npaddingbits.value()) <<
-//   // std::endl;
-//   head.compressiontype = sfc::sfcc::compression_t::DEFLATE;
-//   return {std::move(output_data), output_length, head};
-// }
-// std::tuple<std::unique_ptr<std::uint8_t[]>, unsigned long long,
-//            sfc::sfcc_header>
-// deflate::decompress(const std::unique_ptr<std::uint8_t[]>& data,
-//                     const unsigned long long& length,
-//                     const sfc::sfcc_header& header)
-// {
-//   std::cout << "npaddingbits=" << int(header.npaddingbits.value()) <<
-//   std::endl; auto lz77comp = std::make_unique<lz77>(); auto huffcomp =
-//   std::make_unique<huffman>(); std::cout << "Compressed length=" << length <<
-//   std::endl; auto [temp_data, temp_length, temp_head] =
-//       huffcomp->decompress(data, length, header);
-//   auto [output_data, output_length, head] =
-//       lz77comp->decompress(temp_data, temp_length, temp_head);
-//   head.compressiontype = sfc::sfcc::compression_t::NONE;
-//   return {std::move(output_data), output_length, head};
-// }
-// std::string deflate::getFileExtension() const { return "dflt"; }
-// sfc::sfcc::compression_t deflate::getCompressionType() const
-// {
-//   return sfc::sfcc::compression_t::DEFLATE;
-// }
+// RLE_VARINT
+rle_varint::rle_varint() {}
+rle_varint::~rle_varint() {}
+unsigned long long rle_varint::maxCompressedSize(
+    const unsigned long long length, const sfc::sfcc_header& header) const
+{
+  return ::rle::varintMaxEncodedSize(length / header.dtype_nbytes,
+                                     header.dtype_nbytes) +
+         length % header.dtype_nbytes;
+}
+
+std::tuple<unsigned long long, sfc::sfcc_header> rle_varint::compressInto(
+    const std::uint8_t* data, const unsigned long long length,
+    std::uint8_t* output, const unsigned long long capacity,
+    const sfc::sfcc_header& header)
+{
+  requireCapacity(capacity, maxCompressedSize(length, header));
+  const auto nelements = length / header.dtype_nbytes;
+  unsigned long long output_length = 0;
+  switch (header.dtype_nbytes) {
+    case 1:
+      output_length = ::rle::varintEncode(data, nelements, output);
+      break;
+    case 2:
+      output_length = ::rle::varintEncode(
+          reinterpret_cast<const std::uint16_t*>(data), nelements, output);
+      break;
+    case 4:
+      output_length = ::rle::varintEncode(
+          reinterpret_cast<const std::uint32_t*>(data), nelements, output);
+      break;
+    case 8:
+      output_length = ::rle::varintEncode(
+          reinterpret_cast<const std::uint64_t*>(data), nelements, output);
+      break;
+    default:
+      throw std::logic_error("Unexpected data-type size of " +
+                             std::to_string(header.dtype_nbytes) + " bytes");
+  }
+  // Bytes after the last whole element follow the tokens as they are
+  const auto tail = length % header.dtype_nbytes;
+  std::copy(data + length - tail, data + length, output + output_length);
+  output_length += tail;
+
+  auto head = header;
+  head.compressiontype = ::sfc::sfcc::compression_t::RLE_VARINT;
+  return {output_length, head};
+}
+
+unsigned long long rle_varint::maxDecompressedSize(
+    const std::uint8_t* data, const unsigned long long length,
+    const sfc::sfcc_header& header) const
+{
+  return headerDataLength(header);
+}
+
+std::tuple<unsigned long long, sfc::sfcc_header> rle_varint::decompressInto(
+    const std::uint8_t* data, const unsigned long long length,
+    std::uint8_t* output, const unsigned long long capacity,
+    const sfc::sfcc_header& header)
+{
+  const auto output_length = maxDecompressedSize(data, length, header);
+  requireCapacity(capacity, output_length);
+  const auto nelements = output_length / header.dtype_nbytes;
+  const auto tail = output_length % header.dtype_nbytes;
+  if (tail > length) throw std::runtime_error("RLE stream is truncated");
+  const auto tokens_length = length - tail;
+  unsigned long long decoded = 0;
+  switch (header.dtype_nbytes) {
+    case 1:
+      decoded = ::rle::varintDecode(data, tokens_length, output, nelements);
+      break;
+    case 2:
+      decoded = ::rle::varintDecode(data, tokens_length,
+                                    reinterpret_cast<std::uint16_t*>(output),
+                                    nelements);
+      break;
+    case 4:
+      decoded = ::rle::varintDecode(data, tokens_length,
+                                    reinterpret_cast<std::uint32_t*>(output),
+                                    nelements);
+      break;
+    case 8:
+      decoded = ::rle::varintDecode(data, tokens_length,
+                                    reinterpret_cast<std::uint64_t*>(output),
+                                    nelements);
+      break;
+    default:
+      throw std::logic_error("Unexpected data-type size of " +
+                             std::to_string(header.dtype_nbytes) + " bytes");
+  }
+  if (decoded != nelements)
+    throw std::runtime_error("RLE stream holds " + std::to_string(decoded) +
+                             " elements, expected " +
+                             std::to_string(nelements));
+  std::copy(data + tokens_length, data + length,
+            output + nelements * header.dtype_nbytes);
+
+  auto head = header;
+  head.compressiontype = ::sfc::sfcc::compression_t::NONE;
+  return {output_length, head};
+}
+std::string rle_varint::getFileExtension() const { return "rlev"; }
+sfc::sfcc::compression_t rle_varint::getCompressionType() const
+{
+  return sfc::sfcc::compression_t::RLE_VARINT;
+}
+
+// DEFLATE
+deflate::deflate(int level) : _level{level}
+{
+  if (level < ::deflate::MinLevel || level > ::deflate::MaxLevel)
+    throw std::invalid_argument("DEFLATE level must be between " +
+                                std::to_string(::deflate::MinLevel) + " and " +
+                                std::to_string(::deflate::MaxLevel));
+}
+deflate::~deflate() {}
+unsigned long long deflate::maxCompressedSize(
+    const unsigned long long length, const sfc::sfcc_header& header) const
+{
+  return ::deflate::maxCompressedSize(length);
+}
+
+std::tuple<unsigned long long, sfc::sfcc_header> deflate::compressInto(
+    const std::uint8_t* data, const unsigned long long length,
+    std::uint8_t* output, const unsigned long long capacity,
+    const sfc::sfcc_header& header)
+{
+  requireCapacity(capacity, maxCompressedSize(length, header));
+  const auto [stream, output_length] =
+      ::deflate::easyEncode(data, length, _level);
+  copyStream(stream.get(), output_length, output, capacity);
+
+  auto head = header;
+  head.compressiontype = sfc::sfcc::compression_t::DEFLATE;
+  // The stream ends with an end-of-block code, so trailing bits of the last
+  // byte need not be counted
+  head.npaddingbits = 0;
+  return {output_length, head};
+}
+
+unsigned long long deflate::maxDecompressedSize(
+    const std::uint8_t* data, const unsigned long long length,
+    const sfc::sfcc_header& header) const
+{
+  // Raw DEFLATE does not record its size, so it comes from the header
+  return headerDataLength(header);
+}
+
+std::tuple<unsigned long long, sfc::sfcc_header> deflate::decompressInto(
+    const std::uint8_t* data, const unsigned long long length,
+    std::uint8_t* output, const unsigned long long capacity,
+    const sfc::sfcc_header& header)
+{
+  const auto output_length = maxDecompressedSize(data, length, header);
+  requireCapacity(capacity, output_length);
+  const auto decoded_length =
+      ::deflate::easyDecode(data, length, output, output_length);
+  if (decoded_length != output_length)
+    throw std::runtime_error("DEFLATE stream holds " +
+                             std::to_string(decoded_length) +
+                             " bytes, expected " +
+                             std::to_string(output_length));
+
+  auto head = header;
+  head.compressiontype = sfc::sfcc::compression_t::NONE;
+  return {output_length, head};
+}
+std::string deflate::getFileExtension() const { return "dflt"; }
+sfc::sfcc::compression_t deflate::getCompressionType() const
+{
+  return sfc::sfcc::compression_t::DEFLATE;
+}
 
 // BZIP
 template <class postcompressor>
-bzip<postcompressor>::bzip(bool forceByteCompression)
-    : _forceByteCompression{forceByteCompression}
+bzip<postcompressor>::bzip(bool forceByteCompression,
+                           std::unique_ptr<postcompressor> postcomp)
+    : _forceByteCompression{forceByteCompression},
+      _postcompressor{postcomp ? std::move(postcomp)
+                               : std::make_unique<postcompressor>()}
 {}
 template <class postcompressor>
 bzip<postcompressor>::~bzip()
 {}
 
 template <class postcompressor>
-std::tuple<std::unique_ptr<std::uint8_t[]>, unsigned long long,
-           sfc::sfcc_header>
-bzip<postcompressor>::compress(const std::unique_ptr<std::uint8_t[]>& data,
-                               const unsigned long long& length,
-                               const sfc::sfcc_header& header)
+unsigned long long bzip<postcompressor>::maxCompressedSize(
+    const unsigned long long length, const sfc::sfcc_header& header) const
 {
+  const auto nblocks = length / MAX_BLOCK_SIZE_BYTES;
+  return nblocks *
+         (MAX_BLOCK_HEADER_BYTES +
+          _postcompressor->maxCompressedSize(MAX_BLOCK_SIZE_BYTES, header));
+}
+
+template <class postcompressor>
+std::tuple<unsigned long long, sfc::sfcc_header>
+bzip<postcompressor>::compressInto(const std::uint8_t* data,
+                                   const unsigned long long length,
+                                   std::uint8_t* output,
+                                   const unsigned long long capacity,
+                                   const sfc::sfcc_header& header)
+{
+  requireCapacity(capacity, maxCompressedSize(length, header));
   // Block Size in Bytes
   const auto blockSize = MAX_BLOCK_SIZE_BYTES;
   // Number of blocks
   const auto nblocks = length / blockSize;
+  // Padding bits of each block, if the postcompressor has them
+  const auto usesNPaddingBits =
+      sfc::sfcc_header::CompressionRequiresPaddingBits(
+          _postcompressor->getCompressionType());
 
-  // Generate block data containers
-  auto inputBlocks = std::make_unique<Block[]>(nblocks);
-  auto outputBlocks = std::make_unique<Block[]>(nblocks);
-
-  for (auto i = 0; i < nblocks; i++) {
-    inputBlocks[i].data = data.get() + (MAX_BLOCK_SIZE_BYTES * i);
-    inputBlocks[i].length = MAX_BLOCK_SIZE_BYTES;
+  if (!_scratch.bwt) {
+    _scratch.bwt = std::make_unique<std::uint8_t[]>(MAX_BLOCK_SIZE_BYTES);
+    _scratch.mtf = std::make_unique<std::uint8_t[]>(MAX_BLOCK_SIZE_BYTES);
   }
 
-  // Compress each block
+  // Compress each block, the postcompressor writing straight into the output
+  // after the space for the block header
+  auto output_ptr = output;
+  const auto output_end = output + capacity;
   for (auto iBlock = 0; iBlock < nblocks; iBlock++) {
     if (::sfc::DEBUG)
       std::cout << std::endl
                 << "Compressing block " << iBlock << "/" << nblocks
                 << std::endl;
-    // Get block pointers etc
-    auto inBlock = inputBlocks.get()[iBlock];
-    auto& outBlock = outputBlocks[iBlock];
-
-    // BWT the block
-    // BWT block length is the original + the primary index. Primary index is of
-    // type std::int32_t.
-    auto bwt_length = inBlock.data_length();
-    // Create BWT temporary values
-    auto bwt = std::make_unique<std::uint8_t[]>(bwt_length);
-    std::int32_t primary_index =
-        divbwt((const sauchar_t*)inBlock.data, (sauchar_t*)bwt.get(), nullptr,
-               inBlock.data_length());
-
-    // Handle BWT errors
-    if (primary_index < 0) {
-      throw std::runtime_error("BWT failed on block " + std::to_string(iBlock) +
-                               " with error code " +
-                               std::to_string(primary_index));
-    }
+    Block outBlock;
+    const auto inBlock_data = data + (MAX_BLOCK_SIZE_BYTES * iBlock);
 
-    // BWT was successful, store primary index
-    outBlock.bwt_primary_index = primary_index;
+    // BWT the block, recording where each stream of the decoder starts
+    const auto bwt_length = MAX_BLOCK_SIZE_BYTES;
+    const auto nstreams = ::sfcc::bwt::blockStreams(bwt_length);
+    outBlock.bwt_nstream_rows = nstreams - 1;
+    outBlock.bwt_primary_index = ::sfcc::bwt::byteBWT(
+        inBlock_data, bwt_length, _scratch.bwt.get(), outBlock.bwt_stream_rows,
+        nstreams, _scratch.suffixes);
 
     // MTF blocksize is the original size. The min and max values are managed by
     // outBlock
-    unsigned long long mtf_length = inBlock.data_length();
+    unsigned long long mtf_length = bwt_length;
 
     // MTF on a byte level
-    std::uint8_t min;
-    std::uint8_t max;
-    auto mtf = std::make_unique<std::uint8_t[]>(mtf_length);
-    auto [mtf_temp, min_temp, max_temp] =
-        ::sfcc::easyMTFAnyuType<std::uint8_t, std::uint8_t>(
-            (std::uint8_t*)bwt.get(), mtf_length);
-    std::move((std::uint8_t*)mtf_temp.get(),
-              (std::uint8_t*)(mtf_temp.get() + mtf_length), mtf.get());
-    min = *(std::uint8_t*)&min_temp;
-    max = *(std::uint8_t*)&max_temp;
-
-    bwt.reset();
+    auto& mtf = _scratch.mtf;
+    const auto [min, max] = ::sfcc::mtf::encode<std::uint8_t, std::uint8_t>(
+        _scratch.bwt.get(), mtf_length, mtf.get(), _scratch.alphabet);
 
     // assign to outBlock the MTF values
     outBlock.min_value = min;
@@ -477,94 +884,70 @@ bzip<postcompressor>::compress(const std::unique_ptr<std::uint8_t[]>& data,
     }
 
     // Postcompressor
-    auto postcomp = std::make_unique<postcompressor>();
+    outBlock.encoded = true;
+    if (usesNPaddingBits) outBlock.npaddingbits = 0;
+    const auto payload = output_ptr + outBlock.header_size();
     if (::sfc::DEBUG)
       std::cout << "Compressing MTF data of length " << mtf_length << std::endl;
-    auto [outBlock_data, outBlock_length, outblock_head] =
-        postcomp->compress(mtf, mtf_length, header);
+    auto [outBlock_length, outblock_head] = _postcompressor->compressInto(
+        mtf.get(), mtf_length, payload, output_end - payload, header);
     if (::sfc::DEBUG)
       std::cout << "Postcompression is complete: output length="
                 << outBlock_length << std::endl;
-    // MTF is complete, free up memory
-    mtf.reset();
 
     if (::sfc::DEBUG) {
       std::cout << "Boundaries of Compressed Data:" << std::endl;
       for (auto i = 0; i < 5; i++) {
-        std::cout << std::hex << (int)outBlock_data[i] << " ";
+        std::cout << std::hex << (int)payload[i] << " ";
       }
       std::cout << std::endl << "..." << std::endl;
       for (auto i = outBlock_length - 5; i < outBlock_length; i++) {
-        std::cout << std::hex << (int)outBlock_data[i] << " ";
+        std::cout << std::hex << (int)payload[i] << " ";
       }
       std::cout << std::endl << std::dec;
     }
 
     // Assign to outblock the postcompressor values
-    if (::sfc::sfcc_header::CompressionRequiresPaddingBits(
-            outblock_head.compressiontype))
-      outBlock.npaddingbits = outblock_head.npaddingbits;
+    if (usesNPaddingBits)
+      outBlock.npaddingbits = outblock_head.getPaddingBitsByte();
     outBlock.length = outBlock_length;
-    outBlock.data = outBlock_data.release();
-    outBlock.encoded = true;
-  }
-
-  // Consolidate outputblocks
-  auto blocksize_sum = 0ULL;
-  // Get total size: sum of block headers and block data lengths
-  std::for_each(
-      outputBlocks.get(), outputBlocks.get() + nblocks,
-      [&blocksize_sum](auto& block) { blocksize_sum += block.size(); });
-
-  // Move data across
-  if (::sfc::DEBUG)
-    std::cout << "Allocating output memory: output summed size="
-              << blocksize_sum << std::endl;
-  auto output_data = std::make_unique<std::uint8_t[]>(blocksize_sum);
-  auto output_data_ptr = output_data.get();
-  for (auto iBlock = 0; iBlock < nblocks; iBlock++) {
-    auto& block = outputBlocks[iBlock];
-    auto block_size = block.size();
-    auto block_data = block.toArray();
-    std::move(block_data.get(), block_data.get() + block_size, output_data_ptr);
-    output_data_ptr += block_size;
+    outBlock.writeHeaderTo(output_ptr);
+    output_ptr = payload + outBlock_length;
     if (::sfc::DEBUG)
-      std::cout << "Block [" << iBlock << "]: " << block_size << std::endl;
+      std::cout << "Block [" << iBlock << "]: " << outBlock.size() << std::endl;
   }
+  const auto blocksize_sum = (unsigned long long)(output_ptr - output);
 
   // Update file header
   auto output_header = header;
   output_header.compressiontype = getCompressionType();
   output_header.npaddingbits = 0;
-  // std::cout << output_header.size() << std::endl;
-  return {std::move(output_data), blocksize_sum, output_header};
+  return {blocksize_sum, output_header};
 }
 
 template <class postcompressor>
-std::tuple<std::unique_ptr<std::uint8_t[]>, unsigned long long,
-           sfc::sfcc_header>
-bzip<postcompressor>::decompress(const std::unique_ptr<std::uint8_t[]>& data,
-                                 const unsigned long long& length,
-                                 const sfc::sfcc_header& header)
+std::uint32_t bzip<postcompressor>::countBlocks(
+    const std::uint8_t* data, const unsigned long long length,
+    const sfc::sfcc_header& header) const
 {
   // Does compression use npaddingbits?
   const auto usesNPaddingBits =
       sfc::sfcc_header::CompressionRequiresPaddingBits(header.compressiontype);
-  if (::sfc::DEBUG) {
-    if (usesNPaddingBits) std::cout << "Using padding bits" << std::endl;
-  }
-
-  auto nblocks = 0;
-  // Calculate the number of blocks needed
-  for (auto it = data.get(); it < data.get() + length;) {
+  std::uint32_t nblocks = 0;
+  for (auto it = data; it < data + length;) {
     // Current blocksize
     try {
-      auto blocksize = *((std::uint32_t*)it);
+      std::uint32_t blocksize;
+      std::memcpy(&blocksize, it, sizeof(blocksize));
       it += sizeof(std::uint32_t);
       if (usesNPaddingBits) it += sizeof(std::int8_t);
-      it += sizeof(std::int8_t);    // Min Value
-      it += sizeof(std::int8_t);    // Max Value
-      it += sizeof(std::uint32_t);  // BWT Primary Index
+      it += sizeof(std::int8_t);  // Min Value
+      it += sizeof(std::int8_t);  // Max Value
+      // BWT Primary Index and stream rows
+      std::uint32_t primary_index;
+      std::memcpy(&primary_index, it, sizeof(primary_index));
+      const auto nstreamRows = primary_index >> BWT_NSTREAMS_SHIFT;
+      it += sizeof(std::uint32_t) * (1 + nstreamRows);
       it += blocksize;
       nblocks++;
     } catch (std::exception& e) {
@@ -573,42 +956,91 @@ bzip<postcompressor>::decompress(const std::unique_ptr<std::uint8_t[]>& data,
                                " exceeds data size");
     }
   }
+  return nblocks;
+}
+
+template <class postcompressor>
+unsigned long long bzip<postcompressor>::maxDecompressedSize(
+    const std::uint8_t* data, const unsigned long long length,
+    const sfc::sfcc_header& header) const
+{
+  // Each block decodes to at most the block size
+  return (unsigned long long)countBlocks(data, length, header) *
+         MAX_BLOCK_SIZE_BYTES;
+}
+
+template <class postcompressor>
+std::tuple<unsigned long long, sfc::sfcc_header>
+bzip<postcompressor>::decompressInto(const std::uint8_t* data,
+                                     const unsigned long long length,
+                                     std::uint8_t* output,
+                                     const unsigned long long capacity,
+                                     const sfc::sfcc_header& header)
+{
+  // Does compression use npaddingbits?
+  const auto usesNPaddingBits =
+      sfc::sfcc_header::CompressionRequiresPaddingBits(header.compressiontype);
+  if (::sfc::DEBUG) {
+    if (usesNPaddingBits) std::cout << "Using padding bits" << std::endl;
+  }
+
+  // Calculate the number of blocks needed
+  const auto nblocks = countBlocks(data, length, header);
+  requireCapacity(capacity,
+                  (unsigned long long)nblocks * MAX_BLOCK_SIZE_BYTES);
 
   // Populate input blocks
   auto inputBlocks = std::make_unique<Block[]>(nblocks);
-  auto outputBlocks = std::make_unique<Block[]>(nblocks);
-  auto data_ptr = data.get();
-  for (auto iBlock = 0; iBlock < nblocks; iBlock++) {
-    inputBlocks[iBlock].length = *((std::uint32_t*)data_ptr);
+  auto data_ptr = data;
+  for (auto iBlock = 0U; iBlock < nblocks; iBlock++) {
+    auto& block = inputBlocks[iBlock];
+    // The words follow single bytes, so they are copied rather than read
+    // through std::uint32_t pointers
+    std::memcpy(&block.length, data_ptr, sizeof(std::uint32_t));
     data_ptr += sizeof(std::uint32_t);
 
     if (usesNPaddingBits) {
-      inputBlocks[iBlock].npaddingbits = *((std::uint8_t*)data_ptr);
+      block.npaddingbits = *((std::uint8_t*)data_ptr);
       data_ptr += sizeof(std::uint8_t);
     }
 
-    inputBlocks[iBlock].min_value = *((std::uint8_t*)data_ptr);
+    block.min_value = *((std::uint8_t*)data_ptr);
     data_ptr += sizeof(std::uint8_t);
 
-    inputBlocks[iBlock].max_value = *((std::uint8_t*)data_ptr);
+    block.max_value = *((std::uint8_t*)data_ptr);
     data_ptr += sizeof(std::uint8_t);
 
-    inputBlocks[iBlock].bwt_primary_index = *((std::uint32_t*)data_ptr);
+    std::uint32_t primary_index;
+    std::memcpy(&primary_index, data_ptr, sizeof(primary_index));
     data_ptr += sizeof(std::uint32_t);
-
-    inputBlocks[iBlock].data = data_ptr;
-    data_ptr += inputBlocks[iBlock].length;
+    block.bwt_primary_index = primary_index & BWT_PRIMARY_INDEX_MASK;
+    block.bwt_nstream_rows = primary_index >> BWT_NSTREAMS_SHIFT;
+    if (block.bwt_nstream_rows >= ::sfcc::bwt::BlockStreams)
+      throw std::runtime_error("Block " + std::to_string(iBlock) +
+                               " has too many BWT streams");
+    std::memcpy(block.bwt_stream_rows, data_ptr,
+                block.bwt_nstream_rows * sizeof(std::uint32_t));
+    data_ptr += block.bwt_nstream_rows * sizeof(std::uint32_t);
+
+    block.data = data_ptr;
+    data_ptr += block.length;
 
     if (::sfc::DEBUG)
-      std::cout << "Read block of size " << inputBlocks[iBlock].length
-                << std::endl;
+      std::cout << "Read block of size " << block.length << std::endl;
+  }
+
+  // Blocks are decoded straight into the output, each to at most the block
+  // size
+  auto output_data_ptr = output;
+  if (!_scratch.bwt) {
+    _scratch.bwt = std::make_unique<std::uint8_t[]>(MAX_BLOCK_SIZE_BYTES);
+    _scratch.mtf = std::make_unique<std::uint8_t[]>(MAX_BLOCK_SIZE_BYTES);
   }
 
   // Decompress each block
-  for (auto iBlock = 0; iBlock < nblocks; iBlock++) {
+  for (auto iBlock = 0U; iBlock < nblocks; iBlock++) {
     // Get block pointers etc
-    auto inBlock = inputBlocks.get()[iBlock];
-    auto& outBlock = outputBlocks[iBlock];
+    auto& inBlock = inputBlocks[iBlock];
 
     if (::sfc::DEBUG)
       std::cout << std::endl
@@ -627,28 +1059,28 @@ bzip<postcompressor>::decompress(const std::unique_ptr<std::uint8_t[]>& data,
       std::cout << std::endl << std::dec;
     }
 
-    // Postcompressor
-    auto postcomp = std::make_unique<postcompressor>();
-    auto compressed_data = std::make_unique<std::uint8_t[]>(inBlock.length);
-    std::copy(inBlock.data, inBlock.data + inBlock.length,
-              compressed_data.get());
-
+    // Postcompressor, reading the block where it lies in the input
     if (::sfc::DEBUG)
       std::cout << "Decompressing compressed data of length " << inBlock.length
                 << std::endl;
     auto decompress_header = header;
 
     if (usesNPaddingBits)
-      decompress_header.npaddingbits = inBlock.npaddingbits.value();
+      decompress_header.setPaddingBitsByte(inBlock.npaddingbits.value());
     // Required for LZW
     decompress_header.output_block_length = MAX_BLOCK_SIZE_BYTES;
-    auto [mtf_data, mtf_length, mtf_head] = postcomp->decompress(
-        compressed_data, inBlock.length, decompress_header);
+    if (_postcompressor->maxDecompressedSize(inBlock.data, inBlock.length,
+                                             decompress_header) >
+        MAX_BLOCK_SIZE_BYTES)
+      throw std::runtime_error("Block " + std::to_string(iBlock) +
+                               " is longer than the block size");
+    const auto mtf_data = _scratch.mtf.get();
+    auto [mtf_length, mtf_head] = _postcompressor->decompressInto(
+        inBlock.data, inBlock.length, mtf_data, MAX_BLOCK_SIZE_BYTES,
+        decompress_header);
     if (::sfc::DEBUG)
       std::cout << "Postcompression is complete: output length=" << mtf_length
                 << std::endl;
-    // Decompression is complete, free up memory
-    compressed_data.reset();
 
     if (::sfc::DEBUG) {
       std::cout << "Boundaries of MTF Data:" << std::endl;
@@ -663,59 +1095,29 @@ bzip<postcompressor>::decompress(const std::unique_ptr<std::uint8_t[]>& data,
     }
 
     // Decode MTF data
-    auto bwt_data = easyMTFDecodeAnyuType<std::uint8_t, std::uint8_t>(
-        mtf_data.get(), mtf_length, inBlock.min_value.value(),
-        inBlock.max_value.value());
-    mtf_data.reset();
+    ::sfcc::mtf::decode<std::uint8_t, std::uint8_t>(
+        mtf_data, mtf_length, inBlock.min_value.value(),
+        inBlock.max_value.value(), _scratch.bwt.get(), _scratch.alphabet);
 
     // Decode BWT data
     if (::sfc::DEBUG)
       std::cout << "Decoding BWT data of length " << std::to_string(mtf_length)
                 << std::endl;
-    auto bwt_length = mtf_length;
-    // Create BWT temporary values
-    auto bwt = std::make_unique<std::uint8_t[]>(bwt_length);
-    inverse_bw_transform((const sauchar_t*)bwt_data.get(), bwt.get(), nullptr,
-                         bwt_length, inBlock.bwt_primary_index.value());
+    auto bwt_length = std::uint32_t(mtf_length);
+    ::sfcc::bwt::inverseByteBWT(
+        _scratch.bwt.get(), bwt_length, inBlock.bwt_primary_index.value(),
+        inBlock.bwt_stream_rows, inBlock.bwt_nstream_rows + 1, output_data_ptr,
+        _scratch.lf_rows);
+    output_data_ptr += bwt_length;
     if (::sfc::DEBUG) std::cout << "Decoded BWT data" << std::endl;
-
-    outBlock.length = bwt_length;
-    outBlock.data = bwt.release();
-    outBlock.npaddingbits.reset();
-    outBlock.min_value.reset();
-    outBlock.max_value.reset();
-    outBlock.bwt_primary_index.reset();
-    outBlock.encoded = false;
-  }
-
-  // Consolidate outputblocks
-  auto blocksize_sum = 0ULL;
-  // Get total size: sum of block headers and block data lengths
-  std::for_each(
-      outputBlocks.get(), outputBlocks.get() + nblocks,
-      [&blocksize_sum](auto& block) { blocksize_sum += block.size(); });
-
-  // Move data across
-  if (::sfc::DEBUG)
-    std::cout << "Allocating output memory: output summed size="
-              << blocksize_sum << std::endl;
-  auto output_data = std::make_unique<std::uint8_t[]>(blocksize_sum);
-  auto output_data_ptr = output_data.get();
-  for (auto iBlock = 0; iBlock < nblocks; iBlock++) {
-    auto& block = outputBlocks[iBlock];
-    auto block_size = block.size();
-    auto block_data = block.toArray();
-    std::move(block_data.get(), block_data.get() + block_size, output_data_ptr);
-    output_data_ptr += block_size;
-    if (::sfc::DEBUG)
-      std::cout << "Block [" << iBlock << "]: " << block_size << std::endl;
   }
+  const auto blocksize_sum = (unsigned long long)(output_data_ptr - output);
 
   // Update file header
   auto output_header = header;
   output_header.compressiontype = sfc::sfcc::compression_t::NONE;
   output_header.npaddingbits.reset();
-  return {std::move(output_data), blocksize_sum, output_header};
+  return {blocksize_sum, output_header};
 }
 
 template <class postcompressor>
@@ -736,6 +1138,12 @@ std::string bzip<lzw>::getFileExtension() const
   return "bwt.lzw";
 }
 
+template <>
+std::string bzip<fse>::getFileExtension() const
+{
+  return "bwt.fse";
+}
+
 template <>
 std::string bzip<no_compressor>::getFileExtension() const
 {
@@ -754,6 +1162,12 @@ sfc::sfcc::compression_t bzip<lzw>::getCompressionType() const
   return sfc::sfcc::compression_t::BZIP_LZW;
 }
 
+template <>
+sfc::sfcc::compression_t bzip<fse>::getCompressionType() const
+{
+  return sfc::sfcc::compression_t::BZIP_FSE;
+}
+
 template <>
 sfc::sfcc::compression_t bzip<no_compressor>::getCompressionType() const
 {
@@ -763,30 +1177,40 @@ sfc::sfcc::compression_t bzip<no_compressor>::getCompressionType() const
 // NO_COMPRESSOR
 no_compressor::no_compressor() {}
 no_compressor::~no_compressor() {}
-std::tuple<std::unique_ptr<std::uint8_t[]>, unsigned long long,
-           sfc::sfcc_header>
-no_compressor::compress(const std::unique_ptr<std::uint8_t[]>& data,
-                        const unsigned long long& length,
-                        const sfc::sfcc_header& header)
+unsigned long long no_compressor::maxCompressedSize(
+    const unsigned long long length, const sfc::sfcc_header& header) const
 {
-  auto output_data = std::make_unique<std::uint8_t[]>(length);
-  std::copy(data.get(), data.get() + length, output_data.get());
-  auto output_header = header;
-  output_header.compressiontype = sfc::sfcc::compression_t::NONE;
-  return {std::move(output_data), length, output_header};
+  return length;
 }
 
-std::tuple<std::unique_ptr<std::uint8_t[]>, unsigned long long,
-           sfc::sfcc_header>
-no_compressor::decompress(const std::unique_ptr<std::uint8_t[]>& data,
-                          const unsigned long long& length,
-                          const sfc::sfcc_header& header)
+std::tuple<unsigned long long, sfc::sfcc_header> no_compressor::compressInto(
+    const std::uint8_t* data, const unsigned long long length,
+    std::uint8_t* output, const unsigned long long capacity,
+    const sfc::sfcc_header& header)
 {
-  auto output_data = std::make_unique<std::uint8_t[]>(length);
-  std::copy(data.get(), data.get() + length, output_data.get());
+  // Data that is already in place is left there
+  requireCapacity(capacity, length);
+  if (output != data) std::copy(data, data + length, output);
   auto output_header = header;
   output_header.compressiontype = sfc::sfcc::compression_t::NONE;
-  return {std::move(output_data), length, output_header};
+  return {length, output_header};
+}
+
+unsigned long long no_compressor::maxDecompressedSize(
+    const std::uint8_t* data, const unsigned long long length,
+    const sfc::sfcc_header& header) const
+{
+  return length;
+}
+
+std::tuple<unsigned long long, sfc::sfcc_header>
+no_compressor::decompressInto(const std::uint8_t* data,
+                              const unsigned long long length,
+                              std::uint8_t* output,
+                              const unsigned long long capacity,
+                              const sfc::sfcc_header& header)
+{
+  return compressInto(data, length, output, capacity, header);
 }
 
 std::string no_compressor::getFileExtension() const { return "raw"; }
@@ -796,28 +1220,57 @@ sfc::sfcc::compression_t no_compressor::getCompressionType() const
 }
 
 std::unique_ptr<compressor> make_compressor(
-    const ::sfc::sfcc::compression_t& comp, const bool& bitTransposed)
+    const ::sfc::sfcc::compression_t& comp, const bool& bitTransposed,
+    const std::optional<int>& level)
 {
   using ::sfc::sfcc::compression_t;
   switch (comp) {
     case compression_t::HUFFMAN:
       return std::make_unique<huffman>();
+    case compression_t::HUFFMAN16:
+      return std::make_unique<huffman16>();
+    case compression_t::HUFFMAN16_X4:
+      return std::make_unique<huffman16>(true);
+    case compression_t::FSE:
+      return std::make_unique<fse>();
+    case compression_t::BITPLANE:
+      return std::make_unique<bitplane>();
     case compression_t::LZ77:
-      return std::make_unique<lz77>();
+      return std::make_unique<lz77>(level.value_or(::lz77::DefaultLevel));
+    case compression_t::LZ78:
+      return std::make_unique<lz78>();
     case compression_t::LZW:
       return std::make_unique<lzw>();
     case compression_t::RLE:
       return std::make_unique<rle>();
-    // case compression_t::DEFLATE:
-    //   return std::make_unique<deflate>();
+    case compression_t::RLE_VARINT:
+      return std::make_unique<rle_varint>();
+    case compression_t::DEFLATE:
+      return std::make_unique<deflate>(
+          level.value_or(::deflate::DefaultLevel));
     case compression_t::BZIP_LZ77:
-      return std::make_unique<bzip<lz77>>(bitTransposed);
+      return std::make_unique<bzip<lz77>>(
+          bitTransposed,
+          std::make_unique<lz77>(level.value_or(::lz77::DefaultLevel)));
     case compression_t::BZIP_LZW:
       return std::make_unique<bzip<lzw>>(bitTransposed);
+    case compression_t::BZIP_FSE:
+      return std::make_unique<bzip<fse>>(bitTransposed);
     case compression_t::BWT:
       return std::make_unique<bzip<no_compressor>>(bitTransposed);
+    case compression_t::PIPELINE:
+      throw std::invalid_argument(
+          "A pipeline is built from its stages, not from PIPELINE alone");
     default:
       return nullptr;
   }
 }
+
+std::unique_ptr<compressor> make_compressor(const sfc::sfcc_header& header)
+{
+  if (header.compressiontype == ::sfc::sfcc::compression_t::PIPELINE)
+    return std::make_unique<pipeline>(header.pipeline_stages);
+  return make_compressor(header.compressiontype,
+                         header.bittransposed || header.byteshuffled);
+}
 }  // namespace sfcc
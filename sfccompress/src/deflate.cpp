@@ -0,0 +1,775 @@
+/**
+ * @file deflate.cpp
+ * @author Conrad Haupt (conrad@conradhaupt.co.za)
+ * @brief Raw DEFLATE (RFC 1951) coding
+ * @version 1.0
+ * @date 2020-03-19
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#include "deflate.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "bitstream.h"
+#include "canonical_huffman.h"
+
+namespace deflate {
+namespace {
+
+using sfcc::canonical_huffman::CodeTable;
+
+constexpr std::uint64_t WindowSize = 1ULL << 15;  // Also the longest distance
+constexpr std::uint64_t WindowMask = WindowSize - 1;
+constexpr std::uint32_t MinMatch = 3;
+constexpr std::uint32_t MaxMatch = 258;
+// Matches of MinMatch bytes further back than this cost more than literals
+constexpr std::uint32_t TooFar = 4096;
+constexpr int HashBits = 15;
+// Tokens per block, a block also ends when the input does
+constexpr std::size_t BlockTokens = 1U << 15;
+constexpr std::uint64_t MaxStoredBytes = 65535;
+
+constexpr int MaxCodeLength = 15;
+constexpr int MaxCodeLengthCodeLength = 7;
+constexpr unsigned EndOfBlock = 256;
+constexpr unsigned FirstLengthCode = 257;
+constexpr int NumLengthCodes = 29;
+constexpr int NumLitLenCodes = FirstLengthCode + NumLengthCodes;
+constexpr int NumDistCodes = 30;
+constexpr int NumCodeLengthCodes = 19;
+
+enum BlockType
+{
+  STORED = 0,
+  FIXED = 1,
+  DYNAMIC = 2
+};
+
+constexpr std::uint16_t LengthBase[NumLengthCodes] = {
+    3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+    31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+constexpr std::uint8_t LengthExtra[NumLengthCodes] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+    2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+constexpr std::uint16_t DistBase[NumDistCodes] = {
+    1,    2,    3,    4,    5,    7,     9,     13,    17,  25,
+    33,   49,   65,   97,   129,  193,   257,   385,   513, 769,
+    1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+constexpr std::uint8_t DistExtra[NumDistCodes] = {
+    0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+    6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+// Order in which the code length code lengths are stored
+constexpr std::uint8_t CodeLengthOrder[NumCodeLengthCodes] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+// Code length symbols for runs: repeat the previous length 3-6 times, or
+// write 3-10 or 11-138 zero lengths
+constexpr unsigned RepeatPrevious = 16;
+constexpr unsigned RepeatZero = 17;
+constexpr unsigned RepeatZeroLong = 18;
+
+struct LevelParameters
+{
+  // Chains are searched a quarter as deep for a better match than one this
+  // long
+  std::uint32_t goodLength;
+  // Lazy parsing does not look for a better match than one this long. Greedy
+  // parsing only adds the positions inside matches up to this long to the
+  // hash chains.
+  std::uint32_t lazyLength;
+  std::uint32_t niceLength;  // Searching stops at a match this long
+  int chainLength;
+  bool lazy;
+};
+
+// zlib's configuration table
+constexpr LevelParameters Levels[MaxLevel] = {
+    {4, 4, 8, 4, false},         {4, 5, 16, 8, false},
+    {4, 6, 32, 32, false},       {4, 4, 16, 16, true},
+    {8, 16, 32, 32, true},       {8, 16, 128, 128, true},
+    {8, 32, 128, 256, true},     {32, 128, 258, 1024, true},
+    {32, 258, 258, 4096, true},
+};
+
+// Length and distance codes of every match length and distance
+struct SymbolTables
+{
+  std::array<std::uint8_t, MaxMatch + 1> lengthCode{};
+  // Distances up to 256 are looked up directly, longer ones by their 7 high
+  // bits
+  std::array<std::uint8_t, 512> distCode{};
+
+  SymbolTables()
+  {
+    for (auto code = 0; code < NumLengthCodes; code++)
+      for (std::uint32_t length = LengthBase[code];
+           length < LengthBase[code] + (1U << LengthExtra[code]) &&
+           length <= MaxMatch;
+           length++)
+        lengthCode[length] = code;
+    for (auto code = 0; code < NumDistCodes; code++)
+      for (std::uint32_t dist = DistBase[code] - 1;
+           dist < DistBase[code] - 1U + (1U << DistExtra[code]); dist++)
+        distCode[dist < 256 ? dist : 256 + (dist >> 7)] = code;
+  }
+
+  unsigned distCodeOf(std::uint32_t dist) const
+  {
+    dist--;
+    return distCode[dist < 256 ? dist : 256 + (dist >> 7)];
+  }
+};
+
+const SymbolTables& symbolTables()
+{
+  static const SymbolTables tables;
+  return tables;
+}
+
+std::vector<std::uint8_t> fixedLitLenLengths()
+{
+  std::vector<std::uint8_t> lengths(288);
+  std::fill(&lengths[0], &lengths[144], 8);
+  std::fill(&lengths[144], &lengths[256], 9);
+  std::fill(&lengths[256], &lengths[280], 7);
+  std::fill(&lengths[280], &lengths[288], 8);
+  return lengths;
+}
+
+// The fixed distance code has 32 symbols, of which the last two are invalid
+const CodeTable& fixedLitLenCode()
+{
+  static const CodeTable code(fixedLitLenLengths());
+  return code;
+}
+
+const CodeTable& fixedDistCode()
+{
+  static const CodeTable code(std::vector<std::uint8_t>(32, 5));
+  return code;
+}
+
+inline std::uint64_t readU64(const std::uint8_t* data)
+{
+  std::uint64_t value;
+  std::memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+// Number of equal bytes at current and reference, stopping at end. The
+// reference is earlier in the data, so only current is bounded.
+inline std::uint32_t matchLength(const std::uint8_t* current,
+                                 const std::uint8_t* reference,
+                                 const std::uint8_t* end)
+{
+  const auto start = current;
+  while (end - current >= 8) {
+    const auto differ = readU64(current) ^ readU64(reference);
+    if (differ != 0) {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+      return (current - start) + (__builtin_clzll(differ) >> 3);
+#else
+      return (current - start) + (__builtin_ctzll(differ) >> 3);
+#endif
+    }
+    current += 8;
+    reference += 8;
+  }
+  while (current < end && *current == *reference) {
+    current++;
+    reference++;
+  }
+  return current - start;
+}
+
+struct Match
+{
+  std::uint32_t length = 0;
+  std::uint32_t dist = 0;
+};
+
+// Hash chains over the last WindowSize positions. Positions are looked up
+// before they are inserted, so every chain link reached within the window is
+// still valid.
+class MatchFinder
+{
+ public:
+  MatchFinder(const std::uint8_t* data, std::uint64_t nbytes)
+      : data(data),
+        nbytes(nbytes),
+        head(std::size_t(1) << HashBits, Empty),
+        prev(WindowSize, Empty)
+  {
+  }
+
+  // Positions need MinMatch bytes to be hashed
+  bool hashable(std::uint64_t pos) const { return nbytes - pos >= MinMatch; }
+
+  void insert(std::uint64_t pos)
+  {
+    auto& first = head[hash(pos)];
+    prev[pos & WindowMask] = first;
+    first = pos;
+  }
+
+  Match find(std::uint64_t pos, int chainLength, std::uint32_t niceLength) const
+  {
+    Match best;
+    const auto maxLength =
+        std::uint32_t(std::min<std::uint64_t>(MaxMatch, nbytes - pos));
+    const auto current = data + pos;
+    const auto end = current + maxLength;
+    std::int64_t candidate = head[hash(pos)];
+    while (candidate != Empty && pos - candidate <= WindowSize &&
+           chainLength-- > 0) {
+      const auto reference = data + candidate;
+      // Only a match that is longer than the best can differ from it here
+      if (reference[best.length] == current[best.length]) {
+        const auto length = matchLength(current, reference, end);
+        if (length > best.length) {
+          best = {length, std::uint32_t(pos - candidate)};
+          if (length >= niceLength || length == maxLength) break;
+        }
+      }
+      const auto next = prev[candidate & WindowMask];
+      if (next >= candidate) break;
+      candidate = next;
+    }
+    if (best.length < MinMatch ||
+        (best.length == MinMatch && best.dist > TooFar))
+      return {};
+    return best;
+  }
+
+ private:
+  static constexpr std::int64_t Empty = -1;
+
+  std::uint32_t hash(std::uint64_t pos) const
+  {
+    const std::uint32_t key =
+        data[pos] | (data[pos + 1] << 8) | (data[pos + 2] << 16);
+    return (key * 2654435761U) >> (32 - HashBits);
+  }
+
+  const std::uint8_t* data;
+  const std::uint64_t nbytes;
+  std::vector<std::int64_t> head;
+  std::vector<std::int64_t> prev;
+};
+
+// Code length symbol with its extra bits
+struct CodeLengthSymbol
+{
+  std::uint8_t symbol;
+  std::uint8_t extra;
+};
+
+// Run-length code the concatenated literal/length and distance code lengths
+std::vector<CodeLengthSymbol> codeLengthSymbols(
+    const std::vector<std::uint8_t>& lengths)
+{
+  std::vector<CodeLengthSymbol> symbols;
+  for (std::size_t i = 0; i < lengths.size();) {
+    const auto length = lengths[i];
+    std::size_t run = 1;
+    while (i + run < lengths.size() && lengths[i + run] == length) run++;
+    i += run;
+    if (length == 0) {
+      while (run >= 11) {
+        const auto count = std::min<std::size_t>(run, 138);
+        symbols.push_back({RepeatZeroLong, std::uint8_t(count - 11)});
+        run -= count;
+      }
+      if (run >= 3) {
+        symbols.push_back({RepeatZero, std::uint8_t(run - 3)});
+        run = 0;
+      }
+    } else {
+      symbols.push_back({length, 0});
+      run--;
+      while (run >= 3) {
+        const auto count = std::min<std::size_t>(run, 6);
+        symbols.push_back({RepeatPrevious, std::uint8_t(count - 3)});
+        run -= count;
+      }
+    }
+    for (; run > 0; run--) symbols.push_back({length, 0});
+  }
+  return symbols;
+}
+
+int codeLengthExtraBits(unsigned symbol)
+{
+  switch (symbol) {
+    case RepeatPrevious:
+      return 2;
+    case RepeatZero:
+      return 3;
+    case RepeatZeroLong:
+      return 7;
+    default:
+      return 0;
+  }
+}
+
+// Collects the tokens of a block and writes the block in its cheapest form
+class BlockWriter
+{
+ public:
+  BlockWriter(const std::uint8_t* data, sfcc::BitStreamWriter& writer)
+      : data(data), writer(writer), tables(symbolTables())
+  {
+    tokens.reserve(BlockTokens);
+  }
+
+  void literal(std::uint8_t byte)
+  {
+    tokens.push_back({byte, 0});
+    litLenFrequencies[byte]++;
+    blockBytes++;
+    if (tokens.size() == BlockTokens) flush(false);
+  }
+
+  void match(const Match& match)
+  {
+    tokens.push_back({std::uint16_t(match.length), std::uint16_t(match.dist)});
+    litLenFrequencies[FirstLengthCode + tables.lengthCode[match.length]]++;
+    distFrequencies[tables.distCodeOf(match.dist)]++;
+    blockBytes += match.length;
+    if (tokens.size() == BlockTokens) flush(false);
+  }
+
+  void flush(bool final);
+
+ private:
+  // A literal if dist is zero, a match otherwise
+  struct Token
+  {
+    std::uint16_t litLen;
+    std::uint16_t dist;
+  };
+
+  std::uint64_t extraBits() const;
+  std::uint64_t storedBits() const;
+  void writeStored(bool final);
+  void writeTokens(const CodeTable& litLenCode, const CodeTable& distCode);
+
+  const std::uint8_t* data;
+  sfcc::BitStreamWriter& writer;
+  const SymbolTables& tables;
+  std::vector<Token> tokens;
+  std::vector<std::uint64_t> litLenFrequencies =
+      std::vector<std::uint64_t>(NumLitLenCodes);
+  std::vector<std::uint64_t> distFrequencies =
+      std::vector<std::uint64_t>(NumDistCodes);
+  std::uint64_t blockStart = 0;
+  std::uint64_t blockBytes = 0;
+};
+
+std::uint64_t BlockWriter::extraBits() const
+{
+  std::uint64_t bits = 0;
+  for (auto code = 0; code < NumLengthCodes; code++)
+    bits += litLenFrequencies[FirstLengthCode + code] * LengthExtra[code];
+  for (auto code = 0; code < NumDistCodes; code++)
+    bits += distFrequencies[code] * DistExtra[code];
+  return bits;
+}
+
+std::uint64_t BlockWriter::storedBits() const
+{
+  // Each stored block holds up to MaxStoredBytes and starts on a byte
+  const auto nblocks =
+      std::max<std::uint64_t>(1, (blockBytes + MaxStoredBytes - 1) /
+                                     MaxStoredBytes);
+  const auto firstPadding = (8 - (writer.getBitCount() + 3) % 8) % 8;
+  return nblocks * (3 + 32) + firstPadding + (nblocks - 1) * 5 +
+         blockBytes * 8;
+}
+
+void BlockWriter::writeStored(const bool final)
+{
+  auto remaining = blockBytes;
+  auto in = data + blockStart;
+  do {
+    const auto length = std::min(remaining, MaxStoredBytes);
+    remaining -= length;
+    writer.appendBitsU64(final && remaining == 0, 1);
+    writer.appendBitsU64(STORED, 2);
+    writer.appendBitsU64(0, (8 - writer.getBitCount() % 8) % 8);
+    writer.appendBitsU64(length, 16);
+    writer.appendBitsU64(~length & 0xFFFF, 16);
+    for (std::uint64_t i = 0; i < length; i++) writer.appendBitsU64(in[i], 8);
+    in += length;
+  } while (remaining > 0);
+}
+
+void BlockWriter::writeTokens(const CodeTable& litLenCode,
+                              const CodeTable& distCode)
+{
+  for (const auto& token : tokens) {
+    if (token.dist == 0) {
+      litLenCode.encode(writer, token.litLen);
+      continue;
+    }
+    const unsigned lengthCode = tables.lengthCode[token.litLen];
+    litLenCode.encode(writer, FirstLengthCode + lengthCode);
+    writer.appendBitsU64(token.litLen - LengthBase[lengthCode],
+                         LengthExtra[lengthCode]);
+    const auto distCodeIndex = tables.distCodeOf(token.dist);
+    distCode.encode(writer, distCodeIndex);
+    writer.appendBitsU64(token.dist - DistBase[distCodeIndex],
+                         DistExtra[distCodeIndex]);
+  }
+  litLenCode.encode(writer, EndOfBlock);
+}
+
+void BlockWriter::flush(const bool final)
+{
+  litLenFrequencies[EndOfBlock] = 1;
+
+  // Dynamic codes. The distance code needs at least one length, even if the
+  // block has no matches.
+  auto litLenLengths = sfcc::canonical_huffman::lengthLimitedCodeLengths(
+      litLenFrequencies, MaxCodeLength);
+  auto distLengths = sfcc::canonical_huffman::lengthLimitedCodeLengths(
+      distFrequencies, MaxCodeLength);
+  if (std::all_of(std::begin(distLengths), std::end(distLengths),
+                  [](auto length) { return length == 0; }))
+    distLengths[0] = 1;
+  auto nlitLen = std::size_t(NumLitLenCodes);
+  while (nlitLen > FirstLengthCode && litLenLengths[nlitLen - 1] == 0)
+    nlitLen--;
+  auto ndist = std::size_t(NumDistCodes);
+  while (ndist > 1 && distLengths[ndist - 1] == 0) ndist--;
+
+  std::vector<std::uint8_t> lengths(std::begin(litLenLengths),
+                                    std::begin(litLenLengths) + nlitLen);
+  lengths.insert(std::end(lengths), std::begin(distLengths),
+                 std::begin(distLengths) + ndist);
+  const auto lengthSymbols = codeLengthSymbols(lengths);
+  std::vector<std::uint64_t> codeLengthFrequencies(NumCodeLengthCodes);
+  for (const auto& symbol : lengthSymbols)
+    codeLengthFrequencies[symbol.symbol]++;
+  // zlib rejects a code length code with a single code, so give it a second
+  if (std::count(std::begin(codeLengthFrequencies),
+                 std::end(codeLengthFrequencies), 0) == NumCodeLengthCodes - 1)
+    codeLengthFrequencies[codeLengthFrequencies[0] == 0 ? 0 : 1] = 1;
+  const auto codeLengthLengths =
+      sfcc::canonical_huffman::lengthLimitedCodeLengths(
+          codeLengthFrequencies, MaxCodeLengthCodeLength);
+  auto ncodeLength = NumCodeLengthCodes;
+  while (ncodeLength > 4 &&
+         codeLengthLengths[CodeLengthOrder[ncodeLength - 1]] == 0)
+    ncodeLength--;
+
+  // Sizes of the three block types
+  const auto extra = extraBits();
+  std::uint64_t dynamicBits = 3 + 5 + 5 + 4 + 3 * ncodeLength + extra;
+  for (const auto& symbol : lengthSymbols)
+    dynamicBits += codeLengthLengths[symbol.symbol] +
+                   codeLengthExtraBits(symbol.symbol);
+  std::uint64_t fixedBits = 3 + extra;
+  const auto& fixedLitLen = fixedLitLenCode();
+  for (auto code = 0; code < NumLitLenCodes; code++) {
+    dynamicBits += litLenFrequencies[code] * litLenLengths[code];
+    fixedBits += litLenFrequencies[code] * fixedLitLen.getCodeLength(code);
+  }
+  for (auto code = 0; code < NumDistCodes; code++) {
+    dynamicBits += distFrequencies[code] * distLengths[code];
+    fixedBits += distFrequencies[code] * 5;
+  }
+
+  if (storedBits() < std::min(fixedBits, dynamicBits)) {
+    writeStored(final);
+  } else if (fixedBits <= dynamicBits) {
+    writer.appendBitsU64(final, 1);
+    writer.appendBitsU64(FIXED, 2);
+    writeTokens(fixedLitLen, fixedDistCode());
+  } else {
+    writer.appendBitsU64(final, 1);
+    writer.appendBitsU64(DYNAMIC, 2);
+    writer.appendBitsU64(nlitLen - FirstLengthCode, 5);
+    writer.appendBitsU64(ndist - 1, 5);
+    writer.appendBitsU64(ncodeLength - 4, 4);
+    for (auto i = 0; i < ncodeLength; i++)
+      writer.appendBitsU64(codeLengthLengths[CodeLengthOrder[i]], 3);
+    const CodeTable codeLengthCode(codeLengthLengths);
+    for (const auto& symbol : lengthSymbols) {
+      codeLengthCode.encode(writer, symbol.symbol);
+      writer.appendBitsU64(symbol.extra, codeLengthExtraBits(symbol.symbol));
+    }
+    writeTokens(CodeTable(std::move(litLenLengths)),
+                CodeTable(std::move(distLengths)));
+  }
+
+  blockStart += blockBytes;
+  blockBytes = 0;
+  tokens.clear();
+  std::fill(std::begin(litLenFrequencies), std::end(litLenFrequencies), 0);
+  std::fill(std::begin(distFrequencies), std::end(distFrequencies), 0);
+}
+
+void parseGreedy(const std::uint8_t* data, const std::uint64_t nbytes,
+                 const LevelParameters& params, BlockWriter& block)
+{
+  MatchFinder finder(data, nbytes);
+  for (std::uint64_t pos = 0; pos < nbytes;) {
+    Match match;
+    if (finder.hashable(pos)) {
+      match = finder.find(pos, params.chainLength, params.niceLength);
+      finder.insert(pos);
+    }
+    if (match.length == 0) {
+      block.literal(data[pos++]);
+      continue;
+    }
+    block.match(match);
+    const auto end = pos + match.length;
+    if (match.length <= params.lazyLength)
+      for (pos++; pos < end && finder.hashable(pos); pos++) finder.insert(pos);
+    pos = end;
+  }
+}
+
+void parseLazy(const std::uint8_t* data, const std::uint64_t nbytes,
+               const LevelParameters& params, BlockWriter& block)
+{
+  MatchFinder finder(data, nbytes);
+  // The previous position is held back until it is known whether the match
+  // found there is better than the one at the current position
+  bool pending = false;
+  Match previous;
+  for (std::uint64_t pos = 0; pos < nbytes;) {
+    Match current;
+    if (finder.hashable(pos)) {
+      if (!pending || previous.length < params.lazyLength) {
+        const auto depth = pending && previous.length >= params.goodLength
+                               ? params.chainLength / 4
+                               : params.chainLength;
+        current = finder.find(pos, depth, params.niceLength);
+      }
+      finder.insert(pos);
+    }
+    if (pending && previous.length != 0 && current.length <= previous.length) {
+      block.match(previous);
+      const auto end = pos - 1 + previous.length;
+      for (pos++; pos < end && finder.hashable(pos); pos++) finder.insert(pos);
+      pos = end;
+      pending = false;
+      continue;
+    }
+    if (pending) block.literal(data[pos - 1]);
+    previous = current;
+    pending = true;
+    pos++;
+  }
+  // No match can start at the last position
+  if (pending) block.literal(data[nbytes - 1]);
+}
+
+[[noreturn]] void malformed(const std::string& reason)
+{
+  throw std::runtime_error("Malformed DEFLATE stream: " + reason);
+}
+
+// Decodes the blocks of a stream into a caller buffer
+class Inflater
+{
+ public:
+  Inflater(const std::uint8_t* compressed, std::uint64_t compressedSizeBytes,
+           std::uint8_t* uncompressed, std::uint64_t uncompressedSizeBytes)
+      : reader(compressed, compressedSizeBytes, compressedSizeBytes * 8),
+        out(uncompressed),
+        outSize(uncompressedSizeBytes)
+  {
+  }
+
+  std::uint64_t inflate()
+  {
+    bool final = false;
+    while (!final) {
+      final = reader.readBitsU64(1);
+      switch (reader.readBitsU64(2)) {
+        case STORED:
+          inflateStored();
+          break;
+        case FIXED:
+          inflateCodes(fixedLitLenCode(), fixedDistCode());
+          break;
+        case DYNAMIC:
+          inflateDynamic();
+          break;
+        default:
+          malformed("invalid block type");
+      }
+      checkNotTruncated();
+    }
+    return pos;
+  }
+
+ private:
+  // Huffman codes are read without bounds checks, past the end of the stream
+  // they see zero bits
+  void checkNotTruncated() const
+  {
+    if (reader.getBitsRead() > reader.getBitCount()) malformed("truncated");
+  }
+
+  void checkRoom(std::uint64_t length) const
+  {
+    if (length > outSize - pos) {
+      checkNotTruncated();
+      throw std::runtime_error("DEFLATE output buffer of " +
+                               std::to_string(outSize) + " bytes is too small");
+    }
+  }
+
+  void inflateStored()
+  {
+    reader.readBitsU64((8 - reader.getBitsRead() % 8) % 8);
+    const auto length = reader.readBitsU64(16);
+    if (reader.readBitsU64(16) != (~length & 0xFFFF))
+      malformed("stored block length check failed");
+    checkRoom(length);
+    if (reader.getBitsRead() + length * 8 > reader.getBitCount())
+      malformed("truncated");
+    auto remaining = length;
+    for (; remaining >= 7; remaining -= 7, pos += 7) {
+      const auto bytes = reader.readBitsU64(56);
+      std::memcpy(out + pos, &bytes, 7);
+    }
+    for (; remaining > 0; remaining--) out[pos++] = reader.readBitsU64(8);
+  }
+
+  void inflateDynamic()
+  {
+    const auto nlitLen = reader.readBitsU64(5) + FirstLengthCode;
+    const auto ndist = reader.readBitsU64(5) + 1;
+    const auto ncodeLength = reader.readBitsU64(4) + 4;
+    if (nlitLen > NumLitLenCodes || ndist > NumDistCodes)
+      malformed("too many codes");
+
+    std::vector<std::uint8_t> codeLengthLengths(NumCodeLengthCodes);
+    for (std::uint64_t i = 0; i < ncodeLength; i++)
+      codeLengthLengths[CodeLengthOrder[i]] = reader.readBitsU64(3);
+    const CodeTable codeLengthCode(std::move(codeLengthLengths));
+
+    std::vector<std::uint8_t> lengths;
+    lengths.reserve(nlitLen + ndist);
+    while (lengths.size() < nlitLen + ndist) {
+      const auto symbol = codeLengthCode.decode(reader);
+      if (symbol < RepeatPrevious) {
+        lengths.push_back(symbol);
+        continue;
+      }
+      std::uint8_t length = 0;
+      std::uint64_t count;
+      if (symbol == RepeatPrevious) {
+        if (lengths.empty()) malformed("repeated length without a previous");
+        length = lengths.back();
+        count = 3 + reader.readBitsU64(2);
+      } else if (symbol == RepeatZero) {
+        count = 3 + reader.readBitsU64(3);
+      } else {
+        count = 11 + reader.readBitsU64(7);
+      }
+      if (lengths.size() + count > nlitLen + ndist)
+        malformed("code lengths overrun the codes");
+      lengths.insert(std::end(lengths), count, length);
+    }
+    if (lengths[EndOfBlock] == 0) malformed("no end of block code");
+
+    const CodeTable litLenCode(std::vector<std::uint8_t>(
+        std::begin(lengths), std::begin(lengths) + nlitLen));
+    const CodeTable distCode(std::vector<std::uint8_t>(
+        std::begin(lengths) + nlitLen, std::end(lengths)));
+    inflateCodes(litLenCode, distCode);
+  }
+
+  void inflateCodes(const CodeTable& litLenCode, const CodeTable& distCode)
+  {
+    for (;;) {
+      const auto symbol = litLenCode.decode(reader);
+      if (symbol < EndOfBlock) {
+        checkRoom(1);
+        out[pos++] = symbol;
+        continue;
+      }
+      if (symbol == EndOfBlock) return;
+      const auto lengthCode = symbol - FirstLengthCode;
+      if (lengthCode >= NumLengthCodes) malformed("invalid length code");
+      const auto length =
+          LengthBase[lengthCode] + reader.readBitsU64(LengthExtra[lengthCode]);
+      const auto distCodeIndex = distCode.decode(reader);
+      if (distCodeIndex >= NumDistCodes) malformed("invalid distance code");
+      const auto dist = DistBase[distCodeIndex] +
+                        reader.readBitsU64(DistExtra[distCodeIndex]);
+      if (dist > pos) malformed("distance reaches before the start");
+      checkRoom(length);
+      copyMatch(dist, length);
+    }
+  }
+
+  void copyMatch(std::uint64_t dist, std::uint64_t length)
+  {
+    auto dst = out + pos;
+    const auto src = dst - dist;
+    pos += length;
+    if (dist >= length) {
+      std::memcpy(dst, src, length);
+      return;
+    }
+    for (std::uint64_t i = 0; i < length; i++) dst[i] = src[i];
+  }
+
+  sfcc::BitStreamReader reader;
+  std::uint8_t* const out;
+  const std::uint64_t outSize;
+  std::uint64_t pos = 0;
+};
+
+}  // namespace
+
+unsigned long long maxCompressedSize(const unsigned long long nbytes)
+{
+  return nbytes + nbytes / 16 + 64;
+}
+
+std::tuple<std::unique_ptr<std::uint8_t[]>, unsigned long long> easyEncode(
+    const std::uint8_t* uncompressed, const unsigned long long nbytes,
+    const int level)
+{
+  if (level < MinLevel || level > MaxLevel)
+    throw std::invalid_argument("DEFLATE level must be between " +
+                                std::to_string(MinLevel) + " and " +
+                                std::to_string(MaxLevel));
+  const auto& params = Levels[level - 1];
+
+  sfcc::BitStreamWriter writer(maxCompressedSize(nbytes) * 8);
+  BlockWriter block(uncompressed, writer);
+  if (params.lazy)
+    parseLazy(uncompressed, nbytes, params, block);
+  else
+    parseGreedy(uncompressed, nbytes, params, block);
+  block.flush(true);
+
+  const unsigned long long compressedSizeBytes = writer.getByteCount();
+  return {std::unique_ptr<std::uint8_t[]>(writer.release()),
+          compressedSizeBytes};
+}
+
+unsigned long long easyDecode(const std::uint8_t* compressed,
+                              const unsigned long long compressedSizeBytes,
+                              std::uint8_t* uncompressed,
+                              const unsigned long long uncompressedSizeBytes)
+{
+  return Inflater(compressed, compressedSizeBytes, uncompressed,
+                  uncompressedSizeBytes)
+      .inflate();
+}
+
+}  // namespace deflate
@@ -0,0 +1,378 @@
+/**
+ * @file fse.cpp
+ * @author Conrad Haupt (conrad@conradhaupt.co.za)
+ * @brief Table-based asymmetric numeral system (FSE) coding over bytes
+ * @version 1.0
+ * @date 2020-03-12
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#include "fse.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <string>
+
+namespace fse {
+
+namespace {
+// Stream layout: symbol count, code table, final encoder state, number of
+// padding bits, then the state transition bits starting on a byte boundary
+constexpr int SymbolCountBits = 64;
+constexpr int PaddingBits = 3;
+// Code table: table log, bounds of the coded symbols and a normalised count for
+// each symbol in between. A zero count is followed by the number of further
+// zero counts.
+constexpr int SymbolBits = 8;
+constexpr int TableLogBits = 4;
+constexpr int ZeroRunBits = 8;
+constexpr unsigned MaxZeroRun = (1U << ZeroRunBits) - 1;
+
+int highBit(std::uint32_t value)
+{
+  auto bit = -1;
+  while (value != 0) {
+    value >>= 1;
+    bit++;
+  }
+  return bit;
+}
+
+// Number of bits needed for a normalised count, which can be 2^tableLog
+int countBits(const int tableLog) { return tableLog + 1; }
+
+// Smallest table that still leaves room to tell the symbols apart, but no
+// larger than needed for short inputs
+int chooseTableLog(const unsigned long long nbytes, const unsigned nused)
+{
+  auto tableLog = DefaultTableLog;
+  if (nbytes < (1U << DefaultTableLog))
+    tableLog = highBit(std::max<std::uint32_t>(nbytes, 1)) + 1;
+  tableLog = std::max(tableLog, highBit(std::max(nused, 1U)) + 2);
+  return std::clamp(tableLog, MinTableLog, MaxTableLog);
+}
+
+// Writes the state transition bits back to front. The decoder reads them in
+// the opposite order to which the encoder produces them, so the stream is
+// filled from the end of the buffer and any padding ends up at the front.
+class ReverseBitWriter
+{
+ public:
+  explicit ReverseBitWriter(std::uint8_t* end) : cursor(end) {}
+
+  void appendBits(const std::uint32_t bits, const int bitCount)
+  {
+    bitBuffer = (bitBuffer << bitCount) | bits;
+    bitBufferCount += bitCount;
+    if (bitBufferCount >= 32) flushBytes();
+  }
+
+  // Returns the number of padding bits in front of the first bit
+  int finish()
+  {
+    flushBytes();
+    if (bitBufferCount == 0) return 0;
+    *--cursor = std::uint8_t(bitBuffer << (8 - bitBufferCount));
+    return 8 - bitBufferCount;
+  }
+
+  const std::uint8_t* begin() const { return cursor; }
+
+ private:
+  void flushBytes()
+  {
+    while (bitBufferCount >= 8) {
+      bitBufferCount -= 8;
+      *--cursor = std::uint8_t(bitBuffer >> bitBufferCount);
+    }
+  }
+
+  std::uint8_t* cursor;
+  std::uint64_t bitBuffer = 0;
+  int bitBufferCount = 0;
+};
+}  // namespace
+
+std::vector<std::uint16_t> normaliseCounts(
+    const std::vector<std::uint64_t>& frequencies, const int tableLog)
+{
+  const std::uint32_t tableSize = 1U << tableLog;
+  std::vector<std::uint16_t> counts(frequencies.size(), 0);
+  const auto total = std::accumulate(std::begin(frequencies),
+                                     std::end(frequencies), std::uint64_t(0));
+  if (total == 0) return counts;
+  const auto nused =
+      std::count_if(std::begin(frequencies), std::end(frequencies),
+                    [](auto frequency) { return frequency != 0; });
+  if (std::uint64_t(nused) > tableSize)
+    throw std::logic_error("Cannot code " + std::to_string(nused) +
+                           " symbols with a table log of " +
+                           std::to_string(tableLog));
+
+  std::int64_t sum = 0;
+  for (std::size_t symbol = 0; symbol < frequencies.size(); symbol++) {
+    if (frequencies[symbol] == 0) continue;
+    const auto scaled = std::llround(static_cast<double>(frequencies[symbol]) *
+                                     tableSize / total);
+    counts[symbol] = std::max<long long>(scaled, 1);
+    sum += counts[symbol];
+  }
+
+  // Rounding leaves the sum slightly off. Correct it on the largest counts,
+  // where one step changes the probability the least.
+  while (sum != tableSize) {
+    const auto largest = std::max_element(std::begin(counts), std::end(counts));
+    if (sum > tableSize) {
+      (*largest)--;
+      sum--;
+    } else {
+      (*largest)++;
+      sum++;
+    }
+  }
+  return counts;
+}
+
+CodeTable::CodeTable(std::vector<std::uint16_t> counts, const int log)
+    : normalisedCounts(std::move(counts)), tableLog(log)
+{
+  if (tableLog < MinTableLog || tableLog > MaxTableLog)
+    throw std::runtime_error("FSE table log of " + std::to_string(tableLog) +
+                             " is out of range");
+  if (normalisedCounts.size() > AlphabetSize)
+    throw std::logic_error("FSE alphabet is larger than 8 bits");
+  normalisedCounts.resize(AlphabetSize, 0);
+
+  const std::uint32_t tableSize = 1U << tableLog;
+  std::vector<std::uint32_t> cumulative(AlphabetSize + 1, 0);
+  for (auto symbol = 0; symbol < AlphabetSize; symbol++)
+    cumulative[symbol + 1] = cumulative[symbol] + normalisedCounts[symbol];
+  if (cumulative[AlphabetSize] != tableSize)
+    throw std::runtime_error("FSE normalised counts sum to " +
+                             std::to_string(cumulative[AlphabetSize]) +
+                             " instead of " + std::to_string(tableSize));
+
+  // Spread the symbols over the states. The step is odd, so it visits every
+  // state exactly once.
+  std::vector<std::uint8_t> stateSymbols(tableSize);
+  const std::uint32_t step = (tableSize >> 1) + (tableSize >> 3) + 3;
+  std::uint32_t position = 0;
+  for (auto symbol = 0; symbol < AlphabetSize; symbol++) {
+    for (std::uint32_t i = 0; i < normalisedCounts[symbol]; i++) {
+      stateSymbols[position] = symbol;
+      position = (position + step) & (tableSize - 1);
+    }
+  }
+
+  // Encoder: states of each symbol in spread order, and the transform that maps
+  // a state to its number of output bits and its slot in stateTable
+  stateTable.resize(tableSize);
+  auto nextSlot = cumulative;
+  for (std::uint32_t state = 0; state < tableSize; state++)
+    stateTable[nextSlot[stateSymbols[state]]++] = tableSize + state;
+
+  symbolTransforms.resize(AlphabetSize, {0, 0});
+  for (auto symbol = 0; symbol < AlphabetSize; symbol++) {
+    const std::uint32_t count = normalisedCounts[symbol];
+    auto& transform = symbolTransforms[symbol];
+    if (count == 0) continue;
+    if (count == 1) {
+      transform.deltaNbBits = (std::uint32_t(tableLog) << 16) - tableSize;
+      transform.deltaFindState = std::int32_t(cumulative[symbol]) - 1;
+    } else {
+      const std::uint32_t maxBitsOut = tableLog - highBit(count - 1);
+      const std::uint32_t minStatePlus = count << maxBitsOut;
+      transform.deltaNbBits = (maxBitsOut << 16) - minStatePlus;
+      transform.deltaFindState =
+          std::int32_t(cumulative[symbol]) - std::int32_t(count);
+    }
+  }
+
+  // Decoder: the k-th state of a symbol in spread order continues from the
+  // sub-range [count + k, 2 * count) scaled up to the table size
+  decodeTable.resize(tableSize);
+  std::vector<std::uint32_t> nextState(std::begin(normalisedCounts),
+                                       std::end(normalisedCounts));
+  for (std::uint32_t state = 0; state < tableSize; state++) {
+    const auto symbol = stateSymbols[state];
+    const auto next = nextState[symbol]++;
+    const auto nbBits = tableLog - highBit(next);
+    decodeTable[state] = {std::uint16_t((next << nbBits) - tableSize), symbol,
+                          std::uint8_t(nbBits)};
+  }
+}
+
+void CodeTable::write(BitStreamWriter& writer) const
+{
+  std::uint32_t firstSymbol = 0;
+  std::uint32_t lastSymbol = 0;
+  const auto used =
+      std::find_if(std::begin(normalisedCounts), std::end(normalisedCounts),
+                   [](auto count) { return count != 0; });
+  if (used != std::end(normalisedCounts)) {
+    firstSymbol = std::distance(std::begin(normalisedCounts), used);
+    lastSymbol = normalisedCounts.size() - 1;
+    while (normalisedCounts[lastSymbol] == 0) lastSymbol--;
+  }
+  writer.appendBitsU64(tableLog, TableLogBits);
+  writer.appendBitsU64(firstSymbol, SymbolBits);
+  writer.appendBitsU64(lastSymbol, SymbolBits);
+
+  for (auto symbol = firstSymbol; symbol <= lastSymbol; symbol++) {
+    writer.appendBitsU64(normalisedCounts[symbol], countBits(tableLog));
+    if (normalisedCounts[symbol] != 0) continue;
+    unsigned run = 0;
+    while (run < MaxZeroRun && symbol + 1 <= lastSymbol &&
+           normalisedCounts[symbol + 1] == 0) {
+      run++;
+      symbol++;
+    }
+    writer.appendBitsU64(run, ZeroRunBits);
+  }
+}
+
+CodeTable CodeTable::read(BitStreamReader& reader)
+{
+  const int tableLog = reader.readBitsU64(TableLogBits);
+  if (tableLog < MinTableLog || tableLog > MaxTableLog)
+    throw std::runtime_error("FSE table log of " + std::to_string(tableLog) +
+                             " is out of range");
+  const auto firstSymbol = reader.readBitsU64(SymbolBits);
+  const auto lastSymbol = reader.readBitsU64(SymbolBits);
+  if (firstSymbol > lastSymbol)
+    throw std::runtime_error("Invalid FSE code table bounds");
+
+  std::vector<std::uint16_t> counts(AlphabetSize, 0);
+  for (auto symbol = firstSymbol; symbol <= lastSymbol; symbol++) {
+    counts[symbol] = reader.readBitsU64(countBits(tableLog));
+    if (counts[symbol] == 0) symbol += reader.readBitsU64(ZeroRunBits);
+  }
+  return CodeTable(std::move(counts), tableLog);
+}
+
+std::uint64_t CodeTable::tableSizeBits() const
+{
+  // Worst case is a zero run after every count
+  return TableLogBits + 2ULL * SymbolBits +
+         normalisedCounts.size() * (countBits(tableLog) + ZeroRunBits);
+}
+
+unsigned long long maxCompressedSize(const unsigned long long nbytes)
+{
+  if (nbytes == 0) return SymbolCountBits / 8;
+  // The largest table with a zero run after every count, then at most
+  // MaxTableLog bits per symbol
+  const auto tableBits = TableLogBits + 2ULL * SymbolBits +
+                         AlphabetSize * (countBits(MaxTableLog) + ZeroRunBits);
+  const auto headerBits =
+      SymbolCountBits + tableBits + MaxTableLog + PaddingBits;
+  return (headerBits + 7) / 8 + (nbytes * MaxTableLog + 7) / 8 + 1;
+}
+
+std::tuple<std::unique_ptr<std::uint8_t[]>, unsigned long long> easyEncode(
+    const std::uint8_t* uncompressed, const unsigned long long nbytes)
+{
+  if (nbytes == 0) {
+    // Only the symbol count
+    BitStreamWriter writer(SymbolCountBits);
+    writer.appendBitsU64(0, SymbolCountBits);
+    const unsigned long long compressedSizeBytes = writer.getByteCount();
+    return {std::unique_ptr<std::uint8_t[]>(writer.release()),
+            compressedSizeBytes};
+  }
+
+  std::vector<std::uint64_t> frequencies(AlphabetSize, 0);
+  std::for_each(uncompressed, uncompressed + nbytes,
+                [&frequencies](std::uint8_t symbol) { frequencies[symbol]++; });
+  const auto nused =
+      std::count_if(std::begin(frequencies), std::end(frequencies),
+                    [](auto frequency) { return frequency != 0; });
+  const auto tableLog = chooseTableLog(nbytes, nused);
+  const CodeTable table(normaliseCounts(frequencies, tableLog), tableLog);
+  const std::uint32_t tableSize = 1U << tableLog;
+
+  // ANS is last-in first-out, so encode from the back. Every symbol outputs at
+  // most tableLog bits. The bits output by the first encoded symbol only
+  // describe the initial state and are dropped.
+  const auto transitionBytes = (nbytes * tableLog + 7) / 8 + 1;
+  auto transitions = std::make_unique<std::uint8_t[]>(transitionBytes);
+  ReverseBitWriter transitionWriter(transitions.get() + transitionBytes);
+  std::uint32_t state = tableSize;
+  for (auto i = nbytes; i-- > 0;) {
+    const auto symbol = uncompressed[i];
+    const auto nbBits = table.encodeBitCount(state, symbol);
+    if (i != nbytes - 1)
+      transitionWriter.appendBits(state & ((1U << nbBits) - 1), nbBits);
+    state = table.encodeNextState(state, symbol, nbBits);
+  }
+  const auto padding = transitionWriter.finish();
+  const auto transitionSizeBytes =
+      transitions.get() + transitionBytes - transitionWriter.begin();
+
+  BitStreamWriter header(SymbolCountBits + table.tableSizeBits() + tableLog +
+                         PaddingBits);
+  header.appendBitsU64(nbytes, SymbolCountBits);
+  table.write(header);
+  header.appendBitsU64(state - tableSize, tableLog);
+  header.appendBitsU64(padding, PaddingBits);
+
+  const unsigned long long compressedSizeBytes =
+      header.getByteCount() + transitionSizeBytes;
+  auto compressed = std::make_unique<std::uint8_t[]>(compressedSizeBytes);
+  auto compressed_ptr = std::copy(
+      header.getBitStream(), header.getBitStream() + header.getByteCount(),
+      compressed.get());
+  std::copy(transitionWriter.begin(),
+            transitionWriter.begin() + transitionSizeBytes, compressed_ptr);
+  return {std::move(compressed), compressedSizeBytes};
+}
+
+unsigned long long decodedSizeBytes(
+    const std::uint8_t* compressed,
+    const unsigned long long compressedSizeBytes)
+{
+  BitStreamReader reader(compressed, compressedSizeBytes,
+                         compressedSizeBytes * 8);
+  return reader.readBitsU64(SymbolCountBits);
+}
+
+unsigned long long easyDecode(const std::uint8_t* compressed,
+                              const unsigned long long compressedSizeBytes,
+                              std::uint8_t* uncompressed,
+                              const unsigned long long uncompressedSizeBytes)
+{
+  BitStreamReader header(compressed, compressedSizeBytes,
+                         compressedSizeBytes * 8);
+  const auto nbytes = header.readBitsU64(SymbolCountBits);
+  if (nbytes > uncompressedSizeBytes)
+    throw std::runtime_error("FSE output buffer is too small: " +
+                             std::to_string(uncompressedSizeBytes) + " < " +
+                             std::to_string(nbytes));
+  if (nbytes == 0) return 0;
+
+  const auto table = CodeTable::read(header);
+  std::uint32_t state = header.readBitsU64(table.getTableLog());
+  const int padding = header.readBitsU64(PaddingBits);
+
+  const auto offset = (header.getBitsRead() + 7) / 8;
+  const auto transitionSizeBytes = compressedSizeBytes - offset;
+  BitStreamReader reader(compressed + offset, transitionSizeBytes,
+                         transitionSizeBytes * 8);
+  reader.peekBits(padding);
+  reader.skipBits(padding);
+
+  for (unsigned long long i = 0; i + 1 < nbytes; i++) {
+    const auto& entry = table.decodeEntry(state);
+    uncompressed[i] = entry.symbol;
+    state = entry.newState + reader.peekBits(entry.nbBits);
+    reader.skipBits(entry.nbBits);
+  }
+  uncompressed[nbytes - 1] = table.decodeEntry(state).symbol;
+
+  if (reader.getBitsRead() > reader.getBitCount())
+    throw std::runtime_error("FSE stream ended unexpectedly");
+  return nbytes;
+}
+
+}  // namespace fse
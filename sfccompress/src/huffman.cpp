@@ -66,12 +66,11 @@
 // own error handling strategy. The default simply writes to
 // stderr and calls std::abort().
 //
-// Memory allocated explicitly by the bit streams will be sourced
-// from HUFFMAN_MALLOC/HUFFMAN_MFREE, so you can override the macros
-// to add custom memory management. Current that's all the memory
-// we allocate directly, but we also use std::priority_queue<> to
-// build the Huffman tree and the queue will allocate memory from
-// the global heap, so you won't be able to catch that, unfortunately.
+// Bits are written and read through the shared word-buffered
+// sfcc::BitStreamWriter/BitStreamReader (see bitstream.h), whose
+// buffers are allocated with new[] and must be freed with delete[].
+// We also use std::priority_queue<> to build the Huffman tree and the
+// queue will allocate memory from the global heap.
 //
 // The huffman::Node struct is not very optimized for size.
 // We use full signed integers for the value and child indexes,
@@ -98,11 +97,6 @@
 // Nice quick video tutorial on Huffman coding:
 //  https://youtu.be/apcCVfXfcqE
 
-// If you provide a custom malloc(), you must also provide a custom free().
-// Note: We never check HUFFMAN_MALLOC's return for null. A custom
-// implementation should just abort with a fatal error if the program runs out
-// of memory.
-
 namespace huffman {
 
 // ========================================================
@@ -176,19 +170,6 @@ bool Code::operator<(const Code other) const
   }
 }
 
-// ========================================================
-// class BitStreamReader:
-// ========================================================
-
-int BitStreamReader::getByteCount() const { return sizeInBytes; }
-int BitStreamReader::getBitCount() const { return sizeInBits; }
-const std::uint8_t *BitStreamReader::getBitStream() const { return stream; }
-
-// Current Huffman code being read from the stream:
-void BitStreamReader::clearCode() { currCode.clear(); }
-Code BitStreamReader::getCode() const { return currCode; }
-int BitStreamReader::getCodeLength() const { return currCode.getLength(); }
-
 bool Node::isValid() const { return frequency != Nil; }
 bool Node::isLeaf() const { return leftChild == Nil && rightChild == Nil; }
 
@@ -210,18 +191,6 @@ namespace huffman {
 // Local helpers:
 // ========================================================
 
-// Round up to the next power-of-two number, e.g. 37 => 64
-static int nextPowerOfTwo(int num)
-{
-  --num;
-  for (std::size_t i = 1; i < sizeof(num) * 8; i <<= 1) {
-    num = num | num >> i;
-  }
-  return ++num;
-}
-
-// ========================================================
-
 // Count the minimum number of bits required to
 // represent the integer 'num', AKA its log2.
 static int bitsForInteger(int num)
@@ -250,249 +219,21 @@ void fatalError(const char *const message)
 
 #endif  // HUFFMAN_USING_DEFAULT_ERROR_HANDLER
 
-// ========================================================
-// class BitStreamWriter:
-// ========================================================
-
-BitStreamWriter::BitStreamWriter()
-{
-  // 8192 bits for a start (1024 bytes). It will resize if needed.
-  // Default granularity is 2.
-  internalInit();
-  allocate(8192);
-}
-
-BitStreamWriter::BitStreamWriter(const int initialSizeInBits,
-                                 const int growthGranularity)
-{
-  internalInit();
-  setGranularity(growthGranularity);
-  allocate(initialSizeInBits);
-}
-
-BitStreamWriter::~BitStreamWriter()
-{
-  if (stream != nullptr) {
-    HUFFMAN_MFREE(stream);
-  }
-}
-
-void BitStreamWriter::internalInit()
-{
-  stream = nullptr;
-  bytesAllocated = 0;
-  granularity = 2;
-  currBytePos = 0;
-  nextBitPos = 0;
-  numBitsWritten = 0;
-}
-
-void BitStreamWriter::allocate(int bitsWanted)
-{
-  // Require at least a byte.
-  if (bitsWanted <= 0) {
-    bitsWanted = 8;
-  }
-
-  // Round upwards if needed:
-  if ((bitsWanted % 8) != 0) {
-    bitsWanted = nextPowerOfTwo(bitsWanted);
-  }
-
-  // We might already have the required count.
-  const int sizeInBytes = bitsWanted / 8;
-  if (sizeInBytes <= bytesAllocated) {
-    return;
-  }
-
-  stream = allocBytes(sizeInBytes, stream, bytesAllocated);
-  bytesAllocated = sizeInBytes;
-}
-
-void BitStreamWriter::appendBit(const int bit)
-{
-  const std::uint32_t mask = std::uint32_t(1) << nextBitPos;
-  stream[currBytePos] = (stream[currBytePos] & ~mask) | (-bit & mask);
-  ++numBitsWritten;
-
-  if (++nextBitPos == 8) {
-    nextBitPos = 0;
-    if (++currBytePos == bytesAllocated) {
-      allocate(bytesAllocated * granularity * 8);
-    }
-  }
-}
-
-void BitStreamWriter::appendBitsU64(const std::uint64_t num, const int bitCount)
-{
-  assert(bitCount <= 64);
-  for (int b = 0; b < bitCount; ++b) {
-    const std::uint64_t mask = std::uint64_t(1) << b;
-    const int bit = !!(num & mask);
-    appendBit(bit);
-  }
-}
-
-void BitStreamWriter::appendCode(const Code code)
-{
-  for (int b = 0; b < code.getLength(); ++b) {
-    appendBit(code.getBit(b));
-  }
-}
-
-#ifndef HUFFMAN_NO_STD_STRING
-
-void BitStreamWriter::appendBitString(const std::string &bitStr)
-{
-  for (std::size_t i = 0; i < bitStr.length(); ++i) {
-    appendBit(bitStr[i] == '0' ? 0 : 1);
-  }
-}
-
-std::string BitStreamWriter::toBitString() const
-{
-  std::string bitString;
-
-  int usedBytes = numBitsWritten / 8;
-  int leftovers = numBitsWritten % 8;
-  if (leftovers != 0) {
-    ++usedBytes;
-  }
-  assert(usedBytes <= bytesAllocated);
-
-  for (int i = 0; i < usedBytes; ++i) {
-    const int nBits =
-        (leftovers == 0) ? 8 : (i == usedBytes - 1) ? leftovers : 8;
-    for (int j = 0; j < nBits; ++j) {
-      bitString += (stream[i] & (1 << j) ? '1' : '0');
-    }
-  }
-
-  return bitString;
-}
-
-#endif  // HUFFMAN_NO_STD_STRING
-
-std::uint8_t *BitStreamWriter::release()
-{
-  std::uint8_t *oldPtr = stream;
-  internalInit();
-  return oldPtr;
-}
-
-void BitStreamWriter::setGranularity(const int growthGranularity)
-{
-  granularity = (growthGranularity >= 2) ? growthGranularity : 2;
-}
-
-int BitStreamWriter::getByteCount() const
-{
-  int usedBytes = numBitsWritten / 8;
-  int leftovers = numBitsWritten % 8;
-  if (leftovers != 0) {
-    ++usedBytes;
-  }
-  assert(usedBytes <= bytesAllocated);
-  return usedBytes;
-}
-
-int BitStreamWriter::getBitCount() const { return numBitsWritten; }
-
-const std::uint8_t *BitStreamWriter::getBitStream() const { return stream; }
-
-std::uint8_t *BitStreamWriter::allocBytes(const int bytesWanted,
-                                          std::uint8_t *oldPtr,
-                                          const int oldSize)
-{
-  std::uint8_t *newMemory =
-      static_cast<std::uint8_t *>(HUFFMAN_MALLOC(bytesWanted));
-  std::memset(newMemory, 0, bytesWanted);
-
-  if (oldPtr != nullptr) {
-    std::memcpy(newMemory, oldPtr, oldSize);
-    HUFFMAN_MFREE(oldPtr);
-  }
-
-  return newMemory;
-}
-
-// ========================================================
-// class BitStreamReader:
-// ========================================================
-
-BitStreamReader::BitStreamReader(const BitStreamWriter &bitStreamWriter)
-    : stream(bitStreamWriter.getBitStream()),
-      sizeInBytes(bitStreamWriter.getByteCount()),
-      sizeInBits(bitStreamWriter.getBitCount())
-{
-  reset();
-}
-
-BitStreamReader::BitStreamReader(const std::uint8_t *bitStream,
-                                 const int byteCount, const int bitCount)
-    : stream(bitStream), sizeInBytes(byteCount), sizeInBits(bitCount)
-{
-  reset();
-}
-
-bool BitStreamReader::readNextBit()
-{
-  if (numBitsRead > 45000000)
-    // std::cout << numBitsRead << "\t" << sizeInBits << std::endl;
-    if (numBitsRead >= sizeInBits) {
-      return false;  // We are done.
-    }
-
-  const std::uint32_t mask = std::uint32_t(1) << nextBitPos;
-  const int bit = !!(stream[currBytePos] & mask);
-  auto prevNumBitsRead = numBitsRead;
-  ++numBitsRead;
-  if (numBitsRead < prevNumBitsRead) std::cout << "ERROR, ERROR!" << std::endl;
-
-  if (++nextBitPos == 8) {
-    nextBitPos = 0;
-    ++currBytePos;
-  }
-
-  currCode.appendBit(bit);
-  return true;
-}
-
-std::uint64_t BitStreamReader::readBitsU64(const int bitCount)
-{
-  assert(bitCount <= 64);
-
-  // We can reuse the Code reading infrastructure for this.
-  // This is arguably a little hackish, but gets the job done...
-  currCode.clear();
-  for (int b = 0; b < bitCount; ++b) {
-    if (!readNextBit()) {
-      HUFFMAN_ERROR("Failed to read bits from stream! Unexpected end.");
-      break;
-    }
-  }
-  return currCode.getAsU64();
-}
-
-void BitStreamReader::reset()
-{
-  currBytePos = 0;
-  nextBitPos = 0;
-  numBitsRead = 0;
-  currCode.clear();
-}
-
 // ========================================================
 // class Encoder:
 // ========================================================
 
-Encoder::Encoder(const std::uint8_t *data, const int dataSizeBytes,
+Encoder::Encoder(const std::uint8_t *data, const std::uint64_t dataSizeBytes,
                  const bool prependTreeToBitStream)
     : treeRoot(nullptr), treePrefixBits(0)
 {
   countFrequencies(data, dataSizeBytes);
   buildHuffmanTree();
 
+  // The exact output size is known once the codes are assigned, so the
+  // stream is allocated once up-front instead of growing while appending.
+  bitStream.allocate(worstCaseBitCount(prependTreeToBitStream));
+
   if (prependTreeToBitStream) {
     writeTreeBitStream();
   }
@@ -540,7 +281,7 @@ void Encoder::buildHuffmanTree()
   recursiveAssignCodes(treeRoot, nullptr, 0);
 }
 
-Node *Encoder::addInnerNode(const int frequency, const int leftChild,
+Node *Encoder::addInnerNode(const std::int64_t frequency, const int leftChild,
                             const int rightChild)
 {
   // Find a free slot:
@@ -582,7 +323,8 @@ void Encoder::recursiveAssignCodes(Node *node, const Node *parent,
   }
 }
 
-void Encoder::countFrequencies(const std::uint8_t *data, int dataSizeBytes)
+void Encoder::countFrequencies(const std::uint8_t *data,
+                               std::uint64_t dataSizeBytes)
 {
   for (; dataSizeBytes > 0; --dataSizeBytes, ++data) {
     // We'll use the value of each byte as the symbol index, since our table has
@@ -600,16 +342,49 @@ void Encoder::countFrequencies(const std::uint8_t *data, int dataSizeBytes)
   }
 }
 
-void Encoder::writeDataBitStream(const std::uint8_t *data, int dataSizeBytes)
+void Encoder::writeDataBitStream(const std::uint8_t *data,
+                                 std::uint64_t dataSizeBytes)
 {
+  // Copy the leaf codes into flat tables so the hot loop only touches two
+  // small arrays instead of the larger Node structures.
+  std::array<std::uint64_t, MaxSymbols> codeBits;
+  std::array<int, MaxSymbols> codeLengths;
+  for (int s = 0; s < MaxSymbols; ++s) {
+    codeBits[s] = nodes[s].code.getAsU64();
+    codeLengths[s] = nodes[s].code.getLength();
+  }
+
   for (; dataSizeBytes > 0; --dataSizeBytes, ++data) {
     // We can index the nodes directly from each byte of data
     // since the first 256 slots are reserved for the symbols,
     // so Node::value is the same as its index in th array for
     // the first 256 leaf nodes.
     const int nodeIndex = *data;
-    bitStream.appendCode(nodes[nodeIndex].code);
+    bitStream.appendBitsU64(codeBits[nodeIndex], codeLengths[nodeIndex]);
+  }
+}
+
+std::uint64_t Encoder::worstCaseBitCount(
+    const bool prependTreeToBitStream) const
+{
+  // Data bits: every occurrence of a symbol costs its code length
+  std::uint64_t bits = 0;
+  int maxCodeLengthInBits = 0;
+  for (int s = 0; s < MaxSymbols; ++s) {
+    if (nodes[s].isValid()) {
+      const int codeLen = nodes[s].code.getLength();
+      bits += static_cast<std::uint64_t>(nodes[s].frequency) * codeLen;
+      maxCodeLengthInBits = std::max(maxCodeLengthInBits, codeLen);
+    }
+  }
+
+  // Tree prefix: two 16-bit counts, then a length field and code per symbol
+  if (prependTreeToBitStream) {
+    bits += 32 + 7;
+    bits += static_cast<std::uint64_t>(MaxSymbols) *
+            (bitsForInteger(maxCodeLengthInBits) + maxCodeLengthInBits);
   }
+  return bits;
 }
 
 void Encoder::writeTreeBitStream()
@@ -723,8 +498,9 @@ Decoder::Decoder(const BitStreamWriter &encodedBitStream)
   readPrefixData();
 }
 
-Decoder::Decoder(const std::uint8_t *encodedData, const int encodedSizeBytes,
-                 const int encodedSizeBits)
+Decoder::Decoder(const std::uint8_t *encodedData,
+                 const std::uint64_t encodedSizeBytes,
+                 const std::uint64_t encodedSizeBits)
     : bitStream(encodedData, encodedSizeBytes, encodedSizeBits)
 {
   readPrefixData();
@@ -749,41 +525,21 @@ void Decoder::readPrefixData()
     //
     // Read the code_length field, fixed bit-width:
     //
-    bitStream.clearCode();
-    for (std::uint64_t l = 0; l < codeLengthWidth; ++l) {
-      if (!bitStream.readNextBit()) {
-        HUFFMAN_ERROR(
-            "Failed to read code length from stream! Unexpected end.");
-        return;
-      }
-    }
+    const std::uint64_t codeBitsWidth = bitStream.readBitsU64(codeLengthWidth);
     treePrefixBits += codeLengthWidth;
-    const std::uint64_t codeBitsWidth = bitStream.getCode().getAsU64();
     assert(codeBitsWidth <= Code::MaxBits);
 
     //
     // Now read the code bits using the just acquired length:
     //
-    bitStream.clearCode();
-    for (std::uint64_t l = 0; l < codeBitsWidth; ++l) {
-      if (!bitStream.readNextBit()) {
-        HUFFMAN_ERROR("Failed to read code bits from stream! Unexpected end.");
-        return;
-      }
-    }
+    codes[c].setAsU64(bitStream.readBitsU64(codeBitsWidth));
+    codes[c].setLength(codeBitsWidth);
     treePrefixBits += codeBitsWidth;
-
-    // Store the new code:
-    codes[c] = bitStream.getCode();
   }
 
   // There might be some padding left that must be skipped:
-  bitStream.clearCode();
-  while ((treePrefixBits % 8) != 0) {
-    bitStream.readNextBit();
-    ++treePrefixBits;
-  }
-  bitStream.clearCode();
+  bitStream.readBitsU64((8 - (treePrefixBits % 8)) % 8);
+  currCode.clear();
 
   // Populate codes_maps
   // codes_maps does not replace codes and instead is only used in
@@ -794,6 +550,29 @@ void Decoder::readPrefixData()
       codes_maps.insert({codes[i], i});
     }
   }
+  buildDecodeTable();
+}
+
+void Decoder::buildDecodeTable()
+{
+  // Codes are read LSB-first, so every index whose low bits are a code maps
+  // to it. The shortest code wins, as when matching bit by bit.
+  decodeTable.assign(std::size_t(1) << DecodeTableBits, 0);
+  for (int s = 0; s < MaxSymbols; ++s) {
+    const int length = codes[s].getLength();
+    if (length == 0 || length > DecodeTableBits) {
+      continue;
+    }
+    const std::uint32_t entry = (std::uint32_t(length) << 16) | s;
+    const std::uint64_t code = codes[s].getAsU64();
+    for (std::uint64_t high = 0; high < (std::uint64_t(1) << DecodeTableBits);
+         high += std::uint64_t(1) << length) {
+      auto &slot = decodeTable[high | code];
+      if (slot == 0 || int(slot >> 16) > length) {
+        slot = entry;
+      }
+    }
+  }
 }
 
 int Decoder::findMatchingCode(const Code code) const
@@ -805,37 +584,50 @@ int Decoder::findMatchingCode(const Code code) const
     return it_map->second;
 }
 
-int Decoder::decode(std::uint8_t *data, const int dataSizeBytes)
+int Decoder::decodeSlow()
+{
+  // Codes longer than the table are matched bit by bit
+  currCode.clear();
+  int bit;
+  while (bitStream.readNextBit(bit)) {
+    currCode.appendBit(bit);
+    const int codeIndex = findMatchingCode(currCode);
+    if (codeIndex != Nil) {
+      return codeIndex;
+    }
+  }
+  return Nil;
+}
+
+std::uint64_t Decoder::decode(std::uint8_t *data,
+                              const std::uint64_t dataSizeBytes)
 {
   assert(data != nullptr);
   assert(dataSizeBytes != 0);
 
-  int bytesDecoded = 0;
-  while (bitStream.readNextBit() && bytesDecoded < dataSizeBytes) {
-    // See if the current code is valid:
-    if (bytesDecoded == 8388607) {
-      auto i = 0;
-    }
-    const int codeIndex = findMatchingCode(bitStream.getCode());
-    if (codeIndex == Nil) {
-      continue;
-    }
-
-    if (bytesDecoded == dataSizeBytes) {
-      // HUFFMAN_ERROR("Decoder output buffer too small!");
-      std::cout << "Decoder output buffer too small: " << bytesDecoded << "\t"
-                << bitStream.getBitCount() << "\t" << bitStream.getByteCount()
-                << std::endl;
-      // break;
+  std::uint64_t bytesDecoded = 0;
+  while (bytesDecoded < dataSizeBytes && !bitStream.isEndOfStream()) {
+    const std::uint32_t entry =
+        decodeTable[bitStream.peekBits(DecodeTableBits)];
+    const int length = entry >> 16;
+    int codeIndex;
+    if (length != 0) {
+      // The bits past the end of the stream read as zero, so a code may only
+      // match with them
+      if (bitStream.getBitsRead() + length > bitStream.getBitCount()) {
+        break;
+      }
+      bitStream.skipBits(length);
+      codeIndex = entry & 0xFFFF;
+    } else {
+      codeIndex = decodeSlow();
+      if (codeIndex == Nil) {
+        break;
+      }
     }
 
-    if (bytesDecoded < dataSizeBytes)
-      *data++ = static_cast<std::uint8_t>(codeIndex);
-    // else
-    //   std::cout << bytesDecoded << std::endl;
+    *data++ = static_cast<std::uint8_t>(codeIndex);
     ++bytesDecoded;
-
-    bitStream.clearCode();
   }
 
   return bytesDecoded;
@@ -845,16 +637,26 @@ int Decoder::decode(std::uint8_t *data, const int dataSizeBytes)
 // easyEncode() implementation:
 // ========================================================
 
+std::uint64_t maxCompressedSize(const std::uint64_t uncompressedSizeBytes)
+{
+  // Tree prefix with every code as long as a Code can hold, padded to a byte
+  const std::uint64_t treeBits =
+      32 + static_cast<std::uint64_t>(MaxSymbols) *
+               (bitsForInteger(Code::MaxBits) + Code::MaxBits);
+  return (treeBits + 7) / 8 + (uncompressedSizeBytes * 9 + 7) / 8;
+}
+
 void easyEncode(const std::uint8_t *uncompressed,
-                const int uncompressedSizeBytes, std::uint8_t **compressed,
-                int *compressedSizeBytes, int *compressedSizeBits)
+                const std::uint64_t uncompressedSizeBytes,
+                std::uint8_t **compressed, std::uint64_t *compressedSizeBytes,
+                std::uint64_t *compressedSizeBits)
 {
   if (uncompressed == nullptr || compressed == nullptr) {
     HUFFMAN_ERROR("huffman::easyEncode(): Null data pointer(s)!");
     return;
   }
 
-  if (uncompressedSizeBytes <= 0 || compressedSizeBytes == nullptr ||
+  if (uncompressedSizeBytes == 0 || compressedSizeBytes == nullptr ||
       compressedSizeBits == nullptr) {
     HUFFMAN_ERROR("huffman::easyEncode(): Bad in/out sizes!");
     return;
@@ -874,17 +676,19 @@ void easyEncode(const std::uint8_t *uncompressed,
 // easyDecode() implementation:
 // ========================================================
 
-int easyDecode(const std::uint8_t *compressed, const int compressedSizeBytes,
-               const int compressedSizeBits, std::uint8_t *uncompressed,
-               const int uncompressedSizeBytes)
+std::uint64_t easyDecode(const std::uint8_t *compressed,
+                         const std::uint64_t compressedSizeBytes,
+                         const std::uint64_t compressedSizeBits,
+                         std::uint8_t *uncompressed,
+                         const std::uint64_t uncompressedSizeBytes)
 {
   if (compressed == nullptr || uncompressed == nullptr) {
     HUFFMAN_ERROR("huffman::easyDecode(): Null data pointer(s)!");
     return 0;
   }
 
-  if (compressedSizeBytes <= 0 || compressedSizeBits <= 0 ||
-      uncompressedSizeBytes <= 0) {
+  if (compressedSizeBytes == 0 || compressedSizeBits == 0 ||
+      uncompressedSizeBytes == 0) {
     HUFFMAN_ERROR("huffman::easyDecode(): Bad in/out sizes!");
     return 0;
   }
@@ -0,0 +1,115 @@
+/**
+ * @file lz77_decoder.cpp
+ * @author Conrad Haupt (conrad@conradhaupt.co.za)
+ * @brief Single-pass decoding of yalz77 streams into a caller buffer
+ * @version 1.0
+ * @date 2020-03-17
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#include "lz77_decoder.h"
+#include <cstring>
+
+namespace lz77 {
+namespace {
+
+[[noreturn]] void malformed()
+{
+  throw std::runtime_error("Malformed data while uncompressing");
+}
+
+std::uint64_t readVlq(const std::uint8_t*& in, const std::uint8_t* end)
+{
+  std::uint64_t value = 0;
+  for (int shift = 0;; shift += 7) {
+    if (in == end || shift > 63) malformed();
+    const auto byte = *in++;
+    value |= std::uint64_t(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) return value;
+  }
+}
+
+// Copy length bytes from offset bytes back, where the two may overlap. out
+// has room up to end, and bytes past length may be overwritten when there is
+// slack for it.
+inline void copyMatch(std::uint8_t* out, std::uint64_t offset,
+                      std::uint64_t length, const std::uint8_t* end)
+{
+  if (offset == 1) {
+    std::memset(out, out[-1], length);
+    return;
+  }
+  // Copying a whole period at a time doubles the distance the next copy can
+  // reach back while keeping source and destination apart.
+  while (offset < 8 && length > offset) {
+    std::memcpy(out, out - offset, offset);
+    out += offset;
+    length -= offset;
+    offset <<= 1;
+  }
+  if (length <= offset) {
+    std::memcpy(out, out - offset, length);
+    return;
+  }
+  const std::uint64_t step = offset >= 16 ? 16 : 8;
+  std::uint64_t i = 0;
+  if (std::uint64_t(end - out) >= length + step) {
+    for (; i < length; i += step) std::memcpy(out + i, out + i - offset, step);
+    return;
+  }
+  for (; i + step <= length; i += step)
+    std::memcpy(out + i, out + i - offset, step);
+  std::memcpy(out + i, out + i - offset, length - i);
+}
+
+}  // namespace
+
+unsigned long long decodedSizeBytes(const std::uint8_t* compressed,
+                                    unsigned long long compressedSizeBytes)
+{
+  return readVlq(compressed, compressed + compressedSizeBytes);
+}
+
+unsigned long long decode(const std::uint8_t* compressed,
+                          unsigned long long compressedSizeBytes,
+                          std::uint8_t* uncompressed,
+                          unsigned long long uncompressedSizeBytes)
+{
+  auto in = compressed;
+  const auto inEnd = compressed + compressedSizeBytes;
+  const auto size = readVlq(in, inEnd);
+  if (size > uncompressedSizeBytes)
+    throw std::runtime_error("LZ77 output buffer is too small");
+
+  auto out = uncompressed;
+  const auto outEnd = uncompressed + size;
+  const auto bufferEnd = uncompressed + uncompressedSizeBytes;
+  while (out != outEnd) {
+    auto message = readVlq(in, inEnd);
+    const bool isLiteral = message & 1;
+    message >>= 1;
+    if (isLiteral) {
+      if (message > std::uint64_t(inEnd - in) ||
+          message > std::uint64_t(outEnd - out))
+        malformed();
+      std::memcpy(out, in, message);
+      in += message;
+      out += message;
+      continue;
+    }
+    std::uint64_t run = message & (SHORTRUN_MAX - 1);
+    if (run == 0) run = readVlq(in, inEnd);
+    const auto offset = message >> SHORTRUN_BITS;
+    const auto length = run + MIN_RUN - 1;
+    const auto remaining = std::uint64_t(outEnd - out);
+    if (offset == 0 || offset > std::uint64_t(out - uncompressed) ||
+        run > remaining || length > remaining)
+      malformed();
+    copyMatch(out, offset, length, bufferEnd);
+    out += length;
+  }
+  return size;
+}
+
+}  // namespace lz77
@@ -0,0 +1,447 @@
+/**
+ * @file lz77_encoder.cpp
+ * @author Conrad Haupt (conrad@conradhaupt.co.za)
+ * @brief Levelled LZ77 match finder writing the yalz77 stream format
+ * @version 1.0
+ * @date 2020-03-16
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#include "lz77_encoder.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace lz77 {
+namespace {
+
+// Shortest match the stream can hold and the number of bytes read to hash a
+// position. Positions closer than HashReadBytes to the end are never looked
+// up, although matches found earlier may run to the end.
+constexpr std::uint64_t MinMatch = MIN_RUN;
+constexpr std::uint64_t HashReadBytes = 8;
+// Table entries are 32-bit offsets from the start of a segment. The tables are
+// cleared at the start of each segment, so matches do not reach into an
+// earlier one.
+constexpr std::uint64_t SegmentBytes = 1ULL << 30;
+constexpr std::uint32_t Empty = std::numeric_limits<std::uint32_t>::max();
+// Level 1 advances faster through data without matches, one extra byte per
+// 2^SkipShift failed searches.
+constexpr int SkipShift = 6;
+// Positions priced together by the optimal parser
+constexpr std::uint64_t OptimalChunkBytes = 1ULL << 16;
+
+enum class Parser
+{
+  GREEDY,
+  LAZY,
+  OPTIMAL
+};
+
+struct LevelParameters
+{
+  int hashLog;
+  int chainLog;  // Zero for a single probe of the hash table
+  int searchDepth;
+  std::uint64_t niceLength;  // Searching stops at a match this long
+  Parser parser;
+};
+
+constexpr LevelParameters Levels[MaxLevel] = {
+    {16, 0, 1, 32, Parser::GREEDY},      {17, 18, 4, 64, Parser::GREEDY},
+    {17, 19, 8, 64, Parser::GREEDY},     {18, 20, 16, 128, Parser::GREEDY},
+    {18, 20, 16, 128, Parser::LAZY},     {18, 20, 4, 32, Parser::OPTIMAL},
+    {18, 21, 8, 64, Parser::OPTIMAL},    {18, 22, 32, 128, Parser::OPTIMAL},
+    {18, 22, 128, 256, Parser::OPTIMAL},
+};
+
+inline int vlqLength(std::uint64_t value)
+{
+  int length = 1;
+  while (value >>= 7) length++;
+  return length;
+}
+
+// Bytes taken by a match token, see compress_t::feed()
+inline std::uint64_t tokenCost(std::uint64_t length, std::uint64_t offset)
+{
+  const auto run = length - MinMatch + 1;
+  if (run < SHORTRUN_MAX)
+    return vlqLength(((offset << SHORTRUN_BITS) | run) << 1);
+  return vlqLength(offset << (SHORTRUN_BITS + 1)) + vlqLength(run);
+}
+
+inline std::uint64_t readU64(const std::uint8_t* data)
+{
+  std::uint64_t value;
+  std::memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+// Number of equal bytes at current and reference, stopping at end. The
+// reference is earlier in the data, so only current is bounded.
+inline std::uint64_t matchLength(const std::uint8_t* current,
+                                 const std::uint8_t* reference,
+                                 const std::uint8_t* end)
+{
+  const auto start = current;
+#ifdef __SSE2__
+  while (end - current >= 16) {
+    const auto a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(current));
+    const auto b =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(reference));
+    const unsigned differ = _mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) ^ 0xFFFFU;
+    if (differ != 0) return (current - start) + __builtin_ctz(differ);
+    current += 16;
+    reference += 16;
+  }
+#endif
+  while (end - current >= 8) {
+    const auto differ = readU64(current) ^ readU64(reference);
+    if (differ != 0) {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+      return (current - start) + (__builtin_clzll(differ) >> 3);
+#else
+      return (current - start) + (__builtin_ctzll(differ) >> 3);
+#endif
+    }
+    current += 8;
+    reference += 8;
+  }
+  while (current < end && *current == *reference) {
+    current++;
+    reference++;
+  }
+  return current - start;
+}
+
+// Hash table of the most recent position for each 5-byte prefix, optionally
+// chained to earlier positions with the same hash within a window.
+class MatchFinder
+{
+ public:
+  MatchFinder(const std::uint8_t* data, std::uint64_t length,
+              const LevelParameters& params)
+      : data(data),
+        length(length),
+        hashLog(params.hashLog),
+        searchDepth(params.searchDepth),
+        head(std::size_t(1) << params.hashLog, Empty),
+        chain(params.chainLog ? std::size_t(1) << params.chainLog : 0, Empty),
+        windowBytes(1ULL << params.chainLog)
+  {}
+
+  bool canMatch(std::uint64_t pos) const
+  {
+    return pos + HashReadBytes <= length;
+  }
+
+  // Start a new segment if pos is too far from the current one
+  void rebase(std::uint64_t pos)
+  {
+    if (pos - base < SegmentBytes) return;
+    base = next = pos;
+    std::fill(std::begin(head), std::end(head), Empty);
+    std::fill(std::begin(chain), std::end(chain), Empty);
+  }
+
+  // Add every position before pos that has not been added yet
+  void insertUpTo(std::uint64_t pos)
+  {
+    for (; next < pos && canMatch(next); next++) insert(next);
+    next = std::max(next, pos);
+  }
+
+  // Leave the positions before pos out of the tables
+  void skipTo(std::uint64_t pos) { next = std::max(next, pos); }
+
+  // Call visit(reference) for earlier positions that may match pos, nearest
+  // first, until it returns false. pos is added to the tables afterwards.
+  template <class Visit>
+  void visitCandidates(std::uint64_t pos, Visit&& visit)
+  {
+    insertUpTo(pos);
+    const auto slot = hash(pos);
+    auto candidate = head[slot];
+    for (int depth = searchDepth; candidate != Empty && depth > 0; depth--) {
+      // Every stored position is a valid reference, but the chain link of one
+      // outside the window may have been overwritten.
+      const auto reference = base + candidate;
+      if (!visit(reference) || pos - reference >= windowBytes) break;
+      candidate = chain.empty() ? Empty : chain[candidate & chainMask()];
+    }
+    insert(pos);
+    next = pos + 1;
+  }
+
+ private:
+  std::uint32_t hash(std::uint64_t pos) const
+  {
+    // Multiplicative hash of the 5 bytes at pos
+    constexpr std::uint64_t Prime5Bytes = 889523592379ULL;
+    return std::uint32_t(((readU64(data + pos) << 24) * Prime5Bytes) >>
+                         (64 - hashLog));
+  }
+  std::uint64_t chainMask() const { return chain.size() - 1; }
+  void insert(std::uint64_t pos)
+  {
+    const auto slot = hash(pos);
+    const auto offset = std::uint32_t(pos - base);
+    if (!chain.empty()) chain[offset & chainMask()] = head[slot];
+    head[slot] = offset;
+  }
+
+  const std::uint8_t* data;
+  std::uint64_t length;
+  int hashLog;
+  int searchDepth;
+  std::vector<std::uint32_t> head;
+  std::vector<std::uint32_t> chain;
+  std::uint64_t windowBytes;
+  std::uint64_t base = 0;
+  std::uint64_t next = 0;
+};
+
+// Writes literal packets and match tokens, see compress_t::feed()
+class TokenWriter
+{
+ public:
+  explicit TokenWriter(std::uint8_t* out) : start(out), out(out) {}
+
+  void vlq(std::uint64_t value)
+  {
+    while (value > 0x7F) {
+      *out++ = std::uint8_t(value | 0x80);
+      value >>= 7;
+    }
+    *out++ = std::uint8_t(value);
+  }
+  void literals(const std::uint8_t* from, std::uint64_t count)
+  {
+    if (count == 0) return;
+    vlq((count << 1) | 1);
+    std::memcpy(out, from, count);
+    out += count;
+  }
+  void match(std::uint64_t length, std::uint64_t offset)
+  {
+    const auto run = length - MinMatch + 1;
+    if (run < SHORTRUN_MAX) {
+      vlq(((offset << SHORTRUN_BITS) | run) << 1);
+    } else {
+      vlq(offset << (SHORTRUN_BITS + 1));
+      vlq(run);
+    }
+  }
+  std::uint64_t size() const { return out - start; }
+
+ private:
+  std::uint8_t* start;
+  std::uint8_t* out;
+};
+
+struct Match
+{
+  std::uint64_t length = 0;
+  std::uint64_t offset = 0;
+  std::int64_t gain = 0;  // Bytes saved over literals, positive if found
+};
+
+Match findBestMatch(MatchFinder& finder, const std::uint8_t* data,
+                    std::uint64_t length, std::uint64_t pos,
+                    std::uint64_t niceLength)
+{
+  Match best;
+  const auto current = data + pos;
+  const auto end = data + length;
+  finder.visitCandidates(pos, [&](std::uint64_t reference) {
+    const auto ref = data + reference;
+    // Only a longer match can have a larger gain from further away
+    if (best.length != 0 && (current + best.length >= end ||
+                             ref[best.length] != current[best.length]))
+      return true;
+    const auto matched = matchLength(current, ref, end);
+    if (matched < MinMatch || matched <= best.length) return true;
+    const auto gain = std::int64_t(matched) -
+                      std::int64_t(tokenCost(matched, pos - reference));
+    if (gain > best.gain) best = {matched, pos - reference, gain};
+    return matched < niceLength;
+  });
+  return best;
+}
+
+// Levels 1-5: take the best match at each position, or with lazy parsing at
+// the first of a run of positions whose best match does not improve.
+void parseGreedy(const std::uint8_t* data, std::uint64_t length,
+                 const LevelParameters& params, TokenWriter& writer)
+{
+  MatchFinder finder(data, length, params);
+  const bool singleProbe = params.chainLog == 0;
+  std::uint64_t anchor = 0;  // Start of the pending literals
+  std::uint64_t pos = 0;
+  while (finder.canMatch(pos)) {
+    finder.rebase(pos);
+    if (singleProbe) finder.skipTo(pos);
+    auto match = findBestMatch(finder, data, length, pos, params.niceLength);
+    if (match.gain <= 0) {
+      pos += singleProbe ? 1 + ((pos - anchor) >> SkipShift) : 1;
+      continue;
+    }
+    if (params.parser == Parser::LAZY) {
+      while (match.length < params.niceLength && finder.canMatch(pos + 1)) {
+        const auto next =
+            findBestMatch(finder, data, length, pos + 1, params.niceLength);
+        // Deferring writes a literal and may start a literal packet
+        if (next.gain <= match.gain + 2) break;
+        match = next;
+        pos++;
+      }
+    }
+    writer.literals(data + anchor, pos - anchor);
+    writer.match(match.length, match.offset);
+    pos += match.length;
+    anchor = pos;
+    if (singleProbe)
+      finder.skipTo(pos);
+    else
+      finder.insertUpTo(pos);
+  }
+  writer.literals(data + anchor, length - anchor);
+}
+
+// Levels 6-9: price every match length from every position of a chunk and keep
+// the cheapest encoding of the chunk. Starting a literal packet costs a byte
+// more than continuing one, so each position has a cheapest arrival by a
+// literal and by a match.
+void parseOptimal(const std::uint8_t* data, std::uint64_t length,
+                  const LevelParameters& params, TokenWriter& writer)
+{
+  enum
+  {
+    LITERAL = 0,
+    MATCH = 1
+  };
+  struct Arrival
+  {
+    std::uint64_t price;
+    std::uint32_t length;  // One for a literal
+    std::uint32_t offset;
+    std::uint8_t from;  // State at the start of the step
+  };
+  constexpr auto Unreached = std::numeric_limits<std::uint64_t>::max();
+
+  MatchFinder finder(data, length, params);
+  std::vector<Arrival> arrivals[2];
+  std::vector<Arrival> steps;
+  std::uint64_t anchor = 0;
+  for (std::uint64_t chunk = 0; chunk < length;) {
+    finder.rebase(chunk);
+    const auto chunkLength = std::min(OptimalChunkBytes, length - chunk);
+    for (auto& states : arrivals)
+      states.assign(chunkLength + 1, {Unreached, 0, 0, 0});
+    // Literals left over from the previous chunk continue their packet
+    arrivals[anchor < chunk ? LITERAL : MATCH][0].price = 0;
+
+    std::uint64_t searchFrom = 0;
+    for (std::uint64_t i = 0; i < chunkLength; i++) {
+      const auto& atLiteral = arrivals[LITERAL][i];
+      const auto& atMatch = arrivals[MATCH][i];
+      const auto fromState = atLiteral.price <= atMatch.price ? LITERAL : MATCH;
+      const auto price = std::min(atLiteral.price, atMatch.price);
+
+      const auto continuePrice =
+          atLiteral.price == Unreached ? Unreached : atLiteral.price + 1;
+      const auto startPrice =
+          atMatch.price == Unreached ? Unreached : atMatch.price + 2;
+      arrivals[LITERAL][i + 1] =
+          continuePrice <= startPrice
+              ? Arrival{continuePrice, 1, 0, LITERAL}
+              : Arrival{startPrice, 1, 0, MATCH};
+
+      const auto pos = chunk + i;
+      // Positions inside a match of niceLength or more are not searched
+      if (i < searchFrom || !finder.canMatch(pos)) continue;
+      const auto current = data + pos;
+      const auto end = current + (chunkLength - i);
+      std::uint64_t longest = MinMatch - 1;
+      finder.visitCandidates(pos, [&](std::uint64_t reference) {
+        const auto matched = matchLength(current, data + reference, end);
+        const auto offset = pos - reference;
+        for (auto run = longest + 1; run <= matched; run++) {
+          const auto cost = tokenCost(run, offset);
+          if (cost >= run) continue;
+          auto& arrival = arrivals[MATCH][i + run];
+          if (price + cost < arrival.price)
+            arrival = {price + cost, std::uint32_t(run), std::uint32_t(offset),
+                       std::uint8_t(fromState)};
+        }
+        longest = std::max(longest, matched);
+        return matched < params.niceLength;
+      });
+      if (longest >= params.niceLength) searchFrom = i + longest;
+    }
+
+    // Walk back from the cheaper final state and write the steps in order
+    steps.clear();
+    int state = arrivals[LITERAL][chunkLength].price <=
+                        arrivals[MATCH][chunkLength].price
+                    ? LITERAL
+                    : MATCH;
+    for (auto i = chunkLength; i > 0;) {
+      const auto& step = arrivals[state][i];
+      steps.push_back(step);
+      i -= step.length;
+      state = step.from;
+    }
+    auto pos = chunk;
+    for (auto step = steps.rbegin(); step != steps.rend(); ++step) {
+      if (step->offset != 0) {
+        writer.literals(data + anchor, pos - anchor);
+        writer.match(step->length, step->offset);
+        anchor = pos + step->length;
+      }
+      pos += step->length;
+    }
+    finder.insertUpTo(chunk + chunkLength);
+    chunk += chunkLength;
+  }
+  writer.literals(data + anchor, length - anchor);
+}
+
+}  // namespace
+
+unsigned long long maxCompressedSize(unsigned long long length)
+{
+  // Every match saves at least a byte, which pays for the header of the
+  // literal packet before it if that is shorter than 64 bytes. Longer packets
+  // cost at most a byte for every 64 literals, and the last packet and the
+  // length need at most 10 bytes each.
+  return length + length / 64 + 32;
+}
+
+unsigned long long encode(const std::uint8_t* uncompressed,
+                          unsigned long long length, std::uint8_t* compressed,
+                          int level)
+{
+  if (level < MinLevel || level > MaxLevel)
+    throw std::invalid_argument("LZ77 level must be between " +
+                                std::to_string(MinLevel) + " and " +
+                                std::to_string(MaxLevel));
+  TokenWriter writer(compressed);
+  writer.vlq(length);
+  const auto& params = Levels[level - 1];
+  if (params.parser == Parser::OPTIMAL)
+    parseOptimal(uncompressed, length, params, writer);
+  else
+    parseGreedy(uncompressed, length, params, writer);
+  return writer.size();
+}
+
+}  // namespace lz77
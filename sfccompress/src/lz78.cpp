@@ -0,0 +1,196 @@
+/**
+ * @file lz78.cpp
+ * @author Conrad Haupt (conrad@conradhaupt.co.za)
+ * @brief LZ78 coding with a flat trie dictionary
+ * @version 1.0
+ * @date 2020-03-18
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#include "lz78.h"
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+namespace lz78 {
+
+namespace {
+// Stream layout: byte count, dictionary width, then an (index, byte) pair for
+// every phrase. The last phrase may end on an existing entry, in which case it
+// is written as that entry's parent and final byte.
+constexpr int ByteCountBits = 64;
+constexpr int DictBitsBits = 5;
+constexpr int ByteBits = 8;
+
+// Bits needed for an index into a dictionary of size entries
+int indexBits(std::uint32_t size)
+{
+  int bits = 0;
+  while ((std::uint64_t(1) << bits) < size) bits++;
+  return bits;
+}
+
+// Every phrase holds at least one byte
+unsigned long long maxCompressedSizeBits(const unsigned long long nbytes,
+                                         const int maxDictBits)
+{
+  return ByteCountBits + DictBitsBits + nbytes * (maxDictBits + ByteBits);
+}
+}  // namespace
+
+Trie::Trie(const int maxDictBits)
+    : maxDictBits(maxDictBits),
+      rootChildren(256, Nil),
+      keys(std::size_t(2) << maxDictBits, Nil),
+      children(std::size_t(2) << maxDictBits),
+      slotMask((std::uint32_t(2) << maxDictBits) - 1)
+{
+  if (maxDictBits < MinDictBits || maxDictBits > MaxDictBits)
+    throw std::invalid_argument("LZ78 dictionary width must be between " +
+                                std::to_string(MinDictBits) + " and " +
+                                std::to_string(MaxDictBits) + " bits");
+  nodes = 1;
+}
+
+std::uint32_t Trie::slotOf(const std::uint32_t node,
+                           const std::uint8_t byte) const
+{
+  // Fibonacci hashing of the edge
+  const std::uint32_t key = (node << 8) | byte;
+  return (key * 2654435761U) >> (32 - (maxDictBits + 1));
+}
+
+std::uint32_t Trie::child(const std::uint32_t node,
+                          const std::uint8_t byte) const
+{
+  if (node == Root) return rootChildren[byte];
+  const std::uint32_t key = (node << 8) | byte;
+  for (auto slot = slotOf(node, byte);; slot = (slot + 1) & slotMask) {
+    if (keys[slot] == key) return children[slot];
+    if (keys[slot] == Nil) return Nil;
+  }
+}
+
+bool Trie::add(const std::uint32_t node, const std::uint8_t byte)
+{
+  if (node == Root) {
+    rootChildren[byte] = nodes;
+  } else {
+    auto slot = slotOf(node, byte);
+    while (keys[slot] != Nil) slot = (slot + 1) & slotMask;
+    keys[slot] = (node << 8) | byte;
+    children[slot] = nodes;
+  }
+  return ++nodes == (std::uint32_t(1) << maxDictBits);
+}
+
+void Trie::clear()
+{
+  nodes = 1;
+  std::fill(std::begin(rootChildren), std::end(rootChildren), Nil);
+  std::fill(std::begin(keys), std::end(keys), Nil);
+}
+
+unsigned long long maxCompressedSize(const unsigned long long nbytes,
+                                     const int maxDictBits)
+{
+  return (maxCompressedSizeBits(nbytes, maxDictBits) + 7) / 8;
+}
+
+std::tuple<std::unique_ptr<std::uint8_t[]>, unsigned long long> easyEncode(
+    const std::uint8_t* uncompressed, const unsigned long long nbytes,
+    const int maxDictBits)
+{
+  Trie trie(maxDictBits);
+  sfcc::BitStreamWriter writer(maxCompressedSizeBits(nbytes, maxDictBits));
+  writer.appendBitsU64(nbytes, ByteCountBits);
+  writer.appendBitsU64(maxDictBits, DictBitsBits);
+
+  auto node = Trie::Root;
+  auto parent = Trie::Root;
+  std::uint8_t last = 0;
+  for (auto i = 0ULL; i < nbytes; i++) {
+    const auto byte = uncompressed[i];
+    const auto next = trie.child(node, byte);
+    if (next != Trie::Nil) {
+      parent = node;
+      last = byte;
+      node = next;
+      continue;
+    }
+    writer.appendBitsU64(node, indexBits(trie.size()));
+    writer.appendBitsU64(byte, ByteBits);
+    if (trie.add(node, byte)) trie.clear();
+    node = Trie::Root;
+  }
+  if (node != Trie::Root) {
+    writer.appendBitsU64(parent, indexBits(trie.size()));
+    writer.appendBitsU64(last, ByteBits);
+  }
+
+  const unsigned long long compressedSizeBytes = writer.getByteCount();
+  return {std::unique_ptr<std::uint8_t[]>(writer.release()),
+          compressedSizeBytes};
+}
+
+unsigned long long decodedSizeBytes(
+    const std::uint8_t* compressed,
+    const unsigned long long compressedSizeBytes)
+{
+  sfcc::BitStreamReader reader(compressed, compressedSizeBytes,
+                               compressedSizeBytes * 8);
+  return reader.readBitsU64(ByteCountBits);
+}
+
+unsigned long long easyDecode(const std::uint8_t* compressed,
+                              const unsigned long long compressedSizeBytes,
+                              std::uint8_t* uncompressed,
+                              const unsigned long long uncompressedSizeBytes)
+{
+  sfcc::BitStreamReader reader(compressed, compressedSizeBytes,
+                               compressedSizeBytes * 8);
+  const auto nbytes = reader.readBitsU64(ByteCountBits);
+  if (nbytes > uncompressedSizeBytes)
+    throw std::runtime_error("LZ78 output buffer is too small: " +
+                             std::to_string(uncompressedSizeBytes) + " < " +
+                             std::to_string(nbytes));
+  const int maxDictBits = reader.readBitsU64(DictBitsBits);
+  if (maxDictBits < MinDictBits || maxDictBits > MaxDictBits)
+    throw std::runtime_error("Unsupported LZ78 dictionary width of " +
+                             std::to_string(maxDictBits) + " bits");
+
+  // Each entry is the phrase of an earlier pair, which is already in the
+  // output, so only its position is kept.
+  struct Phrase
+  {
+    std::uint64_t start;
+    std::uint32_t length;
+  };
+  std::vector<Phrase> phrases(std::size_t(1) << maxDictBits);
+  phrases[Trie::Root] = {0, 0};
+  std::uint32_t size = 1;
+  std::uint64_t pos = 0;
+  while (pos < nbytes) {
+    const auto index = std::uint32_t(reader.readBitsU64(indexBits(size)));
+    const auto byte = std::uint8_t(reader.readBitsU64(ByteBits));
+    if (index >= size)
+      throw std::runtime_error("Invalid LZ78 dictionary index " +
+                               std::to_string(index));
+    const auto& prefix = phrases[index];
+    if (prefix.length >= nbytes - pos)
+      throw std::runtime_error("LZ78 stream is longer than its byte count");
+    std::memcpy(uncompressed + pos, uncompressed + prefix.start,
+                prefix.length);
+    uncompressed[pos + prefix.length] = byte;
+    phrases[size] = {pos, prefix.length + 1};
+    pos += prefix.length + 1;
+    if (++size == (std::uint32_t(1) << maxDictBits)) size = 1;
+  }
+  // Reading past the end throws above, and the writer pads the last byte only
+  if (reader.getBitCount() - reader.getBitsRead() >= 8)
+    throw std::runtime_error("LZ78 stream has data after its last pair");
+  return nbytes;
+}
+
+}  // namespace lz78
@@ -31,7 +31,8 @@
 // This is the compression scheme used by the GIF image format and the Unix
 // 'compress' tool. Main differences from this implementation is that End Of
 // Input (EOI) and Clear Codes (CC) are not stored in the output and the max
-// code length in bits is 12, vs 16 in compress.
+// code length in bits defaults to 12, vs 16 in compress. It can be raised to
+// MaxDictBits, the encoder and decoder must agree on it.
 //
 // EOI is simply detected by the end of the data stream, while CC happens if the
 // dictionary gets filled. Data is written/read from bit streams, which handle
@@ -71,26 +72,16 @@
 #include <cstdio>  // For the default error handler
 #endif             // LZW_USING_DEFAULT_ERROR_HANDLER
 
+#include <algorithm>
 #include <cassert>
 #include <cstring>
+#include <limits>
 #include "lzw.h"
 
 namespace lzw {
 
 // ========================================================
 
-// Round up to the next power-of-two number, e.g. 37 => 64
-static int nextPowerOfTwo(int num)
-{
-  --num;
-  for (std::size_t i = 1; i < sizeof(num) * 8; i <<= 1) {
-    num = num | num >> i;
-  }
-  return ++num;
-}
-
-// ========================================================
-
 #ifdef LZW_USING_DEFAULT_ERROR_HANDLER
 
 // Prints a fatal error to stderr and aborts the process.
@@ -106,258 +97,35 @@ void fatalError(const char *const message)
 #endif  // LZW_USING_DEFAULT_ERROR_HANDLER
 
 // ========================================================
-// class BitStreamWriter:
-// ========================================================
-
-BitStreamWriter::BitStreamWriter()
-{
-  // 8192 bits for a start (1024 bytes). It will resize if needed.
-  // Default granularity is 2.
-  internalInit();
-  allocate(8192);
-}
-
-BitStreamWriter::BitStreamWriter(const int initialSizeInBits,
-                                 const int growthGranularity)
-{
-  internalInit();
-  setGranularity(growthGranularity);
-  allocate(initialSizeInBits);
-}
-
-BitStreamWriter::~BitStreamWriter()
-{
-  if (stream != nullptr) {
-    LZW_MFREE(stream);
-  }
-}
-
-void BitStreamWriter::internalInit()
-{
-  stream = nullptr;
-  bytesAllocated = 0;
-  granularity = 2;
-  currBytePos = 0;
-  nextBitPos = 0;
-  numBitsWritten = 0;
-}
-
-void BitStreamWriter::allocate(int bitsWanted)
-{
-  // Require at least a byte.
-  if (bitsWanted <= 0) {
-    bitsWanted = 8;
-  }
-
-  // Round upwards if needed:
-  if ((bitsWanted % 8) != 0) {
-    bitsWanted = nextPowerOfTwo(bitsWanted);
-  }
-
-  // We might already have the required count.
-  const int sizeInBytes = bitsWanted / 8;
-  if (sizeInBytes <= bytesAllocated) {
-    return;
-  }
-
-  stream = allocBytes(sizeInBytes, stream, bytesAllocated);
-  bytesAllocated = sizeInBytes;
-}
-
-void BitStreamWriter::appendBit(const int bit)
-{
-  const std::uint32_t mask = std::uint32_t(1) << nextBitPos;
-  stream[currBytePos] = (stream[currBytePos] & ~mask) | (-bit & mask);
-  ++numBitsWritten;
-
-  if (++nextBitPos == 8) {
-    nextBitPos = 0;
-    if (++currBytePos == bytesAllocated) {
-      allocate(bytesAllocated * granularity * 8);
-    }
-  }
-}
-
-void BitStreamWriter::appendBitsU64(const std::uint64_t num, const int bitCount)
-{
-  assert(bitCount <= 64);
-  for (int b = 0; b < bitCount; ++b) {
-    const std::uint64_t mask = std::uint64_t(1) << b;
-    const int bit = !!(num & mask);
-    appendBit(bit);
-  }
-}
-
-#ifndef LZW_NO_STD_STRING
-
-void BitStreamWriter::appendBitString(const std::string &bitStr)
-{
-  for (std::size_t i = 0; i < bitStr.length(); ++i) {
-    appendBit(bitStr[i] == '0' ? 0 : 1);
-  }
-}
-
-std::string BitStreamWriter::toBitString() const
-{
-  std::string bitString;
-
-  int usedBytes = numBitsWritten / 8;
-  int leftovers = numBitsWritten % 8;
-  if (leftovers != 0) {
-    ++usedBytes;
-  }
-  assert(usedBytes <= bytesAllocated);
-
-  for (int i = 0; i < usedBytes; ++i) {
-    const int nBits =
-        (leftovers == 0) ? 8 : (i == usedBytes - 1) ? leftovers : 8;
-    for (int j = 0; j < nBits; ++j) {
-      bitString += (stream[i] & (1 << j) ? '1' : '0');
-    }
-  }
-
-  return bitString;
-}
-
-#endif  // LZW_NO_STD_STRING
-
-std::uint8_t *BitStreamWriter::release()
-{
-  std::uint8_t *oldPtr = stream;
-  internalInit();
-  return oldPtr;
-}
-
-void BitStreamWriter::setGranularity(const int growthGranularity)
-{
-  granularity = (growthGranularity >= 2) ? growthGranularity : 2;
-}
-
-int BitStreamWriter::getByteCount() const
-{
-  int usedBytes = numBitsWritten / 8;
-  int leftovers = numBitsWritten % 8;
-  if (leftovers != 0) {
-    ++usedBytes;
-  }
-  assert(usedBytes <= bytesAllocated);
-  return usedBytes;
-}
-
-int BitStreamWriter::getBitCount() const { return numBitsWritten; }
-
-const std::uint8_t *BitStreamWriter::getBitStream() const { return stream; }
-
-std::uint8_t *BitStreamWriter::allocBytes(const int bytesWanted,
-                                          std::uint8_t *oldPtr,
-                                          const int oldSize)
-{
-  std::uint8_t *newMemory =
-      static_cast<std::uint8_t *>(LZW_MALLOC(bytesWanted));
-  std::memset(newMemory, 0, bytesWanted);
-
-  if (oldPtr != nullptr) {
-    std::memcpy(newMemory, oldPtr, oldSize);
-    LZW_MFREE(oldPtr);
-  }
-
-  return newMemory;
-}
-
-// ========================================================
-// class BitStreamReader:
+// class Dictionary:
 // ========================================================
 
-BitStreamReader::BitStreamReader(const BitStreamWriter &bitStreamWriter)
-    : stream(bitStreamWriter.getBitStream()),
-      sizeInBytes(bitStreamWriter.getByteCount()),
-      sizeInBits(bitStreamWriter.getBitCount())
-{
-  reset();
-}
-
-BitStreamReader::BitStreamReader(const std::uint8_t *bitStream,
-                                 const int byteCount, const int bitCount)
-    : stream(bitStream), sizeInBytes(byteCount), sizeInBits(bitCount)
-{
-  reset();
-}
-
-bool BitStreamReader::readNextBit(int &bitOut)
-{
-  if (numBitsRead >= sizeInBits) {
-    return false;  // We are done.
-  }
-
-  const std::uint32_t mask = std::uint32_t(1) << nextBitPos;
-  bitOut = !!(stream[currBytePos] & mask);
-  ++numBitsRead;
-
-  if (++nextBitPos == 8) {
-    nextBitPos = 0;
-    ++currBytePos;
-  }
-  return true;
-}
-
-std::uint64_t BitStreamReader::readBitsU64(const int bitCount)
+Dictionary::Dictionary(const int maxDictBits)
+    : maxDictBits(maxDictBits),
+      slots(std::size_t(2) << maxDictBits, Nil),
+      slotMask((std::uint32_t(2) << maxDictBits) - 1)
 {
-  assert(bitCount <= 64);
-
-  std::uint64_t num = 0;
-  for (int b = 0; b < bitCount; ++b) {
-    int bit;
-    if (!readNextBit(bit)) {
-      LZW_ERROR("Failed to read bits from stream! Unexpected end.");
-      break;
-    }
-
-    // Based on a "Stanford bit-hack":
-    // http://graphics.stanford.edu/~seander/bithacks.html#ConditionalSetOrClearBitsWithoutBranching
-    const std::uint64_t mask = std::uint64_t(1) << b;
-    num = (num & ~mask) | (-bit & mask);
+  if (maxDictBits < StartBits || maxDictBits > MaxDictBits) {
+    LZW_ERROR("Unsupported dictionary width!");
   }
 
-  return num;
-}
-
-void BitStreamReader::reset()
-{
-  currBytePos = 0;
-  nextBitPos = 0;
-  numBitsRead = 0;
-}
-
-bool BitStreamReader::isEndOfStream() const
-{
-  return numBitsRead >= sizeInBits;
-}
-
-// ========================================================
-// class Dictionary:
-// ========================================================
-
-Dictionary::Dictionary()
-{
   // First 256 dictionary entries are reserved to the byte/ASCII
   // range. Additional entries follow for the character sequences
-  // found in the input. Up to 4096 - 256 (MaxDictEntries - FirstCode).
+  // found in the input. Up to 2^maxDictBits - 256. The roots are
+  // found without a lookup, so they are not in the hash table.
+  entries.resize(std::size_t(1) << maxDictBits);
   size = FirstCode;
   for (int i = 0; i < size; ++i) {
     entries[i].code = Nil;
     entries[i].value = i;
-    entries_map.insert({{Nil, i}, i});
   }
 }
 
-bool entries_compare(const std::tuple<int, int> &lhs,
-                     const std::tuple<int, int> &rhs)
+std::uint32_t Dictionary::slotOf(const int code, const int value) const
 {
-  if (std::get<0>(lhs) == std::get<0>(rhs)) {
-    return std::get<1>(lhs) > std::get<1>(rhs);
-  } else {
-    return std::get<0>(lhs) > std::get<0>(rhs);
-  }
+  // Fibonacci hashing of the (code, value) pair
+  const std::uint32_t key = (std::uint32_t(code) << 8) | std::uint32_t(value);
+  return (key * 2654435761U) >> (32 - (maxDictBits + 1));
 }
 
 int Dictionary::findIndex(const int code, const int value) const
@@ -366,24 +134,29 @@ int Dictionary::findIndex(const int code, const int value) const
     return value;
   }
 
-  auto it = entries_map.find({code, value});
-  if (it == std::end(entries_map)) {
-    return Nil;
-  } else {
-    return it->second;
+  for (auto slot = slotOf(code, value);; slot = (slot + 1) & slotMask) {
+    const int index = slots[slot];
+    if (index == Nil ||
+        (entries[index].code == code && entries[index].value == value)) {
+      return index;
+    }
   }
 }
 
 bool Dictionary::add(const int code, const int value)
 {
-  if (size == MaxDictEntries) {
+  if (size == (1 << maxDictBits)) {
     LZW_ERROR("Dictionary overflowed!");
     return false;
   }
 
   entries[size].code = code;
   entries[size].value = value;
-  entries_map.insert({{code, value}, size});
+  auto slot = slotOf(code, value);
+  while (slots[slot] != Nil) {
+    slot = (slot + 1) & slotMask;
+  }
+  slots[slot] = size;
   ++size;
   return true;
 }
@@ -392,15 +165,11 @@ bool Dictionary::flush(int &codeBitsWidth)
 {
   if (size == (1 << codeBitsWidth)) {
     ++codeBitsWidth;
-    if (codeBitsWidth > MaxDictBits) {
+    if (codeBitsWidth > maxDictBits) {
       // Clear the dictionary (except the first 256 byte entries).
       codeBitsWidth = StartBits;
       size = FirstCode;
-      entries_map.clear();
-      for (int i = 0; i < size; ++i) {
-        entries_map.insert({{Nil, i}, i});
-      }
-
+      std::fill(std::begin(slots), std::end(slots), Nil);
       return true;
     }
   }
@@ -411,16 +180,23 @@ bool Dictionary::flush(int &codeBitsWidth)
 // easyEncode() implementation:
 // ========================================================
 
-void easyEncode(const std::uint8_t *uncompressed, int uncompressedSizeBytes,
-                std::uint8_t **compressed, int *compressedSizeBytes,
-                int *compressedSizeBits)
+std::uint64_t maxCompressedSize(const std::uint64_t uncompressedSizeBytes,
+                                const int maxDictBits)
+{
+  return ((uncompressedSizeBytes + 1) * maxDictBits + 7) / 8;
+}
+
+void easyEncode(const std::uint8_t *uncompressed,
+                std::uint64_t uncompressedSizeBytes, std::uint8_t **compressed,
+                std::uint64_t *compressedSizeBytes,
+                std::uint64_t *compressedSizeBits, const int maxDictBits)
 {
   if (uncompressed == nullptr || compressed == nullptr) {
     LZW_ERROR("lzw::easyEncode(): Null data pointer(s)!");
     return;
   }
 
-  if (uncompressedSizeBytes <= 0 || compressedSizeBytes == nullptr ||
+  if (uncompressedSizeBytes == 0 || compressedSizeBytes == nullptr ||
       compressedSizeBits == nullptr) {
     LZW_ERROR("lzw::easyEncode(): Bad in/out sizes!");
     return;
@@ -429,11 +205,12 @@ void easyEncode(const std::uint8_t *uncompressed, int uncompressedSizeBytes,
   // LZW encoding context:
   int code = Nil;
   int codeBitsWidth = StartBits;
-  Dictionary dictionary;
+  Dictionary dictionary(maxDictBits);
 
-  // Output bit stream we write to. This will allocate
-  // memory as needed to accommodate the encoded data.
-  BitStreamWriter bitStream;
+  // Output bit stream we write to. Every input byte emits at most one
+  // code, so the stream is sized for that bound up-front and never grows.
+  BitStreamWriter bitStream(maxCompressedSize(uncompressedSizeBytes,
+                                              maxDictBits) * 8);
 
   for (; uncompressedSizeBytes > 0; --uncompressedSizeBytes, ++uncompressed) {
     const int value = *uncompressed;
@@ -470,111 +247,129 @@ void easyEncode(const std::uint8_t *uncompressed, int uncompressedSizeBytes,
 // easyDecode() and helpers:
 // ========================================================
 
-static bool outputByte(int code, std::uint8_t *&output, int outputSizeBytes,
-                       int &bytesDecodedSoFar)
+// Every phrase after the first in a dictionary epoch is a previously output
+// phrase followed by one byte, so it already sits in the output buffer. The
+// decoder only records where each phrase was written and how long it is, and
+// copies it forward instead of walking the prefix chain.
+struct Phrase
 {
-  if (bytesDecodedSoFar >= outputSizeBytes) {
-    LZW_ERROR("Decoder output buffer too small!");
-    return false;
-  }
-
-  assert(code >= 0 && code < 256);
-  *output++ = static_cast<std::uint8_t>(code);
-  ++bytesDecodedSoFar;
-  return true;
-}
-
-static bool outputSequence(const Dictionary &dict, int code,
-                           std::uint8_t *&output, int outputSizeBytes,
-                           int &bytesDecodedSoFar, int &firstByte)
+  std::uint64_t start;
+  std::uint32_t length;
+};
+
+// Copy length bytes from an earlier position of the output, which must not
+// overlap the destination. Short phrases are copied with two 8-byte moves when
+// there is room; the bytes past length are rewritten by later phrases.
+static inline void copyPhrase(std::uint8_t *output, std::uint64_t from,
+                              std::uint64_t to, std::uint32_t length,
+                              std::uint64_t outputSizeBytes)
 {
-  // A sequence is stored backwards, so we have to write
-  // it to a temp then output the buffer in reverse.
-  int i = 0;
-  std::uint8_t sequence[MaxDictEntries];
-  do {
-    assert(i < MaxDictEntries - 1 && code >= 0);
-    sequence[i++] = dict.entries[code].value;
-    code = dict.entries[code].code;
-  } while (code >= 0);
-
-  firstByte = sequence[--i];
-  for (; i >= 0; --i) {
-    if (!outputByte(sequence[i], output, outputSizeBytes, bytesDecodedSoFar)) {
-      return false;
-    }
+  if (length <= 16 && to + 16 <= outputSizeBytes &&
+      from + 16 <= outputSizeBytes) {
+    std::uint64_t lo, hi;
+    std::memcpy(&lo, output + from, 8);
+    std::memcpy(&hi, output + from + 8, 8);
+    std::memcpy(output + to, &lo, 8);
+    std::memcpy(output + to + 8, &hi, 8);
+  } else {
+    std::memcpy(output + to, output + from, length);
   }
-  return true;
 }
 
-int easyDecode(const std::uint8_t *compressed, const int compressedSizeBytes,
-               const int compressedSizeBits, std::uint8_t *uncompressed,
-               const int uncompressedSizeBytes)
+std::uint64_t easyDecode(const std::uint8_t *compressed,
+                         const std::uint64_t compressedSizeBytes,
+                         const std::uint64_t compressedSizeBits,
+                         std::uint8_t *uncompressed,
+                         const std::uint64_t uncompressedSizeBytes,
+                         const int maxDictBits)
 {
   if (compressed == nullptr || uncompressed == nullptr) {
     LZW_ERROR("lzw::easyDecode(): Null data pointer(s)!");
     return 0;
   }
 
-  if (compressedSizeBytes <= 0 || compressedSizeBits <= 0 ||
-      uncompressedSizeBytes <= 0) {
+  if (compressedSizeBytes == 0 || compressedSizeBits == 0 ||
+      uncompressedSizeBytes == 0) {
     LZW_ERROR("lzw::easyDecode(): Bad in/out sizes!");
     return 0;
   }
 
-  int code = Nil;
-  int prevCode = Nil;
-  int firstByte = 0;
-  int bytesDecoded = 0;
-  int codeBitsWidth = StartBits;
+  if (maxDictBits < StartBits || maxDictBits > MaxDictBits) {
+    LZW_ERROR("Unsupported dictionary width!");
+    return 0;
+  }
 
   // We'll reconstruct the dictionary based on the
   // bit stream codes. Unlike Huffman encoding, we
   // don't store the dictionary as a prefix to the data.
-  Dictionary dictionary;
+  // Only the phrase positions are needed, the roots are
+  // single bytes that are never looked up.
+  std::vector<Phrase> phrases(std::size_t(1) << maxDictBits);
+  int dictSize = FirstCode;
+  int codeBitsWidth = StartBits;
+  int prevCode = Nil;
+  Phrase prev{0, 0};
+  std::uint64_t bytesDecoded = 0;
+
   BitStreamReader bitStream(compressed, compressedSizeBytes,
                             compressedSizeBits);
 
   // We check to avoid an overflow of the user buffer.
   // If the buffer is smaller than the decompressed size,
   // LZW_ERROR() is called. If that doesn't throw or
-  // terminate we break the loop and return the current
-  // decompression count.
+  // terminate we return the partial decompression count.
   while (!bitStream.isEndOfStream()) {
-    assert(codeBitsWidth <= MaxDictBits);
-    code = static_cast<int>(bitStream.readBitsU64(codeBitsWidth));
+    assert(codeBitsWidth <= maxDictBits);
+    const int code = static_cast<int>(bitStream.readBitsU64(codeBitsWidth));
+    const std::uint64_t start = bytesDecoded;
+    std::uint32_t length;
+
+    if (code < FirstCode) {
+      length = 1;
+    } else if (prevCode != Nil && code < dictSize) {
+      length = phrases[code].length;
+    } else if (prevCode != Nil && code == dictSize) {
+      // The phrase being defined: the previous one plus its own first byte
+      length = prev.length + 1;
+    } else {
+      LZW_ERROR("lzw::easyDecode(): Invalid code in stream!");
+      return bytesDecoded;
+    }
 
-    if (prevCode == Nil) {
-      if (!outputByte(code, uncompressed, uncompressedSizeBytes,
-                      bytesDecoded)) {
-        break;
-      }
-      firstByte = code;
-      prevCode = code;
-      continue;
+    if (length > uncompressedSizeBytes - bytesDecoded) {
+      LZW_ERROR("Decoder output buffer too small!");
+      return bytesDecoded;
     }
 
-    if (code >= dictionary.size) {
-      if (!outputSequence(dictionary, prevCode, uncompressed,
-                          uncompressedSizeBytes, bytesDecoded, firstByte)) {
-        break;
-      }
-      if (!outputByte(firstByte, uncompressed, uncompressedSizeBytes,
-                      bytesDecoded)) {
-        break;
-      }
+    if (code < FirstCode) {
+      uncompressed[bytesDecoded] = static_cast<std::uint8_t>(code);
+    } else if (code < dictSize) {
+      copyPhrase(uncompressed, phrases[code].start, bytesDecoded, length,
+                 uncompressedSizeBytes);
     } else {
-      if (!outputSequence(dictionary, code, uncompressed, uncompressedSizeBytes,
-                          bytesDecoded, firstByte)) {
-        break;
-      }
+      copyPhrase(uncompressed, prev.start, bytesDecoded, prev.length,
+                 uncompressedSizeBytes);
+      uncompressed[bytesDecoded + prev.length] = uncompressed[prev.start];
+    }
+    bytesDecoded += length;
+
+    if (prevCode == Nil) {
+      prevCode = code;
+      prev = {start, length};
+      continue;
     }
 
-    dictionary.add(prevCode, firstByte);
-    if (dictionary.flush(codeBitsWidth)) {
+    // The new entry is the previous phrase extended by the first byte of
+    // this one, which directly follows it in the output.
+    phrases[dictSize++] = {prev.start, prev.length + 1};
+    if (dictSize == (1 << codeBitsWidth) && ++codeBitsWidth > maxDictBits) {
+      // Clear the dictionary (except the first 256 byte entries).
+      codeBitsWidth = StartBits;
+      dictSize = FirstCode;
       prevCode = Nil;
     } else {
       prevCode = code;
+      prev = {start, length};
     }
   }
 
@@ -13,10 +13,14 @@
 #include <args.hxx>
 #include <iostream>
 #include <string>
+#include "autoselect.h"
 #include "bittranspose.h"
+#include "byteshuffle.h"
 #include "compress_handler.h"
+#include "pipeline.h"
 #include "reorder.h"
 #include "sfcc.h"
+#include "stats.h"
 
 void _compress(args::Subparser& sp)
 {
@@ -31,15 +35,92 @@ void _compress(args::Subparser& sp)
                                      sfc::main::desc::compress_file);
   args::Positional<std::string> outfile(sp, "output file",
                                         sfc::main::desc::compress_out_file);
+  // None of them leaves the bits as they are, as -B does
   args::Group bittranspose_group(
-      sp, "This group is all exclusive:", args::Group::Validators::Xor);
+      sp, "This group is all exclusive:", args::Group::Validators::AtMostOne);
   args::Flag bittranspose(bittranspose_group, "bittranspose",
                           sfc::main::desc::bittranspose, {'b', "bittranspose"});
   args::Flag nobittranspose(bittranspose_group, "do not bittranspose",
                             sfc::main::desc::nobittranspose,
                             {'B', "nobittranspose"});
+  args::Flag byteshuffle(bittranspose_group, "byteshuffle",
+                         sfc::main::desc::byteshuffle, {'y', "byteshuffle"});
+  args::ValueFlag<unsigned long long> bittranspose_block(
+      sp, "N", sfc::main::desc::bittranspose_block, {"bittranspose-block"});
+  args::ValueFlag<int> level(sp, "N", sfc::main::desc::level, {'l', "level"});
+  args::ValueFlag<std::string> pipeline(sp, "SPEC", sfc::main::desc::pipeline,
+                                        {'p', "pipeline"});
+  args::MapFlag<std::string, sfcc::objective_t> autoselect(
+      sp, "OBJECTIVE", sfc::main::desc::autoselect, {"auto"},
+      sfcc::objective_string_t);
+  args::ValueFlag<double> auto_weight(sp, "W", sfc::main::desc::auto_weight,
+                                      {"auto-weight"}, 0.5);
   sp.Parse();
-  if (!file || (!sfc && !comp)) std::cout << sp << std::endl;
+  if (!file || (!sfc && !comp && !pipeline && !autoselect))
+    std::cout << sp << std::endl;
+  if (level && (args::get(level) < ::lz77::MinLevel ||
+                args::get(level) > ::lz77::MaxLevel)) {
+    std::cerr << "Compression level must be between " << ::lz77::MinLevel
+              << " and " << ::lz77::MaxLevel << std::endl;
+    return;
+  }
+  std::optional<std::uint8_t> bittranspose_block_nbits;
+  if (bittranspose_block && !bittranspose) {
+    std::cerr << "--bittranspose-block sets the blocks of -b, so it needs -b"
+              << std::endl;
+    return;
+  }
+  if (bittranspose_block) {
+    const auto block_bytes = args::get(bittranspose_block);
+    for (auto nbits = sfc::sfcc::bittranspose_block_min_nbits;
+         nbits <= sfc::sfcc::bittranspose_block_max_nbits; nbits++)
+      if (block_bytes == 1ULL << nbits) bittranspose_block_nbits = nbits;
+    if (!bittranspose_block_nbits) {
+      std::cerr << "Bit-transpose block size must be a power of two from "
+                << (1ULL << sfc::sfcc::bittranspose_block_min_nbits) << " to "
+                << (1ULL << sfc::sfcc::bittranspose_block_max_nbits)
+                << " bytes" << std::endl;
+      return;
+    }
+  }
+  if (comp && args::get(comp) == sfc::sfcc::compression_t::PIPELINE) {
+    std::cerr << "-c PIPELINE has no stages, list them with -p instead"
+              << std::endl;
+    return;
+  }
+  std::optional<sfcc::pipeline_spec> spec;
+  if (pipeline) {
+    if (comp || bittranspose || byteshuffle) {
+      std::cerr << "A pipeline lists its own transforms and codec, so it "
+                   "cannot be combined with -c, -b or -y"
+                << std::endl;
+      return;
+    }
+    try {
+      spec = sfcc::parsePipeline(args::get(pipeline));
+    } catch (const std::invalid_argument& e) {
+      std::cerr << e.what() << std::endl;
+      return;
+    }
+  }
+  if (autoselect) {
+    if (sfc || comp || pipeline || bittranspose || nobittranspose ||
+        byteshuffle) {
+      std::cerr << "--auto chooses the curve, transform and codec, so it "
+                   "cannot be combined with -s, -c, -p, -b, -B or -y"
+                << std::endl;
+      return;
+    }
+    if (args::get(auto_weight) < 0 || args::get(auto_weight) > 1) {
+      std::cerr << "The --auto-weight must be from 0 to 1" << std::endl;
+      return;
+    }
+  }
+  // A curve named by the pipeline takes the place of -s
+  auto curve = spec && spec->curve ? spec->curve.value() : args::get(sfc);
+  auto codec = args::get(comp);
+  auto do_bittranspose = bittranspose && !nobittranspose;
+  auto do_byteshuffle = bool(byteshuffle);
 
   sfc::sfcc_file sfile(args::get(file));
   if (sfile.getHeader().compressiontype != sfc::sfcc::compression_t::NONE) {
@@ -56,6 +137,24 @@ void _compress(args::Subparser& sp)
     return;
   }
 
+  if (autoselect) {
+    sfcc::auto_options options;
+    options.objective = args::get(autoselect);
+    options.ratio_weight = args::get(auto_weight);
+    if (level) options.level = args::get(level);
+    const auto best =
+        sfcc::autoSelect(sfile.getData(), sfile.getHeader(), options);
+    curve = best.curve;
+    codec = best.codec;
+    do_bittranspose = best.transform == sfcc::transform_t::BITTRANSPOSE;
+    do_byteshuffle = best.transform == sfcc::transform_t::BYTESHUFFLE;
+    std::cout << "Chose " << sfc::sfcc::tostring(curve) << ", "
+              << sfcc::tostring(best.transform) << " and "
+              << sfc::sfcc::tostring(codec) << ", sampled at a ratio of "
+              << best.ratio << " and " << best.decode_speed / (1 << 20)
+              << " MiB/s decoded" << std::endl;
+  }
+
   auto data_in = std::make_unique<std::uint8_t[]>(sfile.size());
   std::copy(sfile.getData(), sfile.getData() + sfile.size(), data_in.get());
   auto header = sfile.getHeader();
@@ -63,39 +162,58 @@ void _compress(args::Subparser& sp)
 
   // Reorder
   auto reorder = sfcc::make_reorderer(header.ndims, dimlength, header.sfctype,
-                                      args::get(sfc));
+                                      curve);
 
   reorder->reorder_withtemporary_vardtype(
       data_in.get(), sfc::pow(dimlength, header.ndims) * header.dtype_nbytes,
       header.dtype_nbytes);
 
   // Bit-Transpose
-  if (bittranspose && !nobittranspose) {
+  if (do_bittranspose) {
     if (::sfc::DEBUG)
       std::cout << "Transposing bits with data-type of "
                 << int(header.dtype_nbytes) << " bytes" << std::endl;
-    auto bittransposer = sfcc::BitTransposer();
+    header.bittransposed = true;
+    header.bittranspose_block_nbits = bittranspose_block_nbits;
+    auto bittransposer = sfcc::BitTransposer(sfcc::bestBitTransposeKernel(),
+                                             header.bittransposeBlockBytes());
     bittransposer.transpose(
         data_in.get(), sfc::pow(dimlength, header.ndims) * header.dtype_nbytes,
         header.dtype_nbytes);
-    header.bittransposed = true;
+  } else if (do_byteshuffle) {
+    if (::sfc::DEBUG)
+      std::cout << "Shuffling bytes with data-type of "
+                << int(header.dtype_nbytes) << " bytes" << std::endl;
+    sfcc::ByteShuffler().shuffle(
+        data_in.get(), sfc::pow(dimlength, header.ndims) * header.dtype_nbytes,
+        header.dtype_nbytes);
+    header.byteshuffled = true;
   }
 
-  header.sfctype = args::get(sfc);
+  header.sfctype = curve;
 
   std::uint8_t* data;
-  int length;
-  std::unique_ptr<std::uint8_t[]> data_tmp;
-  // Compress
-  auto compressor = sfcc::make_compressor(args::get(comp), bittranspose);
+  unsigned long long length;
+  std::unique_ptr<std::uint8_t[]> data_out;
+  // Compress straight into a buffer of the worst-case size, each codec taking
+  // its own default level without -l
+  std::unique_ptr<sfcc::compressor> compressor;
+  std::optional<int> codec_level;
+  if (level) codec_level = args::get(level);
+  if (spec)
+    compressor = std::make_unique<sfcc::pipeline>(spec->stages, codec_level);
+  else
+    compressor = sfcc::make_compressor(
+        codec, do_bittranspose || do_byteshuffle, codec_level);
   if (compressor) {
-    auto [data_tmp, _length, _header] =
-        compressor->compress(data_in, sfile.size(), header);
-    data = data_tmp.release();
-    length = _length;
-    header = _header;
+    const auto capacity = compressor->maxCompressedSize(sfile.size(), header);
+    data_out = std::make_unique<std::uint8_t[]>(capacity);
+    std::tie(length, header) = compressor->compressInto(
+        data_in.get(), sfile.size(), data_out.get(), capacity, header);
+    data_in.reset();
+    data = data_out.get();
   } else {
-    data = data_in.release();
+    data = data_in.get();
     length = sfile.sizein_bytes();
     header.compressiontype = sfc::sfcc::compression_t::NONE;
   }
@@ -104,8 +222,9 @@ void _compress(args::Subparser& sp)
   if (outfile)
     outputFileName = args::get(outfile);
   else {
-    outputFileName = args::get(file) + sfc::main::SFCToExt(args::get(sfc)) +
-                     (bittranspose ? ".btr" : "") +
+    outputFileName = args::get(file) + sfc::main::SFCToExt(curve) +
+                     (do_bittranspose ? ".btr" : "") +
+                     (do_byteshuffle ? ".bsh" : "") +
                      (compressor ? '.' + compressor->getFileExtension() : "");
   }
   outputfile = std::ofstream(outputFileName, std::ios::binary);
@@ -121,7 +240,6 @@ void _compress(args::Subparser& sp)
   outputfile.write((char*)header_ptr.get(), header.size());
   outputfile.write((char*)data, length);
   outputfile.close();
-  delete[] data;
 }
 
 void _decompress(args::Subparser& sp)
@@ -146,39 +264,47 @@ void _decompress(args::Subparser& sp)
   if (::sfc::DEBUG)
     std::cout << "File is " << (bittransposed ? "" : "not ") << "bit-transposed"
               << std::endl;
-  header.sfctype = sfc::main::sfcs::types::ROW_MAJOR;
   std::uint8_t* data;
-  int length;
-  std::unique_ptr<std::uint8_t[]> data_tmp;
+  unsigned long long length;
+  std::unique_ptr<std::uint8_t[]> data_out;
 
-  auto data_in = std::make_unique<std::uint8_t[]>(sfile.size());
-  std::copy(sfile.getData(), sfile.getData() + sfile.size(), data_in.get());
-  // Decompress
-  auto compressor =
-      sfcc::make_compressor(sfile.getHeader().compressiontype, bittransposed);
+  // Decompress straight from the file data, with the curve of the file as the
+  // Lorenzo stage of a pipeline predicts along it
+  const bool byteshuffled = header.byteshuffled;
+  auto compressor = sfcc::make_compressor(sfile.getHeader());
   if (compressor) {
-    auto [data_tmp, _length, _header] =
-        compressor->decompress(data_in, sfile.size(), header);
-    data = data_tmp.release();
-    length = _length;
-    header = _header;
+    const auto capacity =
+        compressor->maxDecompressedSize(sfile.getData(), sfile.size(), header);
+    data_out = std::make_unique<std::uint8_t[]>(capacity);
+    std::tie(length, header) = compressor->decompressInto(
+        sfile.getData(), sfile.size(), data_out.get(), capacity, header);
   } else {
-    data = data_in.release();
+    // The data is reordered in place
+    data_out = std::make_unique<std::uint8_t[]>(sfile.size());
+    std::copy(sfile.getData(), sfile.getData() + sfile.size(), data_out.get());
     length = sfile.sizein_bytes();
     header.compressiontype = sfc::sfcc::compression_t::NONE;
   }
-  data_in.reset();
+  data = data_out.get();
+  header.sfctype = sfc::main::sfcs::types::ROW_MAJOR;
 
   auto dimlength = 1ULL << sfile.getHeader().sidelength_k;
 
   // Bit-transpose if necessary
   if (bittransposed) {
-    auto bittransposer = sfcc::BitTransposer();
+    auto bittransposer = sfcc::BitTransposer(sfcc::bestBitTransposeKernel(),
+                                             header.bittransposeBlockBytes());
     bittransposer.reverse_transpose(
         data, sfc::pow(dimlength, header.ndims) * header.dtype_nbytes,
         header.dtype_nbytes);
     if (::sfc::DEBUG) std::cout << "Transposed" << std::endl;
     header.bittransposed = false;
+    header.bittranspose_block_nbits.reset();
+  } else if (byteshuffled) {
+    sfcc::ByteShuffler().reverse_shuffle(
+        data, sfc::pow(dimlength, header.ndims) * header.dtype_nbytes,
+        header.dtype_nbytes);
+    header.byteshuffled = false;
   }
 
   // Reorder
@@ -210,6 +336,10 @@ void _decompress(args::Subparser& sp)
       auto nFilenameExt = outputFileName.rfind(".btr");
       outputFileName.erase(nFilenameExt, outputFileName.size() - nFilenameExt);
     }
+    if (byteshuffled) {
+      auto nFilenameExt = outputFileName.rfind(".bsh");
+      outputFileName.erase(nFilenameExt, outputFileName.size() - nFilenameExt);
+    }
     auto nFilenameExt =
         outputFileName.rfind(sfc::main::SFCToExt(sfile.getHeader().sfctype));
     outputFileName.erase(nFilenameExt, outputFileName.size() - nFilenameExt);
@@ -233,7 +363,44 @@ void _decompress(args::Subparser& sp)
   output->write((char*)header_ptr.get(), header.size());
   output->write((char*)data, length);
   if (!outputToStdOut) delete output;
-  delete[] data;
+}
+
+void _stats(args::Subparser& sp)
+{
+  args::PositionalList<std::string> files(sp, "files",
+                                          sfc::main::desc::stats_files);
+  args::MapFlag<std::string, sfc::main::sfcs::types> sfc(
+      sp, "CURVE", sfc::main::desc::stats_curve, {'s', "sfc"},
+      sfc::sfcc::sfc_string_t);
+  args::ValueFlag<unsigned long long> block_size(
+      sp, "N", sfc::main::desc::stats_block_size, {"block-size"}, 16384);
+  args::MapFlag<std::string, sfc::main::stats::format_t> format(
+      sp, "FORMAT", sfc::main::desc::stats_format, {"format"},
+      sfc::main::stats::format_string_t, sfc::main::stats::format_t::CSV);
+  sp.Parse();
+  if (!files) {
+    std::cout << sp << std::endl;
+    return;
+  }
+
+  std::vector<sfc::main::sfcs::types> curves = {
+      sfc::main::sfcs::types::ROW_MAJOR, sfc::main::sfcs::types::MORTON,
+      sfc::main::sfcs::types::GRAY_CODE, sfc::main::sfcs::types::HILBERT};
+  if (sfc) curves = {args::get(sfc)};
+  std::vector<sfcc::file_stats> stats;
+  for (const auto& filename : args::get(files)) {
+    try {
+      auto file = sfcc::fileStats(filename, curves, args::get(block_size));
+      std::move(file.begin(), file.end(), std::back_inserter(stats));
+    } catch (const std::exception& e) {
+      std::cerr << filename << ": " << e.what() << std::endl;
+      return;
+    }
+  }
+  if (args::get(format) == sfc::main::stats::format_t::JSON)
+    sfcc::writeStatsJSON(std::cout, stats);
+  else
+    sfcc::writeStatsCSV(std::cout, stats);
 }
 
 int main(int argc, char* argv[])
@@ -248,6 +415,7 @@ int main(int argc, char* argv[])
                          _compress);
   args::Command decompress(cmds, "decompress", sfc::main::desc::decompress,
                            _decompress);
+  args::Command stats(cmds, "stats", sfc::main::desc::stats, _stats);
 
   // Parse
   try {
@@ -0,0 +1,747 @@
+/**
+ * @file pipeline.cpp
+ * @author Conrad Haupt (conrad@conradhaupt.co.za)
+ * @brief A chain of transforms and codecs described by a stage list
+ * @version 1.0
+ * @date 2020-03-25
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#include "pipeline.h"
+#include <cctype>
+#include <cstring>
+#include "bittranspose.h"
+#include "byteshuffle.h"
+#include "predict.h"
+
+namespace sfcc {
+namespace {
+using ::sfc::sfcc::compression_t;
+
+std::string toLower(std::string str)
+{
+  std::transform(str.begin(), str.end(), str.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+  return str;
+}
+
+std::string toUpper(std::string str)
+{
+  std::transform(str.begin(), str.end(), str.begin(),
+                 [](unsigned char c) { return std::toupper(c); });
+  return str;
+}
+
+std::string trim(const std::string& str)
+{
+  const auto first = str.find_first_not_of(" \t");
+  if (first == std::string::npos) return "";
+  return str.substr(first, str.find_last_not_of(" \t") - first + 1);
+}
+
+// Transforms keep the compression type of the header, as they are recorded by
+// the stage list of the pipeline alone
+class transform : public compressor
+{
+ public:
+  virtual sfc::sfcc::compression_t getCompressionType() const
+  {
+    return compression_t::NONE;
+  }
+};
+
+// Bit-transposes every whole group of 16 or 32 values as BitTransposer does,
+// copying the values after the last group
+class bitshuffle_stage : public transform
+{
+ public:
+  virtual unsigned long long maxCompressedSize(
+      const unsigned long long length, const sfc::sfcc_header& header) const
+  {
+    return length;
+  }
+  virtual std::tuple<unsigned long long, sfc::sfcc_header> compressInto(
+      const std::uint8_t* data, const unsigned long long length,
+      std::uint8_t* output, const unsigned long long capacity,
+      const sfc::sfcc_header& header)
+  {
+    return run(data, length, output, capacity, header, false);
+  }
+  virtual unsigned long long maxDecompressedSize(
+      const std::uint8_t* data, const unsigned long long length,
+      const sfc::sfcc_header& header) const
+  {
+    return length;
+  }
+  virtual std::tuple<unsigned long long, sfc::sfcc_header> decompressInto(
+      const std::uint8_t* data, const unsigned long long length,
+      std::uint8_t* output, const unsigned long long capacity,
+      const sfc::sfcc_header& header)
+  {
+    return run(data, length, output, capacity, header, true);
+  }
+  virtual std::string getFileExtension() const { return "bitshuffle"; }
+
+ private:
+  const BitTransposeKernel _kernel = bestBitTransposeKernel();
+
+  template <typename T>
+  unsigned long long transposeGroups(const std::uint8_t* data,
+                                     const unsigned long long length,
+                                     std::uint8_t* output,
+                                     const bool reverse) const
+  {
+    constexpr auto nbits = sizeof(T) * CHAR_BIT;
+    const auto ngroups = length / sizeof(T) / nbits;
+    const auto in = reinterpret_cast<const T*>(data);
+    const auto out = reinterpret_cast<T*>(output);
+    if (reverse)
+      reverseBittransposeBlocks(in, out, ngroups, _kernel);
+    else
+      bittransposeBlocks(in, out, ngroups, _kernel);
+    return ngroups * nbits * sizeof(T);
+  }
+
+  std::tuple<unsigned long long, sfc::sfcc_header> run(
+      const std::uint8_t* data, const unsigned long long length,
+      std::uint8_t* output, const unsigned long long capacity,
+      const sfc::sfcc_header& header, const bool reverse) const
+  {
+    requireCapacity(capacity, length);
+    auto done = 0ULL;
+    if (header.dtype_nbytes == 2)
+      done = transposeGroups<std::uint16_t>(data, length, output, reverse);
+    else if (header.dtype_nbytes == 4)
+      done = transposeGroups<std::uint32_t>(data, length, output, reverse);
+    else
+      throw std::invalid_argument("bitshuffle needs 2- or 4-byte values, not " +
+                                  std::to_string(header.dtype_nbytes));
+    std::copy(data + done, data + length, output + done);
+    return {length, header};
+  }
+};
+
+class byteshuffle_stage : public transform
+{
+ public:
+  virtual unsigned long long maxCompressedSize(
+      const unsigned long long length, const sfc::sfcc_header& header) const
+  {
+    return length;
+  }
+  virtual std::tuple<unsigned long long, sfc::sfcc_header> compressInto(
+      const std::uint8_t* data, const unsigned long long length,
+      std::uint8_t* output, const unsigned long long capacity,
+      const sfc::sfcc_header& header)
+  {
+    requireCapacity(capacity, length);
+    byteShuffle(data, output, length, header.dtype_nbytes, _kernel);
+    return {length, header};
+  }
+  virtual unsigned long long maxDecompressedSize(
+      const std::uint8_t* data, const unsigned long long length,
+      const sfc::sfcc_header& header) const
+  {
+    return length;
+  }
+  virtual std::tuple<unsigned long long, sfc::sfcc_header> decompressInto(
+      const std::uint8_t* data, const unsigned long long length,
+      std::uint8_t* output, const unsigned long long capacity,
+      const sfc::sfcc_header& header)
+  {
+    requireCapacity(capacity, length);
+    reverseByteShuffle(data, output, length, header.dtype_nbytes, _kernel);
+    return {length, header};
+  }
+  virtual std::string getFileExtension() const { return "byteshuffle"; }
+
+ private:
+  const ByteShuffleKernel _kernel = bestByteShuffleKernel();
+};
+
+// Blocks of up to BLOCK_BYTES, each preceded by its length and a word whose
+// high byte tells how it is sorted. Bytes are sorted as in bzip<>, with the
+// primary index in the low bits, the number of stream rows less one in the
+// high byte and then the rows. The sbwt stage sorts 2- and 4-byte values as
+// whole samples with easyBWT() instead, with SAMPLE_FLAG | the width in the
+// high byte, the row of the end-of-line in the low bits and the length /
+// width + 1 samples of easyBWT() after it. The bwt stage sorts bytes even for
+// wider values, as every stage after it reads bytes: on the 16-bit test data
+// sample sorting is no smaller before FSE or Huffman and is larger before MTF,
+// RLE_VARINT or DEFLATE, which lose the runs of bytes that byte sorting makes.
+class bwt_stage : public transform
+{
+ public:
+  bwt_stage(const bool samples = false) : _samples{samples} {}
+
+  virtual unsigned long long maxCompressedSize(
+      const unsigned long long length, const sfc::sfcc_header& header) const
+  {
+    const auto nblocks = (length + BLOCK_BYTES - 1) / BLOCK_BYTES;
+    return length + nblocks * MAX_BLOCK_HEADER_BYTES;
+  }
+  virtual std::tuple<unsigned long long, sfc::sfcc_header> compressInto(
+      const std::uint8_t* data, const unsigned long long length,
+      std::uint8_t* output, const unsigned long long capacity,
+      const sfc::sfcc_header& header)
+  {
+    requireCapacity(capacity, maxCompressedSize(length, header));
+    const auto width = header.dtype_nbytes;
+    const auto samples =
+        _samples && (width == 2 || width == 4) && length % width == 0;
+    auto out = output;
+    for (auto start = 0ULL; start < length;) {
+      const auto n =
+          std::uint32_t(std::min<unsigned long long>(BLOCK_BYTES,
+                                                     length - start));
+      if (samples)
+        out += sampleBlock(data + start, n, width, out);
+      else
+        out += byteBlock(data + start, n, out);
+      start += n;
+    }
+    return {std::uint64_t(out - output), header};
+  }
+  virtual unsigned long long maxDecompressedSize(
+      const std::uint8_t* data, const unsigned long long length,
+      const sfc::sfcc_header& header) const
+  {
+    auto output_length = 0ULL;
+    for (auto pos = 0ULL; pos < length;) {
+      const auto block = readBlock(data, length, pos);
+      output_length += block.length;
+      pos = block.end;
+    }
+    return output_length;
+  }
+  virtual std::tuple<unsigned long long, sfc::sfcc_header> decompressInto(
+      const std::uint8_t* data, const unsigned long long length,
+      std::uint8_t* output, const unsigned long long capacity,
+      const sfc::sfcc_header& header)
+  {
+    const auto output_length = maxDecompressedSize(data, length, header);
+    requireCapacity(capacity, output_length);
+    auto out = output;
+    for (auto pos = 0ULL; pos < length;) {
+      const auto block = readBlock(data, length, pos);
+      const auto nsamples = block.width ? block.length / block.width : 0;
+      const auto bwt = data + block.end - block.length - block.width;
+      if (block.width == 2)
+        inverseSampleBWT<std::uint16_t>(bwt, nsamples, block.primary, out);
+      else if (block.width == 4)
+        inverseSampleBWT<std::uint32_t>(bwt, nsamples, block.primary, out);
+      else
+        bwt::inverseByteBWT(data + block.end - block.length, block.length,
+                            block.primary, block.rows, block.nstreams, out,
+                            _lf_rows);
+      out += block.length;
+      pos = block.end;
+    }
+    return {output_length, header};
+  }
+  virtual std::string getFileExtension() const
+  {
+    return _samples ? "sbwt" : "bwt";
+  }
+
+ private:
+  constexpr static std::uint32_t BLOCK_BYTES = 1U << 20;
+  constexpr static int NSTREAMS_SHIFT = 24;
+  constexpr static std::uint32_t SAMPLE_FLAG = 0x80;
+  constexpr static unsigned long long MAX_BLOCK_HEADER_BYTES =
+      (bwt::BlockStreams + 1) * sizeof(std::uint32_t);
+  const bool _samples;
+  std::vector<std::int32_t> _suffixes;
+  std::vector<std::uint32_t> _lf_rows;
+
+  static unsigned long long blockHeaderSize(const int nstreams)
+  {
+    return (nstreams + 1) * sizeof(std::uint32_t);
+  }
+
+  unsigned long long byteBlock(const std::uint8_t* data, const std::uint32_t n,
+                               std::uint8_t* out)
+  {
+    const auto nstreams = bwt::blockStreams(n);
+    std::uint32_t rows[bwt::BlockStreams - 1];
+    const auto primary = bwt::byteBWT(data, n, out + blockHeaderSize(nstreams),
+                                      rows, nstreams, _suffixes);
+    std::uint32_t words[bwt::BlockStreams + 1] = {
+        n, primary | (std::uint32_t(nstreams - 1) << NSTREAMS_SHIFT)};
+    std::copy(rows, rows + nstreams - 1, words + 2);
+    // Blocks start at any byte, so the words are copied rather than stored
+    std::memcpy(out, words, blockHeaderSize(nstreams));
+    return blockHeaderSize(nstreams) + n;
+  }
+
+  // The samples of a block start at any byte, so they are copied to and from
+  // arrays of T before easyBWT() and easyInverseBWT() read them as T
+  template <typename T>
+  static std::tuple<std::unique_ptr<std::uint8_t[]>, std::uint32_t>
+  sampleBWT(const std::uint8_t* data, const std::uint32_t n)
+  {
+    std::vector<T> samples(n / sizeof(T));
+    std::memcpy(samples.data(), data, n);
+    auto [bwt, first, last] = easyBWT(samples.data(), samples.size());
+    return {std::move(bwt), last};
+  }
+
+  template <typename T>
+  static void inverseSampleBWT(const std::uint8_t* bwt,
+                               const unsigned long long nsamples,
+                               const std::uint32_t last, std::uint8_t* out)
+  {
+    std::vector<T> samples(nsamples + 1);
+    std::memcpy(samples.data(), bwt, samples.size() * sizeof(T));
+    std::vector<T> decoded(nsamples);
+    easyInverseBWT(samples.data(), nsamples, last, decoded.data());
+    std::memcpy(out, decoded.data(), nsamples * sizeof(T));
+  }
+
+  static unsigned long long sampleBlock(const std::uint8_t* data,
+                                        const std::uint32_t n, const int width,
+                                        std::uint8_t* out)
+  {
+    auto [bwt, last] = width == 2 ? sampleBWT<std::uint16_t>(data, n)
+                                  : sampleBWT<std::uint32_t>(data, n);
+    const std::uint32_t words[] = {
+        n, last | ((SAMPLE_FLAG | width) << NSTREAMS_SHIFT)};
+    std::memcpy(out, words, sizeof(words));
+    std::copy(bwt.get(), bwt.get() + n + width, out + blockHeaderSize(1));
+    return blockHeaderSize(1) + n + width;
+  }
+
+  struct Block
+  {
+    std::uint32_t length;
+    // The end-of-line row of sample blocks
+    std::uint32_t primary;
+    int nstreams;
+    std::uint32_t rows[bwt::BlockStreams - 1];
+    // Bytes per sample of sample blocks, else 0
+    int width;
+    unsigned long long end;  // Offset of the end of the block
+  };
+  static Block readBlock(const std::uint8_t* data,
+                         const unsigned long long length,
+                         const unsigned long long pos)
+  {
+    if (length - pos < blockHeaderSize(1))
+      throw std::runtime_error("BWT stage block header is truncated");
+    Block block;
+    std::uint32_t word;
+    std::memcpy(&block.length, data + pos, sizeof(block.length));
+    std::memcpy(&word, data + pos + 4, sizeof(word));
+    const auto kind = word >> NSTREAMS_SHIFT;
+    block.primary = word & ((1U << NSTREAMS_SHIFT) - 1);
+    if (kind & SAMPLE_FLAG) {
+      block.nstreams = 1;
+      block.width = int(kind & ~SAMPLE_FLAG);
+      if (block.length == 0 || (block.width != 2 && block.width != 4) ||
+          block.length % block.width != 0)
+        throw std::runtime_error("BWT stage block header is malformed");
+      block.end = pos + blockHeaderSize(1) + block.length + block.width;
+    } else {
+      block.nstreams = int(kind) + 1;
+      block.width = 0;
+      if (block.length == 0 || block.nstreams > bwt::BlockStreams)
+        throw std::runtime_error("BWT stage block header is malformed");
+      block.end = pos + blockHeaderSize(block.nstreams) + block.length;
+    }
+    if (block.end > length)
+      throw std::runtime_error("BWT stage block is truncated");
+    std::memcpy(block.rows, data + pos + blockHeaderSize(1),
+                (block.nstreams - 1) * sizeof(std::uint32_t));
+    return block;
+  }
+};
+
+// The smallest and largest bytes followed by their MTF indices
+class mtf_stage : public transform
+{
+ public:
+  virtual unsigned long long maxCompressedSize(
+      const unsigned long long length, const sfc::sfcc_header& header) const
+  {
+    return length + 2;
+  }
+  virtual std::tuple<unsigned long long, sfc::sfcc_header> compressInto(
+      const std::uint8_t* data, const unsigned long long length,
+      std::uint8_t* output, const unsigned long long capacity,
+      const sfc::sfcc_header& header)
+  {
+    requireCapacity(capacity, maxCompressedSize(length, header));
+    const auto [min, max] = mtf::encode<std::uint8_t, std::uint8_t>(
+        data, length, output + 2, _alphabet);
+    output[0] = min;
+    output[1] = max;
+    return {length + 2, header};
+  }
+  virtual unsigned long long maxDecompressedSize(
+      const std::uint8_t* data, const unsigned long long length,
+      const sfc::sfcc_header& header) const
+  {
+    if (length < 2) throw std::runtime_error("MTF stage is truncated");
+    return length - 2;
+  }
+  virtual std::tuple<unsigned long long, sfc::sfcc_header> decompressInto(
+      const std::uint8_t* data, const unsigned long long length,
+      std::uint8_t* output, const unsigned long long capacity,
+      const sfc::sfcc_header& header)
+  {
+    const auto output_length = maxDecompressedSize(data, length, header);
+    requireCapacity(capacity, output_length);
+    if (data[0] > data[1])
+      throw std::runtime_error("MTF stage alphabet is malformed");
+    mtf::decode<std::uint8_t, std::uint8_t>(data + 2, output_length, data[0],
+                                            data[1], output, _alphabet);
+    return {output_length, header};
+  }
+  virtual std::string getFileExtension() const { return "mtf"; }
+
+ private:
+  std::vector<std::uint8_t> _alphabet;
+};
+
+// Residuals of the values from a predictor, of the same length
+class predict_stage : public transform
+{
+ public:
+  predict_stage(const predictor_t predictor)
+      : _predictor{predictor},
+        _name{predictor == predictor_t::DELTA ? "delta" : "lorenzo"}
+  {}
+
+  virtual unsigned long long maxCompressedSize(
+      const unsigned long long length, const sfc::sfcc_header& header) const
+  {
+    return length;
+  }
+  virtual std::tuple<unsigned long long, sfc::sfcc_header> compressInto(
+      const std::uint8_t* data, const unsigned long long length,
+      std::uint8_t* output, const unsigned long long capacity,
+      const sfc::sfcc_header& header)
+  {
+    requireCapacity(capacity, length);
+    _predictor.predict(data, output, length, header);
+    return {length, header};
+  }
+  virtual unsigned long long maxDecompressedSize(
+      const std::uint8_t* data, const unsigned long long length,
+      const sfc::sfcc_header& header) const
+  {
+    return length;
+  }
+  virtual std::tuple<unsigned long long, sfc::sfcc_header> decompressInto(
+      const std::uint8_t* data, const unsigned long long length,
+      std::uint8_t* output, const unsigned long long capacity,
+      const sfc::sfcc_header& header)
+  {
+    requireCapacity(capacity, length);
+    _predictor.reverse(data, output, length, header);
+    return {length, header};
+  }
+  virtual std::string getFileExtension() const { return _name; }
+
+ private:
+  Predictor _predictor;
+  const std::string _name;
+};
+
+std::unique_ptr<compressor> makeStage(const std::uint8_t stage,
+                                      const std::optional<int> level)
+{
+  switch (stage_t(stage)) {
+    case stage_t::BITSHUFFLE:
+      return std::make_unique<bitshuffle_stage>();
+    case stage_t::BYTESHUFFLE:
+      return std::make_unique<byteshuffle_stage>();
+    case stage_t::BWT:
+      return std::make_unique<bwt_stage>();
+    case stage_t::SAMPLE_BWT:
+      return std::make_unique<bwt_stage>(true);
+    case stage_t::MTF:
+      return std::make_unique<mtf_stage>();
+    case stage_t::DELTA:
+      return std::make_unique<predict_stage>(predictor_t::DELTA);
+    case stage_t::LORENZO:
+      return std::make_unique<predict_stage>(predictor_t::LORENZO);
+  }
+  return make_compressor(compression_t(stage & ~codec_stage), false, level);
+}
+
+// Whether the output of stage is values of the width of its input
+bool keepsWidth(const std::uint8_t stage)
+{
+  switch (stage_t(stage)) {
+    case stage_t::BITSHUFFLE:
+    case stage_t::BYTESHUFFLE:
+    case stage_t::DELTA:
+    case stage_t::LORENZO:
+      return true;
+    default:
+      return false;
+  }
+}
+}  // namespace
+
+bool validStage(const std::uint8_t stage)
+{
+  if (!(stage & codec_stage))
+    return stage >= std::uint8_t(stage_t::BITSHUFFLE) &&
+           stage <= std::uint8_t(stage_t::SAMPLE_BWT);
+  switch (compression_t(stage & ~codec_stage)) {
+    case compression_t::RLE:
+    case compression_t::HUFFMAN:
+    case compression_t::LZ77:
+    case compression_t::LZ78:
+    case compression_t::LZW:
+    case compression_t::DEFLATE:
+    case compression_t::HUFFMAN16:
+    case compression_t::HUFFMAN16_X4:
+    case compression_t::FSE:
+    case compression_t::BITPLANE:
+    case compression_t::RLE_VARINT:
+      return true;
+    default:
+      return false;
+  }
+}
+
+std::uint8_t parseStage(const std::string& name)
+{
+  const auto lower = toLower(name);
+  if (lower == "bitshuffle" || lower == "bittranspose")
+    return std::uint8_t(stage_t::BITSHUFFLE);
+  if (lower == "byteshuffle") return std::uint8_t(stage_t::BYTESHUFFLE);
+  if (lower == "bwt") return std::uint8_t(stage_t::BWT);
+  if (lower == "sbwt") return std::uint8_t(stage_t::SAMPLE_BWT);
+  if (lower == "mtf") return std::uint8_t(stage_t::MTF);
+  if (lower == "delta") return std::uint8_t(stage_t::DELTA);
+  if (lower == "lorenzo") return std::uint8_t(stage_t::LORENZO);
+  const auto codec = ::sfc::sfcc::compression_string_t.find(toUpper(name));
+  if (codec != ::sfc::sfcc::compression_string_t.end()) {
+    const auto stage = codec_stage | std::uint8_t(codec->second);
+    if (validStage(stage)) return stage;
+  }
+  throw std::invalid_argument("Unknown pipeline stage: " + name);
+}
+
+std::string stageName(const std::uint8_t stage)
+{
+  if (!validStage(stage))
+    throw std::invalid_argument("Unknown pipeline stage " +
+                                std::to_string(stage));
+  switch (stage_t(stage)) {
+    case stage_t::BITSHUFFLE:
+      return "bitshuffle";
+    case stage_t::BYTESHUFFLE:
+      return "byteshuffle";
+    case stage_t::BWT:
+      return "bwt";
+    case stage_t::SAMPLE_BWT:
+      return "sbwt";
+    case stage_t::MTF:
+      return "mtf";
+    case stage_t::DELTA:
+      return "delta";
+    case stage_t::LORENZO:
+      return "lorenzo";
+  }
+  return toLower(::sfc::sfcc::tostring(compression_t(stage & ~codec_stage)));
+}
+
+pipeline_spec parsePipeline(const std::string& spec)
+{
+  pipeline_spec result;
+  std::size_t start = 0;
+  for (auto first = true; start <= spec.size(); first = false) {
+    auto end = spec.find('|', start);
+    if (end == std::string::npos) end = spec.size();
+    const auto name = trim(spec.substr(start, end - start));
+    start = end + 1;
+    if (name.empty())
+      throw std::invalid_argument("Pipeline \"" + spec +
+                                  "\" has an empty stage");
+    const auto curve = ::sfc::sfcc::sfc_string_t.find(toUpper(name));
+    if (first && curve != ::sfc::sfcc::sfc_string_t.end()) {
+      result.curve = curve->second;
+      continue;
+    }
+    result.stages.push_back(parseStage(name));
+  }
+  if (result.stages.empty())
+    throw std::invalid_argument("Pipeline \"" + spec + "\" has no stages");
+  if (result.stages.size() > MaxPipelineStages)
+    throw std::invalid_argument("Pipelines have at most " +
+                                std::to_string(MaxPipelineStages) +
+                                " stages");
+  return result;
+}
+
+std::string pipelineToString(const std::vector<std::uint8_t>& stages)
+{
+  std::string result;
+  for (const auto stage : stages)
+    result += (result.empty() ? "" : "|") + stageName(stage);
+  return result;
+}
+
+// PIPELINE
+pipeline::pipeline(const std::vector<std::uint8_t>& stages,
+                   const std::optional<int> level)
+    : _stages{stages}
+{
+  if (_stages.empty() || _stages.size() > MaxPipelineStages)
+    throw std::invalid_argument("Pipelines have 1 to " +
+                                std::to_string(MaxPipelineStages) +
+                                " stages, not " +
+                                std::to_string(_stages.size()));
+  for (const auto stage : _stages) {
+    if (!validStage(stage))
+      throw std::invalid_argument("Unknown pipeline stage " +
+                                  std::to_string(stage));
+    _compressors.push_back(makeStage(stage, level));
+  }
+}
+pipeline::~pipeline() {}
+
+sfc::sfcc_header pipeline::stageHeader(const sfc::sfcc_header& header,
+                                       const std::size_t i,
+                                       const unsigned long long length) const
+{
+  auto head = header;
+  head.compressiontype = compression_t::NONE;
+  head.npaddingbits.reset();
+  head.lzw_dict_nbits.reset();
+  head.bittransposed = i > 0 && _stages[i - 1] == std::uint8_t(
+                                                     stage_t::BITSHUFFLE);
+  head.bittranspose_block_nbits.reset();
+  head.byteshuffled = i > 0 && _stages[i - 1] == std::uint8_t(
+                                                    stage_t::BYTESHUFFLE);
+  head.pipeline_stages.clear();
+  head.output_block_length.reset();
+  for (std::size_t j = 0; j < i; j++)
+    if (!keepsWidth(_stages[j])) head.dtype_nbytes = 1;
+  if (head.dtype_nbytes == 0 || length % head.dtype_nbytes != 0)
+    head.dtype_nbytes = 1;
+  return head;
+}
+
+unsigned long long pipeline::maxCompressedSize(
+    const unsigned long long length, const sfc::sfcc_header& header) const
+{
+  // The stages only see byte values after the first that does not keep their
+  // width, so the bound of each stage holds for any input up to its length
+  auto bound = length;
+  for (std::size_t i = 0; i < _stages.size(); i++)
+    bound = _compressors[i]->maxCompressedSize(bound,
+                                               stageHeader(header, i, bound));
+  return tableSize() + bound;
+}
+
+std::tuple<unsigned long long, sfc::sfcc_header> pipeline::compressInto(
+    const std::uint8_t* data, const unsigned long long length,
+    std::uint8_t* output, const unsigned long long capacity,
+    const sfc::sfcc_header& header)
+{
+  requireCapacity(capacity, maxCompressedSize(length, header));
+  auto input = data;
+  auto input_length = length;
+  for (std::size_t i = 0; i < _stages.size(); i++) {
+    const auto head = stageHeader(header, i, input_length);
+    std::uint8_t* stage_output = output + tableSize();
+    auto stage_capacity = capacity - tableSize();
+    if (i + 1 < _stages.size()) {
+      auto& buffer = _buffers[i % 2];
+      const auto bound = _compressors[i]->maxCompressedSize(input_length, head);
+      if (buffer.size() < bound) buffer.resize(bound);
+      stage_output = buffer.data();
+      stage_capacity = buffer.size();
+    }
+    unsigned long long output_length = 0;
+    std::uint8_t padding = 0;
+    if (input_length > 0) {
+      const auto [written, stage_header] = _compressors[i]->compressInto(
+          input, input_length, stage_output, stage_capacity, head);
+      output_length = written;
+      padding = stage_header.getPaddingBitsByte();
+    }
+    const auto entry = output + i * STAGE_ENTRY_BYTES;
+    // Entries are STAGE_ENTRY_BYTES apart, so most are not aligned
+    std::memcpy(entry, &input_length, sizeof(std::uint64_t));
+    entry[sizeof(std::uint64_t)] = padding;
+    if (::sfc::DEBUG)
+      std::cout << "PIPELINE: " << stageName(_stages[i]) << " "
+                << input_length << " -> " << output_length << std::endl;
+    input = stage_output;
+    input_length = output_length;
+  }
+
+  auto head = header;
+  head.compressiontype = compression_t::PIPELINE;
+  head.pipeline_stages = _stages;
+  return {tableSize() + input_length, head};
+}
+
+unsigned long long pipeline::maxDecompressedSize(
+    const std::uint8_t* data, const unsigned long long length,
+    const sfc::sfcc_header& header) const
+{
+  if (length < tableSize())
+    throw std::runtime_error("Pipeline stage table is truncated");
+  std::uint64_t output_length;
+  std::memcpy(&output_length, data, sizeof(output_length));
+  return output_length;
+}
+
+std::tuple<unsigned long long, sfc::sfcc_header> pipeline::decompressInto(
+    const std::uint8_t* data, const unsigned long long length,
+    std::uint8_t* output, const unsigned long long capacity,
+    const sfc::sfcc_header& header)
+{
+  const auto output_length = maxDecompressedSize(data, length, header);
+  requireCapacity(capacity, output_length);
+  const std::uint8_t* input = data + tableSize();
+  auto input_length = length - tableSize();
+  for (auto i = _stages.size(); i-- > 0;) {
+    const auto entry = data + i * STAGE_ENTRY_BYTES;
+    std::uint64_t stage_length;
+    std::memcpy(&stage_length, entry, sizeof(stage_length));
+    std::uint8_t* stage_output = output;
+    if (i > 0) {
+      auto& buffer = _buffers[i % 2];
+      if (buffer.size() < stage_length) buffer.resize(stage_length);
+      stage_output = buffer.data();
+    }
+    if (stage_length > 0) {
+      auto head = stageHeader(header, i, stage_length);
+      head.compressiontype = _compressors[i]->getCompressionType();
+      head.setPaddingBitsByte(entry[sizeof(std::uint64_t)]);
+      head.output_block_length = stage_length;
+      const auto [written, stage_header] = _compressors[i]->decompressInto(
+          input, input_length, stage_output, stage_length, head);
+      if (written != stage_length)
+        throw std::runtime_error(
+            "Pipeline stage " + stageName(_stages[i]) + " decoded " +
+            std::to_string(written) + " bytes, expected " +
+            std::to_string(stage_length));
+    }
+    input = stage_output;
+    input_length = stage_length;
+  }
+
+  auto head = header;
+  head.compressiontype = compression_t::NONE;
+  head.pipeline_stages.clear();
+  return {output_length, head};
+}
+
+std::string pipeline::getFileExtension() const { return "pipe"; }
+sfc::sfcc::compression_t pipeline::getCompressionType() const
+{
+  return compression_t::PIPELINE;
+}
+
+}  // namespace sfcc
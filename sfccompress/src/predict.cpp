@@ -0,0 +1,205 @@
+/**
+ * @file predict.cpp
+ * @author Conrad Haupt (conrad@conradhaupt.co.za)
+ * @brief Predictive coding of values as residuals of their neighbours
+ * @version 1.0
+ * @date 2020-03-28
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#include "predict.h"
+#include <algorithm>
+#include <stdexcept>
+#include "reorder.h"
+
+namespace sfcc {
+namespace {
+using ::sfc::sfcc::sfc_t;
+
+// 2-byte values are integers already
+std::uint16_t toOrdered(const std::uint16_t value) { return value; }
+std::uint16_t fromOrdered(const std::uint16_t value) { return value; }
+
+// Positive floats have the sign bit set and negative floats all their bits
+// flipped, so that the integers are in the order of the floats
+std::uint32_t toOrdered(const std::uint32_t value)
+{
+  return value & 0x80000000U ? ~value : value | 0x80000000U;
+}
+std::uint32_t fromOrdered(const std::uint32_t value)
+{
+  return value & 0x80000000U ? value & 0x7FFFFFFFU : ~value;
+}
+
+template <typename U>
+U zigzag(const U residual)
+{
+  return U(residual << 1) ^ U(-(residual >> (sizeof(U) * 8 - 1)));
+}
+
+template <typename U>
+U unzigzag(const U value)
+{
+  return U(value >> 1) ^ U(-(value & 1));
+}
+
+unsigned long long nvalues(const std::vector<unsigned long long>& shape)
+{
+  auto n = 1ULL;
+  for (const auto side : shape) n *= side;
+  return n;
+}
+
+template <typename U>
+void predict(const U* __restrict input, U* __restrict output,
+             const std::vector<unsigned long long>& shape)
+{
+  const auto n = nvalues(shape);
+  const auto side = shape[0];
+  for (auto row = 0ULL; row < n; row += side) {
+    output[row] = toOrdered(input[row]);
+    for (auto x = 1ULL; x < side; x++)
+      output[row + x] =
+          toOrdered(input[row + x]) - toOrdered(input[row + x - 1]);
+  }
+  // From the last slice of the axis back, so that each slice subtracts the
+  // one before it while it still holds its own values
+  auto stride = side;
+  for (std::size_t axis = 1; axis < shape.size(); axis++) {
+    const auto block = stride * shape[axis];
+    for (auto base = 0ULL; base < n; base += block) {
+      for (auto c = shape[axis] - 1; c > 0; c--) {
+        U* __restrict slice = output + base + c * stride;
+        const U* __restrict before = slice - stride;
+        for (auto j = 0ULL; j < stride; j++) slice[j] -= before[j];
+      }
+    }
+    stride = block;
+  }
+  for (auto i = 0ULL; i < n; i++) output[i] = zigzag(output[i]);
+}
+
+template <typename U>
+void reversePredict(const U* __restrict input, U* __restrict output,
+                    const std::vector<unsigned long long>& shape)
+{
+  const auto n = nvalues(shape);
+  for (auto i = 0ULL; i < n; i++) output[i] = unzigzag(input[i]);
+  // The differences commute, so their sums can be undone in any order, the
+  // slower axes first as they vectorise across rows
+  auto stride = shape[0];
+  for (std::size_t axis = 1; axis < shape.size(); axis++) {
+    const auto block = stride * shape[axis];
+    for (auto base = 0ULL; base < n; base += block) {
+      for (auto c = 1ULL; c < shape[axis]; c++) {
+        U* __restrict slice = output + base + c * stride;
+        const U* __restrict before = slice - stride;
+        for (auto j = 0ULL; j < stride; j++) slice[j] += before[j];
+      }
+    }
+    stride = block;
+  }
+  const auto side = shape[0];
+  for (auto row = 0ULL; row < n; row += side)
+    for (auto x = 1ULL; x < side; x++) output[row + x] += output[row + x - 1];
+  for (auto i = 0ULL; i < n; i++) output[i] = fromOrdered(output[i]);
+}
+
+void requireShape(const std::vector<unsigned long long>& shape,
+                  const int nbytes)
+{
+  if (nbytes != 2 && nbytes != 4)
+    throw std::invalid_argument("Prediction needs 2- or 4-byte values, not " +
+                                std::to_string(nbytes));
+  if (shape.empty() || std::find(shape.begin(), shape.end(), 0ULL) !=
+                           shape.end())
+    throw std::invalid_argument("Prediction needs a non-empty array");
+}
+}  // namespace
+
+void predictValues(const std::uint8_t* input, std::uint8_t* output,
+                   const std::vector<unsigned long long>& shape,
+                   const int nbytes)
+{
+  requireShape(shape, nbytes);
+  if (nbytes == 2)
+    predict((const std::uint16_t*)input, (std::uint16_t*)output, shape);
+  else
+    predict((const std::uint32_t*)input, (std::uint32_t*)output, shape);
+}
+
+void reversePredictValues(const std::uint8_t* input, std::uint8_t* output,
+                          const std::vector<unsigned long long>& shape,
+                          const int nbytes)
+{
+  requireShape(shape, nbytes);
+  if (nbytes == 2)
+    reversePredict((const std::uint16_t*)input, (std::uint16_t*)output,
+                   shape);
+  else
+    reversePredict((const std::uint32_t*)input, (std::uint32_t*)output,
+                   shape);
+}
+
+// PREDICTOR
+std::vector<unsigned long long> Predictor::shape(
+    const unsigned long long length, const sfc::sfcc_header& header) const
+{
+  const auto nbytes = header.dtype_nbytes;
+  if (nbytes == 0 || length % nbytes != 0)
+    throw std::invalid_argument("Length must be divisible by dtype_nbytes");
+  if (_predictor == predictor_t::DELTA) return {length / nbytes};
+  const auto side = 1ULL << header.sidelength_k;
+  std::vector<unsigned long long> shape(header.ndims, side);
+  if (header.ndims == 0 || nvalues(shape) * nbytes != length)
+    throw std::invalid_argument(
+        "Lorenzo prediction needs the whole array of the header");
+  if (header.sfctype != sfc_t::ROW_MAJOR && header.ndims != 2 &&
+      header.ndims != 3)
+    throw std::invalid_argument(
+        "Lorenzo prediction along a curve needs a 2D or 3D array");
+  return shape;
+}
+
+void Predictor::predict(const std::uint8_t* input, std::uint8_t* output,
+                        const unsigned long long length,
+                        const sfc::sfcc_header& header)
+{
+  const auto values = shape(length, header);
+  if (_predictor == predictor_t::DELTA ||
+      header.sfctype == sfc_t::ROW_MAJOR) {
+    predictValues(input, output, values, header.dtype_nbytes);
+    return;
+  }
+  const auto side = 1ULL << header.sidelength_k;
+  _scratch.assign(input, input + length);
+  make_reorderer(header.ndims, side, header.sfctype, sfc_t::ROW_MAJOR)
+      ->reorder_withtemporary_vardtype(_scratch.data(), length,
+                                       header.dtype_nbytes);
+  predictValues(_scratch.data(), output, values, header.dtype_nbytes);
+  make_reorderer(header.ndims, side, sfc_t::ROW_MAJOR, header.sfctype)
+      ->reorder_withtemporary_vardtype(output, length, header.dtype_nbytes);
+}
+
+void Predictor::reverse(const std::uint8_t* input, std::uint8_t* output,
+                        const unsigned long long length,
+                        const sfc::sfcc_header& header)
+{
+  const auto values = shape(length, header);
+  if (_predictor == predictor_t::DELTA ||
+      header.sfctype == sfc_t::ROW_MAJOR) {
+    reversePredictValues(input, output, values, header.dtype_nbytes);
+    return;
+  }
+  const auto side = 1ULL << header.sidelength_k;
+  _scratch.assign(input, input + length);
+  make_reorderer(header.ndims, side, header.sfctype, sfc_t::ROW_MAJOR)
+      ->reorder_withtemporary_vardtype(_scratch.data(), length,
+                                       header.dtype_nbytes);
+  reversePredictValues(_scratch.data(), output, values, header.dtype_nbytes);
+  make_reorderer(header.ndims, side, sfc_t::ROW_MAJOR, header.sfctype)
+      ->reorder_withtemporary_vardtype(output, length, header.dtype_nbytes);
+}
+
+}  // namespace sfcc
@@ -0,0 +1,234 @@
+/**
+ * @file rle_varint.cpp
+ * @author Conrad Haupt (conrad@conradhaupt.co.za)
+ * @brief Run-length coding with variable-length counts
+ * @version 1.0
+ * @date 2020-03-20
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#include "rle_varint.h"
+#include <algorithm>
+#include <cstring>
+#ifdef __AVX2__
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace rle {
+namespace {
+
+// Runs are found by comparing a vector of bytes at a time. Bit i of the mask is
+// set if byte i of both inputs is equal.
+#ifdef __AVX2__
+constexpr int VectorBytes = 32;
+inline std::uint32_t equalBytes(const std::uint8_t* a, const std::uint8_t* b)
+{
+  const auto va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a));
+  const auto vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b));
+  return _mm256_movemask_epi8(_mm256_cmpeq_epi8(va, vb));
+}
+#elif defined(__SSE2__)
+constexpr int VectorBytes = 16;
+inline std::uint32_t equalBytes(const std::uint8_t* a, const std::uint8_t* b)
+{
+  const auto va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a));
+  const auto vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b));
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(va, vb));
+}
+#else
+constexpr int VectorBytes = 8;
+inline std::uint32_t equalBytes(const std::uint8_t* a, const std::uint8_t* b)
+{
+  std::uint32_t mask = 0;
+  for (auto i = 0; i < VectorBytes; i++)
+    mask |= std::uint32_t(a[i] == b[i]) << i;
+  return mask;
+}
+#endif
+constexpr std::uint32_t AllEqual =
+    std::uint32_t((std::uint64_t(1) << VectorBytes) - 1);
+
+// Mask with a bit for the first byte of every element
+template <typename T>
+constexpr std::uint32_t elementStarts()
+{
+  std::uint32_t mask = 0;
+  for (std::size_t i = 0; i < VectorBytes; i += sizeof(T)) mask |= 1U << i;
+  return mask;
+}
+
+// Reduce a byte mask to the first byte of elements whose bytes are all set
+template <typename T>
+inline std::uint32_t wholeElements(const std::uint32_t mask)
+{
+  auto elements = mask;
+  for (std::size_t shift = 1; shift < sizeof(T); shift++)
+    elements &= mask >> shift;
+  return elements & elementStarts<T>();
+}
+
+// First position from pos at which MinRun equal elements begin, or nelements
+template <typename T>
+std::uint64_t findRun(const T* input, std::uint64_t pos,
+                      const std::uint64_t nelements)
+{
+  constexpr auto VectorElements = VectorBytes / sizeof(T);
+  const auto bytes = reinterpret_cast<const std::uint8_t*>(input);
+  for (; pos + (MinRun - 1) + VectorElements <= nelements;
+       pos += VectorElements) {
+    const auto at = bytes + pos * sizeof(T);
+    const auto mask = equalBytes(at, at + sizeof(T)) &
+                      equalBytes(at, at + 2 * sizeof(T)) &
+                      equalBytes(at, at + 3 * sizeof(T));
+    const auto starts = wholeElements<T>(mask);
+    if (starts != 0) return pos + __builtin_ctz(starts) / sizeof(T);
+  }
+  static_assert(MinRun == 4, "The run test compares four elements");
+  for (; pos + MinRun <= nelements; pos++)
+    if (input[pos] == input[pos + 1] && input[pos] == input[pos + 2] &&
+        input[pos] == input[pos + 3])
+      return pos;
+  return nelements;
+}
+
+// End of the run of equal elements from start, which is at least MinRun long
+template <typename T>
+std::uint64_t findRunEnd(const T* input, const std::uint64_t start,
+                         const std::uint64_t nelements)
+{
+  constexpr auto VectorElements = VectorBytes / sizeof(T);
+  const auto bytes = reinterpret_cast<const std::uint8_t*>(input);
+  // Every element of the run equals the one before it
+  auto pos = start + MinRun;
+  for (; pos + VectorElements <= nelements; pos += VectorElements) {
+    const auto at = bytes + pos * sizeof(T);
+    const auto mask = equalBytes(at, at - sizeof(T));
+    if (mask != AllEqual) return pos + __builtin_ctz(~mask) / sizeof(T);
+  }
+  while (pos < nelements && input[pos] == input[pos - 1]) pos++;
+  return pos;
+}
+
+inline std::uint8_t* writeVarint(std::uint8_t* output, std::uint64_t value)
+{
+  while (value >= 0x80) {
+    *output++ = std::uint8_t(value) | 0x80;
+    value >>= 7;
+  }
+  *output++ = std::uint8_t(value);
+  return output;
+}
+
+[[noreturn]] void malformed()
+{
+  throw std::runtime_error("Malformed data while uncompressing RLE");
+}
+
+inline std::uint64_t readVarint(const std::uint8_t*& input,
+                                const std::uint8_t* end)
+{
+  std::uint64_t value = 0;
+  for (int shift = 0;; shift += 7) {
+    if (input == end || shift > 63) malformed();
+    const auto byte = *input++;
+    value |= std::uint64_t(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) return value;
+  }
+}
+
+}  // namespace
+
+unsigned long long varintMaxEncodedSize(const unsigned long long nelements,
+                                        const int elementBytes)
+{
+  // Literal tokens cost at most two bytes per MaxLiteralRun elements. A run
+  // token saves more than the header of the literal token it may split off.
+  return nelements * elementBytes +
+         2 * ((nelements + MaxLiteralRun - 1) / MaxLiteralRun);
+}
+
+template <typename T>
+unsigned long long varintEncode(const T* input,
+                                const unsigned long long nelements,
+                                std::uint8_t* output)
+{
+  const auto start = output;
+  for (std::uint64_t pos = 0; pos < nelements;) {
+    const auto runStart = findRun(input, pos, nelements);
+    while (pos < runStart) {
+      const auto count = std::min<std::uint64_t>(runStart - pos, MaxLiteralRun);
+      output = writeVarint(output, count << 1);
+      std::memcpy(output, input + pos, count * sizeof(T));
+      output += count * sizeof(T);
+      pos += count;
+    }
+    if (runStart == nelements) break;
+
+    pos = findRunEnd(input, runStart, nelements);
+    output = writeVarint(output, ((pos - runStart) << 1) | 1);
+    std::memcpy(output, input + runStart, sizeof(T));
+    output += sizeof(T);
+  }
+  return output - start;
+}
+
+template <typename T>
+unsigned long long varintDecode(const std::uint8_t* input,
+                                const unsigned long long inSizeBytes,
+                                T* output, const unsigned long long nelements)
+{
+  const auto end = input + inSizeBytes;
+  std::uint64_t pos = 0;
+  while (input != end) {
+    const auto token = readVarint(input, end);
+    const auto count = token >> 1;
+    if (count == 0 || count > nelements - pos) malformed();
+    if (token & 1) {
+      if (std::uint64_t(end - input) < sizeof(T)) malformed();
+      T value;
+      std::memcpy(&value, input, sizeof(T));
+      input += sizeof(T);
+      std::fill(output + pos, output + pos + count, value);
+    } else {
+      if (std::uint64_t(end - input) / sizeof(T) < count) malformed();
+      std::memcpy(output + pos, input, count * sizeof(T));
+      input += count * sizeof(T);
+    }
+    pos += count;
+  }
+  return pos;
+}
+
+template unsigned long long varintEncode<std::uint8_t>(const std::uint8_t*,
+                                                       unsigned long long,
+                                                       std::uint8_t*);
+template unsigned long long varintEncode<std::uint16_t>(const std::uint16_t*,
+                                                        unsigned long long,
+                                                        std::uint8_t*);
+template unsigned long long varintEncode<std::uint32_t>(const std::uint32_t*,
+                                                        unsigned long long,
+                                                        std::uint8_t*);
+template unsigned long long varintEncode<std::uint64_t>(const std::uint64_t*,
+                                                        unsigned long long,
+                                                        std::uint8_t*);
+template unsigned long long varintDecode<std::uint8_t>(const std::uint8_t*,
+                                                       unsigned long long,
+                                                       std::uint8_t*,
+                                                       unsigned long long);
+template unsigned long long varintDecode<std::uint16_t>(const std::uint8_t*,
+                                                        unsigned long long,
+                                                        std::uint16_t*,
+                                                        unsigned long long);
+template unsigned long long varintDecode<std::uint32_t>(const std::uint8_t*,
+                                                        unsigned long long,
+                                                        std::uint32_t*,
+                                                        unsigned long long);
+template unsigned long long varintDecode<std::uint64_t>(const std::uint8_t*,
+                                                        unsigned long long,
+                                                        std::uint64_t*,
+                                                        unsigned long long);
+
+}  // namespace rle
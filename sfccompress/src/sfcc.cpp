@@ -25,14 +25,20 @@ std::unordered_map<std::string, compression_t> compression_string_t{
     {"LZ77", compression_t::LZ77},
     {"LZ78", compression_t::LZ78},
     {"LZW", compression_t::LZW},
-    // {"DEFLATE", compression_t::DEFLATE},
+    {"DEFLATE", compression_t::DEFLATE},
     {"BZIP_LZ77", compression_t::BZIP_LZ77},
     {"BZIP_LZW", compression_t::BZIP_LZW},
-    {"BWT", compression_t::BWT}};
+    {"BWT", compression_t::BWT},
+    {"HUFFMAN16", compression_t::HUFFMAN16},
+    {"HUFFMAN16_X4", compression_t::HUFFMAN16_X4},
+    {"FSE", compression_t::FSE},
+    {"BZIP_FSE", compression_t::BZIP_FSE},
+    {"BITPLANE", compression_t::BITPLANE},
+    {"RLE_VARINT", compression_t::RLE_VARINT},
+    {"PIPELINE", compression_t::PIPELINE}};
 
 const std::string magicword = "SFCC";
 const std::uint8_t magicword_uint8_t[] = {'S', 'F', 'C', 'C'};
-const std::uint8_t bittranspose_mask = 0b10000000;
 }  // namespace sfcc
 
 sfcc_file::sfcc_file(const std::string& filename) : _data(nullptr)
@@ -67,15 +73,11 @@ sfcc_file::sfcc_file(const std::string& filename) : _data(nullptr)
   std::uint8_t temp;
   file.get((char&)temp);
 
-  // Extract bittranspose
-  auto bittranspose_int = temp & sfcc::bittranspose_mask;
-  // Reset bit in sfc type int
-  temp &= ~sfcc::bittranspose_mask;
-  header.sfctype = sfcc::sfc_t(temp);
-  header.bittransposed = bittranspose_int != 0;
+  // Extract bittranspose and its block size from the sfc type
+  header.setSfcTypeByte(temp);
 
   if (::sfc::DEBUG)
-    std::cout << "sfctype=" << int(temp)
+    std::cout << "sfctype=" << int(std::uint8_t(header.sfctype))
               << ", bit-transposed=" << (header.bittransposed ? "yes" : "no")
               << std::endl;
 
@@ -85,7 +87,12 @@ sfcc_file::sfcc_file(const std::string& filename) : _data(nullptr)
           header.compressiontype)) {
     std::uint8_t temp;
     file.get((char&)temp);
-    header.npaddingbits = temp;
+    header.setPaddingBitsByte(temp);
+  }
+  if (header.compressiontype == sfcc::compression_t::PIPELINE) {
+    file.get((char&)temp);
+    header.pipeline_stages.resize(temp);
+    file.read((char*)header.pipeline_stages.data(), temp);
   }
 
   _header = header;
@@ -116,17 +123,20 @@ std::unique_ptr<std::uint8_t[]> HeaderToArray(const sfcc_header& header)
   ptr[index++] = header.sidelength_k;
   ptr[index++] = header.dtype_nbytes;
   // Encode bittransposed into sfctype
-  auto sfctype_int = std::uint8_t(header.sfctype);
-  if (header.bittransposed) sfctype_int |= sfcc::bittranspose_mask;
-
-  ptr[index++] = sfctype_int;
+  ptr[index++] = header.getSfcTypeByte();
   ptr[index++] = std::uint8_t(header.compressiontype);
   if (header.npaddingbits && sfc::sfcc_header::CompressionRequiresPaddingBits(
                                  header.compressiontype)) {
     if (::sfc::DEBUG)
       std::cout << "npaddingbits = "
                 << std::uint16_t(header.npaddingbits.value()) << std::endl;
-    ptr[index++] = std::uint8_t(header.npaddingbits.value());
+    ptr[index++] = header.getPaddingBitsByte();
+  }
+  if (header.compressiontype == sfcc::compression_t::PIPELINE) {
+    if (header.pipeline_stages.size() > UINT8_MAX)
+      throw std::invalid_argument("Pipelines hold at most 255 stages");
+    ptr[index++] = header.pipeline_stages.size();
+    for (auto stage : header.pipeline_stages) ptr[index++] = stage;
   }
   return std::move(ptr);
 }
@@ -0,0 +1,566 @@
+/**
+ * @file stats.cpp
+ * @author Conrad Haupt (conrad@conradhaupt.co.za)
+ * @brief Block entropy and value statistics of sfcc files
+ * @version 1.0
+ * @date 2020-03-27
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#include "stats.h"
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include "reorder.h"
+
+namespace sfcc {
+namespace {
+using ::sfc::sfcc::compression_t;
+using ::sfc::sfcc::sfc_t;
+
+// Bytes between clearing the order-1 counts when there are no blocks, few
+// enough that no 32-bit count overflows
+constexpr unsigned long long ChunkBytes = 1ULL << 20;
+
+double nlog2n(const unsigned long long n) { return n ? n * std::log2(n) : 0; }
+
+// Entropy in bits of count symbols given the sum of n log2 n of their counts
+double entropyBits(const double sumNLogN, const unsigned long long count)
+{
+  return count ? std::log2(count) - sumNLogN / count : 0;
+}
+
+// Moments and runs of a sequence of values, merged in the order of the
+// sequence with Chan's update of the variance
+struct Moments
+{
+  unsigned long long count = 0;
+  double mean = 0;
+  double m2 = 0;
+  double min = std::numeric_limits<double>::infinity();
+  double max = -std::numeric_limits<double>::infinity();
+  unsigned long long nruns = 0;
+  unsigned long long max_run = 0;
+  // Runs at either end, which may continue into a neighbouring sequence
+  unsigned long long first_run = 0;
+  unsigned long long last_run = 0;
+  double first = 0;
+  double last = 0;
+
+  void merge(const Moments& next)
+  {
+    if (next.count == 0) return;
+    if (count == 0) {
+      *this = next;
+      return;
+    }
+    const auto joined = last == next.first;
+    const auto total = count + next.count;
+    const auto delta = next.mean - mean;
+    mean += delta * next.count / total;
+    m2 += next.m2 + delta * delta * count / total * next.count;
+    min = std::min(min, next.min);
+    max = std::max(max, next.max);
+    max_run = std::max(max_run, next.max_run);
+    if (joined) {
+      max_run = std::max(max_run, last_run + next.first_run);
+      if (nruns == 1) first_run += next.first_run;
+      last_run = next.nruns == 1 ? last_run + next.last_run : next.last_run;
+    } else {
+      last_run = next.last_run;
+    }
+    nruns += next.nruns - (joined ? 1 : 0);
+    last = next.last;
+    count = total;
+  }
+};
+
+template <typename T>
+Moments valueMoments(const T* values, const unsigned long long n)
+{
+  Moments m;
+  if (n == 0) return m;
+  double sum = 0;
+  T min = values[0];
+  T max = values[0];
+  for (auto i = 0ULL; i < n; i++) {
+    sum += values[i];
+    min = std::min(min, values[i]);
+    max = std::max(max, values[i]);
+  }
+  m.count = n;
+  m.mean = sum / n;
+  m.min = min;
+  m.max = max;
+  // The block is still in cache, so a second pass is cheap and exact
+  for (auto i = 0ULL; i < n; i++) {
+    const auto d = values[i] - m.mean;
+    m.m2 += d * d;
+  }
+
+  unsigned long long run = 1;
+  m.nruns = 1;
+  for (auto i = 1ULL; i < n; i++) {
+    if (values[i] == values[i - 1]) {
+      run++;
+      continue;
+    }
+    if (m.nruns == 1) m.first_run = run;
+    m.max_run = std::max(m.max_run, run);
+    m.nruns++;
+    run = 1;
+  }
+  if (m.nruns == 1) m.first_run = run;
+  m.max_run = std::max(m.max_run, run);
+  m.last_run = run;
+  m.first = values[0];
+  m.last = values[n - 1];
+  return m;
+}
+
+// The values of length bytes of data, widened so that their differences fit
+void readValues(const std::uint8_t* data, const unsigned long long length,
+                const value_t type, std::vector<std::int32_t>& values)
+{
+  values.resize(length / valueBytes(type));
+  if (type == value_t::INT16) {
+    const auto in = reinterpret_cast<const std::int16_t*>(data);
+    std::copy(in, in + values.size(), values.begin());
+  } else {
+    std::copy(data, data + values.size(), values.begin());
+  }
+}
+
+// Counts of integers from lowest on
+class Histogram
+{
+ private:
+  std::int32_t _lowest;
+  std::vector<unsigned long long> _counts;
+
+ public:
+  Histogram(const std::int32_t lowest, const std::int32_t highest)
+      : _lowest{lowest}, _counts(highest - lowest + 1)
+  {}
+
+  void add(const std::int32_t value) { _counts[value - _lowest]++; }
+
+  // The value of rank k from 0 in sorted order
+  std::int32_t kth(unsigned long long k) const
+  {
+    for (std::size_t i = 0; i < _counts.size(); i++) {
+      if (k < _counts[i]) return _lowest + std::int32_t(i);
+      k -= _counts[i];
+    }
+    throw std::logic_error("Histogram holds fewer values than the rank");
+  }
+
+  double sumNLog2N() const
+  {
+    double sum = 0;
+    for (const auto count : _counts) sum += nlog2n(count);
+    return sum;
+  }
+};
+
+// The quantile q of count values of rank kth, interpolated between the two
+// values around it as pandas does
+template <typename Rank>
+double quantile(const double q, const unsigned long long count,
+                const Rank& kth)
+{
+  const auto position = q * (count - 1);
+  const auto below = static_cast<unsigned long long>(position);
+  const double low = kth(below);
+  if (below + 1 >= count) return low;
+  return low + (double(kth(below + 1)) - low) * (position - below);
+}
+
+template <typename Rank>
+describe_stats describe(const Moments& m, const Rank& kth)
+{
+  const auto nan = std::numeric_limits<double>::quiet_NaN();
+  if (m.count == 0) return {0, nan, nan, nan, nan, nan, nan, nan};
+  return {m.count,
+          m.mean,
+          m.count > 1 ? std::sqrt(m.m2 / (m.count - 1)) : nan,
+          m.min,
+          quantile(0.25, m.count, kth),
+          quantile(0.5, m.count, kth),
+          quantile(0.75, m.count, kth),
+          m.max};
+}
+
+// describe() of a block, whose values are sorted in place
+describe_stats describeSorted(const Moments& m,
+                              std::vector<std::int32_t>& values)
+{
+  std::sort(values.begin(), values.end());
+  return describe(m, [&](const unsigned long long k) { return values[k]; });
+}
+
+// Entropy in bits of sorted values
+double sortedEntropyBits(const std::vector<std::int32_t>& sorted)
+{
+  double sum = 0;
+  for (auto i = 0ULL; i < sorted.size();) {
+    auto j = i + 1;
+    while (j < sorted.size() && sorted[j] == sorted[i]) j++;
+    sum += nlog2n(j - i);
+    i = j;
+  }
+  return entropyBits(sum, sorted.size());
+}
+
+// Byte histograms of blocks, accumulated into those of the whole
+class ByteCounter
+{
+ private:
+  std::vector<std::uint32_t> _pairs;
+  std::vector<unsigned long long> _total_pairs;
+  unsigned long long _total[256]{};
+
+ public:
+  ByteCounter() : _pairs(1 << 16), _total_pairs(1 << 16) {}
+
+  // Order-0 and order-1 entropy of a block in bits per byte
+  std::pair<double, double> block(const std::uint8_t* data,
+                                  const unsigned long long n)
+  {
+    if (n == 0) return {0, 0};
+    // Four tables so that runs of a byte do not wait on one counter
+    std::uint32_t counts[4][256]{};
+    auto i = 0ULL;
+    for (; i + 4 <= n; i += 4) {
+      counts[0][data[i]]++;
+      counts[1][data[i + 1]]++;
+      counts[2][data[i + 2]]++;
+      counts[3][data[i + 3]]++;
+    }
+    for (; i < n; i++) counts[0][data[i]]++;
+    for (i = 1; i < n; i++) _pairs[(data[i - 1] << 8) | data[i]]++;
+
+    double symbols = 0;
+    double contexts = 0;
+    for (auto s = 0; s < 256; s++) {
+      const auto count = counts[0][s] + counts[1][s] + counts[2][s] +
+                         counts[3][s];
+      _total[s] += count;
+      symbols += nlog2n(count);
+      // The last byte is no pair's context
+      contexts += nlog2n(count - (s == data[n - 1] ? 1 : 0));
+    }
+    // Each pair is summed on its first visit and cleared, so that only the
+    // pairs of the block are touched
+    double pairs = 0;
+    for (i = 1; i < n; i++) {
+      const auto pair = (data[i - 1] << 8) | data[i];
+      if (!_pairs[pair]) continue;
+      pairs += nlog2n(_pairs[pair]);
+      _total_pairs[pair] += _pairs[pair];
+      _pairs[pair] = 0;
+    }
+    return {entropyBits(symbols, n), (contexts - pairs) / (n - 1 ? n - 1 : 1)};
+  }
+
+  // The pair that spans two blocks
+  void join(const std::uint8_t last, const std::uint8_t first)
+  {
+    _total_pairs[(last << 8) | first]++;
+  }
+
+  // Order-0 and order-1 entropy of every block so far in bits per byte
+  std::pair<double, double> total(const std::uint8_t lastByte) const
+  {
+    double symbols = 0;
+    double contexts = 0;
+    unsigned long long n = 0;
+    for (auto s = 0; s < 256; s++) {
+      n += _total[s];
+      symbols += nlog2n(_total[s]);
+      contexts += nlog2n(_total[s] - (s == lastByte ? 1 : 0));
+    }
+    double pairs = 0;
+    for (const auto count : _total_pairs) pairs += nlog2n(count);
+    return {entropyBits(symbols, n),
+            n > 1 ? (contexts - pairs) / (n - 1) : 0};
+  }
+};
+
+std::string curveName(const sfc_t curve)
+{
+  switch (curve) {
+    case sfc_t::ROW_MAJOR:
+      return "Raster";
+    case sfc_t::SNAKE_SCAN:
+      return "Snake Scan";
+    case sfc_t::MORTON:
+      return "Morton";
+    case sfc_t::GRAY_CODE:
+      return "Gray Code";
+    case sfc_t::HILBERT:
+      return "Hilbert";
+    default:
+      return "NULL";
+  }
+}
+
+std::string compressionName(const compression_t compression)
+{
+  static const char* names[] = {
+      "None",      "RLE",         "Huffman", "LZ77",     "LZ78", "LZW",
+      "Deflate",   "BWT77",       "BWTW",    "BWT",      "Huffman16",
+      "Huffman16X4", "FSE",       "BWTF",    "BitPlane", "RLEV", "Pipeline"};
+  const auto index = std::size_t(compression);
+  return index < std::size(names) ? names[index] : "Null";
+}
+
+std::string typeName(const value_t type)
+{
+  return type == value_t::INT16 ? "int16" : "uint8";
+}
+
+// The file the variants of a file are named after, as in sfcc_stats.py
+std::string originalName(const std::string& filename)
+{
+  const auto end = filename.find(".sfcc");
+  return end == std::string::npos ? filename : filename.substr(0, end + 5);
+}
+
+std::string jsonString(const std::string& str)
+{
+  std::string out = "\"";
+  for (const auto c : str) {
+    if (c == '"' || c == '\\') out += '\\';
+    out += c;
+  }
+  return out + '"';
+}
+
+std::string jsonNumber(const double value)
+{
+  if (!std::isfinite(value)) return "null";
+  std::ostringstream out;
+  out << std::setprecision(10) << value;
+  return out.str();
+}
+
+void writeDescribeCSV(std::ostream& out, const describe_stats& stats)
+{
+  out << ';' << stats.count << ';' << stats.mean << ';' << stats.std << ';'
+      << stats.min << ';' << stats.q25 << ';' << stats.q50 << ';' << stats.q75
+      << ';' << stats.max;
+}
+
+void writeBlockCSV(std::ostream& out, const file_stats& file,
+                   const std::string& block, const block_stats& stats)
+{
+  out << originalName(file.filename) << ';' << curveName(file.curve) << ';'
+      << (file.bittransposed ? "True" : "False") << ';'
+      << compressionName(file.compression) << ';' << stats.value_entropy;
+  writeDescribeCSV(out, stats.values);
+  writeDescribeCSV(out, stats.diffs);
+  out << ';' << (file.byteshuffled ? "True" : "False") << ';' << block << ';'
+      << stats.offset << ';' << stats.length << ';' << stats.entropy << ';'
+      << stats.entropy1 << ';' << stats.nruns << ';' << stats.max_run << '\n';
+}
+
+void writeDescribeJSON(std::ostream& out, const describe_stats& stats)
+{
+  out << "{\"count\": " << stats.count
+      << ", \"mean\": " << jsonNumber(stats.mean)
+      << ", \"std\": " << jsonNumber(stats.std)
+      << ", \"min\": " << jsonNumber(stats.min)
+      << ", \"25%\": " << jsonNumber(stats.q25)
+      << ", \"50%\": " << jsonNumber(stats.q50)
+      << ", \"75%\": " << jsonNumber(stats.q75)
+      << ", \"max\": " << jsonNumber(stats.max) << "}";
+}
+
+void writeBlockJSON(std::ostream& out, const block_stats& stats)
+{
+  out << "{\"offset\": " << stats.offset << ", \"length\": " << stats.length
+      << ", \"value_entropy\": " << jsonNumber(stats.value_entropy)
+      << ", \"entropy\": " << jsonNumber(stats.entropy)
+      << ", \"entropy1\": " << jsonNumber(stats.entropy1)
+      << ", \"values\": ";
+  writeDescribeJSON(out, stats.values);
+  out << ", \"diffs\": ";
+  writeDescribeJSON(out, stats.diffs);
+  out << ", \"runs\": " << stats.nruns << ", \"max_run\": " << stats.max_run
+      << "}";
+}
+}  // namespace
+
+value_t valueType(const sfc::sfcc_header& header)
+{
+  return header.compressiontype == compression_t::NONE &&
+                 header.dtype_nbytes == 2
+             ? value_t::INT16
+             : value_t::UINT8;
+}
+
+int valueBytes(const value_t type) { return type == value_t::INT16 ? 2 : 1; }
+
+data_stats dataStats(const std::uint8_t* data, const unsigned long long length,
+                     const value_t type, const unsigned long long block_bytes)
+{
+  if (block_bytes % valueBytes(type) != 0)
+    throw std::invalid_argument("Blocks must hold whole values of " +
+                                std::to_string(valueBytes(type)) + " bytes");
+  const auto lowest = type == value_t::INT16
+                          ? std::numeric_limits<std::int16_t>::min()
+                          : std::numeric_limits<std::uint8_t>::min();
+  const auto highest = type == value_t::INT16
+                           ? std::numeric_limits<std::int16_t>::max()
+                           : std::numeric_limits<std::uint8_t>::max();
+  Histogram total_values(lowest, highest);
+  Histogram total_diffs(lowest - highest, highest - lowest);
+  Moments values_moments;
+  Moments diffs_moments;
+  std::vector<std::int32_t> values;
+  std::vector<std::int32_t> diffs;
+  std::int32_t last = 0;
+  auto have_last = false;
+
+  data_stats result{};
+  ByteCounter counter;
+  const auto chunk = block_bytes ? block_bytes : ChunkBytes;
+  for (auto offset = 0ULL; offset < length; offset += chunk) {
+    const auto n = std::min(chunk, length - offset);
+    const auto block = data + offset;
+    if (offset > 0) counter.join(block[-1], block[0]);
+    const auto [entropy, entropy1] = counter.block(block, n);
+
+    // The difference across the boundary only belongs to the whole
+    readValues(block, n, type, values);
+    if (have_last && !values.empty()) {
+      const auto across = values.front() - last;
+      total_diffs.add(across);
+      diffs_moments.merge(valueMoments(&across, 1));
+    }
+    if (!values.empty()) {
+      last = values.back();
+      have_last = true;
+    }
+    diffs.resize(values.empty() ? 0 : values.size() - 1);
+    for (std::size_t i = 0; i < diffs.size(); i++) {
+      diffs[i] = values[i + 1] - values[i];
+      total_diffs.add(diffs[i]);
+    }
+    for (const auto value : values) total_values.add(value);
+    const auto block_values = valueMoments(values.data(), values.size());
+    const auto block_diffs = valueMoments(diffs.data(), diffs.size());
+    values_moments.merge(block_values);
+    diffs_moments.merge(block_diffs);
+    if (!block_bytes) continue;
+
+    block_stats stats{offset, n, 0, entropy / 8, entropy1 / 8};
+    stats.diffs = describeSorted(block_diffs, diffs);
+    stats.values = describeSorted(block_values, values);
+    stats.value_entropy =
+        sortedEntropyBits(values) / (8 * valueBytes(type));
+    stats.nruns = block_values.nruns;
+    stats.max_run = block_values.max_run;
+    result.blocks.push_back(stats);
+  }
+
+  const auto [entropy, entropy1] =
+      counter.total(length ? data[length - 1] : 0);
+  auto& total = result.total;
+  total = {0, length, 0, entropy / 8, entropy1 / 8};
+  total.value_entropy =
+      entropyBits(total_values.sumNLog2N(), values_moments.count) /
+      (8 * valueBytes(type));
+  total.values = describe(values_moments, [&](const unsigned long long k) {
+    return total_values.kth(k);
+  });
+  total.diffs = describe(diffs_moments, [&](const unsigned long long k) {
+    return total_diffs.kth(k);
+  });
+  total.nruns = values_moments.nruns;
+  total.max_run = values_moments.max_run;
+  return result;
+}
+
+std::vector<file_stats> fileStats(const std::string& filename,
+                                  const std::vector<sfc_t>& curves,
+                                  const unsigned long long block_bytes)
+{
+  sfc::sfcc_file file(filename);
+  const auto& header = file.getHeader();
+  const auto type = valueType(header);
+  file_stats stats{filename,           header.sfctype,
+                   header.bittransposed, header.byteshuffled,
+                   header.compressiontype, type};
+  const auto reorderable =
+      header.compressiontype == compression_t::NONE && !header.bittransposed &&
+      !header.byteshuffled &&
+      (header.dtype_nbytes == 2 || header.dtype_nbytes == 4) &&
+      (header.ndims == 2 || header.ndims == 3);
+  std::vector<file_stats> result;
+  if (!reorderable || curves.empty()) {
+    stats.stats = dataStats(file.getData(), file.size(), type, block_bytes);
+    result.push_back(std::move(stats));
+    return result;
+  }
+
+  std::vector<std::uint8_t> data(file.size());
+  for (const auto curve : curves) {
+    std::copy(file.getData(), file.getData() + file.size(), data.begin());
+    const auto reorder = make_reorderer(
+        header.ndims, 1ULL << header.sidelength_k, header.sfctype, curve);
+    reorder->reorder_withtemporary_vardtype(data.data(), data.size(),
+                                            header.dtype_nbytes);
+    stats.curve = curve;
+    stats.stats = dataStats(data.data(), data.size(), type, block_bytes);
+    result.push_back(stats);
+  }
+  return result;
+}
+
+void writeStatsCSV(std::ostream& out, const std::vector<file_stats>& files)
+{
+  out << "Filename;sfc;bit-transposed;compression;Total Entropy;count;mean;"
+         "std;min;25%;50%;75%;max;diff count;diff mean;diff std;diff min;"
+         "diff 25%;diff 50%;diff 75%;diff max;byte-shuffled;block;offset;"
+         "length;byte entropy;order-1 entropy;runs;max run\n";
+  const auto precision = out.precision(10);
+  for (const auto& file : files) {
+    writeBlockCSV(out, file, "all", file.stats.total);
+    for (std::size_t i = 0; i < file.stats.blocks.size(); i++)
+      writeBlockCSV(out, file, std::to_string(i), file.stats.blocks[i]);
+  }
+  out.precision(precision);
+}
+
+void writeStatsJSON(std::ostream& out, const std::vector<file_stats>& files)
+{
+  out << "[";
+  for (std::size_t f = 0; f < files.size(); f++) {
+    const auto& file = files[f];
+    out << (f ? ",\n " : "\n ") << "{\"filename\": "
+        << jsonString(file.filename)
+        << ", \"sfc\": " << jsonString(curveName(file.curve))
+        << ", \"bittransposed\": " << (file.bittransposed ? "true" : "false")
+        << ", \"byteshuffled\": " << (file.byteshuffled ? "true" : "false")
+        << ", \"compression\": "
+        << jsonString(compressionName(file.compression))
+        << ", \"type\": " << jsonString(typeName(file.type))
+        << ",\n  \"total\": ";
+    writeBlockJSON(out, file.stats.total);
+    out << ",\n  \"blocks\": [";
+    for (std::size_t i = 0; i < file.stats.blocks.size(); i++) {
+      out << (i ? ",\n   " : "\n   ");
+      writeBlockJSON(out, file.stats.blocks[i]);
+    }
+    out << "]}";
+  }
+  out << "\n]\n";
+}
+
+}  // namespace sfcc
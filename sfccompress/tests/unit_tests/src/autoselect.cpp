@@ -0,0 +1,53 @@
+/**
+ * @file autoselect.cpp
+ * @author Conrad Haupt (conrad@conradhaupt.co.za)
+ * @brief
+ * @version 1.0
+ * @date 2020-03-26
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#include "autoselect.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include "compressor_data.h"
+
+TEST_P(CompressorDataTestFicture, autoSelectRanksTrialsByObjective)
+{
+  sfcc::auto_options options;
+  options.ntrials = 2;
+  const auto ranked =
+      sfcc::rankCandidates(file.getData(), file.getHeader(), options);
+  ASSERT_EQ(ranked.size(), 2 * options.codecs.size());
+  for (std::size_t i = 1; i < ranked.size(); i++)
+    EXPECT_GE(ranked[i - 1].ratio, ranked[i].ratio);
+  for (const auto& candidate : ranked) {
+    EXPECT_GT(candidate.ratio, 0);
+    EXPECT_GT(candidate.decode_speed, 0);
+    EXPECT_EQ(candidate.score, candidate.ratio);
+  }
+
+  options.objective = sfcc::objective_t::DECODE_SPEED;
+  const auto fastest =
+      sfcc::autoSelect(file.getData(), file.getHeader(), options);
+  const auto speeds =
+      sfcc::rankCandidates(file.getData(), file.getHeader(), options);
+  EXPECT_EQ(fastest.score, fastest.decode_speed);
+  EXPECT_TRUE(std::is_sorted(
+      speeds.begin(), speeds.end(),
+      [](auto& a, auto& b) { return a.decode_speed > b.decode_speed; }));
+}
+
+TEST_P(CompressorDataTestFicture, autoSelectRejectsBadOptions)
+{
+  sfcc::auto_options options;
+  options.objective = sfcc::objective_t::MIXED;
+  options.ratio_weight = 1.5;
+  EXPECT_THROW(sfcc::autoSelect(file.getData(), file.getHeader(), options),
+               std::invalid_argument);
+  options.ratio_weight = 0.5;
+  options.nsamples = 0;
+  EXPECT_THROW(sfcc::autoSelect(file.getData(), file.getHeader(), options),
+               std::invalid_argument);
+}
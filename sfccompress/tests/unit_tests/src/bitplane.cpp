@@ -0,0 +1,80 @@
+/**
+ * @file bitplane.cpp
+ * @author Conrad Haupt (conrad@conradhaupt.co.za)
+ * @brief
+ * @version 1.0
+ * @date 2020-03-14
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#include "bitplane.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "bittranspose.h"
+
+namespace {
+// Smooth 16-bit samples with a little noise in the low bits, bit-transposed.
+// The top planes are constant and the bottom planes are noise.
+std::vector<std::uint8_t> transposedSamples(const std::size_t nsamples)
+{
+  std::srand(0);
+  std::vector<std::uint16_t> samples(nsamples);
+  for (std::size_t i = 0; i < nsamples; i++)
+    samples[i] = 2000 + 1000 * std::sin(i / 500.0) + std::rand() % 4;
+  std::vector<std::uint8_t> data(nsamples * 2);
+  std::memcpy(data.data(), samples.data(), data.size());
+  sfcc::BitTransposer().transpose(data.data(), data.size(), 2);
+  return data;
+}
+}  // namespace
+
+TEST(bitplane, transposedPlanesAreReversible)
+{
+  // Not a multiple of the transposition block, so there are trailing bytes
+  auto data = transposedSamples(100003);
+  const auto planeBytes = bitplane::planeSizeBytes(data.size(), 2);
+  ASSERT_EQ(planeBytes * 16, data.size() - 6);
+  auto [compressed, compressedSize] =
+      bitplane::easyEncode(data.data(), data.size(), 16, planeBytes);
+  EXPECT_LT(compressedSize, data.size() / 2);
+  ASSERT_EQ(bitplane::decodedSizeBytes(compressed.get(), compressedSize),
+            data.size());
+
+  std::vector<std::uint8_t> decoded(data.size());
+  EXPECT_EQ(bitplane::easyDecode(compressed.get(), compressedSize,
+                                 decoded.data(), decoded.size()),
+            data.size());
+  EXPECT_EQ(data, decoded);
+}
+
+TEST(bitplane, flatDataIsReversible)
+{
+  std::srand(0);
+  // Incompressible data is stored, constant data costs nothing
+  for (auto fill : {-1, 0, 0xFF}) {
+    std::vector<std::uint8_t> data(4096);
+    for (auto& value : data) value = fill < 0 ? std::rand() % 256 : fill;
+    auto [compressed, compressedSize] =
+        bitplane::easyEncode(data.data(), data.size(), 1, data.size());
+    EXPECT_LE(compressedSize, data.size() + 32);
+    std::vector<std::uint8_t> decoded(data.size());
+    bitplane::easyDecode(compressed.get(), compressedSize, decoded.data(),
+                         decoded.size());
+    EXPECT_EQ(data, decoded);
+  }
+}
+
+TEST(bitplane, truncatedStreamThrows)
+{
+  auto data = transposedSamples(10000);
+  auto [compressed, compressedSize] = bitplane::easyEncode(
+      data.data(), data.size(), 16, bitplane::planeSizeBytes(data.size(), 2));
+  std::vector<std::uint8_t> decoded(data.size());
+  EXPECT_THROW(bitplane::easyDecode(compressed.get(), compressedSize / 2,
+                                    decoded.data(), decoded.size()),
+               std::runtime_error);
+}
@@ -0,0 +1,61 @@
+/**
+ * @file bitstream.cpp
+ * @author Conrad Haupt (conrad@conradhaupt.co.za)
+ * @brief
+ * @version 1.0
+ * @date 2020-03-02
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#include "bitstream.h"
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <vector>
+
+TEST(bitstream, writesBitsLSBFirst)
+{
+  sfcc::BitStreamWriter writer(8);
+  writer.appendBit(1);
+  writer.appendBitsU64(0b10, 2);
+  writer.appendBitsU64(0b11111, 5);
+  writer.appendBitsU64(0b1, 1);
+  EXPECT_EQ(writer.getBitCount(), 9);
+  EXPECT_EQ(writer.getByteCount(), 2);
+  EXPECT_EQ(writer.getBitStream()[0], 0b11111101);
+  EXPECT_EQ(writer.getBitStream()[1], 0b1);
+}
+
+TEST(bitstream, variableWidthValuesAreReversible)
+{
+  // Start small so that the writer has to grow
+  sfcc::BitStreamWriter writer(8);
+  std::vector<std::pair<std::uint64_t, int>> values;
+  std::srand(0);
+  for (auto i = 0; i < 10000; i++) {
+    const int width = 1 + std::rand() % 64;
+    std::uint64_t value = (std::uint64_t(std::rand()) << 62) ^
+                          (std::uint64_t(std::rand()) << 31) ^ std::rand();
+    if (width < 64) value &= (std::uint64_t(1) << width) - 1;
+    values.push_back({value, width});
+    writer.appendBitsU64(value, width);
+  }
+
+  sfcc::BitStreamReader reader(writer);
+  for (auto [value, width] : values) EXPECT_EQ(reader.readBitsU64(width), value);
+  EXPECT_TRUE(reader.isEndOfStream());
+  EXPECT_THROW(reader.readBitsU64(1), std::runtime_error);
+}
+
+TEST(bitstream, peekDoesNotConsume)
+{
+  sfcc::BitStreamWriter writer;
+  writer.appendBitsU64(0x2d, 7);
+  sfcc::BitStreamReader reader(writer);
+  EXPECT_EQ(reader.peekBits(3), 0x5);
+  EXPECT_EQ(reader.peekBits(7), 0x2d);
+  reader.skipBits(3);
+  EXPECT_EQ(reader.peekBits(4), 0x5);
+  // Bits past the end of the stream read as zero
+  EXPECT_EQ(reader.peekBits(20), 0x5);
+}
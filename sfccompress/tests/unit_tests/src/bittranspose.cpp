@@ -12,7 +12,9 @@
 #include <gtest/gtest.h>
 #include <algorithm>
 #include <cstdint>
+#include <cstdlib>
 #include <ios>
+#include <vector>
 
 TEST(bittranspose, transposesSingleBlock_64)
 {
@@ -68,16 +70,16 @@ TEST(bittranspose, transposesSingleBlock_64)
 
   // Declare output memory
   std::uint64_t** output = new std::uint64_t*[inputLength]();
-  for (auto i = 0; i < sizeof(std::uint64_t) * CHAR_BIT; i++) {
+  for (std::size_t i = 0; i < sizeof(std::uint64_t) * CHAR_BIT; i++) {
     output[i] = new std::uint64_t();
   }
 
   sfcc::bittranspose(values, output);
 
-  for (auto v = 0; v < inputLength; v++) {
+  for (std::size_t v = 0; v < inputLength; v++) {
     EXPECT_EQ(output[v][0], expected[v]);
   }
-  for (auto i = 0; i < inputLength; i++) delete output[i];
+  for (std::size_t i = 0; i < inputLength; i++) delete output[i];
   delete[] output;
 }
 
@@ -90,7 +92,7 @@ TEST(bittranspose, tranposeIsReversable_64)
 
   // Declare output memory
   std::uint64_t** output = new std::uint64_t*[inputLength];
-  for (auto i = 0; i < sizeof(std::uint64_t) * CHAR_BIT; i++) {
+  for (std::size_t i = 0; i < sizeof(std::uint64_t) * CHAR_BIT; i++) {
     output[i] = new std::uint64_t();
   }
 
@@ -102,12 +104,12 @@ TEST(bittranspose, tranposeIsReversable_64)
   sfcc::reverse_bittranspose(output, reversed_values);
 
   // Compare reversed and original
-  for (auto i = 0; i < inputLength; i++) {
+  for (std::size_t i = 0; i < inputLength; i++) {
     EXPECT_EQ(values[i], reversed_values[i]);
   }
 
   delete[] values;
-  for (auto i = 0; i < inputLength; i++) delete output[i];
+  for (std::size_t i = 0; i < inputLength; i++) delete output[i];
   delete[] output;
   delete[] reversed_values;
 }
@@ -121,7 +123,7 @@ TEST(bittranspose, reverseTransposeIsCorrect_64)
 
   // Declare output memory
   std::uint64_t** output = new std::uint64_t*[inputLength];
-  for (auto i = 0; i < sizeof(std::uint64_t) * CHAR_BIT; i++) {
+  for (std::size_t i = 0; i < sizeof(std::uint64_t) * CHAR_BIT; i++) {
     output[i] = new std::uint64_t();
   }
 
@@ -133,11 +135,11 @@ TEST(bittranspose, reverseTransposeIsCorrect_64)
   sfcc::reverse_bittranspose(output, reversed_values);
 
   // Compare reversed and original
-  for (auto i = 0; i < inputLength; i++) {
+  for (std::size_t i = 0; i < inputLength; i++) {
     EXPECT_EQ(values[i], reversed_values[i]);
   }
   delete[] reversed_values;
-  for (auto i = 0; i < inputLength; i++) {
+  for (std::size_t i = 0; i < inputLength; i++) {
     delete output[i];
   }
   delete[] output;
@@ -256,4 +258,92 @@ TEST(BitTransposer, tranposeIsReversable_64)
 
   delete[] transformed_values;
   delete[] reversed_values;
-}
\ No newline at end of file
+}
+namespace {
+template <typename T>
+void expectKernelsMatchReference()
+{
+  constexpr auto nbits = sizeof(T) * CHAR_BIT;
+  constexpr auto nblocks = 37ULL;
+  constexpr auto length = nblocks * nbits;
+  std::vector<T> values(length);
+  for (auto& value : values) value = T(std::rand() * 2654435761U);
+
+  // Per-block reference into the plane layout
+  std::vector<T> expected(length);
+  T* planes[nbits];
+  for (std::size_t i = 0; i < nbits; i++) planes[i] = expected.data() + i * nblocks;
+  for (auto block = 0ULL; block < nblocks; block++) {
+    sfcc::bittranspose(values.data() + block * nbits, planes);
+    for (auto& plane : planes) plane++;
+  }
+
+  for (auto kernel : {sfcc::BitTransposeKernel::SCALAR,
+                      sfcc::BitTransposeKernel::SSE2,
+                      sfcc::BitTransposeKernel::AVX2}) {
+    if (!sfcc::bitTransposeKernelSupported(kernel)) continue;
+    auto transposed = values;
+    sfcc::BitTransposer(kernel).transpose_t<T>(transposed.data(), length);
+    EXPECT_EQ(transposed, expected) << "kernel " << int(kernel);
+    sfcc::BitTransposer(kernel).reverse_transpose_t<T>(transposed.data(),
+                                                       length);
+    EXPECT_EQ(transposed, values) << "kernel " << int(kernel);
+  }
+}
+}  // namespace
+
+TEST(BitTransposer, kernelsMatchReference)
+{
+  expectKernelsMatchReference<std::uint16_t>();
+  expectKernelsMatchReference<std::uint32_t>();
+}
+
+TEST(BitTransposer, transposesBlocksIndependently)
+{
+  constexpr auto blockBytes = 512ULL;
+  constexpr auto blockLength = blockBytes / sizeof(std::uint32_t);
+  // Two whole blocks, then a short block with a partial group of values
+  constexpr auto length = 2 * blockLength + 3 * 32 + 5;
+  std::vector<std::uint32_t> values(length);
+  for (auto& value : values) value = std::uint32_t(std::rand() * 2654435761U);
+
+  auto transposed = values;
+  sfcc::BitTransposer(sfcc::BitTransposeKernel::SCALAR, blockBytes)
+      .transpose_t<std::uint32_t>(transposed.data(), length);
+
+  // Each block matches the whole-array layout of that block alone
+  for (auto start = 0ULL; start < length; start += blockLength) {
+    const auto n = std::min(blockLength, length - start);
+    std::vector<std::uint32_t> expected(values.begin() + start,
+                                        values.begin() + start + n);
+    sfcc::BitTransposer(sfcc::BitTransposeKernel::SCALAR)
+        .transpose_t<std::uint32_t>(expected.data(), n);
+    // The values after the last whole group are kept
+    std::copy(values.begin() + start + n / 32 * 32, values.begin() + start + n,
+              expected.begin() + n / 32 * 32);
+    EXPECT_TRUE(std::equal(expected.begin(), expected.end(),
+                           transposed.begin() + start))
+        << "block at " << start;
+  }
+
+  for (auto kernel : {sfcc::BitTransposeKernel::SCALAR,
+                      sfcc::BitTransposeKernel::SSE2,
+                      sfcc::BitTransposeKernel::AVX2}) {
+    if (!sfcc::bitTransposeKernelSupported(kernel)) continue;
+    auto blocked = values;
+    sfcc::BitTransposer(kernel, blockBytes)
+        .transpose_t<std::uint32_t>(blocked.data(), length);
+    EXPECT_EQ(blocked, transposed) << "kernel " << int(kernel);
+    sfcc::BitTransposer(kernel, blockBytes)
+        .reverse_transpose_t<std::uint32_t>(blocked.data(), length);
+    EXPECT_EQ(blocked, values) << "kernel " << int(kernel);
+  }
+}
+
+TEST(BitTransposer, rejectsBlocksOfPartialGroups)
+{
+  std::vector<std::uint32_t> values(1024);
+  EXPECT_THROW(sfcc::BitTransposer(sfcc::BitTransposeKernel::SCALAR, 64)
+                   .transpose_t<std::uint32_t>(values.data(), values.size()),
+               std::invalid_argument);
+}
@@ -12,8 +12,10 @@
 #include <divsufsort.h>
 #include <gtest/gtest.h>
 #include <array>
+#include <cmath>
 #include <cstdlib>
 #include <ctime>
+#include <vector>
 #include "compressor.h"
 
 TEST(bwt, bwtSortsCharsAppropriately)
@@ -49,6 +51,123 @@ TEST(bwt, bwtSortsIntsAppropriately)
   EXPECT_EQ(last, expectedPosEOL);
 }
 
+namespace {
+// BWT by sorting suffixes directly, with shorter suffixes first on ties
+template <typename T>
+std::vector<T> naiveBWT(const std::vector<T>& data, std::uint32_t& last)
+{
+  std::vector<std::size_t> suffixes(data.size() + 1);
+  for (auto i = 0U; i < suffixes.size(); i++) suffixes[i] = i;
+  std::sort(suffixes.begin(), suffixes.end(), [&data](auto lhs, auto rhs) {
+    return std::lexicographical_compare(data.begin() + lhs, data.end(),
+                                        data.begin() + rhs, data.end());
+  });
+  std::vector<T> output(suffixes.size());
+  for (auto i = 0U; i < suffixes.size(); i++) {
+    if (suffixes[i] == 0) {
+      last = i;
+      output[i] = output[i - 1];
+    } else {
+      output[i] = data[suffixes[i] - 1];
+    }
+  }
+  return output;
+}
+
+template <typename T>
+void expectBWTMatchesNaive(const std::vector<T>& data)
+{
+  std::uint32_t expectedLast;
+  const auto expected = naiveBWT(data, expectedLast);
+  auto copy = data;
+  auto [bwt, first, last] = sfcc::easyBWT(copy.data(), copy.size());
+  const auto actual = reinterpret_cast<const T*>(bwt.get());
+  EXPECT_TRUE(std::equal(expected.begin(), expected.end(), actual));
+  EXPECT_EQ(last, expectedLast);
+
+  std::vector<T> restored(data.size());
+  sfcc::easyInverseBWT(actual, data.size(), last, restored.data());
+  EXPECT_EQ(restored, data);
+}
+}  // namespace
+
+TEST(bwt, suffixArrayMatchesNaiveSort)
+{
+  std::srand(std::time(0));
+  for (auto size : {1, 2, 3, 17, 1000, 5000}) {
+    std::vector<std::uint16_t> noise(size);
+    for (auto& i : noise) i = std::uint16_t(std::rand());
+    expectBWTMatchesNaive(noise);
+
+    // Few symbols and long repeats give the deepest recursion
+    std::vector<std::uint32_t> repeats(size);
+    for (auto i = 0; i < size; i++)
+      repeats[i] = 0xFFFF0000U + (i % 7 == 3 ? std::rand() % 3 : (i / 5) % 2);
+    expectBWTMatchesNaive(repeats);
+
+    std::vector<std::int16_t> constant(size, -3);
+    expectBWTMatchesNaive(constant);
+  }
+}
+
+TEST(bwt, inverseRestoresLargeBlocks)
+{
+  // Smooth samples of a wide alphabet, sorted as numbers and not as bytes
+  constexpr auto size = 1 << 20;
+  std::vector<std::int32_t> data(size);
+  for (auto i = 0; i < size; i++)
+    data[i] = std::int32_t(40000 * std::sin(i / 300.0)) + std::rand() % 4;
+  auto copy = data;
+  auto [bwt, first, last] = sfcc::easyBWT(copy.data(), size);
+  std::vector<std::int32_t> restored(size);
+  sfcc::easyInverseBWT(reinterpret_cast<const std::int32_t*>(bwt.get()), size,
+                       last, restored.data());
+  EXPECT_EQ(restored, data);
+}
+
+TEST(bwt, byteBWTMatchesDivbwt)
+{
+  for (auto size : {1U, 7U, 8U, 9U, 1000U, 65537U}) {
+    std::vector<std::uint8_t> data(size);
+    for (auto i = 0U; i < size; i++)
+      data[i] = i % 3 ? std::uint8_t(std::rand() % 4) : std::uint8_t(i / 9);
+
+    std::vector<std::uint8_t> expected(size);
+    const auto expectedIndex =
+        divbwt(data.data(), expected.data(), nullptr, saidx_t(size));
+    const auto nstreams = sfcc::bwt::blockStreams(size);
+    std::vector<std::uint8_t> bwt(size);
+    std::vector<std::uint32_t> streamRows(nstreams - 1);
+    const auto primaryIndex = sfcc::bwt::byteBWT(
+        data.data(), size, bwt.data(), streamRows.data(), nstreams);
+    EXPECT_EQ(bwt, expected);
+    EXPECT_EQ(primaryIndex, std::uint32_t(expectedIndex));
+
+    // Interleaved streams, and a single stream as older files are decoded
+    std::vector<std::uint8_t> restored(size);
+    sfcc::bwt::inverseByteBWT(bwt.data(), size, primaryIndex,
+                              streamRows.data(), nstreams, restored.data());
+    EXPECT_EQ(restored, data);
+    std::fill(restored.begin(), restored.end(), 0);
+    sfcc::bwt::inverseByteBWT(bwt.data(), size, primaryIndex, nullptr, 1,
+                              restored.data());
+    EXPECT_EQ(restored, data);
+  }
+}
+
+TEST(bwt, inverseByteBWTRejectsBadIndices)
+{
+  std::uint8_t bwt[] = {1, 2, 3, 4};
+  std::uint8_t output[4];
+  const std::uint32_t streamRows[] = {9};
+  EXPECT_THROW(sfcc::bwt::inverseByteBWT(bwt, 4, 0, nullptr, 1, output),
+               std::runtime_error);
+  EXPECT_THROW(sfcc::bwt::inverseByteBWT(bwt, 4, 5, nullptr, 1, output),
+               std::runtime_error);
+  EXPECT_THROW(sfcc::bwt::inverseByteBWT(bwt, 4, 2, streamRows, 2, output),
+               std::runtime_error);
+}
+
 TEST(mtf, MTFOfIncreasingSequenceIsCorrect)
 {
   std::uint16_t data[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
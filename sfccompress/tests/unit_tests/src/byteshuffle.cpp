@@ -0,0 +1,68 @@
+/**
+ * @file byteshuffle.cpp
+ * @author Conrad Haupt (conrad@conradhaupt.co.za)
+ * @brief
+ * @version 1.0
+ * @date 2020-03-23
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#include "byteshuffle.h"
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+const sfcc::ByteShuffleKernel kernels[] = {sfcc::ByteShuffleKernel::SCALAR,
+                                           sfcc::ByteShuffleKernel::SSE2,
+                                           sfcc::ByteShuffleKernel::AVX2};
+}  // namespace
+
+TEST(byteShuffle, kernelsMatchReference)
+{
+  for (auto nbytes : {1, 2, 3, 4, 8}) {
+    // Enough values for several vectors, a partial one and a partial value
+    const auto nvalues = 1000ULL;
+    const auto length = nvalues * nbytes + nbytes / 2;
+    std::vector<std::uint8_t> values(length);
+    for (auto& value : values) value = std::uint8_t(std::rand());
+
+    std::vector<std::uint8_t> expected(values);
+    for (auto v = 0ULL; v < nvalues; v++)
+      for (auto b = 0; b < nbytes; b++)
+        expected[b * nvalues + v] = values[v * nbytes + b];
+
+    for (auto kernel : kernels) {
+      if (!sfcc::byteShuffleKernelSupported(kernel)) continue;
+      std::vector<std::uint8_t> shuffled(length);
+      sfcc::byteShuffle(values.data(), shuffled.data(), length, nbytes,
+                        kernel);
+      EXPECT_EQ(shuffled, expected)
+          << "kernel " << int(kernel) << ", " << nbytes << " bytes";
+      std::vector<std::uint8_t> reversed(length);
+      sfcc::reverseByteShuffle(shuffled.data(), reversed.data(), length,
+                               nbytes, kernel);
+      EXPECT_EQ(reversed, values)
+          << "kernel " << int(kernel) << ", " << nbytes << " bytes";
+    }
+  }
+}
+
+TEST(ByteShuffler, shuffleIsReversable)
+{
+  std::vector<float> values(4096);
+  for (std::size_t i = 0; i < values.size(); i++) values[i] = 0.5f * i - 17.25f;
+  auto shuffled = values;
+  const auto data = reinterpret_cast<std::uint8_t*>(shuffled.data());
+  const auto length = shuffled.size() * sizeof(float);
+
+  sfcc::ByteShuffler shuffler;
+  shuffler.shuffle(data, length, sizeof(float));
+  EXPECT_NE(shuffled, values);
+  shuffler.reverse_shuffle(data, length, sizeof(float));
+  EXPECT_EQ(shuffled, values);
+  EXPECT_THROW(shuffler.shuffle(data, length - 1, sizeof(float)),
+               std::logic_error);
+}
@@ -0,0 +1,130 @@
+/**
+ * @file canonical_huffman.cpp
+ * @author Conrad Haupt (conrad@conradhaupt.co.za)
+ * @brief
+ * @version 1.0
+ * @date 2020-03-09
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#include "canonical_huffman.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+TEST(canonical_huffman, codeLengthsRespectLimit)
+{
+  // Fibonacci frequencies give a maximally deep unrestricted Huffman tree
+  std::vector<std::uint64_t> frequencies{1, 1};
+  while (frequencies.size() < 30)
+    frequencies.push_back(frequencies[frequencies.size() - 1] +
+                          frequencies[frequencies.size() - 2]);
+
+  for (auto limit : {5, 8, 11, 16}) {
+    auto lengths = sfcc::canonical_huffman::lengthLimitedCodeLengths(
+        frequencies, limit);
+    // The code must be complete: the Kraft sum equals one
+    std::uint64_t kraft = 0;
+    for (auto length : lengths) {
+      EXPECT_GE(length, 1);
+      EXPECT_LE(length, limit);
+      kraft += 1ULL << (16 - length);
+    }
+    EXPECT_EQ(kraft, 1ULL << 16);
+  }
+}
+
+TEST(canonical_huffman, codeLengthsAreOptimalWithoutLimit)
+{
+  std::vector<std::uint64_t> frequencies{45, 13, 12, 16, 9, 5, 0};
+  auto lengths =
+      sfcc::canonical_huffman::lengthLimitedCodeLengths(frequencies, 16);
+  std::vector<std::uint8_t> expected{1, 3, 3, 3, 4, 4, 0};
+  EXPECT_EQ(lengths, expected);
+}
+
+TEST(canonical_huffman, sixteenBitSymbolsAreReversible)
+{
+  // Skewed distribution over a wide alphabet so that some codes are longer
+  // than the decode table
+  std::srand(0);
+  std::vector<std::uint16_t> data(100000);
+  for (auto& value : data)
+    value = std::rand() % 4 == 0 ? std::rand() % 65536 : 1000 + std::rand() % 8;
+
+  auto [compressed, compressedSize] =
+      sfcc::canonical_huffman::easyEncode(data.data(), data.size());
+  const auto decodedSize =
+      sfcc::canonical_huffman::decodedSizeBytes(compressed.get(), compressedSize);
+  ASSERT_EQ(decodedSize, data.size() * sizeof(std::uint16_t));
+
+  std::vector<std::uint16_t> decoded(data.size());
+  EXPECT_EQ(sfcc::canonical_huffman::easyDecode(
+                compressed.get(), compressedSize,
+                reinterpret_cast<std::uint8_t*>(decoded.data()), decodedSize),
+            decodedSize);
+  EXPECT_EQ(data, decoded);
+}
+
+TEST(canonical_huffman, singleSymbolIsReversible)
+{
+  std::vector<std::uint8_t> data(1000, 42);
+  auto [compressed, compressedSize] =
+      sfcc::canonical_huffman::easyEncode(data.data(), data.size());
+  std::vector<std::uint8_t> decoded(data.size());
+  sfcc::canonical_huffman::easyDecode(compressed.get(), compressedSize,
+                                      decoded.data(), decoded.size());
+  EXPECT_EQ(data, decoded);
+}
+
+TEST(canonical_huffman, truncatedStreamThrows)
+{
+  std::vector<std::uint8_t> data(1000);
+  for (std::size_t i = 0; i < data.size(); i++) data[i] = i % 7;
+  auto [compressed, compressedSize] =
+      sfcc::canonical_huffman::easyEncode(data.data(), data.size());
+  std::vector<std::uint8_t> decoded(data.size());
+  EXPECT_THROW(sfcc::canonical_huffman::easyDecode(
+                   compressed.get(), compressedSize / 2, decoded.data(),
+                   decoded.size()),
+               std::runtime_error);
+}
+
+TEST(canonical_huffman, interleavedStreamsAreReversible)
+{
+  std::srand(0);
+  std::vector<std::uint16_t> data(100001);
+  for (auto& value : data)
+    value = std::rand() % 4 == 0 ? std::rand() % 65536 : 1000 + std::rand() % 8;
+
+  // Fewer symbols than streams leaves some of the streams empty
+  for (const auto nsymbols : {1ULL, 3ULL, 5ULL, 4097ULL, 100001ULL}) {
+    auto [compressed, compressedSize] =
+        sfcc::canonical_huffman::easyEncodeInterleaved(data.data(), nsymbols);
+    const auto decodedSize = sfcc::canonical_huffman::decodedSizeBytes(
+        compressed.get(), compressedSize);
+    ASSERT_EQ(decodedSize, nsymbols * sizeof(std::uint16_t));
+
+    std::vector<std::uint16_t> decoded(nsymbols);
+    EXPECT_EQ(sfcc::canonical_huffman::easyDecodeInterleaved(
+                  compressed.get(), compressedSize,
+                  reinterpret_cast<std::uint8_t*>(decoded.data()), decodedSize),
+              decodedSize);
+    EXPECT_TRUE(std::equal(decoded.begin(), decoded.end(), data.begin()));
+  }
+}
+
+TEST(canonical_huffman, truncatedInterleavedStreamThrows)
+{
+  std::vector<std::uint8_t> data(1000);
+  for (std::size_t i = 0; i < data.size(); i++) data[i] = i % 7;
+  auto [compressed, compressedSize] =
+      sfcc::canonical_huffman::easyEncodeInterleaved(data.data(), data.size());
+  std::vector<std::uint8_t> decoded(data.size());
+  EXPECT_THROW(sfcc::canonical_huffman::easyDecodeInterleaved(
+                   compressed.get(), compressedSize / 2, decoded.data(),
+                   decoded.size()),
+               std::runtime_error);
+}
@@ -1,6 +1,38 @@
 #include "compressor.h"
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <random>
+#include <vector>
 #include "compressor_data.h"
+#include "huffman.h"
+
+TEST(huffman, decodesCodesLongerThanTheTable)
+{
+  // Fibonacci frequencies give a code one bit longer for each symbol
+  std::vector<std::uint8_t> data;
+  std::uint64_t a = 1, b = 1;
+  for (int s = 0; s < 22; s++, b += a, a = b - a)
+    data.insert(data.end(), a, std::uint8_t(s));
+  std::shuffle(data.begin(), data.end(), std::mt19937(3));
+
+  std::uint8_t* compressed = nullptr;
+  std::uint64_t compressedSizeBytes, compressedSizeBits;
+  huffman::easyEncode(data.data(), data.size(), &compressed,
+                      &compressedSizeBytes, &compressedSizeBits);
+  std::vector<std::uint8_t> decoded(data.size());
+  EXPECT_EQ(huffman::easyDecode(compressed, compressedSizeBytes,
+                                compressedSizeBits, decoded.data(),
+                                decoded.size()),
+            data.size());
+  EXPECT_EQ(decoded, data);
+
+  // A stream cut short decodes only the codes it still holds whole
+  EXPECT_LT(huffman::easyDecode(compressed, compressedSizeBytes,
+                                compressedSizeBits - 5, decoded.data(),
+                                decoded.size()),
+            data.size());
+  delete[] compressed;
+}
 
 TEST_P(CompressorDataTestFicture, huffmanIsReversible)
 {
@@ -17,6 +49,66 @@ TEST_P(CompressorDataTestFicture, huffmanIsReversible)
     EXPECT_EQ(original_data[i], decompressed_data[i]);
 }
 
+TEST_P(CompressorDataTestFicture, huffman16IsReversible)
+{
+  auto compressor = ::sfcc::huffman16();
+  auto [compressed_data, compressed_length, compressed_header] =
+      compressor.compress(file.getDataPointer(), file.size(), file.getHeader());
+  auto [decompressed_data, decompressed_length, decompressed_header] =
+      compressor.decompress(compressed_data, compressed_length,
+                            compressed_header);
+
+  EXPECT_EQ(expectedSize, decompressed_length);
+  const auto original_data = file.getData();
+  for (auto i = 0; i < expectedSize; i++)
+    EXPECT_EQ(original_data[i], decompressed_data[i]);
+}
+
+TEST_P(CompressorDataTestFicture, huffman16x4IsReversible)
+{
+  auto compressor = ::sfcc::huffman16(true);
+  auto [compressed_data, compressed_length, compressed_header] =
+      compressor.compress(file.getDataPointer(), file.size(), file.getHeader());
+  auto [decompressed_data, decompressed_length, decompressed_header] =
+      compressor.decompress(compressed_data, compressed_length,
+                            compressed_header);
+
+  EXPECT_EQ(expectedSize, decompressed_length);
+  const auto original_data = file.getData();
+  for (auto i = 0; i < expectedSize; i++)
+    EXPECT_EQ(original_data[i], decompressed_data[i]);
+}
+
+TEST_P(CompressorDataTestFicture, fseIsReversible)
+{
+  auto compressor = ::sfcc::fse();
+  auto [compressed_data, compressed_length, compressed_header] =
+      compressor.compress(file.getDataPointer(), file.size(), file.getHeader());
+  auto [decompressed_data, decompressed_length, decompressed_header] =
+      compressor.decompress(compressed_data, compressed_length,
+                            compressed_header);
+
+  EXPECT_EQ(expectedSize, decompressed_length);
+  const auto original_data = file.getData();
+  for (auto i = 0; i < expectedSize; i++)
+    EXPECT_EQ(original_data[i], decompressed_data[i]);
+}
+
+TEST_P(CompressorDataTestFicture, bitplaneIsReversible)
+{
+  auto compressor = ::sfcc::bitplane();
+  auto [compressed_data, compressed_length, compressed_header] =
+      compressor.compress(file.getDataPointer(), file.size(), file.getHeader());
+  auto [decompressed_data, decompressed_length, decompressed_header] =
+      compressor.decompress(compressed_data, compressed_length,
+                            compressed_header);
+
+  EXPECT_EQ(expectedSize, decompressed_length);
+  const auto original_data = file.getData();
+  for (auto i = 0; i < expectedSize; i++)
+    EXPECT_EQ(original_data[i], decompressed_data[i]);
+}
+
 TEST_P(CompressorDataTestFicture, lz77IsReversible)
 {
   auto compressor = ::sfcc::lz77();
@@ -32,6 +124,78 @@ TEST_P(CompressorDataTestFicture, lz77IsReversible)
     EXPECT_EQ(original_data[i], decompressed_data[i]);
 }
 
+TEST_P(CompressorDataTestFicture, deflateLevelsAreReversible)
+{
+  for (auto level : {::deflate::MinLevel, ::deflate::MaxLevel}) {
+    auto compressor = ::sfcc::deflate(level);
+    auto [compressed_data, compressed_length, compressed_header] =
+        compressor.compress(file.getDataPointer(), file.size(),
+                            file.getHeader());
+    auto [decompressed_data, decompressed_length, decompressed_header] =
+        compressor.decompress(compressed_data, compressed_length,
+                              compressed_header);
+
+    EXPECT_EQ(expectedSize, decompressed_length);
+    const auto original_data = file.getData();
+    for (auto i = 0; i < expectedSize; i++)
+      ASSERT_EQ(original_data[i], decompressed_data[i]) << "level " << level;
+  }
+}
+
+TEST_P(CompressorDataTestFicture, codecsTakeTheirOwnDefaultLevel)
+{
+  const auto compressed = [&](::sfcc::compressor& compressor) {
+    auto [data, length, header] = compressor.compress(
+        file.getDataPointer(), file.size(), file.getHeader());
+    return std::vector<std::uint8_t>(data.get(), data.get() + length);
+  };
+  auto deflate = ::sfcc::deflate(::deflate::DefaultLevel);
+  auto lz77 = ::sfcc::lz77(::lz77::DefaultLevel);
+  EXPECT_EQ(compressed(*::sfcc::make_compressor(
+                sfc::sfcc::compression_t::DEFLATE)),
+            compressed(deflate));
+  EXPECT_EQ(compressed(*::sfcc::make_compressor(
+                sfc::sfcc::compression_t::LZ77)),
+            compressed(lz77));
+  EXPECT_NE(compressed(*::sfcc::make_compressor(
+                sfc::sfcc::compression_t::DEFLATE, false,
+                ::lz77::DefaultLevel)),
+            compressed(deflate));
+}
+
+TEST_P(CompressorDataTestFicture, lz77LevelsAreReversible)
+{
+  for (auto level : {::lz77::MinLevel, ::lz77::MaxLevel}) {
+    auto compressor = ::sfcc::lz77(level);
+    auto [compressed_data, compressed_length, compressed_header] =
+        compressor.compress(file.getDataPointer(), file.size(),
+                            file.getHeader());
+    auto [decompressed_data, decompressed_length, decompressed_header] =
+        compressor.decompress(compressed_data, compressed_length,
+                              compressed_header);
+
+    EXPECT_EQ(expectedSize, decompressed_length);
+    const auto original_data = file.getData();
+    for (auto i = 0; i < expectedSize; i++)
+      ASSERT_EQ(original_data[i], decompressed_data[i]) << "level " << level;
+  }
+}
+
+TEST_P(CompressorDataTestFicture, lz78IsReversible)
+{
+  auto compressor = ::sfcc::lz78();
+  auto [compressed_data, compressed_length, compressed_header] =
+      compressor.compress(file.getDataPointer(), file.size(), file.getHeader());
+  auto [decompressed_data, decompressed_length, decompressed_header] =
+      compressor.decompress(compressed_data, compressed_length,
+                            compressed_header);
+
+  EXPECT_EQ(expectedSize, decompressed_length);
+  const auto original_data = file.getData();
+  for (auto i = 0; i < expectedSize; i++)
+    EXPECT_EQ(original_data[i], decompressed_data[i]);
+}
+
 TEST_P(CompressorDataTestFicture, lzwIsReversible)
 {
   auto compressor = ::sfcc::lzw();
@@ -47,6 +211,23 @@ TEST_P(CompressorDataTestFicture, lzwIsReversible)
     EXPECT_EQ(original_data[i], decompressed_data[i]);
 }
 
+TEST_P(CompressorDataTestFicture, lzwReadsLegacyDictionaryWidth)
+{
+  // Files written with the original 12-bit dictionary carry no width
+  auto compressor = ::sfcc::lzw(::lzw::DefaultDictBits);
+  auto [compressed_data, compressed_length, compressed_header] =
+      compressor.compress(file.getDataPointer(), file.size(), file.getHeader());
+  EXPECT_FALSE(compressed_header.lzw_dict_nbits.has_value());
+  auto [decompressed_data, decompressed_length, decompressed_header] =
+      ::sfcc::lzw().decompress(compressed_data, compressed_length,
+                               compressed_header);
+
+  EXPECT_EQ(expectedSize, decompressed_length);
+  const auto original_data = file.getData();
+  for (auto i = 0; i < expectedSize; i++)
+    EXPECT_EQ(original_data[i], decompressed_data[i]);
+}
+
 TEST_P(CompressorDataTestFicture, noCompressorIsReversible)
 {
   auto compressor = ::sfcc::no_compressor();
@@ -77,6 +258,107 @@ TEST_P(CompressorDataTestFicture, rleIsReversible)
     EXPECT_EQ(original_data[i], decompressed_data[i]);
 }
 
+TEST_P(CompressorDataTestFicture, rleVarintIsReversible)
+{
+  auto compressor = ::sfcc::rle_varint();
+  auto [compressed_data, compressed_length, compressed_header] =
+      compressor.compress(file.getDataPointer(), file.size(), file.getHeader());
+  auto [decompressed_data, decompressed_length, decompressed_header] =
+      compressor.decompress(compressed_data, compressed_length,
+                            compressed_header);
+
+  EXPECT_EQ(expectedSize, decompressed_length);
+  const auto original_data = file.getData();
+  for (auto i = 0; i < expectedSize; i++)
+    EXPECT_EQ(original_data[i], decompressed_data[i]);
+}
+
+TEST_P(CompressorDataTestFicture, compressIntoIsReversibleInPreallocatedMemory)
+{
+  using ::sfc::sfcc::compression_t;
+  for (auto type :
+       {compression_t::HUFFMAN, compression_t::HUFFMAN16,
+        compression_t::HUFFMAN16_X4, compression_t::FSE,
+        compression_t::BITPLANE, compression_t::LZ77, compression_t::LZ78,
+        compression_t::LZW, compression_t::RLE, compression_t::RLE_VARINT,
+        compression_t::DEFLATE}) {
+    SCOPED_TRACE(::sfc::sfcc::tostring(type));
+    auto compressor = ::sfcc::make_compressor(type);
+    // Both outputs are placed in a single preallocated buffer
+    const auto capacity =
+        compressor->maxCompressedSize(file.size(), file.getHeader());
+    std::vector<std::uint8_t> buffer(capacity + expectedSize);
+    auto [compressed_length, compressed_header] = compressor->compressInto(
+        file.getData(), file.size(), buffer.data(), capacity,
+        file.getHeader());
+    ASSERT_LE(compressed_length, capacity);
+
+    const auto output = buffer.data() + capacity;
+    ASSERT_LE(compressor->maxDecompressedSize(buffer.data(), compressed_length,
+                                              compressed_header),
+              expectedSize);
+    auto [decompressed_length, decompressed_header] =
+        compressor->decompressInto(buffer.data(), compressed_length, output,
+                                   expectedSize, compressed_header);
+
+    EXPECT_EQ(expectedSize, decompressed_length);
+    EXPECT_TRUE(std::equal(output, output + expectedSize, file.getData()));
+  }
+}
+
+TEST_P(CompressorDataTestFicture, bzipCompressIntoIsReversible)
+{
+  using ::sfc::sfcc::compression_t;
+  // Enough copies of the data for two whole blocks
+  const auto length = 2ULL << 20;
+  std::vector<std::uint8_t> data(length);
+  for (auto i = 0ULL; i < length; i++)
+    data[i] = file.getData()[i % file.size()];
+
+  for (auto type : {compression_t::BZIP_LZ77, compression_t::BZIP_LZW,
+                    compression_t::BZIP_FSE, compression_t::BWT}) {
+    SCOPED_TRACE(::sfc::sfcc::tostring(type));
+    auto compressor = ::sfcc::make_compressor(type);
+    const auto capacity =
+        compressor->maxCompressedSize(length, file.getHeader());
+    std::vector<std::uint8_t> compressed(capacity);
+    auto [compressed_length, compressed_header] = compressor->compressInto(
+        data.data(), length, compressed.data(), capacity, file.getHeader());
+    ASSERT_LE(compressed_length, capacity);
+
+    EXPECT_EQ(compressor->maxDecompressedSize(
+                  compressed.data(), compressed_length, compressed_header),
+              length);
+    std::vector<std::uint8_t> decompressed(length);
+    auto [decompressed_length, decompressed_header] =
+        compressor->decompressInto(compressed.data(), compressed_length,
+                                   decompressed.data(), length,
+                                   compressed_header);
+    EXPECT_EQ(length, decompressed_length);
+    EXPECT_TRUE(decompressed == data);
+  }
+}
+
+TEST_P(CompressorDataTestFicture, compressIntoRejectsSmallOutput)
+{
+  auto compressor = ::sfcc::fse();
+  const auto capacity =
+      compressor.maxCompressedSize(file.size(), file.getHeader());
+  std::vector<std::uint8_t> output(capacity);
+  EXPECT_THROW(compressor.compressInto(file.getData(), file.size(),
+                                       output.data(), capacity - 1,
+                                       file.getHeader()),
+               std::length_error);
+
+  auto [compressed_length, compressed_header] = compressor.compressInto(
+      file.getData(), file.size(), output.data(), capacity, file.getHeader());
+  std::vector<std::uint8_t> decompressed(expectedSize);
+  EXPECT_THROW(compressor.decompressInto(output.data(), compressed_length,
+                                         decompressed.data(), expectedSize - 1,
+                                         compressed_header),
+               std::length_error);
+}
+
 INSTANTIATE_TEST_CASE_P(Compressor, CompressorDataTestFicture,
                         ::testing::Values(std::make_tuple<std::string, int>(
                             TEST_COMPRESSOR_DATA_FILENAME, 262144 * 2)));
\ No newline at end of file
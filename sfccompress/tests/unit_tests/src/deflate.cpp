@@ -0,0 +1,90 @@
+/**
+ * @file deflate.cpp
+ * @author Conrad Haupt (conrad@conradhaupt.co.za)
+ * @brief
+ * @version 1.0
+ * @date 2020-03-19
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#include "deflate.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdlib>
+
+namespace {
+void expectReversible(const std::uint8_t* data, const unsigned long long size,
+                      const int level)
+{
+  auto [compressed, compressed_bytes] =
+      ::deflate::easyEncode(data, size, level);
+  auto decompressed = std::make_unique<std::uint8_t[]>(size + 1);
+  EXPECT_EQ(::deflate::easyDecode(compressed.get(), compressed_bytes,
+                                  decompressed.get(), size + 1),
+            size)
+      << "level " << level;
+  EXPECT_TRUE(std::equal(data, data + size, decompressed.get()))
+      << "level " << level;
+}
+}  // namespace
+
+TEST(deflate, allLevelsAreReversible)
+{
+  // Runs, repeats and noise, so that every block type is used
+  constexpr auto size = 1ULL << 18;
+  auto data = std::make_unique<std::uint8_t[]>(size);
+  std::generate(data.get(), data.get() + size / 2,
+                []() { return std::uint8_t(std::rand() % 16); });
+  std::fill(data.get() + size / 2, data.get() + size * 5 / 8, 7);
+  std::generate(data.get() + size * 5 / 8, data.get() + size,
+                []() { return std::uint8_t(std::rand()); });
+  for (auto level = ::deflate::MinLevel; level <= ::deflate::MaxLevel; level++)
+    expectReversible(data.get(), size, level);
+}
+
+TEST(deflate, shortInputsAreReversible)
+{
+  const std::uint8_t data[] = {1, 2, 3, 1, 2, 3, 1, 2};
+  for (auto size = 0ULL; size <= sizeof(data); size++)
+    expectReversible(data, size, ::deflate::DefaultLevel);
+}
+
+TEST(deflate, zlibStreamsAreDecoded)
+{
+  // zlib.compress(data, 9, wbits=-15), a single block with dynamic codes
+  const std::uint8_t compressed[] = {
+      0x5d, 0xca, 0xb1, 0x0d, 0x00, 0x00, 0x08, 0x02, 0xb0, 0x97, 0x08, 0x06,
+      0x15, 0xfe, 0x3f, 0xcc, 0xdd, 0xce, 0x85, 0x30, 0x74, 0x33, 0xab, 0x22,
+      0x12, 0x3b, 0x01, 0x4b, 0x1b, 0xb6, 0x39, 0x10, 0x7e, 0x38};
+  constexpr auto size = 50;
+  std::uint8_t expected[size];
+  for (auto i = 0; i < size; i++) expected[i] = '0' + (i * i * 17 / 3) % 11;
+
+  std::uint8_t decompressed[size];
+  EXPECT_EQ(::deflate::easyDecode(compressed, sizeof(compressed), decompressed,
+                                  size),
+            size);
+  EXPECT_TRUE(std::equal(expected, expected + size, decompressed));
+}
+
+TEST(deflate, malformedStreamsThrow)
+{
+  constexpr auto size = 4096ULL;
+  auto data = std::make_unique<std::uint8_t[]>(size);
+  std::generate(data.get(), data.get() + size,
+                []() { return std::uint8_t(std::rand() % 16); });
+  auto [compressed, compressed_bytes] = ::deflate::easyEncode(data.get(), size);
+  auto decompressed = std::make_unique<std::uint8_t[]>(size);
+  EXPECT_THROW(::deflate::easyDecode(compressed.get(), compressed_bytes / 2,
+                                     decompressed.get(), size),
+               std::runtime_error);
+  EXPECT_THROW(::deflate::easyDecode(compressed.get(), compressed_bytes,
+                                     decompressed.get(), size - 1),
+               std::runtime_error);
+  // Block type 3 is reserved
+  const std::uint8_t reserved[] = {0x07, 0x00};
+  EXPECT_THROW(::deflate::easyDecode(reserved, sizeof(reserved),
+                                     decompressed.get(), size),
+               std::runtime_error);
+}
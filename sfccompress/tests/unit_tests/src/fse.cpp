@@ -0,0 +1,91 @@
+/**
+ * @file fse.cpp
+ * @author Conrad Haupt (conrad@conradhaupt.co.za)
+ * @brief
+ * @version 1.0
+ * @date 2020-03-12
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#include "fse.h"
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <numeric>
+#include <vector>
+
+TEST(fse, normalisedCountsSumToTableSize)
+{
+  // Many rare symbols force counts of one that must be paid for by the others
+  std::vector<std::uint64_t> frequencies(256, 1);
+  frequencies[0] = 1000000;
+  frequencies[1] = 3;
+  for (auto tableLog : {9, 11, 12}) {
+    const auto counts = fse::normaliseCounts(frequencies, tableLog);
+    EXPECT_EQ(std::accumulate(counts.begin(), counts.end(), 0U),
+              1U << tableLog);
+    for (auto count : counts) EXPECT_GE(count, 1);
+  }
+}
+
+TEST(fse, skewedDataIsReversible)
+{
+  // Geometric distribution, similar to MTF output
+  std::srand(0);
+  std::vector<std::uint8_t> data(100000);
+  for (auto& value : data) {
+    value = 0;
+    while (value < 255 && std::rand() % 3 == 0) value++;
+  }
+
+  auto [compressed, compressedSize] =
+      fse::easyEncode(data.data(), data.size());
+  EXPECT_LT(compressedSize, data.size() / 2);
+  const auto decodedSize =
+      fse::decodedSizeBytes(compressed.get(), compressedSize);
+  ASSERT_EQ(decodedSize, data.size());
+
+  std::vector<std::uint8_t> decoded(data.size());
+  EXPECT_EQ(fse::easyDecode(compressed.get(), compressedSize, decoded.data(),
+                            decoded.size()),
+            decoded.size());
+  EXPECT_EQ(data, decoded);
+}
+
+TEST(fse, shortInputsAreReversible)
+{
+  for (auto nbytes : {0, 1, 2, 3, 17, 300}) {
+    std::vector<std::uint8_t> data(nbytes);
+    for (auto i = 0; i < nbytes; i++) data[i] = (i * 37) % 256;
+    auto [compressed, compressedSize] =
+        fse::easyEncode(data.data(), data.size());
+    std::vector<std::uint8_t> decoded(data.size());
+    EXPECT_EQ(fse::easyDecode(compressed.get(), compressedSize,
+                              decoded.data(), decoded.size()),
+              data.size());
+    EXPECT_EQ(data, decoded);
+  }
+}
+
+TEST(fse, singleSymbolIsReversible)
+{
+  std::vector<std::uint8_t> data(1000, 42);
+  auto [compressed, compressedSize] =
+      fse::easyEncode(data.data(), data.size());
+  std::vector<std::uint8_t> decoded(data.size());
+  fse::easyDecode(compressed.get(), compressedSize, decoded.data(),
+                  decoded.size());
+  EXPECT_EQ(data, decoded);
+}
+
+TEST(fse, truncatedStreamThrows)
+{
+  std::vector<std::uint8_t> data(1000);
+  for (std::size_t i = 0; i < data.size(); i++) data[i] = i % 7;
+  auto [compressed, compressedSize] =
+      fse::easyEncode(data.data(), data.size());
+  std::vector<std::uint8_t> decoded(data.size());
+  EXPECT_THROW(fse::easyDecode(compressed.get(), compressedSize / 2,
+                               decoded.data(), decoded.size()),
+               std::runtime_error);
+}
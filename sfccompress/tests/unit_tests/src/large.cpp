@@ -0,0 +1,135 @@
+/**
+ * @file large.cpp
+ * @author Conrad Haupt (conrad@conradhaupt.co.za)
+ * @brief Codec tests on inputs beyond the 32-bit size limits. These need
+ * several GiB of memory and are only built with SFCC_LARGE_TESTS enabled.
+ * @version 1.0
+ * @date 2020-03-12
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#ifdef TEST_LARGE_INPUTS
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include "bitstream.h"
+#include "canonical_huffman.h"
+#include "huffman.h"
+#include "lzw.h"
+#include "rle.h"
+
+namespace {
+// Just over 2 GiB, so byte counts overflow an int and bit counts overflow
+// 32 bits as well
+constexpr std::uint64_t LargeSizeBytes = (1ULL << 31) + (1ULL << 20);
+static_assert(LargeSizeBytes > std::numeric_limits<std::int32_t>::max(),
+              "Large inputs must not fit in an int");
+
+// Slowly varying pseudo-random data which all the codecs can compress
+std::unique_ptr<std::uint8_t[]> makeLargeData()
+{
+  auto data = std::make_unique<std::uint8_t[]>(LargeSizeBytes);
+  std::uint32_t state = 1;
+  for (std::uint64_t i = 0; i < LargeSizeBytes; i += 64) {
+    state = state * 1664525U + 1013904223U;
+    std::fill(data.get() + i,
+              data.get() + std::min(i + 64, LargeSizeBytes),
+              std::uint8_t(state >> 29));
+  }
+  return data;
+}
+}  // namespace
+
+TEST(large, bitStreamPastFourGigabits)
+{
+  // 2^32 + 1024 bits written and read back in 32-bit pieces
+  const std::uint64_t nvalues = (1ULL << 27) + 32;
+  sfcc::BitStreamWriter writer(8);
+  for (std::uint64_t i = 0; i < nvalues; i++) writer.appendBitsU64(i, 32);
+  EXPECT_EQ(writer.getBitCount(), nvalues * 32);
+
+  sfcc::BitStreamReader reader(writer);
+  for (std::uint64_t i = 0; i < nvalues; i++)
+    ASSERT_EQ(reader.readBitsU64(32), i & 0xFFFFFFFF);
+  EXPECT_TRUE(reader.isEndOfStream());
+}
+
+TEST(large, huffmanIsReversible)
+{
+  auto data = makeLargeData();
+  std::uint8_t* compressed;
+  std::uint64_t compressedSizeBytes;
+  std::uint64_t compressedSizeBits;
+  huffman::easyEncode(data.get(), LargeSizeBytes, &compressed,
+                      &compressedSizeBytes, &compressedSizeBits);
+  std::unique_ptr<std::uint8_t[]> compressed_ptr(compressed);
+
+  auto decompressed = std::make_unique<std::uint8_t[]>(LargeSizeBytes);
+  EXPECT_EQ(huffman::easyDecode(compressed, compressedSizeBytes,
+                                compressedSizeBits, decompressed.get(),
+                                LargeSizeBytes),
+            LargeSizeBytes);
+  EXPECT_TRUE(std::equal(data.get(), data.get() + LargeSizeBytes,
+                         decompressed.get()));
+}
+
+TEST(large, canonicalHuffmanIsReversible)
+{
+  auto data = makeLargeData();
+  auto [compressed, compressedSizeBytes] =
+      sfcc::canonical_huffman::easyEncode(
+          reinterpret_cast<const std::uint16_t*>(data.get()),
+          LargeSizeBytes / 2);
+
+  auto decompressed = std::make_unique<std::uint8_t[]>(LargeSizeBytes);
+  EXPECT_EQ(sfcc::canonical_huffman::easyDecode(
+                compressed.get(), compressedSizeBytes, decompressed.get(),
+                LargeSizeBytes),
+            LargeSizeBytes);
+  EXPECT_TRUE(std::equal(data.get(), data.get() + LargeSizeBytes,
+                         decompressed.get()));
+}
+
+TEST(large, lzwIsReversible)
+{
+  auto data = makeLargeData();
+  std::uint8_t* compressed;
+  std::uint64_t compressedSizeBytes;
+  std::uint64_t compressedSizeBits;
+  lzw::easyEncode(data.get(), LargeSizeBytes, &compressed,
+                  &compressedSizeBytes, &compressedSizeBits);
+  std::unique_ptr<std::uint8_t[]> compressed_ptr(compressed);
+
+  auto decompressed = std::make_unique<std::uint8_t[]>(LargeSizeBytes);
+  EXPECT_EQ(lzw::easyDecode(compressed, compressedSizeBytes,
+                            compressedSizeBits, decompressed.get(),
+                            LargeSizeBytes),
+            LargeSizeBytes);
+  EXPECT_TRUE(std::equal(data.get(), data.get() + LargeSizeBytes,
+                         decompressed.get()));
+}
+
+TEST(large, rleIsReversible)
+{
+  auto data = makeLargeData();
+  const auto nvalues = LargeSizeBytes / sizeof(std::uint16_t);
+  // Every 64-byte run becomes at most two 3-byte RLE packets
+  const auto maxCompressedSize = LargeSizeBytes / 8;
+  auto compressed = std::make_unique<std::uint8_t[]>(maxCompressedSize);
+  const auto compressedSizeBytes = rle::easyEncode<std::uint16_t>(
+      reinterpret_cast<std::uint16_t*>(data.get()), nvalues, compressed.get(),
+      maxCompressedSize);
+
+  auto decompressed = std::make_unique<std::uint8_t[]>(LargeSizeBytes);
+  EXPECT_EQ(rle::easyDecode<std::uint16_t>(
+                compressed.get(), compressedSizeBytes,
+                reinterpret_cast<std::uint16_t*>(decompressed.get()),
+                LargeSizeBytes),
+            LargeSizeBytes);
+  EXPECT_TRUE(std::equal(data.get(), data.get() + LargeSizeBytes,
+                         decompressed.get()));
+}
+#endif  // TEST_LARGE_INPUTS
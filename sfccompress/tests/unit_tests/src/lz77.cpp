@@ -0,0 +1,153 @@
+/**
+ * @file lz77.cpp
+ * @author Conrad Haupt (conrad@conradhaupt.co.za)
+ * @brief
+ * @version 1.0
+ * @date 2020-03-16
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#include "lz77_decoder.h"
+#include "lz77_encoder.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace {
+std::vector<std::uint8_t> decode(const std::vector<std::uint8_t>& compressed)
+{
+  lz77::decompress_t decompress;
+  std::string remaining;
+  EXPECT_TRUE(decompress.feed(compressed.data(),
+                              compressed.data() + compressed.size(),
+                              remaining));
+  const auto& result = decompress.result();
+  return std::vector<std::uint8_t>(result.begin(), result.end());
+}
+
+// Decode into a buffer of exactly the decoded size
+std::vector<std::uint8_t> decodeDirect(
+    const std::vector<std::uint8_t>& compressed)
+{
+  std::vector<std::uint8_t> decoded(
+      lz77::decodedSizeBytes(compressed.data(), compressed.size()));
+  EXPECT_EQ(lz77::decode(compressed.data(), compressed.size(), decoded.data(),
+                         decoded.size()),
+            decoded.size());
+  return decoded;
+}
+
+std::vector<std::uint8_t> encode(const std::vector<std::uint8_t>& data,
+                                 int level)
+{
+  std::vector<std::uint8_t> compressed(lz77::maxCompressedSize(data.size()));
+  compressed.resize(
+      lz77::encode(data.data(), data.size(), compressed.data(), level));
+  return compressed;
+}
+}  // namespace
+
+TEST(lz77, allLevelsAreReversible)
+{
+  // Repeated phrases at many distances, with runs that overlap their source
+  std::srand(0);
+  std::vector<std::uint8_t> data;
+  while (data.size() < 300000) {
+    if (data.size() > 16 && std::rand() % 4 != 0) {
+      const auto offset = 1 + std::rand() % std::min<int>(data.size(), 70000);
+      const auto length = 1 + std::rand() % 300;
+      for (auto i = 0; i < length; i++)
+        data.push_back(data[data.size() - offset]);
+    } else {
+      data.push_back(std::uint8_t(std::rand()));
+    }
+  }
+
+  std::uint64_t previousSize = data.size();
+  for (auto level = lz77::MinLevel; level <= lz77::MaxLevel; level++) {
+    const auto compressed = encode(data, level);
+    EXPECT_LT(compressed.size(), data.size() / 2) << "level " << level;
+    EXPECT_EQ(decode(compressed), data) << "level " << level;
+    EXPECT_EQ(decodeDirect(compressed), data) << "level " << level;
+    if (level == lz77::MaxLevel) {
+      EXPECT_LE(compressed.size(), previousSize);
+    }
+    previousSize = compressed.size();
+  }
+}
+
+TEST(lz77, incompressibleAndShortInputsStayWithinBound)
+{
+  std::srand(1);
+  for (auto nbytes : {0, 1, 7, 8, 9, 100, 70000}) {
+    std::vector<std::uint8_t> data(nbytes);
+    for (auto& value : data) value = std::uint8_t(std::rand());
+    for (auto level : {lz77::MinLevel, lz77::DefaultLevel, lz77::MaxLevel}) {
+      const auto compressed = encode(data, level);
+      EXPECT_LE(compressed.size(), lz77::maxCompressedSize(nbytes));
+      EXPECT_EQ(decode(compressed), data)
+          << nbytes << " bytes at level " << level;
+      EXPECT_EQ(decodeDirect(compressed), data)
+          << nbytes << " bytes at level " << level;
+    }
+  }
+}
+
+TEST(lz77, invalidLevelThrows)
+{
+  std::vector<std::uint8_t> data(16), compressed(lz77::maxCompressedSize(16));
+  EXPECT_THROW(lz77::encode(data.data(), data.size(), compressed.data(), 0),
+               std::invalid_argument);
+  EXPECT_THROW(lz77::encode(data.data(), data.size(), compressed.data(),
+                            lz77::MaxLevel + 1),
+               std::invalid_argument);
+}
+
+TEST(lz77, overlappingMatchesAreDecoded)
+{
+  // Each period becomes one long match that overlaps its own output
+  for (auto period = 1; period <= 20; period++) {
+    std::vector<std::uint8_t> data;
+    for (auto i = 0; i < period; i++) data.push_back(std::uint8_t(31 * i + 7));
+    for (auto length : {4, 13, 100, 1000}) {
+      auto periodic = data;
+      for (auto i = 0; i < length; i++)
+        periodic.push_back(periodic[periodic.size() - period]);
+      const auto compressed = encode(periodic, lz77::DefaultLevel);
+      EXPECT_EQ(decodeDirect(compressed), periodic) << "period " << period;
+
+      // With slack after the output the wide copies may run past it
+      std::vector<std::uint8_t> decoded(periodic.size() + 64);
+      lz77::decode(compressed.data(), compressed.size(), decoded.data(),
+                   decoded.size());
+      EXPECT_TRUE(
+          std::equal(periodic.begin(), periodic.end(), decoded.begin()))
+          << "period " << period;
+    }
+  }
+}
+
+TEST(lz77, malformedStreamsThrow)
+{
+  std::vector<std::uint8_t> data(1000);
+  for (auto i = 0; i < 1000; i++) data[i] = std::uint8_t(i % 10 + i / 100);
+  auto compressed = encode(data, lz77::DefaultLevel);
+  std::vector<std::uint8_t> decoded(data.size());
+
+  // Too small an output buffer
+  EXPECT_THROW(lz77::decode(compressed.data(), compressed.size(),
+                            decoded.data(), decoded.size() - 1),
+               std::runtime_error);
+  // Truncated input
+  EXPECT_THROW(lz77::decode(compressed.data(), compressed.size() / 2,
+                            decoded.data(), decoded.size()),
+               std::runtime_error);
+  // A match reaching back before the start: size 8, offset 2, short run 4
+  const std::vector<std::uint8_t> beforeStart = {8, ((2 << 3) | 4) << 1};
+  EXPECT_THROW(lz77::decode(beforeStart.data(), beforeStart.size(),
+                            decoded.data(), decoded.size()),
+               std::runtime_error);
+}
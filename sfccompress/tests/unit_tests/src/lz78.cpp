@@ -0,0 +1,88 @@
+/**
+ * @file lz78.cpp
+ * @author Conrad Haupt (conrad@conradhaupt.co.za)
+ * @brief
+ * @version 1.0
+ * @date 2020-03-18
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#include "lz78.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+void expectReversible(const std::uint8_t* data, const unsigned long long size,
+                      const int bits)
+{
+  auto [compressed, compressed_bytes] = ::lz78::easyEncode(data, size, bits);
+  ASSERT_EQ(::lz78::decodedSizeBytes(compressed.get(), compressed_bytes), size);
+  auto decompressed = std::make_unique<std::uint8_t[]>(size);
+  EXPECT_EQ(::lz78::easyDecode(compressed.get(), compressed_bytes,
+                               decompressed.get(), size),
+            size)
+      << "dictionary width " << bits;
+  EXPECT_TRUE(std::equal(data, data + size, decompressed.get()))
+      << "dictionary width " << bits;
+}
+}  // namespace
+
+TEST(lz78, allDictionaryWidthsAreReversible)
+{
+  // Low-entropy data long enough to fill and restart the smaller dictionaries
+  constexpr auto size = 1ULL << 20;
+  auto data = std::make_unique<std::uint8_t[]>(size);
+  std::generate(data.get(), data.get() + size,
+                []() { return std::uint8_t(std::rand() % 16); });
+  for (auto bits :
+       {::lz78::MinDictBits, ::lz78::DefaultDictBits, ::lz78::MaxDictBits})
+    expectReversible(data.get(), size, bits);
+}
+
+TEST(lz78, shortInputsAreReversible)
+{
+  // Inputs ending part way through a known phrase
+  const std::uint8_t data[] = {7, 7, 7, 7, 7, 7};
+  for (auto size = 0ULL; size <= sizeof(data); size++)
+    expectReversible(data, size, ::lz78::DefaultDictBits);
+}
+
+TEST(lz78, truncatedStreamsThrow)
+{
+  constexpr auto size = 4096ULL;
+  auto data = std::make_unique<std::uint8_t[]>(size);
+  std::generate(data.get(), data.get() + size,
+                []() { return std::uint8_t(std::rand()); });
+  auto [compressed, compressed_bytes] = ::lz78::easyEncode(data.get(), size);
+  auto decompressed = std::make_unique<std::uint8_t[]>(size);
+  EXPECT_THROW(::lz78::easyDecode(compressed.get(), compressed_bytes / 2,
+                                  decompressed.get(), size),
+               std::exception);
+  EXPECT_THROW(::lz78::easyDecode(compressed.get(), compressed_bytes,
+                                  decompressed.get(), size - 1),
+               std::runtime_error);
+
+  // Only the last pairs missing
+  EXPECT_THROW(::lz78::easyDecode(compressed.get(), compressed_bytes - 2,
+                                  decompressed.get(), size),
+               std::runtime_error);
+}
+
+TEST(lz78, trailingDataThrows)
+{
+  constexpr auto size = 4096ULL;
+  std::vector<std::uint8_t> data(size);
+  std::generate(data.begin(), data.end(),
+                []() { return std::uint8_t(std::rand()); });
+  auto [compressed, compressed_bytes] = ::lz78::easyEncode(data.data(), size);
+  std::vector<std::uint8_t> padded(compressed.get(),
+                                   compressed.get() + compressed_bytes);
+  padded.push_back(0);
+  std::vector<std::uint8_t> decompressed(size);
+  EXPECT_THROW(::lz78::easyDecode(padded.data(), padded.size(),
+                                  decompressed.data(), size),
+               std::runtime_error);
+}
@@ -10,6 +10,7 @@
  */
 #include "lzw.h"
 #include <gtest/gtest.h>
+#include <algorithm>
 #include <array>
 #include <cstdlib>
 
@@ -21,8 +22,8 @@ TEST(lzw, lzwIsReversible)
   std::generate(data.get(), data.get() + size,
                 []() { return std::uint8_t(std::rand()); });
   std::uint8_t* compressed_temp = nullptr;
-  int compressed_bytes = 0;
-  int compressed_bits = 0;
+  std::uint64_t compressed_bytes = 0;
+  std::uint64_t compressed_bits = 0;
   EXPECT_NO_THROW(::lzw::easyEncode(data.get(), size, &compressed_temp,
                                     &compressed_bytes, &compressed_bits));
   std::uint8_t* decompressed_temp = new std::uint8_t[size];
@@ -32,4 +33,51 @@ TEST(lzw, lzwIsReversible)
   for (auto i = 0ULL; i < size; i++) EXPECT_EQ(data[i], decompressed_temp[i]);
   delete[] decompressed_temp;
   if (compressed_temp != nullptr) delete[] compressed_temp;
-}
\ No newline at end of file
+}
+TEST(lzw, allDictionaryWidthsAreReversible)
+{
+  // Low-entropy data long enough to fill and flush the smaller dictionaries
+  constexpr auto size = 1ULL << 20;
+  auto data = std::make_unique<std::uint8_t[]>(size);
+  std::generate(data.get(), data.get() + size,
+                []() { return std::uint8_t(std::rand() % 16); });
+  for (auto bits : {::lzw::StartBits, ::lzw::DefaultDictBits,
+                    ::lzw::WideDictBits, ::lzw::MaxDictBits}) {
+    std::uint8_t* compressed_temp = nullptr;
+    std::uint64_t compressed_bytes = 0;
+    std::uint64_t compressed_bits = 0;
+    ::lzw::easyEncode(data.get(), size, &compressed_temp, &compressed_bytes,
+                      &compressed_bits, bits);
+    auto decompressed = std::make_unique<std::uint8_t[]>(size);
+    EXPECT_EQ(::lzw::easyDecode(compressed_temp, compressed_bytes,
+                                compressed_bits, decompressed.get(), size,
+                                bits),
+              size)
+        << "dictionary width " << bits;
+    EXPECT_TRUE(std::equal(data.get(), data.get() + size, decompressed.get()))
+        << "dictionary width " << bits;
+    delete[] compressed_temp;
+  }
+}
+
+TEST(lzw, longAndSelfReferencingPhrasesAreReversible)
+{
+  // Runs of a single byte produce codes that refer to the phrase being defined
+  // and phrases much longer than the short-copy path.
+  constexpr auto size = 200000ULL;
+  auto data = std::make_unique<std::uint8_t[]>(size);
+  for (auto i = 0ULL; i < size; i++) data[i] = std::uint8_t((i / 5000) * 7);
+  std::uint8_t* compressed_temp = nullptr;
+  std::uint64_t compressed_bytes = 0;
+  std::uint64_t compressed_bits = 0;
+  ::lzw::easyEncode(data.get(), size, &compressed_temp, &compressed_bytes,
+                    &compressed_bits);
+  // Decode into an exactly sized buffer so that copies near the end cannot
+  // use the wide path.
+  auto decompressed = std::make_unique<std::uint8_t[]>(size);
+  EXPECT_EQ(::lzw::easyDecode(compressed_temp, compressed_bytes,
+                              compressed_bits, decompressed.get(), size),
+            size);
+  EXPECT_TRUE(std::equal(data.get(), data.get() + size, decompressed.get()));
+  delete[] compressed_temp;
+}
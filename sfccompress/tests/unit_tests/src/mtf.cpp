@@ -10,6 +10,9 @@
  */
 #include "mtf.h"
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
 
 TEST(mtf, returnsCorrectSequence)
 {
@@ -36,4 +39,51 @@ TEST(mtf, isReversible)
   for (auto i = 0; i < length; i++) {
     EXPECT_EQ(data[i], reversed_data[i]);
   }
-}
\ No newline at end of file
+}
+namespace {
+// Straightforward move-to-front over a list of every symbol from min to max
+template <typename T, typename TIndex>
+std::vector<TIndex> naiveMTF(const std::vector<T>& data)
+{
+  const auto [min, max] = std::minmax_element(data.begin(), data.end());
+  std::vector<T> alphabet;
+  for (auto symbol = *min;; symbol++) {
+    alphabet.push_back(symbol);
+    if (symbol == *max) break;
+  }
+  std::vector<TIndex> indices;
+  for (auto value : data) {
+    const auto it = std::find(alphabet.begin(), alphabet.end(), value);
+    indices.push_back(it - alphabet.begin());
+    alphabet.erase(it);
+    alphabet.insert(alphabet.begin(), value);
+  }
+  return indices;
+}
+
+template <typename T, typename TIndex>
+void expectMatchesNaiveMTF(const T range)
+{
+  // Runs of random lengths over the whole alphabet, starting above zero
+  std::vector<T> data;
+  while (data.size() < 20000)
+    data.insert(data.end(), std::rand() % 8 + 1, T(7 + std::rand() % range));
+  const auto length = data.size();
+  auto [mtf, min, max] = sfcc::easyMTFAnyuType<T, TIndex>(data.data(), length);
+  const auto expected = naiveMTF<T, TIndex>(data);
+  EXPECT_TRUE(std::equal(expected.begin(), expected.end(), mtf.get()))
+      << sizeof(T) << "-byte symbols";
+  auto reversed_data =
+      sfcc::easyMTFDecodeAnyuType<T, TIndex>(mtf.get(), length, min, max);
+  EXPECT_TRUE(std::equal(data.begin(), data.end(), reversed_data.get()))
+      << sizeof(T) << "-byte symbols";
+}
+}  // namespace
+
+TEST(mtf, matchesNaiveMoveToFront)
+{
+  expectMatchesNaiveMTF<std::uint8_t, std::uint8_t>(240);
+  expectMatchesNaiveMTF<std::uint16_t, std::uint16_t>(3000);
+  expectMatchesNaiveMTF<std::uint32_t, std::uint16_t>(1000);
+  expectMatchesNaiveMTF<std::uint64_t, std::uint32_t>(300);
+}
@@ -0,0 +1,190 @@
+/**
+ * @file pipeline.cpp
+ * @author Conrad Haupt (conrad@conradhaupt.co.za)
+ * @brief
+ * @version 1.0
+ * @date 2020-03-25
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#include "pipeline.h"
+#include <gtest/gtest.h>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "compressor_data.h"
+
+TEST(parsePipeline, readsCurveAndStages)
+{
+  const auto spec =
+      sfcc::parsePipeline("Hilbert|bitshuffle|BWT|mtf|rle|huffman");
+  ASSERT_TRUE(spec.curve);
+  EXPECT_EQ(spec.curve.value(), sfc::sfcc::sfc_t::HILBERT);
+  using sfcc::stage_t;
+  using sfc::sfcc::compression_t;
+  const std::vector<std::uint8_t> expected = {
+      std::uint8_t(stage_t::BITSHUFFLE), std::uint8_t(stage_t::BWT),
+      std::uint8_t(stage_t::MTF),
+      sfcc::codec_stage | std::uint8_t(compression_t::RLE),
+      sfcc::codec_stage | std::uint8_t(compression_t::HUFFMAN)};
+  EXPECT_EQ(spec.stages, expected);
+  EXPECT_EQ(sfcc::pipelineToString(spec.stages),
+            "bitshuffle|bwt|mtf|rle|huffman");
+
+  EXPECT_FALSE(sfcc::parsePipeline("byteshuffle|fse").curve);
+}
+
+TEST(parsePipeline, rejectsMalformedSpecs)
+{
+  for (auto spec : {"", "hilbert", "bwt||huffman", "bwt|zstd",
+                    "bwt|bzip_fse", "huffman|hilbert"})
+    EXPECT_THROW(sfcc::parsePipeline(spec), std::invalid_argument) << spec;
+  std::string tooLong = "mtf";
+  for (auto i = 0; i < sfcc::MaxPipelineStages; i++) tooLong += "|mtf";
+  EXPECT_THROW(sfcc::parsePipeline(tooLong), std::invalid_argument);
+  EXPECT_THROW(sfcc::pipeline({}), std::invalid_argument);
+  EXPECT_THROW(sfcc::make_compressor(sfc::sfcc::compression_t::PIPELINE),
+               std::invalid_argument);
+}
+
+TEST(sfcc_file, readsPipelineStages)
+{
+  sfc::sfcc_header header{};
+  header.ndims = 1;
+  header.sidelength_k = 2;
+  header.dtype_nbytes = 1;
+  header.compressiontype = sfc::sfcc::compression_t::PIPELINE;
+  header.pipeline_stages = sfcc::parsePipeline("bwt|mtf|fse").stages;
+  const auto filename = ::testing::TempDir() + "pipeline_header.sfcc";
+  {
+    std::ofstream file(filename, std::ios::binary);
+    const auto bytes = sfc::HeaderToArray(header);
+    file.write((const char*)bytes.get(), header.size());
+    file.write("data", 4);
+  }
+  sfc::sfcc_file file(filename);
+  EXPECT_EQ(file.getHeader().compressiontype,
+            sfc::sfcc::compression_t::PIPELINE);
+  EXPECT_EQ(file.getHeader().pipeline_stages, header.pipeline_stages);
+  ASSERT_EQ(file.size(), 4ULL);
+  EXPECT_EQ(std::string((const char*)file.getData(), 4), "data");
+}
+
+TEST_P(CompressorDataTestFicture, pipelinesAreReversible)
+{
+  for (auto spec :
+       {"bitshuffle|bwt|mtf|rle|huffman", "bitshuffle|bitplane",
+        "byteshuffle|fse", "byteshuffle|bwt|mtf|rle_varint|huffman16",
+        "bwt|mtf|lzw", "rle|deflate", "mtf|huffman16_x4|lz78",
+        "delta|huffman16", "lorenzo|byteshuffle|fse", "rle|sbwt|mtf|huffman",
+        "sbwt|deflate"}) {
+    SCOPED_TRACE(spec);
+    auto compressor = ::sfcc::pipeline(sfcc::parsePipeline(spec).stages);
+    const auto capacity =
+        compressor.maxCompressedSize(file.size(), file.getHeader());
+    std::vector<std::uint8_t> compressed(capacity);
+    auto [compressed_length, compressed_header] = compressor.compressInto(
+        file.getData(), file.size(), compressed.data(), capacity,
+        file.getHeader());
+    ASSERT_LE(compressed_length, capacity);
+    EXPECT_EQ(compressed_header.compressiontype,
+              sfc::sfcc::compression_t::PIPELINE);
+
+    // Decoded from the stages in the header, as a file would be
+    auto decompressor = ::sfcc::make_compressor(compressed_header);
+    ASSERT_EQ(decompressor->maxDecompressedSize(
+                  compressed.data(), compressed_length, compressed_header),
+              expectedSize);
+    std::vector<std::uint8_t> decompressed(expectedSize);
+    auto [decompressed_length, decompressed_header] =
+        decompressor->decompressInto(compressed.data(), compressed_length,
+                                     decompressed.data(), expectedSize,
+                                     compressed_header);
+    EXPECT_EQ(expectedSize, decompressed_length);
+    EXPECT_TRUE(std::equal(decompressed.begin(), decompressed.end(),
+                           file.getData()));
+  }
+}
+
+TEST_P(CompressorDataTestFicture, lorenzoPipelinesDecodeAlongTheirCurve)
+{
+  // The data is read as if it were stored along each curve, which the Lorenzo
+  // stage reorders to row-major to predict and back
+  for (const auto curve :
+       {sfc::sfcc::sfc_t::HILBERT, sfc::sfcc::sfc_t::MORTON}) {
+    for (auto spec : {"lorenzo|fse", "lorenzo|byteshuffle|huffman"}) {
+      SCOPED_TRACE(spec);
+      auto header = file.getHeader();
+      header.sfctype = curve;
+      auto compressor = ::sfcc::pipeline(sfcc::parsePipeline(spec).stages);
+      std::vector<std::uint8_t> compressed(
+          compressor.maxCompressedSize(file.size(), header));
+      const auto [compressed_length, compressed_header] =
+          compressor.compressInto(file.getData(), file.size(),
+                                  compressed.data(), compressed.size(),
+                                  header);
+
+      // Decoded with the header of the file, as sfccompress decompress does
+      const auto filename = ::testing::TempDir() + "lorenzo_curve.sfcc";
+      {
+        std::ofstream out(filename, std::ios::binary);
+        const auto bytes = sfc::HeaderToArray(compressed_header);
+        out.write((const char*)bytes.get(), compressed_header.size());
+        out.write((const char*)compressed.data(), compressed_length);
+      }
+      sfc::sfcc_file sfile(filename);
+      ASSERT_EQ(sfile.getHeader().sfctype, curve);
+      auto decompressor = ::sfcc::make_compressor(sfile.getHeader());
+      std::vector<std::uint8_t> decompressed(expectedSize);
+      const auto [decompressed_length, decompressed_header] =
+          decompressor->decompressInto(sfile.getData(), sfile.size(),
+                                       decompressed.data(), expectedSize,
+                                       sfile.getHeader());
+      EXPECT_EQ(decompressed_length, expectedSize);
+      EXPECT_TRUE(std::equal(decompressed.begin(), decompressed.end(),
+                             file.getData()));
+
+      // The curve is not recorded with the stage, so the header must keep it
+      auto row_major = sfile.getHeader();
+      row_major.sfctype = sfc::sfcc::sfc_t::ROW_MAJOR;
+      decompressor->decompressInto(sfile.getData(), sfile.size(),
+                                   decompressed.data(), expectedSize,
+                                   row_major);
+      EXPECT_FALSE(std::equal(decompressed.begin(), decompressed.end(),
+                              file.getData()));
+    }
+  }
+}
+
+TEST_P(CompressorDataTestFicture, sbwtStageSortsWholeSamples)
+{
+  const auto& header = file.getHeader();
+  ASSERT_EQ(header.dtype_nbytes, 2);
+  auto compressor = ::sfcc::pipeline(sfcc::parsePipeline("sbwt").stages);
+  std::vector<std::uint8_t> compressed(
+      compressor.maxCompressedSize(file.size(), header));
+  const auto [compressed_length, compressed_header] = compressor.compressInto(
+      file.getData(), file.size(), compressed.data(), compressed.size(),
+      header);
+  // After the stage table, a block of the length, the end-of-line row with
+  // the sample flag and width in its high byte, and one more sample
+  const auto table = sizeof(std::uint64_t) + 1;
+  EXPECT_EQ(compressed[table + 7], 0x80 | 2);
+  EXPECT_EQ(compressed_length, table + 8 + file.size() + 2);
+
+  std::vector<std::uint8_t> decompressed(file.size());
+  const auto [decompressed_length, decompressed_header] =
+      compressor.decompressInto(compressed.data(), compressed_length,
+                                decompressed.data(), decompressed.size(),
+                                compressed_header);
+  EXPECT_EQ(decompressed_length, file.size());
+  EXPECT_TRUE(std::equal(decompressed.begin(), decompressed.end(),
+                         file.getData()));
+
+  // The bwt stage sorts bytes, whose high byte is the number of streams
+  auto bytes = ::sfcc::pipeline(sfcc::parsePipeline("bwt").stages);
+  bytes.compressInto(file.getData(), file.size(), compressed.data(),
+                     compressed.size(), header);
+  EXPECT_LT(compressed[table + 7], 0x80);
+}
@@ -0,0 +1,80 @@
+/**
+ * @file predict.cpp
+ * @author Conrad Haupt (conrad@conradhaupt.co.za)
+ * @brief
+ * @version 1.0
+ * @date 2020-03-28
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#include "predict.h"
+#include <gtest/gtest.h>
+#include <cstring>
+#include <random>
+#include <vector>
+
+TEST(predict, lorenzoResidualsOfAPlaneAreZero)
+{
+  const std::vector<unsigned long long> shape = {16, 8, 4};
+  std::vector<std::int16_t> values(16 * 8 * 4);
+  for (auto z = 0; z < 4; z++)
+    for (auto y = 0; y < 8; y++)
+      for (auto x = 0; x < 16; x++)
+        values[(z * 8 + y) * 16 + x] = std::int16_t(-300 + 7 * x - 5 * y + z);
+  std::vector<std::uint16_t> residuals(values.size());
+  sfcc::predictValues((const std::uint8_t*)values.data(),
+                      (std::uint8_t*)residuals.data(), shape, 2);
+  // Only the first value of every axis has no neighbour before it
+  for (auto z = 0; z < 4; z++)
+    for (auto y = 0; y < 8; y++)
+      for (auto x = 0; x < 16; x++)
+        if (x > 0 && y > 0 && z > 0) {
+          EXPECT_EQ(residuals[(z * 8 + y) * 16 + x], 0);
+        }
+  // -300 zig-zag mapped
+  EXPECT_EQ(residuals[0], 599);
+
+  std::vector<std::int16_t> decoded(values.size());
+  sfcc::reversePredictValues((const std::uint8_t*)residuals.data(),
+                             (std::uint8_t*)decoded.data(), shape, 2);
+  EXPECT_EQ(decoded, values);
+}
+
+TEST(predict, reversibleAlongCurves)
+{
+  std::mt19937 rng(7);
+  std::normal_distribution<float> noise(0, 10);
+  sfc::sfcc_header header{};
+  header.ndims = 2;
+  header.sidelength_k = 5;
+  header.dtype_nbytes = 4;
+  std::vector<float> values(32 * 32);
+  for (std::size_t i = 0; i < values.size(); i++)
+    values[i] = noise(rng) * (i % 3 ? 1 : -1e-30f);
+  const auto data = (const std::uint8_t*)values.data();
+  const auto length = values.size() * sizeof(float);
+  for (const auto curve :
+       {sfc::sfcc::sfc_t::ROW_MAJOR, sfc::sfcc::sfc_t::MORTON,
+        sfc::sfcc::sfc_t::HILBERT}) {
+    header.sfctype = curve;
+    for (const auto predictor :
+         {sfcc::predictor_t::DELTA, sfcc::predictor_t::LORENZO}) {
+      sfcc::Predictor predict(predictor);
+      std::vector<std::uint8_t> residuals(length);
+      std::vector<float> decoded(values.size());
+      predict.predict(data, residuals.data(), length, header);
+      predict.reverse(residuals.data(), (std::uint8_t*)decoded.data(), length,
+                      header);
+      EXPECT_EQ(std::memcmp(decoded.data(), values.data(), length), 0);
+    }
+  }
+
+  sfcc::Predictor lorenzo(sfcc::predictor_t::LORENZO);
+  std::vector<std::uint8_t> residuals(length);
+  EXPECT_THROW(lorenzo.predict(data, residuals.data(), length / 2, header),
+               std::invalid_argument);
+  header.dtype_nbytes = 1;
+  EXPECT_THROW(lorenzo.predict(data, residuals.data(), length, header),
+               std::invalid_argument);
+}
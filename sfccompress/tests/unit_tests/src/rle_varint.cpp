@@ -0,0 +1,123 @@
+/**
+ * @file rle_varint.cpp
+ * @author Conrad Haupt (conrad@conradhaupt.co.za)
+ * @brief
+ * @version 1.0
+ * @date 2020-03-20
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#include "rle_varint.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+#include "compressor.h"
+
+namespace {
+// Runs of every length up to a few thousand elements between stretches of
+// noise, ending in a run that reaches the end of the data
+template <typename T>
+std::vector<T> mixedRuns()
+{
+  std::vector<T> data;
+  for (auto run = 1; run < 5000; run = run * 3 / 2 + 1) {
+    data.insert(std::end(data), run, T(run));
+    for (auto i = 0; i < run % 37; i++) data.push_back(T(std::rand()));
+  }
+  // A literal stretch longer than a single literal token
+  for (auto i = 0ULL; i < 3 * ::rle::MaxLiteralRun; i++)
+    data.push_back(T(i * 7919));
+  data.insert(std::end(data), 300, T(1));
+  return data;
+}
+
+template <typename T>
+void expectReversible()
+{
+  const auto data = mixedRuns<T>();
+  const auto nelements = data.size();
+  const auto bound = ::rle::varintMaxEncodedSize(nelements, sizeof(T));
+  auto compressed = std::make_unique<std::uint8_t[]>(bound);
+  const auto compressed_bytes =
+      ::rle::varintEncode(data.data(), nelements, compressed.get());
+  EXPECT_LE(compressed_bytes, bound);
+
+  std::vector<T> decompressed(nelements);
+  EXPECT_EQ(::rle::varintDecode(compressed.get(), compressed_bytes,
+                                decompressed.data(), nelements),
+            nelements);
+  EXPECT_EQ(data, decompressed);
+}
+}  // namespace
+
+TEST(rle_varint, allElementWidthsAreReversible)
+{
+  expectReversible<std::uint8_t>();
+  expectReversible<std::uint16_t>();
+  expectReversible<std::uint32_t>();
+  expectReversible<std::uint64_t>();
+}
+
+TEST(rle_varint, longRunsTakeASingleToken)
+{
+  const std::vector<std::uint16_t> data(1 << 19, 0xFFFF);
+  std::uint8_t compressed[16];
+  // A varint of three bytes and the element
+  EXPECT_EQ(::rle::varintEncode(data.data(), data.size(), compressed), 5);
+}
+
+TEST(rle_varint, noiseStaysWithinTheBound)
+{
+  std::vector<std::uint8_t> data(1 << 16);
+  std::generate(std::begin(data), std::end(data),
+                []() { return std::uint8_t(std::rand()); });
+  // Short runs that are not worth a run token
+  for (std::size_t i = 0; i + 3 < data.size(); i += 97)
+    std::fill(&data[i], &data[i + 3], 0);
+  const auto bound = ::rle::varintMaxEncodedSize(data.size(), 1);
+  auto compressed = std::make_unique<std::uint8_t[]>(bound);
+  EXPECT_LE(::rle::varintEncode(data.data(), data.size(), compressed.get()),
+            bound);
+}
+
+TEST(rle_varint, malformedStreamsThrow)
+{
+  std::uint32_t output[8];
+  // A run longer than the output
+  const std::uint8_t overrun[] = {(9 << 1) | 1, 1, 2, 3, 4};
+  EXPECT_THROW(::rle::varintDecode(overrun, sizeof(overrun), output, 8),
+               std::runtime_error);
+  // Literals missing their last element
+  const std::uint8_t truncated[] = {2 << 1, 1, 2, 3, 4, 5, 6, 7};
+  EXPECT_THROW(::rle::varintDecode(truncated, sizeof(truncated), output, 8),
+               std::runtime_error);
+  // An unfinished varint
+  const std::uint8_t unfinished[] = {0x80};
+  EXPECT_THROW(::rle::varintDecode(unfinished, sizeof(unfinished), output, 8),
+               std::runtime_error);
+}
+
+TEST(rle_varint, bytesAfterTheLastElementAreKept)
+{
+  const std::uint8_t data[] = {1, 0, 1, 0, 1, 0, 0x5A};
+  sfc::sfcc_header header{};
+  header.dtype_nbytes = 2;
+  header.output_block_length = sizeof(data);
+  sfcc::rle_varint compressor;
+  std::vector<std::uint8_t> compressed(
+      compressor.maxCompressedSize(sizeof(data), header));
+  const auto [compressed_length, compressed_header] = compressor.compressInto(
+      data, sizeof(data), compressed.data(), compressed.size(), header);
+
+  std::vector<std::uint8_t> decompressed(sizeof(data), 0xEE);
+  const auto [decompressed_length, decompressed_header] =
+      compressor.decompressInto(compressed.data(), compressed_length,
+                                decompressed.data(), decompressed.size(),
+                                compressed_header);
+  EXPECT_EQ(decompressed_length, sizeof(data));
+  EXPECT_TRUE(std::equal(std::begin(data), std::end(data),
+                         decompressed.begin()));
+}
@@ -55,4 +55,44 @@ TEST(sfc_t, hilbertIsFourUInt8)
 {
   EXPECT_EQ(std::uint8_t(sfc::sfcc::sfc_t::HILBERT), std::uint8_t(4));
 }
+
+TEST(sfcc_header, sfcTypeByteKeepsBitTransposeBlockSize)
+{
+  sfc::sfcc_header header{};
+  header.sfctype = sfc::sfcc::sfc_t::HILBERT;
+  header.bittransposed = true;
+  // Older files have no block size
+  header.setSfcTypeByte(header.getSfcTypeByte());
+  EXPECT_EQ(header.getSfcTypeByte(), 0b10000100);
+  EXPECT_FALSE(header.bittranspose_block_nbits);
+  EXPECT_EQ(header.bittransposeBlockBytes(), 0ULL);
+
+  for (auto nbits = sfc::sfcc::bittranspose_block_min_nbits;
+       nbits <= sfc::sfcc::bittranspose_block_max_nbits; nbits++) {
+    header.bittranspose_block_nbits = nbits;
+    sfc::sfcc_header parsed{};
+    parsed.setSfcTypeByte(header.getSfcTypeByte());
+    EXPECT_EQ(parsed.sfctype, sfc::sfcc::sfc_t::HILBERT);
+    EXPECT_TRUE(parsed.bittransposed);
+    EXPECT_EQ(parsed.bittransposeBlockBytes(), 1ULL << nbits);
+  }
+}
+
+TEST(sfcc_header, sfcTypeByteKeepsByteShuffle)
+{
+  sfc::sfcc_header header{};
+  header.sfctype = sfc::sfcc::sfc_t::MORTON;
+  header.byteshuffled = true;
+  EXPECT_EQ(header.getSfcTypeByte(), 0b00001010);
+
+  sfc::sfcc_header parsed{};
+  parsed.setSfcTypeByte(header.getSfcTypeByte());
+  EXPECT_EQ(parsed.sfctype, sfc::sfcc::sfc_t::MORTON);
+  EXPECT_TRUE(parsed.byteshuffled);
+  EXPECT_FALSE(parsed.bittransposed);
+  // Older files have neither
+  parsed.setSfcTypeByte(0b00000010);
+  EXPECT_FALSE(parsed.byteshuffled);
+  EXPECT_FALSE(parsed.bittransposed);
+}
 }  // namespace
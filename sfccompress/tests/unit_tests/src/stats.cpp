@@ -0,0 +1,151 @@
+/**
+ * @file stats.cpp
+ * @author Conrad Haupt (conrad@conradhaupt.co.za)
+ * @brief
+ * @version 1.0
+ * @date 2020-03-27
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#include "stats.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <sstream>
+#include <vector>
+#include "compressor_data.h"
+
+TEST(stats, entropyOfKnownData)
+{
+  std::vector<std::uint8_t> constant(4096, 7);
+  auto stats = sfcc::dataStats(constant.data(), constant.size(),
+                               sfcc::value_t::UINT8, 0);
+  EXPECT_DOUBLE_EQ(stats.total.entropy, 0);
+  EXPECT_DOUBLE_EQ(stats.total.entropy1, 0);
+  EXPECT_EQ(stats.total.nruns, 1);
+  EXPECT_EQ(stats.total.max_run, constant.size());
+  EXPECT_TRUE(stats.blocks.empty());
+
+  // Every byte equally often, but each fully predicted by the one before
+  std::vector<std::uint8_t> ramp(256 * 16);
+  for (std::size_t i = 0; i < ramp.size(); i++) ramp[i] = i;
+  stats = sfcc::dataStats(ramp.data(), ramp.size(), sfcc::value_t::UINT8, 0);
+  EXPECT_DOUBLE_EQ(stats.total.entropy, 1);
+  EXPECT_NEAR(stats.total.entropy1, 0, 1e-12);
+  EXPECT_EQ(stats.total.nruns, ramp.size());
+  EXPECT_EQ(stats.total.max_run, 1);
+  EXPECT_DOUBLE_EQ(stats.total.value_entropy, 1);
+  EXPECT_EQ(stats.total.values.min, 0);
+  EXPECT_EQ(stats.total.values.max, 255);
+  EXPECT_DOUBLE_EQ(stats.total.values.mean, 127.5);
+  // The standard deviation of a sample, as pandas gives
+  const auto n = double(ramp.size());
+  EXPECT_NEAR(stats.total.values.std,
+              std::sqrt((256.0 * 256 - 1) / 12 * n / (n - 1)), 1e-9);
+  EXPECT_EQ(stats.total.diffs.count, ramp.size() - 1);
+  EXPECT_EQ(stats.total.diffs.min, -255);
+  EXPECT_EQ(stats.total.diffs.q50, 1);
+}
+
+TEST(stats, describeMatchesPandas)
+{
+  // pandas.Series([1, 2, 3, 4, 10]).describe() and that of its diff()
+  const std::int16_t values[] = {1, 2, 3, 4, 10};
+  const auto stats = sfcc::dataStats((const std::uint8_t*)values,
+                                     sizeof(values), sfcc::value_t::INT16, 0)
+                         .total;
+  EXPECT_EQ(stats.values.count, 5);
+  EXPECT_DOUBLE_EQ(stats.values.mean, 4);
+  EXPECT_NEAR(stats.values.std, 3.5355339059, 1e-9);
+  EXPECT_DOUBLE_EQ(stats.values.q25, 2);
+  EXPECT_DOUBLE_EQ(stats.values.q50, 3);
+  EXPECT_DOUBLE_EQ(stats.values.q75, 4);
+  EXPECT_EQ(stats.diffs.count, 4);
+  EXPECT_DOUBLE_EQ(stats.diffs.mean, 2.25);
+  EXPECT_DOUBLE_EQ(stats.diffs.q25, 1);
+  EXPECT_DOUBLE_EQ(stats.diffs.q50, 1);
+  EXPECT_DOUBLE_EQ(stats.diffs.q75, 2.25);
+  EXPECT_DOUBLE_EQ(stats.diffs.max, 6);
+  // Five distinct values of 16 bits
+  EXPECT_DOUBLE_EQ(stats.value_entropy, std::log2(5) / 16);
+}
+
+TEST(stats, blocksAddUpToTotal)
+{
+  std::vector<std::int16_t> values(10000);
+  for (std::size_t i = 0; i < values.size(); i++)
+    values[i] = std::int16_t((i / 7) * (i % 3 ? 1 : -1));
+  const auto data = reinterpret_cast<const std::uint8_t*>(values.data());
+  const auto length = values.size() * sizeof(std::int16_t);
+  const auto whole = sfcc::dataStats(data, length, sfcc::value_t::INT16, 0);
+  const auto blocked =
+      sfcc::dataStats(data, length, sfcc::value_t::INT16, 1024);
+  ASSERT_EQ(blocked.blocks.size(), (length + 1023) / 1024);
+  EXPECT_EQ(blocked.blocks.back().length, length % 1024);
+
+  auto count = 0ULL;
+  for (const auto& block : blocked.blocks) count += block.values.count;
+  EXPECT_EQ(count, values.size());
+  EXPECT_DOUBLE_EQ(blocked.total.entropy, whole.total.entropy);
+  EXPECT_NEAR(blocked.total.entropy1, whole.total.entropy1, 1e-12);
+  EXPECT_DOUBLE_EQ(blocked.total.value_entropy, whole.total.value_entropy);
+  for (const auto& [b, w] :
+       {std::make_pair(blocked.total.values, whole.total.values),
+        std::make_pair(blocked.total.diffs, whole.total.diffs)}) {
+    EXPECT_EQ(b.count, w.count);
+    EXPECT_NEAR(b.mean, w.mean, 1e-9);
+    EXPECT_NEAR(b.std, w.std, 1e-9);
+    EXPECT_EQ(b.min, w.min);
+    EXPECT_EQ(b.q25, w.q25);
+    EXPECT_EQ(b.q50, w.q50);
+    EXPECT_EQ(b.q75, w.q75);
+    EXPECT_EQ(b.max, w.max);
+  }
+  EXPECT_EQ(blocked.total.nruns, whole.total.nruns);
+  EXPECT_EQ(blocked.total.max_run, whole.total.max_run);
+
+  // A single block is described by sorting rather than by the histograms
+  const auto single =
+      sfcc::dataStats(data, length, sfcc::value_t::INT16, length).blocks[0];
+  EXPECT_DOUBLE_EQ(single.value_entropy, whole.total.value_entropy);
+  EXPECT_EQ(single.values.q25, whole.total.values.q25);
+  EXPECT_EQ(single.values.q75, whole.total.values.q75);
+  EXPECT_EQ(single.diffs.q50, whole.total.diffs.q50);
+
+  EXPECT_THROW(sfcc::dataStats(data, length, sfcc::value_t::INT16, 1023),
+               std::invalid_argument);
+}
+
+TEST_P(CompressorDataTestFicture, statsOfEachCurve)
+{
+  const auto files =
+      sfcc::fileStats(std::get<0>(GetParam()),
+                      {sfc::sfcc::sfc_t::ROW_MAJOR, sfc::sfcc::sfc_t::HILBERT},
+                      16384);
+  ASSERT_EQ(files.size(), 2);
+  const auto& raster = files[0].stats;
+  const auto& hilbert = files[1].stats;
+  EXPECT_EQ(files[1].curve, sfc::sfcc::sfc_t::HILBERT);
+  EXPECT_EQ(raster.blocks.size(), (file.size() + 16383) / 16384);
+  // Reordering changes neither the bytes nor the values, only their order
+  EXPECT_DOUBLE_EQ(raster.total.entropy, hilbert.total.entropy);
+  EXPECT_DOUBLE_EQ(raster.total.value_entropy, hilbert.total.value_entropy);
+  EXPECT_EQ(raster.total.values.count, hilbert.total.values.count);
+  EXPECT_EQ(raster.total.values.min, hilbert.total.values.min);
+  EXPECT_EQ(raster.total.values.q50, hilbert.total.values.q50);
+  EXPECT_EQ(raster.total.values.max, hilbert.total.values.max);
+  EXPECT_NEAR(raster.total.values.mean, hilbert.total.values.mean, 1e-6);
+
+  std::ostringstream csv;
+  sfcc::writeStatsCSV(csv, files);
+  auto nlines = 0;
+  for (const auto c : csv.str()) nlines += c == '\n';
+  EXPECT_EQ(nlines, 1 + 2 * (1 + raster.blocks.size()));
+  EXPECT_EQ(csv.str().rfind("Filename;sfc;bit-transposed;compression;"
+                            "Total Entropy;count;mean;std;min;25%;50%;",
+                            0),
+            0);
+  std::ostringstream json;
+  sfcc::writeStatsJSON(json, files);
+  EXPECT_NE(json.str().find("\"sfc\": \"Hilbert\""), std::string::npos);
+}
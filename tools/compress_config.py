@@ -29,7 +29,9 @@ import sys
 from itertools import product
 
 compression_schemes = ['HUFFMAN', 'LZ77', 'LZW',
-                       'RLE', 'NONE', 'BWT', 'BZIP_LZ77', 'BZIP_LZW']
+                       'RLE', 'NONE', 'BWT', 'BZIP_LZ77', 'BZIP_LZW',
+                       'HUFFMAN16', 'HUFFMAN16_X4', 'FSE', 'BZIP_FSE', 'BITPLANE',
+                       'LZ78', 'DEFLATE', 'RLE_VARINT']
 curves = ['ROW_MAJOR', 'MORTON', 'GRAY_CODE', 'HILBERT']
 bitshuffle = ['-B', '-b']
 
@@ -84,6 +84,18 @@ def COMPTYPE(compint):
         return 'BWTW'
     elif compint == 9:
         return 'BWT'
+    elif compint == 10:
+        return 'Huffman16'
+    elif compint == 11:
+        return 'Huffman16X4'
+    elif compint == 12:
+        return 'FSE'
+    elif compint == 13:
+        return 'BWTF'
+    elif compint == 14:
+        return 'BitPlane'
+    elif compint == 15:
+        return 'RLEV'
     else:
         return 'Null'
 
@@ -115,12 +127,16 @@ def getStats(filename, headings):
     # Extract encoded bit-transpose from sfctype
     bittransposed_int = sfctype & 0b10000000
     bit_transposed = bittransposed_int != 0
-    # Reset bit-transpose from sfctype
-    sfctype = sfctype & 0b01111111
+    # Reset bit-transpose and its block size from sfctype
+    sfctype = sfctype & 0b00000111
 
     comptype = header[4]
     if comptype in [2, 5, 6]:
         np.frombuffer(sfcc.read(1), dtype=np.uint8)
+    # Pipelines list their stages after a count
+    if comptype == 16:
+        nstages = np.frombuffer(sfcc.read(1), dtype=np.uint8)[0]
+        sfcc.read(nstages)
 
     def entropy(data, base=256):
         e = np.float64(0)
@@ -59,6 +59,18 @@ def COMPTYPE(compint):
         return 'BWTW'
     elif compint == 9:
         return 'BWT'
+    elif compint == 10:
+        return 'Huffman16'
+    elif compint == 11:
+        return 'Huffman16X4'
+    elif compint == 12:
+        return 'FSE'
+    elif compint == 13:
+        return 'BWTF'
+    elif compint == 14:
+        return 'BitPlane'
+    elif compint == 15:
+        return 'RLEV'
     else:
         return 'Null'
 